@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <libavutil/frame.h>
+
+#include "audio_mixer.h"
+#include "config.h"
+}
+
+#include "bench_util.h"
+#include "sample_convert.h"
+
+// cost of one mixer tick with 30 talking participants on each SIMD level. Participants send
+// decoder sized frames (1024 samples), so pushes and ticks are not aligned as in real call.
+// Budget is one tick (20 ms) of wall time
+
+static constexpr int kSources = 30;
+static constexpr int kTicks   = 5000;
+static constexpr int kRate    = SELECON_DEFAULT_AUDIO_SAMPLE_RATE;
+static constexpr int kTick    = kRate * SELECON_MIXER_TICK / 1000;
+
+TEST(AudioMixer, Mix30Streams) {
+	std::vector<AVFrame*> frames;
+	for (int i = 0; i < kSources; ++i)
+		frames.push_back(bench_audio_frame(AV_SAMPLE_FMT_FLTP,
+		                                   kRate,
+		                                   SELECON_DEFAULT_AUDIO_CHANNELS,
+		                                   SELECON_DEFAULT_AUDIO_FRAME_SIZE,
+		                                   0,
+		                                   200.0 + 37.0 * i));
+	enum SConvSimd detected = sconv_simd_detect();
+	for (int l = SCONV_SIMD_NONE; l <= detected; ++l) {
+		enum SConvSimd level = sconv_set_simd_level((SConvSimd)l);
+		SAudioMixer mixer;
+		ASSERT_EQ(smixer_init(&mixer, kRate, SELECON_DEFAULT_AUDIO_CHANNELS, kTick), SELECON_OK);
+		AVFrame* out = av_frame_alloc();
+		BenchStat mix_stat, push_stat;
+		int64_t pushed = 0;  // samples per source
+		for (int t = 0; t < kTicks; ++t) {
+			// keep every source prefill ahead of mixer clock
+			while (pushed < (int64_t)(t + SELECON_MIXER_PREFILL) * kTick) {
+				for (int i = 0; i < kSources; ++i) {
+					int64_t start = bench_now_ns();
+					ASSERT_EQ(smixer_push(&mixer, i + 1, frames[i]), SELECON_OK);
+					push_stat.add(bench_now_ns() - start);
+				}
+				pushed += SELECON_DEFAULT_AUDIO_FRAME_SIZE;
+			}
+			int64_t start = bench_now_ns();
+			ASSERT_EQ(smixer_mix(&mixer, out), kSources);
+			mix_stat.add(bench_now_ns() - start);
+		}
+		char title[128];
+		snprintf(title, sizeof(title), "mix %d streams tick %s", kSources, sconv_simd_str(level));
+		mix_stat.print(title);
+		snprintf(title, sizeof(title), "push frame %s", sconv_simd_str(level));
+		push_stat.print(title);
+		printf("  tick budget used: %.3f%%\n", mix_stat.avg_us() / (SELECON_MIXER_TICK * 10.0));
+		av_frame_free(&out);
+		smixer_free(&mixer);
+	}
+	sconv_set_simd_level(detected);
+	for (AVFrame*& frame : frames) av_frame_free(&frame);
+}
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+
+#include "vad.h"
+}
+
+#include "active_speakers.h"
+#include "bench_util.h"
+#include "codec_options.h"
+#include "config.h"
+
+// receiver CPU in 30 participant conference: 3 people talk, others have open microphones with
+// room noise above VAD threshold (no DTX). All 29 streams are decoded without policy, with top K
+// only loudest ones are, others are dropped by header level before decoder
+
+static constexpr int kRate        = SELECON_DEFAULT_AUDIO_SAMPLE_RATE;
+static constexpr int kChannels    = SELECON_DEFAULT_AUDIO_CHANNELS;
+static constexpr int kFrameSize   = SELECON_DEFAULT_AUDIO_FRAME_SIZE;
+static constexpr int kSenders     = 29;
+static constexpr int kTalking     = 3;
+static constexpr int kFrames      = 500;  // about 10 seconds
+static constexpr timestamp_t kGap = 1000000000ULL * kFrameSize / kRate;
+
+struct EncodedStream {
+	std::vector<AVPacket*> packets;
+	std::vector<float> levels;
+};
+
+// pre-encoded audio of talking participant (tone) and of open microphone (noise)
+static EncodedStream encode(bool talking) {
+	EncodedStream res;
+	const AVCodec* codec = avcodec_find_encoder(SELECON_DEFAULT_AUDIO_CODEC_ID);
+	AVCodecContext* ctx  = avcodec_alloc_context3(codec);
+	ctx->sample_fmt      = SELECON_DEFAULT_AUDIO_SAMPLE_FMT;
+	ctx->sample_rate     = kRate;
+	ctx->frame_size      = kFrameSize;
+	ctx->time_base       = av_make_q(1, 1000);
+	av_channel_layout_default(&ctx->ch_layout, kChannels);
+	SCodecOptions opts = {};
+	scodec_options_preset(&opts, SCODEC_PRESET_CONFERENCE, ctx);
+	EXPECT_EQ(scodec_open(ctx, codec, &opts), 0);
+	scodec_options_free(&opts);
+	AVPacket* packet = av_packet_alloc();
+	uint32_t state   = 1;
+	for (int i = 0; i <= kFrames; ++i) {
+		AVFrame* frame = nullptr;
+		if (i < kFrames) {
+			frame = bench_audio_frame(
+			    ctx->sample_fmt, kRate, kChannels, kFrameSize, (int64_t)i * kFrameSize, 220.0);
+			frame->time_base = ctx->time_base;
+			frame->pts       = (int64_t)i * kFrameSize * 1000 / kRate;
+			for (int c = 0; c < kChannels && !talking; ++c)
+				for (int s = 0; s < kFrameSize; ++s) {
+					state       = state * 1664525u + 1013904223u;
+					float noise = ((state >> 8) / (float)(1 << 24) - 0.5f) * 0.01f;  // -51 dBov
+					((float*)frame->data[c])[s] = noise;
+				}
+		}
+		float level = frame != nullptr ? svad_frame_level(frame) : -127.0f;
+		EXPECT_EQ(avcodec_send_frame(ctx, frame), 0);
+		while (avcodec_receive_packet(ctx, packet) == 0) {
+			res.packets.push_back(av_packet_clone(packet));
+			res.levels.push_back(level);
+			av_packet_unref(packet);
+		}
+		av_frame_free(&frame);
+	}
+	av_packet_free(&packet);
+	avcodec_free_context(&ctx);
+	return res;
+}
+
+static double run(const EncodedStream& talk, const EncodedStream& noise, size_t top_k) {
+	const AVCodec* codec = avcodec_find_decoder(SELECON_DEFAULT_AUDIO_CODEC_ID);
+	std::vector<AVCodecContext*> decoders;
+	std::vector<bool> resync(kSenders, false);
+	for (int s = 0; s < kSenders; ++s) {
+		AVCodecContext* ctx = avcodec_alloc_context3(codec);
+		ctx->sample_rate    = kRate;
+		ctx->time_base      = av_make_q(1, 1000);
+		ctx->pkt_timebase   = av_make_q(1, 1000);
+		av_channel_layout_default(&ctx->ch_layout, kChannels);
+		EXPECT_EQ(avcodec_open2(ctx, codec, nullptr), 0);
+		decoders.push_back(ctx);
+	}
+	SSpeakerTracker tracker;
+	sspeak_init(&tracker);
+	AVFrame* frame    = av_frame_alloc();
+	size_t nb_packets = std::min(talk.packets.size(), noise.packets.size());
+	timestamp_t now   = 1000000000ULL;
+	int64_t decoded   = 0;
+	int64_t start     = bench_cpu_ns();
+	for (size_t i = 0; i < nb_packets; ++i, now += kGap) {
+		for (int s = 0; s < kSenders; ++s) {
+			const EncodedStream& src = s < kTalking ? talk : noise;
+			// talkers differ a bit in loudness as real people do
+			float level = src.levels[i] - (s < kTalking ? 3.0f * s : 0.0f);
+			sspeak_update(&tracker, s + 1, level, now);
+			if (top_k > 0 && !sspeak_in_top(&tracker, s + 1, top_k, now)) {
+				resync[s] = true;
+				continue;
+			}
+			if (resync[s]) {
+				avcodec_flush_buffers(decoders[s]);
+				resync[s] = false;
+			}
+			EXPECT_EQ(avcodec_send_packet(decoders[s], src.packets[i]), 0);
+			while (avcodec_receive_frame(decoders[s], frame) == 0) {
+				++decoded;
+				av_frame_unref(frame);
+			}
+		}
+	}
+	double cpu_ms  = (bench_cpu_ns() - start) / 1e6;
+	double seconds = (double)nb_packets * kFrameSize / kRate;
+	printf("top_k=%-2zu decoded=%6lld frames cpu=%6.1fms/s\n",
+	       top_k,
+	       (long long)decoded,
+	       cpu_ms / seconds);
+	av_frame_free(&frame);
+	sspeak_free(&tracker);
+	for (AVCodecContext*& ctx : decoders) avcodec_free_context(&ctx);
+	return cpu_ms;
+}
+
+TEST(AudioTopK, Decode30Participants) {
+	if (avcodec_find_encoder(SELECON_DEFAULT_AUDIO_CODEC_ID) == nullptr) {
+		printf("%s encoder not available, skipping\n",
+		       avcodec_get_name(SELECON_DEFAULT_AUDIO_CODEC_ID));
+		return;
+	}
+	EncodedStream talk  = encode(true);
+	EncodedStream noise = encode(false);
+	double all          = run(talk, noise, 0);
+	for (size_t k : {1, 3, 5}) {
+		double top = run(talk, noise, k);
+		printf("  saved %.1f%% of decoding cpu\n", 100.0 * (1.0 - top / all));
+	}
+	for (EncodedStream* s : {&talk, &noise})
+		for (AVPacket*& p : s->packets) av_packet_free(&p);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/frame.h>
+}
+
+// helpers shared by benchmarks. Benchmarks are regular gtest cases, but they are
+// built into separate executable and not registered in ctest, because they take long
+// and results only make sense on idle machine
+
+static inline int64_t bench_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// CPU time consumed by whole process (all threads)
+static inline int64_t bench_cpu_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// accumulates samples (in nanoseconds) and prints summary
+class BenchStat {
+public:
+	void add(int64_t ns) { samples.push_back(ns); }
+
+	size_t count() const { return samples.size(); }
+
+	double avg_us() const {
+		if (samples.empty())
+			return 0.0;
+		double sum = 0.0;
+		for (int64_t s : samples) sum += s;
+		return sum / samples.size() / 1000.0;
+	}
+
+	double percentile_us(double p) {
+		if (samples.empty())
+			return 0.0;
+		std::sort(samples.begin(), samples.end());
+		size_t index = std::min(samples.size() - 1, (size_t)(p * samples.size()));
+		return samples[index] / 1000.0;
+	}
+
+	void print(const char* name) {
+		printf("%-40s n=%-6zu avg=%10.2fus p50=%10.2fus p95=%10.2fus p99=%10.2fus\n",
+		       name,
+		       count(),
+		       avg_us(),
+		       percentile_us(0.50),
+		       percentile_us(0.95),
+		       percentile_us(0.99));
+	}
+
+private:
+	std::vector<int64_t> samples;
+};
+
+// moving gradient with a bouncing box, so encoders have some motion to work on
+static inline AVFrame* bench_video_frame(
+    AVPixelFormat fmt, int width, int height, int64_t index, AVRational time_base) {
+	AVFrame* frame   = av_frame_alloc();
+	frame->format    = fmt;
+	frame->width     = width;
+	frame->height    = height;
+	frame->pts       = index;
+	frame->time_base = time_base;
+	av_frame_get_buffer(frame, 0);
+	for (int y = 0; y < height; ++y)
+		for (int x = 0; x < width; ++x)
+			frame->data[0][y * frame->linesize[0] + x] = (uint8_t)(x + y + index * 3);
+	for (int y = 0; y < height / 2; ++y)
+		for (int x = 0; x < width / 2; ++x) {
+			frame->data[1][y * frame->linesize[1] + x] = (uint8_t)(128 + x - index);
+			frame->data[2][y * frame->linesize[2] + x] = (uint8_t)(128 + y + index);
+		}
+	int box = std::min(width, height) / 4;
+	int bx  = (int)(index * 4 % (width - box));
+	int by  = (int)(index * 2 % (height - box));
+	for (int y = by; y < by + box; ++y)
+		for (int x = bx; x < bx + box; ++x) frame->data[0][y * frame->linesize[0] + x] = 235;
+	return frame;
+}
+
+// sine tone of given frequency
+static inline AVFrame* bench_audio_frame(AVSampleFormat fmt,
+                                         int sample_rate,
+                                         int channels,
+                                         int nb_samples,
+                                         int64_t first_sample,
+                                         double freq = 440.0) {
+	AVFrame* frame     = av_frame_alloc();
+	frame->format      = fmt;
+	frame->sample_rate = sample_rate;
+	frame->nb_samples  = nb_samples;
+	frame->pts         = first_sample;
+	frame->time_base   = av_make_q(1, sample_rate);
+	av_channel_layout_default(&frame->ch_layout, channels);
+	av_frame_get_buffer(frame, 0);
+	for (int i = 0; i < nb_samples; ++i) {
+		double v = 0.5 * sin(2 * M_PI * freq * (first_sample + i) / sample_rate);
+		for (int c = 0; c < channels; ++c) {
+			switch (fmt) {
+				case AV_SAMPLE_FMT_S16:
+					((int16_t*)frame->data[0])[i * channels + c] = (int16_t)(v * INT16_MAX);
+					break;
+				case AV_SAMPLE_FMT_S16P:
+					((int16_t*)frame->data[c])[i] = (int16_t)(v * INT16_MAX);
+					break;
+				case AV_SAMPLE_FMT_FLT: ((float*)frame->data[0])[i * channels + c] = v; break;
+				case AV_SAMPLE_FMT_FLTP: ((float*)frame->data[c])[i] = v; break;
+				default: break;
+			}
+		}
+	}
+	return frame;
+}
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include "bench_util.h"
+#include "codec_options.h"
+#include "config.h"
+
+// encode latency and bitrate of each codec preset on synthetic video
+//
+// latency is reported twice: wall time spent in send/receive per frame and lookahead in frames
+// (how many frames were sent before first packet came out). Realtime presets must have zero
+// lookahead, otherwise every frame is delayed by lookahead / fps on the sender side
+
+struct PresetCase {
+	AVCodecID codec_id;
+	int width;
+	int height;
+};
+
+class CodecPresets : public testing::TestWithParam<PresetCase> {};
+
+static constexpr int kFrameCount = 300;
+static constexpr int kFps        = SELECON_DEFAULT_VIDEO_FPS;
+
+static void run_preset(const PresetCase& pc, SCodecPreset preset) {
+	const AVCodec* codec = avcodec_find_encoder(pc.codec_id);
+	if (codec == nullptr) {
+		printf("%s encoder not available, skipping\n", avcodec_get_name(pc.codec_id));
+		return;
+	}
+	AVCodecContext* ctx = avcodec_alloc_context3(codec);
+	ASSERT_NE(ctx, nullptr);
+	ctx->pix_fmt   = AV_PIX_FMT_YUV420P;
+	ctx->width     = pc.width;
+	ctx->height    = pc.height;
+	ctx->framerate = av_make_q(kFps, 1);
+	ctx->time_base = av_make_q(1, kFps);
+
+	SCodecOptions opts = {};
+	ASSERT_EQ(scodec_options_preset(&opts, preset, ctx), SELECON_OK);
+	ASSERT_EQ(scodec_open(ctx, codec, &opts), 0);
+	scodec_options_free(&opts);
+
+	AVPacket* packet   = av_packet_alloc();
+	BenchStat stat;
+	int64_t total_size = 0;
+	int lookahead      = -1;
+	int64_t cpu_start  = bench_cpu_ns();
+	for (int i = 0; i <= kFrameCount; ++i) {
+		AVFrame* frame =
+		    i < kFrameCount ? bench_video_frame(ctx->pix_fmt, ctx->width, ctx->height, i, ctx->time_base)
+		                    : nullptr;  // flush
+		int64_t start = bench_now_ns();
+		ASSERT_EQ(avcodec_send_frame(ctx, frame), 0);
+		while (avcodec_receive_packet(ctx, packet) == 0) {
+			if (lookahead < 0)
+				lookahead = i;
+			total_size += packet->size;
+			av_packet_unref(packet);
+		}
+		if (frame != nullptr)
+			stat.add(bench_now_ns() - start);
+		av_frame_free(&frame);
+	}
+	double cpu_ms = (bench_cpu_ns() - cpu_start) / 1e6;
+
+	char name[128];
+	snprintf(name,
+	         sizeof(name),
+	         "%s %dx%d %s",
+	         codec->name,
+	         pc.width,
+	         pc.height,
+	         scodec_preset_str(preset));
+	stat.print(name);
+	printf("%-40s lookahead=%d frames cpu=%.1fms/s bitrate=%.1fkbps\n",
+	       "",
+	       lookahead,
+	       cpu_ms * kFps / kFrameCount,
+	       total_size * 8.0 * kFps / kFrameCount / 1000.0);
+
+	av_packet_free(&packet);
+	avcodec_free_context(&ctx);
+}
+
+TEST_P(CodecPresets, encodeLatency) {
+	for (SCodecPreset preset :
+	     {SCODEC_PRESET_NONE, SCODEC_PRESET_CONFERENCE, SCODEC_PRESET_LOW_CPU, SCODEC_PRESET_QUALITY})
+		run_preset(GetParam(), preset);
+}
+
+INSTANTIATE_TEST_SUITE_P(Bench,
+                         CodecPresets,
+                         testing::Values(PresetCase{AV_CODEC_ID_H264, 320, 180},
+                                         PresetCase{AV_CODEC_ID_H264, 1280, 720},
+                                         PresetCase{AV_CODEC_ID_VP8, 320, 180},
+                                         PresetCase{AV_CODEC_ID_VP8, 1280, 720}));
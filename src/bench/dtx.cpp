@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/samplefmt.h>
+
+#include "message.h"
+#include "vad.h"
+}
+
+#include "bench_util.h"
+#include "codec_options.h"
+#include "config.h"
+
+// bandwidth and CPU saved by DTX on typical conference audio: participant talks 30% of time,
+// rest is quiet room noise. Sender cost is VAD plus encoding, receiver cost is decoding (or
+// playing silence for markers). Bytes are full media messages, in mesh each is sent N-1 times
+
+static constexpr int kRate      = SELECON_DEFAULT_AUDIO_SAMPLE_RATE;
+static constexpr int kChannels  = SELECON_DEFAULT_AUDIO_CHANNELS;
+static constexpr int kFrameSize = SELECON_DEFAULT_AUDIO_FRAME_SIZE;
+static constexpr int kFrames    = 3000;    // about 64 seconds
+static constexpr int kSpurt     = 50;      // frames in talk spurt or pause unit (~1s)
+static constexpr int kMeshPeers = 29;      // 30 participants
+static constexpr double kNoise  = 0.0003;  // about -73 dBov
+
+static bool talking(int index) { return index / kSpurt % 10 < 3; }
+
+// voice-like tone during talk spurts, low noise otherwise
+static AVFrame* speech_frame(int index, uint32_t& state) {
+	AVFrame* frame = bench_audio_frame(
+	    AV_SAMPLE_FMT_FLTP, kRate, kChannels, kFrameSize, (int64_t)index * kFrameSize, 220.0);
+	for (int c = 0; c < kChannels; ++c) {
+		float* samples = (float*)frame->data[c];
+		for (int i = 0; i < kFrameSize; ++i) {
+			state       = state * 1664525u + 1013904223u;
+			float noise = ((state >> 8) / (float)(1 << 24) * 2.0f - 1.0f) * kNoise;
+			samples[i]  = talking(index) ? samples[i] * 0.6f + noise : noise;
+		}
+	}
+	frame->time_base = av_make_q(1, 1000);
+	frame->pts       = (int64_t)index * kFrameSize * 1000 / kRate;
+	return frame;
+}
+
+struct DtxResult {
+	int64_t bytes        = 0;
+	int64_t encoded      = 0;  // frames
+	int64_t markers      = 0;
+	double encode_cpu_ms = 0.0;
+	double decode_cpu_ms = 0.0;
+};
+
+static AVCodecContext* open_coder(const AVCodec* codec, bool encoder) {
+	AVCodecContext* ctx = avcodec_alloc_context3(codec);
+	ctx->sample_fmt     = SELECON_DEFAULT_AUDIO_SAMPLE_FMT;
+	ctx->sample_rate    = kRate;
+	ctx->frame_size     = kFrameSize;
+	ctx->time_base      = av_make_q(1, 1000);
+	av_channel_layout_default(&ctx->ch_layout, kChannels);
+	SCodecOptions opts = {};
+	if (encoder)
+		scodec_options_preset(&opts, SCODEC_PRESET_CONFERENCE, ctx);
+	EXPECT_EQ(scodec_open(ctx, codec, &opts), 0);
+	scodec_options_free(&opts);
+	return ctx;
+}
+
+static DtxResult run(const std::vector<AVFrame*>& frames, bool dtx) {
+	DtxResult res;
+	const AVCodec* enc_codec = avcodec_find_encoder(SELECON_DEFAULT_AUDIO_CODEC_ID);
+	const AVCodec* dec_codec = avcodec_find_decoder(SELECON_DEFAULT_AUDIO_CODEC_ID);
+	AVCodecContext* enc      = open_coder(enc_codec, true);
+	AVCodecContext* dec      = open_coder(dec_codec, false);
+	AVPacket* packet         = av_packet_alloc();
+	AVFrame* decoded         = av_frame_alloc();
+	std::vector<AVPacket*> sent;
+	SVad vad;
+	svad_init(&vad, SELECON_VAD_THRESHOLD, kRate * SELECON_VAD_HANGOVER / 1000);
+	const int marker_interval = kRate * SELECON_DTX_MARKER_INTERVAL / 1000 / kFrameSize;
+	int silence               = 0;  // frames not reported yet
+	int silent_for            = 0;  // frames since silence start
+	std::vector<int> markers;       // samples per marker, in send order with packets as -1
+
+	int64_t cpu_start = bench_cpu_ns();
+	for (AVFrame* frame : frames) {
+		bool voiced = !dtx || svad_process(&vad, frame);
+		if (!voiced) {
+			++silence;
+			if (silent_for++ % marker_interval == 0) {
+				markers.push_back(silence * kFrameSize);
+				silence = 0;
+			}
+			continue;
+		}
+		if (silence > 0) {
+			markers.push_back(silence * kFrameSize);
+			silence = 0;
+		}
+		silent_for = 0;
+		EXPECT_EQ(avcodec_send_frame(enc, frame), 0);
+		while (avcodec_receive_packet(enc, packet) == 0) {
+			sent.push_back(av_packet_clone(packet));
+			markers.push_back(-1);
+			av_packet_unref(packet);
+		}
+		++res.encoded;
+	}
+	res.encode_cpu_ms = (bench_cpu_ns() - cpu_start) / 1e6;
+
+	for (AVPacket* p : sent) {
+		SMessage* msg = message_audio_alloc(1, -20.0f, p);
+		res.bytes += msg->size;
+		message_free(&msg);
+	}
+	for (int m : markers)
+		if (m >= 0) {
+			res.bytes += sizeof(SMsgAudioSilence);
+			++res.markers;
+		}
+
+	// receiver: packets are decoded, markers turn into silent frames as in input worker
+	cpu_start   = bench_cpu_ns();
+	size_t next = 0;
+	for (int m : markers) {
+		if (m < 0) {
+			EXPECT_GE(avcodec_send_packet(dec, sent[next++]), 0);
+			while (avcodec_receive_frame(dec, decoded) == 0) av_frame_unref(decoded);
+			continue;
+		}
+		for (int left = m; left > 0; left -= kFrameSize) {
+			decoded->format      = dec->sample_fmt;
+			decoded->sample_rate = kRate;
+			decoded->nb_samples  = std::min(left, kFrameSize);
+			av_channel_layout_default(&decoded->ch_layout, kChannels);
+			av_frame_get_buffer(decoded, 0);
+			av_samples_set_silence(
+			    decoded->extended_data, 0, decoded->nb_samples, kChannels, dec->sample_fmt);
+			av_frame_unref(decoded);
+		}
+	}
+	res.decode_cpu_ms = (bench_cpu_ns() - cpu_start) / 1e6;
+
+	for (AVPacket*& p : sent) av_packet_free(&p);
+	av_frame_free(&decoded);
+	av_packet_free(&packet);
+	avcodec_free_context(&dec);
+	avcodec_free_context(&enc);
+	return res;
+}
+
+TEST(Dtx, TalkSpurts) {
+	AVCodecID codec_id = SELECON_DEFAULT_AUDIO_CODEC_ID;
+	if (avcodec_find_encoder(codec_id) == nullptr) {
+		printf("%s encoder not available, skipping\n", avcodec_get_name(codec_id));
+		return;
+	}
+	std::vector<AVFrame*> frames;
+	uint32_t state = 1;
+	for (int i = 0; i < kFrames; ++i) frames.push_back(speech_frame(i, state));
+	const double seconds = (double)kFrames * kFrameSize / kRate;
+	DtxResult full       = run(frames, false);
+	DtxResult dtx        = run(frames, true);
+	for (AVFrame*& frame : frames) av_frame_free(&frame);
+	for (const auto& [name, res] : {std::make_pair("no dtx", full), std::make_pair("dtx", dtx)}) {
+		printf("%-8s encoded=%5lld frames markers=%4lld uplink=%6.1fkbps mesh=%7.1fkbps "
+		       "encode=%5.1fms/s decode=%5.1fms/s\n",
+		       name,
+		       (long long)res.encoded,
+		       (long long)res.markers,
+		       res.bytes * 8.0 / seconds / 1000.0,
+		       res.bytes * 8.0 * kMeshPeers / seconds / 1000.0,
+		       res.encode_cpu_ms / seconds,
+		       res.decode_cpu_ms / seconds);
+	}
+	printf("saved: bandwidth %.1f%%, encode cpu %.1f%%, decode cpu %.1f%%\n",
+	       100.0 * (1.0 - (double)dtx.bytes / full.bytes),
+	       100.0 * (1.0 - dtx.encode_cpu_ms / full.encode_cpu_ms),
+	       100.0 * (1.0 - dtx.decode_cpu_ms / full.decode_cpu_ms));
+	EXPECT_LT(dtx.encoded, full.encoded / 2);
+}
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <libavutil/frame.h>
+
+#include "media_filters.h"
+}
+
+#include "bench_util.h"
+#include "config.h"
+
+// per-frame cost of MediaFilterGraph when frames already have stream format, with passthrough
+// and with graph forced (allow_bypass cleared)
+
+static constexpr int kFrames = 5000;
+
+static void run_filter(MediaFilterGraph* graph, AVFrame* src, const char* name) {
+	AVFrame* in  = av_frame_alloc();
+	AVFrame* out = av_frame_alloc();
+	BenchStat stat;
+	for (int i = 0; i < kFrames; ++i) {
+		av_frame_ref(in, src);
+		int64_t start = bench_now_ns();
+		ASSERT_EQ(mfgraph_send(graph, in), SELECON_OK);
+		while (mfgraph_receive(graph, out) >= 0) av_frame_unref(out);
+		stat.add(bench_now_ns() - start);
+	}
+	stat.print(name);
+	av_frame_free(&in);
+	av_frame_free(&out);
+}
+
+TEST(FilterBypass, Audio) {
+	AVFrame* src = bench_audio_frame(SELECON_DEFAULT_AUDIO_SAMPLE_FMT,
+	                                 SELECON_DEFAULT_AUDIO_SAMPLE_RATE,
+	                                 SELECON_DEFAULT_AUDIO_CHANNELS,
+	                                 SELECON_DEFAULT_AUDIO_FRAME_SIZE,
+	                                 0);
+	for (bool bypass : {false, true}) {
+		MediaFilterGraph graph;
+		mfgraph_init_audio(&graph,
+		                   SELECON_DEFAULT_AUDIO_SAMPLE_FMT,
+		                   SELECON_DEFAULT_AUDIO_SAMPLE_RATE,
+		                   SELECON_DEFAULT_AUDIO_CHANNELS,
+		                   SELECON_DEFAULT_AUDIO_FRAME_SIZE);
+		graph.allow_bypass = bypass;
+		run_filter(
+		    &graph, src, bypass ? "audio fltp 48k stereo bypass" : "audio fltp 48k stereo graph");
+		mfgraph_free(&graph);
+	}
+	av_frame_free(&src);
+}
+
+TEST(FilterBypass, Video) {
+	AVFrame* src = bench_video_frame(SELECON_DEFAULT_VIDEO_PIXEL_FMT,
+	                                 SELECON_DEFAULT_VIDEO_WIDTH,
+	                                 SELECON_DEFAULT_VIDEO_HEIGHT,
+	                                 0,
+	                                 av_make_q(1, 1000));
+	src->sample_aspect_ratio = av_make_q(1, 1);
+	for (bool bypass : {false, true}) {
+		MediaFilterGraph graph;
+		mfgraph_init_video(&graph,
+		                   SELECON_DEFAULT_VIDEO_PIXEL_FMT,
+		                   SELECON_DEFAULT_VIDEO_WIDTH,
+		                   SELECON_DEFAULT_VIDEO_HEIGHT);
+		graph.allow_bypass = bypass;
+		run_filter(
+		    &graph, src, bypass ? "video yuv420p 320x180 bypass" : "video yuv420p 320x180 graph");
+		mfgraph_free(&graph);
+	}
+	av_frame_free(&src);
+}
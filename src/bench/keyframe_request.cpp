@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include "bench_util.h"
+#include "codec_options.h"
+#include "config.h"
+#include "stream.h"
+
+// time from join to first frame late joiner can decode (next keyframe of sender) when joiner waits
+// for next GOP and when it asks sender for keyframe. Join storm shows rate limit: many receivers
+// asking at once cost one forced keyframe. Stream is fed in real time
+
+static constexpr int kFps           = SELECON_DEFAULT_VIDEO_FPS;
+static constexpr int kFrames        = 8 * kFps;
+static constexpr int kJoinEvery     = 23;  // frames, not multiple of GOP, so joins fall all over it
+static constexpr int kStormJoins    = 20;
+static constexpr int kStormInterval = 10;  // ms between joins of storm
+
+struct Sent {
+	std::mutex mutex;
+	std::vector<int64_t> keyframes;  // send time
+	int64_t bytes = 0;
+};
+
+static void media_handler(void*, part_id_t, AVMediaType, AVFrame*) {}
+
+static void packet_handler(void* user_data, SStream*, AVPacket* packet) {
+	auto* sent = reinterpret_cast<Sent*>(user_data);
+	std::lock_guard<std::mutex> lock(sent->mutex);
+	sent->bytes += packet->size;
+	if (packet->flags & AV_PKT_FLAG_KEY)
+		sent->keyframes.push_back(bench_now_ns());
+}
+
+static void run(const char* name, bool request, bool storm) {
+	Sent sent;
+	SStreamContainer cont;
+	scont_init(&cont, media_handler, packet_handler, reinterpret_cast<SContext*>(&sent));
+	sstream_id_t stream = nullptr;
+	ASSERT_EQ(scont_alloc_stream(&cont,
+	                             1,
+	                             get_curr_timestamp(),
+	                             SSTREAM_VIDEO,
+	                             SSTREAM_OUTPUT,
+	                             nullptr,
+	                             nullptr,
+	                             &stream),
+	          SELECON_OK);
+	std::vector<int64_t> joins;
+	for (int i = 0; i < kFrames; ++i) {
+		AVFrame* frame = bench_video_frame(SELECON_DEFAULT_VIDEO_PIXEL_FMT,
+		                                   SELECON_DEFAULT_VIDEO_WIDTH,
+		                                   SELECON_DEFAULT_VIDEO_HEIGHT,
+		                                   i,
+		                                   av_make_q(1, kFps));
+		ASSERT_EQ(scont_push_frame(&cont, stream, &frame), SELECON_OK);
+		bool join = storm ? i == kFrames / 2 : i > 0 && i % kJoinEvery == 0;
+		for (int j = 0; join && j < (storm ? kStormJoins : 1); ++j) {
+			joins.push_back(bench_now_ns());
+			if (request)
+				scont_request_keyframe(&cont, stream);
+			if (storm)
+				usleep(kStormInterval * 1000);
+		}
+		usleep(1000000 / kFps);
+	}
+	scont_close_stream(&cont, &stream);
+	BenchStat wait;
+	for (int64_t join : joins)
+		for (int64_t key : sent.keyframes)
+			if (key >= join) {
+				wait.add(key - join);
+				break;
+			}
+	printf("%-22s keyframes=%3zu video=%6.1fkbps ",
+	       name,
+	       sent.keyframes.size(),
+	       sent.bytes * 8.0 / kFrames * kFps / 1e3);
+	wait.print("join to keyframe");
+	scont_free(&cont);
+}
+
+TEST(KeyframeRequest, LateJoinerFirstFrame) {
+	if (avcodec_find_encoder(SELECON_DEFAULT_VIDEO_CODEC_ID) == nullptr) {
+		printf("%s encoder not available, skipping\n",
+		       avcodec_get_name(SELECON_DEFAULT_VIDEO_CODEC_ID));
+		return;
+	}
+	run("wait for GOP", false, false);
+	run("request keyframe", true, false);
+	run("join storm, request", true, true);
+}
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include "bench_util.h"
+#include "stream.h"
+
+// memory and thread cost of input streams in 30 participant conference where everybody talks,
+// but only few participants have camera on.
+//
+// eager: audio and video input stream per peer, as it was done on join.
+// lazy: streams created by first packet of each type, as conference thread does now
+
+static constexpr int kPeers        = 29;
+static constexpr int kVideoSenders = 3;
+
+// reads field (in kB or plain count) from /proc/self/status
+static long proc_status(const char* field) {
+	FILE* fp = fopen("/proc/self/status", "r");
+	if (fp == nullptr)
+		return -1;
+	char line[256];
+	long value = -1;
+	size_t len = strlen(field);
+	while (fgets(line, sizeof(line), fp) != nullptr)
+		if (strncmp(line, field, len) == 0 && line[len] == ':') {
+			value = atol(line + len + 1);
+			break;
+		}
+	fclose(fp);
+	return value;
+}
+
+static void media_handler(void*, part_id_t, AVMediaType, AVFrame*) {}
+
+static void packet_handler(void*, SStream*, AVPacket*) {}
+
+static void report(const char* name, SStreamContainer* cont, long threads0, long rss0) {
+	printf("%-40s streams=%zu threads=+%ld rss=+%ldkB\n",
+	       name,
+	       cont->nb_in,
+	       proc_status("Threads") - threads0,
+	       proc_status("VmRSS") - rss0);
+}
+
+TEST(LazyStreams, MostlyAudioConference) {
+	long threads0 = proc_status("Threads");
+	long rss0     = proc_status("VmRSS");
+
+	SStreamContainer cont;
+	scont_init(&cont, media_handler, packet_handler, nullptr);
+	int64_t start = bench_now_ns();
+	for (int peer = 1; peer <= kPeers; ++peer) {
+		sstream_id_t stream = nullptr;
+		for (auto type : {SSTREAM_AUDIO, SSTREAM_VIDEO})
+			ASSERT_EQ(scont_alloc_stream(
+			              &cont, peer, 0, type, SSTREAM_INPUT, nullptr, nullptr, &stream),
+			          SELECON_OK);
+	}
+	printf("eager allocation took %.1fms\n", (bench_now_ns() - start) / 1e6);
+	report("eager (audio + video per peer)", &cont, threads0, rss0);
+	scont_free(&cont);
+
+	threads0 = proc_status("Threads");
+	rss0     = proc_status("VmRSS");
+	scont_init(&cont, media_handler, packet_handler, nullptr);
+	start = bench_now_ns();
+	for (int peer = 1; peer <= kPeers; ++peer) {
+		sstream_id_t stream = nullptr;
+		ASSERT_EQ(scont_get_input_stream(&cont, peer, 0, SSTREAM_AUDIO, &stream), SELECON_OK);
+		if (peer <= kVideoSenders) {
+			ASSERT_EQ(scont_get_input_stream(&cont, peer, 0, SSTREAM_VIDEO, &stream), SELECON_OK);
+		}
+	}
+	printf("lazy allocation took %.1fms\n", (bench_now_ns() - start) / 1e6);
+	std::string name = "lazy (" + std::to_string(kVideoSenders) + " video senders)";
+	report(name.c_str(), &cont, threads0, rss0);
+
+	// everybody went silent - all streams are reclaimed
+	EXPECT_EQ(scont_close_idle_streams(&cont, 0), (size_t)(kPeers + kVideoSenders));
+	report("after idle reclaim", &cont, threads0, rss0);
+	scont_free(&cont);
+}
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+extern "C" {
+#include "cert.h"
+#include "connection.h"
+#include "endpoint.h"
+#include "media_crypto.h"
+#include "message.h"
+}
+
+#include "bench_util.h"
+
+// uplink and send CPU of one participant in conference of 30, when it sends its media to every
+// peer (mesh) and when it sends it to relay only, and how much relay pays for that: it forwards
+// media of 29 senders to 28 receivers each. Media is replaced with messages of typical size, so
+// only transport is measured. Messages go over secure unix socket connections as in real call.
+// Second case compares media encrypted by TLS for every peer with media sealed once with
+// conference key and sent outside of TLS
+
+static constexpr int kPeers        = 29;
+static constexpr int kSeconds      = 2;
+static constexpr int kAudioRate    = 48000 / 1024;  // opus/aac frames per second
+static constexpr int kAudioSize    = 160;
+static constexpr int kVideoFps     = 30;
+static constexpr int kVideoSize    = 2048;
+static constexpr const char* kPath = "/tmp/selecon_bench_relay.sock";
+
+static int64_t thread_cpu_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+class RelayBench : public ::testing::Test {
+protected:
+	void SetUp() override {
+		signal(SIGPIPE, SIG_IGN);  // TLS shutdown of one side writes to other side closed already
+		cert_init();
+		unlink(kPath);
+		SEndpoint ep;
+		ASSERT_EQ(selecon_parse_endpoint2(&ep, (std::string("file://") + kPath).c_str()),
+		          SELECON_OK);
+		ASSERT_EQ(sconn_listen(&listener, &ep), SELECON_OK);
+		for (int i = 0; i < kPeers; ++i) {
+			std::thread accepter([&, i] { sconn_accept_secure(listener, &receivers[i], 5000); });
+			EXPECT_EQ(sconn_connect_secure(&senders[i], &ep), SELECON_OK);
+			accepter.join();
+			ASSERT_NE(receivers[i], nullptr);
+		}
+		drainer = std::thread([this] { drain(); });
+	}
+
+	void TearDown() override {
+		for (SConnection*& con : senders) sconn_disconnect(&con);
+		stop = true;
+		drainer.join();
+		for (SConnection*& con : receivers) sconn_disconnect(&con);
+		sconn_disconnect(&listener);
+		unlink(kPath);
+	}
+
+	// receiving side only throws messages away
+	void drain() {
+		SMessage* msg = nullptr;
+		size_t index  = 0;
+		while (!stop) {
+			enum SError err = sconn_recv_one(receivers, kPeers, &msg, &index, 100);
+			if (err == SELECON_CON_HANGUP)
+				receivers[index] = nullptr;
+			else if (err == SELECON_NO_VALID_CONNECTIONS)
+				break;
+		}
+		message_free(&msg);
+	}
+
+	// sends kSeconds of media of nb_senders participants, each to nb_receivers connections.
+	// Returns send CPU in ms per second of media
+	double send_media(int nb_senders, int nb_receivers) {
+		SMessage* audio = message_alloc2(kAudioSize, SMSG_AUDIO);
+		SMessage* video = message_alloc2(kVideoSize, SMSG_VIDEO);
+		int64_t start   = thread_cpu_ns();
+		for (int s = 0; s < nb_senders; ++s) {
+			for (int i = 0; i < kSeconds * kAudioRate; ++i)
+				for (int r = 0; r < nb_receivers; ++r) sconn_send(senders[r], audio);
+			for (int i = 0; i < kSeconds * kVideoFps; ++i)
+				for (int r = 0; r < nb_receivers; ++r) sconn_send(senders[r], video);
+		}
+		double cpu_ms = (thread_cpu_ns() - start) / 1e6 / kSeconds;
+		message_free(&audio);
+		message_free(&video);
+		return cpu_ms;
+	}
+
+	SConnection* listener          = nullptr;
+	SConnection* senders[kPeers]   = {};
+	SConnection* receivers[kPeers] = {};
+	std::atomic<bool> stop         = false;
+	std::thread drainer;
+};
+
+TEST_F(RelayBench, MeshVersusRelay) {
+	double media_kbps = (kAudioRate * kAudioSize + kVideoFps * kVideoSize) * 8 / 1e3;
+	double mesh_cpu   = send_media(1, kPeers);
+	double relay_cpu  = send_media(1, 1);
+	double node_cpu   = send_media(kPeers, kPeers - 1);
+	printf("participant mesh:  uplink=%8.1fkbps send cpu=%7.2fms/s\n",
+	       media_kbps * kPeers,
+	       mesh_cpu);
+	printf("participant relay: uplink=%8.1fkbps send cpu=%7.2fms/s\n", media_kbps, relay_cpu);
+	printf("relay node:        uplink=%8.1fkbps send cpu=%7.2fms/s\n",
+	       media_kbps * kPeers * (kPeers - 1),
+	       node_cpu);
+}
+
+TEST_F(RelayBench, SealOnceVersusTlsPerHop) {
+	constexpr int kFrames = kSeconds * kVideoFps;
+	struct SMediaCrypto crypto;
+	ASSERT_EQ(smcrypt_init(&crypto), SELECON_OK);
+	SMessage* msg  = message_alloc2(sizeof(SMsgVideo) + kVideoSize + SMCRYPT_TAG_SIZE, SMSG_VIDEO);
+	SMsgVideo* vid = (SMsgVideo*)msg;
+	uint8_t* tag   = vid->data + kVideoSize;
+	size_t aad     = vid->data - (uint8_t*)msg;
+	int64_t start  = thread_cpu_ns();
+	for (int i = 0; i < kFrames; ++i)
+		for (int r = 0; r < kPeers; ++r) sconn_send(senders[r], msg);
+	double tls_us = (thread_cpu_ns() - start) / 1e3 / kFrames;
+	start         = thread_cpu_ns();
+	for (int i = 0; i < kFrames; ++i)
+		smcrypt_seal(&crypto, 1, 0, &vid->seal, msg, aad, vid->data, kVideoSize, tag);
+	double seal_us = (thread_cpu_ns() - start) / 1e3 / kFrames;
+	start          = thread_cpu_ns();
+	for (int i = 0; i < kFrames; ++i) {
+		smcrypt_seal(&crypto, 1, 0, &vid->seal, msg, aad, vid->data, kVideoSize, tag);
+		for (int r = 0; r < kPeers; ++r) sconn_send_plain(senders[r], msg);
+	}
+	double sealed_us = (thread_cpu_ns() - start) / 1e3 / kFrames;
+	printf("video frame of %d bytes to %d peers, send cpu per frame:\n", kVideoSize, kPeers);
+	printf("tls per hop:          %8.2fus\n", tls_us);
+	printf("sealed once + plain:  %8.2fus (seal %.2fus)\n", sealed_us, seal_us);
+	message_free(&msg);
+	smcrypt_free(&crypto);
+}
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+
+#include "media_filters.h"
+}
+
+#include "bench_util.h"
+#include "sample_convert.h"
+
+// audio sample kernels on each SIMD level and whole audio filter path with direct conversion
+// against libavfilter graph. One iteration is one encoder frame of stereo audio
+
+static constexpr int kIterations = 20000;
+static constexpr int kSamples    = 1024;
+static constexpr int kChannels   = 2;
+
+template <typename Fn>
+static void bench_kernel(const char* name, enum SConvSimd level, Fn fn) {
+	BenchStat stat;
+	for (int i = 0; i < kIterations; ++i) {
+		int64_t start = bench_now_ns();
+		fn();
+		stat.add(bench_now_ns() - start);
+	}
+	char title[128];
+	snprintf(title, sizeof(title), "%s %s", name, sconv_simd_str(level));
+	stat.print(title);
+}
+
+TEST(SampleConvert, Kernels) {
+	AVFrame* s16  = bench_audio_frame(AV_SAMPLE_FMT_S16, 48000, kChannels, kSamples, 0);
+	AVFrame* fltp = bench_audio_frame(AV_SAMPLE_FMT_FLTP, 48000, kChannels, kSamples, 0);
+	std::vector<float> left(kSamples), right(kSamples);
+	float* planes[] = {left.data(), right.data()};
+	std::vector<int16_t> interleaved(kSamples * kChannels);
+	enum SConvSimd detected = sconv_simd_detect();
+	for (int l = SCONV_SIMD_NONE; l <= detected; ++l) {
+		enum SConvSimd level = sconv_set_simd_level((SConvSimd)l);
+		bench_kernel("s16 -> fltp", level, [&] {
+			sconv_s16_to_fltp((const int16_t*)s16->data[0], planes, kChannels, kSamples);
+		});
+		bench_kernel("fltp -> s16", level, [&] {
+			sconv_fltp_to_s16(
+			    (const float* const*)fltp->data, interleaved.data(), kChannels, kSamples);
+		});
+		bench_kernel("gain", level, [&] {
+			for (int c = 0; c < kChannels; ++c) sconv_gain_flt(planes[c], kSamples, 0.5f);
+		});
+	}
+	sconv_set_simd_level(detected);
+	av_frame_free(&s16);
+	av_frame_free(&fltp);
+}
+
+static void bench_graph(const char* name, AVSampleFormat src_fmt, int src_rate, bool bypass) {
+	MediaFilterGraph graph;
+	mfgraph_init_audio(&graph, AV_SAMPLE_FMT_FLTP, 48000, kChannels, kSamples);
+	graph.allow_bypass = bypass;
+	AVFrame* src       = bench_audio_frame(src_fmt, src_rate, kChannels, kSamples, 0);
+	AVFrame* in        = av_frame_alloc();
+	AVFrame* out       = av_frame_alloc();
+	BenchStat stat;
+	for (int i = 0; i < kIterations / 4; ++i) {
+		av_frame_ref(in, src);
+		int64_t start = bench_now_ns();
+		ASSERT_EQ(mfgraph_send(&graph, in), SELECON_OK);
+		while (mfgraph_receive(&graph, out) == 0) av_frame_unref(out);
+		stat.add(bench_now_ns() - start);
+	}
+	char title[128];
+	snprintf(title, sizeof(title), "%s %s", name, bypass ? "direct" : "graph");
+	stat.print(title);
+	av_frame_free(&in);
+	av_frame_free(&out);
+	av_frame_free(&src);
+	mfgraph_free(&graph);
+}
+
+TEST(SampleConvert, FilterPath) {
+	for (bool bypass : {false, true}) {
+		bench_graph("s16 48k -> fltp 48k", AV_SAMPLE_FMT_S16, 48000, bypass);
+		bench_graph("s16 44.1k -> fltp 48k", AV_SAMPLE_FMT_S16, 44100, bypass);
+	}
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <mutex>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include "bench_util.h"
+#include "codec_options.h"
+#include "config.h"
+#include "stream.h"
+
+// sender CPU of 720p output stream with single encoder and with 720p/360p/180p simulcast, and
+// bandwidth sent in mesh conference of 30 where each sender is watched in full by 4 participants
+// (last N) and as thumbnail by the rest. Without simulcast thumbnails get full stream too.
+// Stream is fed in real time, as frames faster than stream frame rate are decimated
+
+static constexpr int kWidth  = 1280;
+static constexpr int kHeight = 720;
+static constexpr int kFps    = 30;
+static constexpr int kFrames = 5 * kFps;
+static constexpr int kFull   = 4;   // receivers of top layer
+static constexpr int kThumbs = 25;  // receivers of lowest layer
+
+struct LayerBytes {
+	std::mutex mutex;
+	int64_t bytes[SELECON_MAX_SIMULCAST_LAYERS] = {};
+};
+
+static void media_handler(void*, part_id_t, AVMediaType, AVFrame*) {}
+
+static void packet_handler(void* user_data, SStream*, AVPacket* packet) {
+	auto* sent = reinterpret_cast<LayerBytes*>(user_data);
+	std::lock_guard<std::mutex> lock(sent->mutex);
+	sent->bytes[packet->stream_index] += packet->size;
+}
+
+static void run(int nb_layers) {
+	LayerBytes sent;
+	SStreamContainer cont;
+	scont_init(&cont, media_handler, packet_handler, reinterpret_cast<SContext*>(&sent));
+	SVideoParams params = {kWidth, kHeight, kFps};
+	SCodecOptions opts  = {};
+	opts.simulcast      = nb_layers;
+	sstream_id_t stream = nullptr;
+	enum SError err     = scont_alloc_stream(&cont,
+                                         1,
+                                         get_curr_timestamp(),
+                                         SSTREAM_VIDEO,
+                                         SSTREAM_OUTPUT,
+                                         &params,
+                                         &opts,
+                                         &stream);
+	ASSERT_EQ(err, SELECON_OK);
+	int layers    = stream->nb_layers;
+	int64_t start = bench_cpu_ns();
+	for (int i = 0; i < kFrames; ++i) {
+		AVFrame* frame = bench_video_frame(
+		    SELECON_DEFAULT_VIDEO_PIXEL_FMT, kWidth, kHeight, i, av_make_q(1, kFps));
+		ASSERT_EQ(scont_push_frame(&cont, stream, &frame), SELECON_OK);
+		usleep(1000000 / kFps);
+	}
+	scont_close_stream(&cont, &stream);
+	double seconds = (double)kFrames / kFps;
+	double cpu_ms  = (bench_cpu_ns() - start) / 1e6;
+	printf("%d layer(s): encode cpu=%6.1fms/s", layers, cpu_ms / seconds);
+	for (int l = 0; l < layers; ++l)
+		printf(" L%d=%7.1fkbps", l, sent.bytes[l] * 8 / seconds / 1e3);
+	double uplink = (kFull * sent.bytes[0] + kThumbs * sent.bytes[layers - 1]) * 8 / seconds / 1e3;
+	printf(" uplink to %d peers=%8.1fkbps\n", kFull + kThumbs, uplink);
+	scont_free(&cont);
+}
+
+TEST(Simulcast, Encode720pLayers) {
+	if (avcodec_find_encoder(SELECON_DEFAULT_VIDEO_CODEC_ID) == nullptr) {
+		printf("%s encoder not available, skipping\n",
+		       avcodec_get_name(SELECON_DEFAULT_VIDEO_CODEC_ID));
+		return;
+	}
+	run(1);
+	run(2);
+	run(3);
+}
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include "bench_util.h"
+#include "codec_options.h"
+#include "config.h"
+#include "stream.h"
+
+// time from first packet after reenter until first decoded frame reaches media handler.
+//
+// Each round emulates participant hangup (scont_close_streams) and reenter (input stream is
+// requested again by first packet). Without pool decoder is opened from scratch every time
+
+static constexpr int kRounds = 50;
+
+struct FirstFrame {
+	std::mutex mutex;
+	std::condition_variable cond;
+	bool decoded = false;
+};
+
+static void media_handler(void* user_data, part_id_t, AVMediaType, AVFrame*) {
+	auto* first = static_cast<FirstFrame*>(user_data);
+	std::lock_guard<std::mutex> lock(first->mutex);
+	first->decoded = true;
+	first->cond.notify_one();
+}
+
+static void packet_handler(void*, SStream*, AVPacket*) {}
+
+// encodes frames with codec of conference profile until first packet comes out
+static AVPacket* encode_first_packet(const SMediaProfile& profile, SStreamType type) {
+	AVCodecID codec_id =
+	    type == SSTREAM_AUDIO ? profile.audio.codec_id : profile.video.codec_id;
+	const AVCodec* codec = avcodec_find_encoder(codec_id);
+	if (codec == nullptr)
+		return nullptr;
+	AVCodecContext* ctx = avcodec_alloc_context3(codec);
+	if (type == SSTREAM_AUDIO) {
+		ctx->sample_fmt  = profile.audio.sample_fmt;
+		ctx->sample_rate = profile.audio.sample_rate;
+		ctx->frame_size  = profile.audio.frame_size;
+		av_channel_layout_default(&ctx->ch_layout, profile.audio.nb_channels);
+	} else {
+		ctx->pix_fmt   = profile.video.pixel_fmt;
+		ctx->width     = profile.video.width;
+		ctx->height    = profile.video.height;
+		ctx->framerate = av_make_q(profile.video.framerate, 1);
+	}
+	ctx->time_base     = av_make_q(1, 1000);
+	SCodecOptions opts = {};
+	scodec_options_preset(&opts, SCODEC_PRESET_CONFERENCE, ctx);
+	int ret = scodec_open(ctx, codec, &opts);
+	scodec_options_free(&opts);
+	AVPacket* packet = av_packet_alloc();
+	for (int i = 0; ret >= 0 && i < 100; ++i) {
+		AVFrame* frame = type == SSTREAM_AUDIO
+		                     ? bench_audio_frame(ctx->sample_fmt,
+		                                         ctx->sample_rate,
+		                                         ctx->ch_layout.nb_channels,
+		                                         ctx->frame_size,
+		                                         (int64_t)i * ctx->frame_size)
+		                     : bench_video_frame(
+		                           ctx->pix_fmt, ctx->width, ctx->height, i, ctx->time_base);
+		frame->pts = av_rescale_q(frame->pts, frame->time_base, ctx->time_base);
+		ret        = avcodec_send_frame(ctx, frame);
+		av_frame_free(&frame);
+		if (ret >= 0 && avcodec_receive_packet(ctx, packet) == 0)
+			break;
+	}
+	if (packet->size == 0)
+		av_packet_free(&packet);
+	avcodec_free_context(&ctx);
+	return packet;
+}
+
+static void run_reenter(SStreamType type, size_t pool_size) {
+	FirstFrame first;
+	SStreamContainer cont;
+	scont_init(&cont, media_handler, packet_handler, reinterpret_cast<SContext*>(&first));
+	scont_set_pool_size(&cont, pool_size);
+	SMediaProfile profile;
+	scont_get_profile(&cont, &profile);
+	AVPacket* packet = encode_first_packet(profile, type);
+	if (packet == nullptr) {
+		printf("encoder not available, skipping\n");
+		scont_free(&cont);
+		return;
+	}
+
+	const part_id_t part_id = 1;
+	BenchStat stat;
+	for (int round = 0; round < kRounds; ++round) {
+		first.decoded = false;
+		int64_t start = bench_now_ns();
+		sstream_id_t stream = nullptr;
+		ASSERT_EQ(scont_get_input_stream(&cont, part_id, 0, type, &stream), SELECON_OK);
+		AVPacket* copy = av_packet_clone(packet);
+		ASSERT_EQ(scont_push_packet(&cont, stream, &copy), SELECON_OK);
+		{
+			std::unique_lock<std::mutex> lock(first.mutex);
+			ASSERT_TRUE(first.cond.wait_for(
+			    lock, std::chrono::seconds(5), [&] { return first.decoded; }));
+		}
+		stat.add(bench_now_ns() - start);
+		scont_close_streams(&cont, part_id);  // hangup
+	}
+	char name[128];
+	snprintf(name,
+	         sizeof(name),
+	         "%s %s pool=%zu",
+	         type == SSTREAM_AUDIO ? "audio" : "video",
+	         avcodec_get_name(type == SSTREAM_AUDIO ? profile.audio.codec_id
+	                                                : profile.video.codec_id),
+	         pool_size);
+	stat.print(name);
+	av_packet_free(&packet);
+	scont_free(&cont);
+}
+
+TEST(StreamPool, AudioFirstFrameAfterReenter) {
+	run_reenter(SSTREAM_AUDIO, 0);
+	run_reenter(SSTREAM_AUDIO, SELECON_STREAM_POOL_SIZE);
+}
+
+TEST(StreamPool, VideoFirstFrameAfterReenter) {
+	run_reenter(SSTREAM_VIDEO, 0);
+	run_reenter(SSTREAM_VIDEO, SELECON_STREAM_POOL_SIZE);
+}
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include "bench_util.h"
+#include "codec_options.h"
+#include "config.h"
+
+// receiver decode CPU of VP8 L1T3 stream when all, two or only base temporal layer is decoded.
+// Dropped packets never reach decoder, as receiver does it by temporal id from message header
+
+static constexpr int kWidth  = 640;
+static constexpr int kHeight = 360;
+static constexpr int kFps    = 30;
+static constexpr int kFrames = 10 * kFps;
+
+struct LayeredPacket {
+	AVPacket* packet;
+	int temporal_id;
+};
+
+static std::vector<LayeredPacket> encode(const AVCodec* codec) {
+	std::vector<LayeredPacket> packets;
+	AVCodecContext* ctx = avcodec_alloc_context3(codec);
+	ctx->pix_fmt        = AV_PIX_FMT_YUV420P;
+	ctx->width          = kWidth;
+	ctx->height         = kHeight;
+	ctx->framerate      = av_make_q(kFps, 1);
+	ctx->time_base      = av_make_q(1, kFps);
+	SCodecOptions opts  = {};
+	scodec_options_preset(&opts, SCODEC_PRESET_CONFERENCE, ctx);
+	opts.temporal_layers = SELECON_MAX_TEMPORAL_LAYERS;
+	EXPECT_EQ(scodec_open(ctx, codec, &opts), 0);
+	int nb_layers = scodec_temporal_layers(codec, &opts);
+	scodec_options_free(&opts);
+	AVPacket* packet = av_packet_alloc();
+	STemporalTracker tracker;
+	scodec_temporal_init(&tracker, nb_layers);
+	for (int i = 0; i <= kFrames; ++i) {
+		AVFrame* frame =
+		    i < kFrames ? bench_video_frame(ctx->pix_fmt, kWidth, kHeight, i, ctx->time_base)
+		                : nullptr;
+		if (frame != nullptr)
+			scodec_temporal_submit(&tracker, frame->pts, false);
+		EXPECT_EQ(avcodec_send_frame(ctx, frame), 0);
+		while (avcodec_receive_packet(ctx, packet) == 0) {
+			int temporal_id =
+			    scodec_temporal_packet(&tracker, packet->pts, packet->flags & AV_PKT_FLAG_KEY);
+			packets.push_back({av_packet_clone(packet), temporal_id});
+			av_packet_unref(packet);
+		}
+		av_frame_free(&frame);
+	}
+	av_packet_free(&packet);
+	avcodec_free_context(&ctx);
+	return packets;
+}
+
+static void run(const std::vector<LayeredPacket>& packets, int decoded_layers) {
+	const AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_VP8);
+	AVCodecContext* ctx  = avcodec_alloc_context3(codec);
+	SCodecOptions opts   = {};
+	scodec_options_preset(&opts, SCODEC_PRESET_CONFERENCE, ctx);
+	EXPECT_EQ(scodec_open(ctx, codec, &opts), 0);
+	scodec_options_free(&opts);
+	AVFrame* frame  = av_frame_alloc();
+	int64_t decoded = 0;
+	int64_t errors  = 0;
+	int64_t start   = bench_cpu_ns();
+	for (const LayeredPacket& p : packets) {
+		if (p.temporal_id >= decoded_layers)
+			continue;
+		if (avcodec_send_packet(ctx, p.packet) < 0)
+			++errors;
+		while (avcodec_receive_frame(ctx, frame) == 0) {
+			++decoded;
+			av_frame_unref(frame);
+		}
+	}
+	double cpu_ms  = (bench_cpu_ns() - start) / 1e6;
+	double seconds = (double)kFrames / kFps;
+	printf("decoding %d temporal layer(s): fps=%5.1f cpu=%6.1fms/s errors=%lld\n",
+	       decoded_layers,
+	       decoded / seconds,
+	       cpu_ms / seconds,
+	       (long long)errors);
+	av_frame_free(&frame);
+	avcodec_free_context(&ctx);
+}
+
+TEST(TemporalLayers, DecodeVp8L1T3) {
+	const AVCodec* codec = avcodec_find_encoder_by_name("libvpx");
+	if (codec == nullptr || avcodec_find_decoder(AV_CODEC_ID_VP8) == nullptr) {
+		printf("libvpx not available, skipping\n");
+		return;
+	}
+	std::vector<LayeredPacket> packets = encode(codec);
+	for (int layers = SELECON_MAX_TEMPORAL_LAYERS; layers >= 1; --layers) run(packets, layers);
+	for (LayeredPacket& p : packets) av_packet_free(&p.packet);
+}
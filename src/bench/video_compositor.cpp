@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+
+#include "video_compositor.h"
+}
+
+#include "bench_util.h"
+#include "config.h"
+
+// one composition of 9 participants (default 320x180 video, scaled into 720p grid cells) when
+// every participant sent new frame and when only one of them did (dirty tile tracking)
+
+static constexpr int kSources = 9;
+static constexpr int kFrames  = 1000;
+
+static void bench_compose(const char* name, int nb_changed) {
+	SCompositorLayout layout = {{1280, 720, 30}, 0};
+	SVideoCompositor comp;
+	ASSERT_EQ(scomp_init(&comp, &layout), SELECON_OK);
+	std::vector<AVFrame*> frames;
+	for (int i = 0; i < kSources; ++i)
+		frames.push_back(bench_video_frame(SELECON_DEFAULT_VIDEO_PIXEL_FMT,
+		                                   SELECON_DEFAULT_VIDEO_WIDTH,
+		                                   SELECON_DEFAULT_VIDEO_HEIGHT,
+		                                   i,
+		                                   av_make_q(1, SELECON_DEFAULT_VIDEO_FPS)));
+	for (int i = 0; i < kSources; ++i) scomp_push(&comp, i + 1, frames[i]);
+	AVFrame* out = av_frame_alloc();
+	ASSERT_EQ(scomp_compose(&comp, out), kSources);
+	BenchStat stat;
+	for (int f = 0; f < kFrames; ++f) {
+		for (int i = 0; i < nb_changed; ++i) scomp_push(&comp, (f + i) % kSources + 1, frames[i]);
+		int64_t start = bench_now_ns();
+		ASSERT_EQ(scomp_compose(&comp, out), nb_changed);
+		stat.add(bench_now_ns() - start);
+	}
+	stat.print(name);
+	av_frame_free(&out);
+	for (AVFrame*& frame : frames) av_frame_free(&frame);
+	scomp_free(&comp);
+}
+
+TEST(VideoCompositor, Compose9) {
+	bench_compose("compose 9 tiles, 9 changed", kSources);
+	bench_compose("compose 9 tiles, 1 changed", 1);
+	bench_compose("compose 9 tiles, none changed", 0);
+}
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+
+#include "message.h"
+}
+
+#include "bench_util.h"
+#include "codec_options.h"
+#include "config.h"
+
+// receiver bandwidth and decoding CPU in 30 participant conference when video of every peer is
+// received versus last N subscription. Unsubscribed senders skip the send, so their video costs
+// receiver nothing. Senders share one pre-encoded stream, each receiver-side decoder is separate
+
+static constexpr int kSenders = 29;
+static constexpr int kFrames  = 150;  // 5 seconds
+static constexpr int kWidth   = SELECON_DEFAULT_VIDEO_WIDTH;
+static constexpr int kHeight  = SELECON_DEFAULT_VIDEO_HEIGHT;
+static constexpr int kFps     = SELECON_DEFAULT_VIDEO_FPS;
+
+static std::vector<AVPacket*> encode(const AVCodec* codec) {
+	std::vector<AVPacket*> packets;
+	AVCodecContext* ctx = avcodec_alloc_context3(codec);
+	ctx->pix_fmt        = SELECON_DEFAULT_VIDEO_PIXEL_FMT;
+	ctx->width          = kWidth;
+	ctx->height         = kHeight;
+	ctx->framerate      = av_make_q(kFps, 1);
+	ctx->time_base      = av_make_q(1, kFps);
+	SCodecOptions opts  = {};
+	scodec_options_preset(&opts, SCODEC_PRESET_CONFERENCE, ctx);
+	EXPECT_EQ(scodec_open(ctx, codec, &opts), 0);
+	scodec_options_free(&opts);
+	AVPacket* packet = av_packet_alloc();
+	for (int i = 0; i <= kFrames; ++i) {
+		AVFrame* frame =
+		    i < kFrames ? bench_video_frame(ctx->pix_fmt, kWidth, kHeight, i, ctx->time_base)
+		                : nullptr;
+		EXPECT_EQ(avcodec_send_frame(ctx, frame), 0);
+		while (avcodec_receive_packet(ctx, packet) == 0) {
+			packets.push_back(av_packet_clone(packet));
+			av_packet_unref(packet);
+		}
+		av_frame_free(&frame);
+	}
+	av_packet_free(&packet);
+	avcodec_free_context(&ctx);
+	return packets;
+}
+
+static void run(const std::vector<AVPacket*>& packets, int subscribed) {
+	const AVCodec* codec = avcodec_find_decoder(SELECON_DEFAULT_VIDEO_CODEC_ID);
+	std::vector<AVCodecContext*> decoders;
+	for (int s = 0; s < subscribed; ++s) {
+		AVCodecContext* ctx = avcodec_alloc_context3(codec);
+		SCodecOptions opts  = {};
+		scodec_options_preset(&opts, SCODEC_PRESET_CONFERENCE, ctx);
+		EXPECT_EQ(scodec_open(ctx, codec, &opts), 0);
+		scodec_options_free(&opts);
+		decoders.push_back(ctx);
+	}
+	AVFrame* frame  = av_frame_alloc();
+	int64_t bytes   = 0;
+	int64_t decoded = 0;
+	int64_t start   = bench_cpu_ns();
+	for (AVPacket* packet : packets) {
+		for (AVCodecContext* ctx : decoders) {
+			SMessage* msg = message_video_alloc(1, 0, 0, packet);
+			bytes += msg->size;
+			message_free(&msg);
+			EXPECT_EQ(avcodec_send_packet(ctx, packet), 0);
+			while (avcodec_receive_frame(ctx, frame) == 0) {
+				++decoded;
+				av_frame_unref(frame);
+			}
+		}
+	}
+	double cpu_ms  = (bench_cpu_ns() - start) / 1e6;
+	double seconds = (double)kFrames / kFps;
+	// paused senders got one subscription message each
+	bytes += (kSenders - subscribed) * sizeof(SMsgVideoSubscription);
+	printf("receiving %2d of %d videos: downlink=%7.1fkbps decoded=%5lld frames cpu=%6.1fms/s\n",
+	       subscribed,
+	       kSenders,
+	       bytes * 8.0 / seconds / 1000.0,
+	       (long long)decoded,
+	       cpu_ms / seconds);
+	av_frame_free(&frame);
+	for (AVCodecContext*& ctx : decoders) avcodec_free_context(&ctx);
+}
+
+TEST(VideoLastN, Receive30Participants) {
+	const AVCodec* codec = avcodec_find_encoder(SELECON_DEFAULT_VIDEO_CODEC_ID);
+	if (codec == nullptr) {
+		printf("%s encoder not available, skipping\n",
+		       avcodec_get_name(SELECON_DEFAULT_VIDEO_CODEC_ID));
+		return;
+	}
+	std::vector<AVPacket*> packets = encode(codec);
+	run(packets, kSenders);
+	run(packets, 4);
+	for (AVPacket*& packet : packets) av_packet_free(&packet);
+}
@@ -0,0 +1,195 @@
+#include "active_speakers.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+#define SILENCE_LEVEL -127.0f
+
+enum SError sspeak_init(struct SSpeakerTracker *tracker) {
+	memset(tracker, 0, sizeof(*tracker));
+	if (pthread_mutex_init(&tracker->mutex, NULL) != 0)
+		return SELECON_PTHREAD_ERROR;
+	return SELECON_OK;
+}
+
+void sspeak_free(struct SSpeakerTracker *tracker) {
+	free(tracker->speakers);
+	tracker->speakers    = NULL;
+	tracker->nb_speakers = 0;
+	pthread_mutex_destroy(&tracker->mutex);
+}
+
+static struct SSpeaker *find_speaker_locked(struct SSpeakerTracker *tracker, part_id_t part_id) {
+	for (size_t i = 0; i < tracker->nb_speakers; ++i)
+		if (tracker->speakers[i].part_id == part_id)
+			return &tracker->speakers[i];
+	return NULL;
+}
+
+static bool speaking(const struct SSpeaker *speaker, timestamp_t now) {
+	return speaker->level >= SELECON_VAD_THRESHOLD &&
+	       now - speaker->last_ts <= SELECON_SPEAKER_TIMEOUT * 1000000ULL;
+}
+
+// loudest speaking participant takes over when dominant one is silent or quieter by margin
+static bool elect_dominant_locked(struct SSpeakerTracker *tracker, timestamp_t now) {
+	struct SSpeaker *loudest = NULL;
+	for (size_t i = 0; i < tracker->nb_speakers; ++i) {
+		struct SSpeaker *speaker = &tracker->speakers[i];
+		if (speaking(speaker, now) && (loudest == NULL || speaker->level > loudest->level))
+			loudest = speaker;
+	}
+	if (loudest == NULL || loudest->part_id == tracker->dominant)
+		return false;
+	struct SSpeaker *dominant = find_speaker_locked(tracker, tracker->dominant);
+	if (dominant != NULL && speaking(dominant, now) &&
+	    loudest->level < dominant->level + SELECON_SPEAKER_SWITCH_MARGIN)
+		return false;
+	tracker->dominant = loudest->part_id;
+	return true;
+}
+
+bool sspeak_update(struct SSpeakerTracker *tracker,
+                   part_id_t part_id,
+                   float level,
+                   timestamp_t now) {
+	pthread_mutex_lock(&tracker->mutex);
+	struct SSpeaker *speaker = find_speaker_locked(tracker, part_id);
+	if (speaker == NULL) {
+		struct SSpeaker *speakers =
+		    realloc(tracker->speakers, (tracker->nb_speakers + 1) * sizeof(struct SSpeaker));
+		if (speakers == NULL) {
+			pthread_mutex_unlock(&tracker->mutex);
+			return false;
+		}
+		tracker->speakers = speakers;
+		speaker           = &speakers[tracker->nb_speakers++];
+		speaker->part_id  = part_id;
+		speaker->level    = SILENCE_LEVEL;
+		speaker->last_ts  = 0;
+		speaker->top_ts   = 0;
+		speaker->voice_ts = 0;
+	}
+	// fast attack catches word onsets, slow release bridges short pauses between words
+	if (now - speaker->last_ts > SELECON_SPEAKER_TIMEOUT * 1000000ULL)
+		speaker->level = SILENCE_LEVEL;
+	float k = level > speaker->level ? SELECON_SPEAKER_ATTACK : SELECON_SPEAKER_RELEASE;
+	speaker->level += k * (level - speaker->level);
+	speaker->last_ts = now;
+	if (speaker->level >= SELECON_VAD_THRESHOLD)
+		speaker->voice_ts = now;
+	bool changed = elect_dominant_locked(tracker, now);
+	pthread_mutex_unlock(&tracker->mutex);
+	return changed;
+}
+
+bool sspeak_remove(struct SSpeakerTracker *tracker, part_id_t part_id) {
+	pthread_mutex_lock(&tracker->mutex);
+	struct SSpeaker *speaker = find_speaker_locked(tracker, part_id);
+	if (speaker != NULL)
+		*speaker = tracker->speakers[--tracker->nb_speakers];
+	bool was_dominant = tracker->dominant == part_id;
+	if (was_dominant)
+		tracker->dominant = 0;
+	pthread_mutex_unlock(&tracker->mutex);
+	return was_dominant;
+}
+
+part_id_t sspeak_dominant(struct SSpeakerTracker *tracker) {
+	pthread_mutex_lock(&tracker->mutex);
+	part_id_t dominant = tracker->dominant;
+	pthread_mutex_unlock(&tracker->mutex);
+	return dominant;
+}
+
+size_t sspeak_ranking(struct SSpeakerTracker *tracker,
+                      struct SSpeaker *ranking,
+                      size_t max,
+                      timestamp_t now) {
+	size_t count = 0;
+	pthread_mutex_lock(&tracker->mutex);
+	// insertion into short sorted array, conference has tens of participants at most
+	for (size_t i = 0; i < tracker->nb_speakers; ++i) {
+		const struct SSpeaker *speaker = &tracker->speakers[i];
+		if (!speaking(speaker, now))
+			continue;
+		size_t pos = count;
+		while (pos > 0 && ranking[pos - 1].level < speaker->level) {
+			if (pos < max)
+				ranking[pos] = ranking[pos - 1];
+			--pos;
+		}
+		if (pos < max) {
+			ranking[pos] = *speaker;
+			if (count < max)
+				++count;
+		}
+	}
+	pthread_mutex_unlock(&tracker->mutex);
+	return count;
+}
+
+static int rank_locked(struct SSpeakerTracker *tracker,
+                       const struct SSpeaker *speaker,
+                       timestamp_t now) {
+	if (!speaking(speaker, now))
+		return -1;
+	int rank = 0;
+	for (size_t i = 0; i < tracker->nb_speakers; ++i)
+		if (speaking(&tracker->speakers[i], now) && tracker->speakers[i].level > speaker->level)
+			++rank;
+	return rank;
+}
+
+int sspeak_rank(struct SSpeakerTracker *tracker, part_id_t part_id, timestamp_t now) {
+	int rank = -1;
+	pthread_mutex_lock(&tracker->mutex);
+	struct SSpeaker *speaker = find_speaker_locked(tracker, part_id);
+	if (speaker != NULL)
+		rank = rank_locked(tracker, speaker, now);
+	pthread_mutex_unlock(&tracker->mutex);
+	return rank;
+}
+
+bool sspeak_in_top(struct SSpeakerTracker *tracker, part_id_t part_id, size_t k, timestamp_t now) {
+	bool in_top = true;
+	pthread_mutex_lock(&tracker->mutex);
+	struct SSpeaker *speaker = find_speaker_locked(tracker, part_id);
+	if (speaker != NULL && tracker->nb_speakers > k) {
+		int rank = rank_locked(tracker, speaker, now);
+		if (rank >= 0 && (size_t)rank < k)
+			speaker->top_ts = now;
+		// hold keeps speaker through short dips instead of chopping words
+		in_top = speaker->top_ts != 0 &&
+		         now - speaker->top_ts <= SELECON_AUDIO_TOP_K_HOLD * 1000000ULL;
+	}
+	pthread_mutex_unlock(&tracker->mutex);
+	return in_top;
+}
+
+size_t sspeak_recent(struct SSpeakerTracker *tracker, part_id_t *ids, size_t max) {
+	size_t count = 0;
+	pthread_mutex_lock(&tracker->mutex);
+	// same insertion as in sspeak_ranking, by time of speech instead of level
+	for (size_t i = 0; i < tracker->nb_speakers; ++i) {
+		const struct SSpeaker *speaker = &tracker->speakers[i];
+		if (speaker->voice_ts == 0)
+			continue;
+		size_t pos = count;
+		while (pos > 0 &&
+		       find_speaker_locked(tracker, ids[pos - 1])->voice_ts < speaker->voice_ts) {
+			if (pos < max)
+				ids[pos] = ids[pos - 1];
+			--pos;
+		}
+		if (pos < max) {
+			ids[pos] = speaker->part_id;
+			if (count < max)
+				++count;
+		}
+	}
+	pthread_mutex_unlock(&tracker->mutex);
+	return count;
+}
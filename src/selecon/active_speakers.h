@@ -0,0 +1,67 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "error.h"
+#include "stypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// audio level of remote participant taken from media message headers
+struct SSpeaker {
+	part_id_t part_id;
+	float level;           // smoothed, dBov
+	timestamp_t last_ts;   // time of last level update
+	timestamp_t top_ts;    // last time participant was among top K speakers
+	timestamp_t voice_ts;  // last time participant was speaking
+};
+
+// ranks participants by audio levels senders put into SMsgAudio headers, so nothing has to be
+// decoded. Dominant speaker is kept through pauses and changes only when other participant is
+// louder by SELECON_SPEAKER_SWITCH_MARGIN or dominant one is silent
+struct SSpeakerTracker {
+	struct SSpeaker *speakers;
+	size_t nb_speakers;
+	part_id_t dominant;  // 0 if nobody spoke yet
+	pthread_mutex_t mutex;
+};
+
+enum SError sspeak_init(struct SSpeakerTracker *tracker);
+void sspeak_free(struct SSpeakerTracker *tracker);
+
+// adds level (dBov) of next packet of participant. Returns true if dominant speaker changed
+bool sspeak_update(struct SSpeakerTracker *tracker,
+                   part_id_t part_id,
+                   float level,
+                   timestamp_t now);
+
+// forgets participant. Returns true if it was dominant speaker
+bool sspeak_remove(struct SSpeakerTracker *tracker, part_id_t part_id);
+
+part_id_t sspeak_dominant(struct SSpeakerTracker *tracker);
+
+// fills ranking with participants speaking now (level above SELECON_VAD_THRESHOLD and updated
+// within SELECON_SPEAKER_TIMEOUT), loudest first. Returns amount of written entries
+size_t sspeak_ranking(struct SSpeakerTracker *tracker,
+                      struct SSpeaker *ranking,
+                      size_t max,
+                      timestamp_t now);
+
+// rank of participant in speaking order (0 is loudest) or -1 if it is silent
+int sspeak_rank(struct SSpeakerTracker *tracker, part_id_t part_id, timestamp_t now);
+
+// true if participant is among k loudest speakers or left them less than SELECON_AUDIO_TOP_K_HOLD
+// ago. Everybody is in top when there are no more than k known participants
+bool sspeak_in_top(struct SSpeakerTracker *tracker, part_id_t part_id, size_t k, timestamp_t now);
+
+// fills ids with participants who spoke at some point, most recent speaker first. Returns amount
+// of written ids
+size_t sspeak_recent(struct SSpeakerTracker *tracker, part_id_t *ids, size_t max);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
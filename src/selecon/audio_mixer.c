@@ -0,0 +1,303 @@
+#define _GNU_SOURCE
+
+#include "audio_mixer.h"
+
+#include <libavutil/audio_fifo.h>
+#include <libavutil/channel_layout.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "config.h"
+#include "sample_convert.h"
+
+enum SError smixer_init(struct SAudioMixer *mixer, int sample_rate, int nb_channels, int tick_size) {
+	if (sample_rate <= 0 || nb_channels <= 0 || tick_size <= 0)
+		return SELECON_INVALID_ARG;
+	memset(mixer, 0, sizeof(*mixer));
+	if (pthread_mutex_init(&mixer->mutex, NULL) != 0)
+		return SELECON_PTHREAD_ERROR;
+	mixer->sample_rate  = sample_rate;
+	mixer->nb_channels  = nb_channels;
+	mixer->tick_size    = tick_size;
+	mixer->limiter_gain = 1.0f;
+	mixer->planes       = calloc(nb_channels, sizeof(float *));
+	mixer->in_frame     = av_frame_alloc();
+	mixer->out_frame    = av_frame_alloc();
+	if (mixer->planes == NULL || mixer->in_frame == NULL || mixer->out_frame == NULL) {
+		smixer_free(mixer);
+		return SELECON_MEMORY_ERROR;
+	}
+	for (int c = 0; c < nb_channels; ++c) {
+		mixer->planes[c] = calloc(tick_size, sizeof(float));
+		if (mixer->planes[c] == NULL) {
+			smixer_free(mixer);
+			return SELECON_MEMORY_ERROR;
+		}
+	}
+	return SELECON_OK;
+}
+
+static void source_free(struct SMixerSource *source) {
+	mfgraph_free(&source->graph);
+	if (source->fifo != NULL)
+		av_audio_fifo_free(source->fifo);
+	source->fifo = NULL;
+}
+
+void smixer_free(struct SAudioMixer *mixer) {
+	if (mixer->running)
+		smixer_stop(mixer);
+	for (size_t i = 0; i < mixer->nb_sources; ++i) source_free(&mixer->sources[i]);
+	free(mixer->sources);
+	if (mixer->planes != NULL)
+		for (int c = 0; c < mixer->nb_channels; ++c) free(mixer->planes[c]);
+	free(mixer->planes);
+	pthread_mutex_destroy(&mixer->mutex);
+	av_frame_free(&mixer->in_frame);
+	av_frame_free(&mixer->out_frame);
+	memset(mixer, 0, sizeof(*mixer));
+}
+
+// mixer->mutex must be locked
+static struct SMixerSource *find_source(struct SAudioMixer *mixer, part_id_t part_id) {
+	for (size_t i = 0; i < mixer->nb_sources; ++i)
+		if (mixer->sources[i].part_id == part_id)
+			return &mixer->sources[i];
+	return NULL;
+}
+
+// mixer->mutex must be locked
+static struct SMixerSource *get_source(struct SAudioMixer *mixer, part_id_t part_id) {
+	struct SMixerSource *source = find_source(mixer, part_id);
+	if (source != NULL)
+		return source;
+	struct AVAudioFifo *fifo = av_audio_fifo_alloc(
+	    AV_SAMPLE_FMT_FLTP, mixer->nb_channels, (SELECON_MIXER_MAX_DELAY + 1) * mixer->tick_size);
+	if (fifo == NULL)
+		return NULL;
+	struct SMixerSource *sources =
+	    reallocarray(mixer->sources, mixer->nb_sources + 1, sizeof(struct SMixerSource));
+	if (sources == NULL) {
+		av_audio_fifo_free(fifo);
+		return NULL;
+	}
+	mixer->sources = sources;
+	source         = &mixer->sources[mixer->nb_sources++];
+	memset(source, 0, sizeof(*source));
+	source->part_id = part_id;
+	source->gain    = 1.0f;
+	source->fifo    = fifo;
+	mfgraph_init_audio(&source->graph,
+	                   AV_SAMPLE_FMT_FLTP,
+	                   mixer->sample_rate,
+	                   mixer->nb_channels,
+	                   mixer->tick_size);
+	return source;
+}
+
+static void *mixer_worker(void *arg) {
+	struct SAudioMixer *mixer = arg;
+	const int64_t tick_ns     = (int64_t)mixer->tick_size * 1000000000 / mixer->sample_rate;
+	struct AVFrame *frame     = av_frame_alloc();
+	struct timespec next;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (mixer->running) {
+		int64_t ns   = next.tv_nsec + tick_ns;
+		next.tv_sec += ns / 1000000000;
+		next.tv_nsec = ns % 1000000000;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		// after long stall restart clock instead of mixing burst of ticks
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		int64_t late = (now.tv_sec - next.tv_sec) * 1000000000 + now.tv_nsec - next.tv_nsec;
+		if (late > SELECON_MIXER_MAX_DELAY * tick_ns)
+			next = now;
+		if (mixer->running && smixer_mix(mixer, frame) > 0)
+			mixer->handler(mixer->user_data, mixer->part_id, AVMEDIA_TYPE_AUDIO, frame);
+	}
+	av_frame_free(&frame);
+	return NULL;
+}
+
+enum SError smixer_start(struct SAudioMixer *mixer,
+                         media_handler_fn_t handler,
+                         void *user_data,
+                         part_id_t part_id) {
+	if (handler == NULL)
+		return SELECON_INVALID_ARG;
+	pthread_mutex_lock(&mixer->mutex);
+	if (mixer->running) {
+		pthread_mutex_unlock(&mixer->mutex);
+		return SELECON_ALREADY_INIT;
+	}
+	mixer->handler   = handler;
+	mixer->user_data = user_data;
+	mixer->part_id   = part_id;
+	mixer->running   = true;
+	// audio queued while stopped would play with delay
+	for (size_t i = 0; i < mixer->nb_sources; ++i) {
+		av_audio_fifo_reset(mixer->sources[i].fifo);
+		mixer->sources[i].primed = false;
+	}
+	if (pthread_create(&mixer->thread, NULL, mixer_worker, mixer) != 0) {
+		mixer->running = false;
+		pthread_mutex_unlock(&mixer->mutex);
+		return SELECON_PTHREAD_ERROR;
+	}
+	pthread_setname_np(mixer->thread, "mixer");
+	pthread_mutex_unlock(&mixer->mutex);
+	return SELECON_OK;
+}
+
+void smixer_stop(struct SAudioMixer *mixer) {
+	pthread_mutex_lock(&mixer->mutex);
+	bool running   = mixer->running;
+	mixer->running = false;
+	pthread_mutex_unlock(&mixer->mutex);
+	if (running)
+		pthread_join(mixer->thread, NULL);
+}
+
+bool smixer_running(struct SAudioMixer *mixer) {
+	pthread_mutex_lock(&mixer->mutex);
+	bool running = mixer->running;
+	pthread_mutex_unlock(&mixer->mutex);
+	return running;
+}
+
+enum SError smixer_push(struct SAudioMixer *mixer, part_id_t part_id, const struct AVFrame *frame) {
+	enum SError err = SELECON_MEMORY_ERROR;
+	pthread_mutex_lock(&mixer->mutex);
+	struct SMixerSource *source = get_source(mixer, part_id);
+	if (source != NULL && av_frame_ref(mixer->in_frame, frame) == 0) {
+		err = mfgraph_send(&source->graph, mixer->in_frame);
+		while (err == SELECON_OK && mfgraph_receive(&source->graph, mixer->out_frame) == 0) {
+			av_audio_fifo_write(
+			    source->fifo, (void **)mixer->out_frame->extended_data, mixer->out_frame->nb_samples);
+			av_frame_unref(mixer->out_frame);
+		}
+		// nobody reads fifo while mixer is stopped
+		int size = av_audio_fifo_size(source->fifo);
+		if (size > SELECON_MIXER_MAX_DELAY * mixer->tick_size)
+			av_audio_fifo_drain(source->fifo, size - SELECON_MIXER_MAX_DELAY * mixer->tick_size);
+	}
+	pthread_mutex_unlock(&mixer->mutex);
+	return err;
+}
+
+enum SError smixer_set_gain(struct SAudioMixer *mixer, part_id_t part_id, float gain) {
+	if (!isfinite(gain) || gain < 0.0f)
+		return SELECON_INVALID_ARG;
+	pthread_mutex_lock(&mixer->mutex);
+	struct SMixerSource *source = get_source(mixer, part_id);
+	if (source != NULL)
+		source->gain = gain;
+	pthread_mutex_unlock(&mixer->mutex);
+	return source != NULL ? SELECON_OK : SELECON_MEMORY_ERROR;
+}
+
+enum SError smixer_set_mute(struct SAudioMixer *mixer, part_id_t part_id, bool muted) {
+	pthread_mutex_lock(&mixer->mutex);
+	struct SMixerSource *source = get_source(mixer, part_id);
+	if (source != NULL)
+		source->muted = muted;
+	pthread_mutex_unlock(&mixer->mutex);
+	return source != NULL ? SELECON_OK : SELECON_MEMORY_ERROR;
+}
+
+void smixer_remove_source(struct SAudioMixer *mixer, part_id_t part_id) {
+	pthread_mutex_lock(&mixer->mutex);
+	struct SMixerSource *source = find_source(mixer, part_id);
+	if (source != NULL) {
+		source_free(source);
+		size_t index = source - mixer->sources;
+		for (size_t i = index + 1; i < mixer->nb_sources; ++i)
+			mixer->sources[i - 1] = mixer->sources[i];
+		mixer->nb_sources--;
+	}
+	pthread_mutex_unlock(&mixer->mutex);
+}
+
+static int prepare_frame(struct SAudioMixer *mixer, struct AVFrame *frame) {
+	int ret;
+	if (frame->buf[0] == NULL || frame->nb_samples != mixer->tick_size) {
+		av_frame_unref(frame);
+		frame->format      = AV_SAMPLE_FMT_FLTP;
+		frame->sample_rate = mixer->sample_rate;
+		frame->nb_samples  = mixer->tick_size;
+		av_channel_layout_default(&frame->ch_layout, mixer->nb_channels);
+		ret = av_frame_get_buffer(frame, 0);
+	} else
+		ret = av_frame_make_writable(frame);  // no copy unless handler kept reference
+	frame->time_base = av_make_q(1, mixer->sample_rate);
+	return ret;
+}
+
+// mixer->mutex must be locked. Reads one tick of source into mixer->planes, returns number of
+// samples read. Source is heard only after prefill and goes back to prefill on underrun, which
+// keeps jitter of its packets away from mixer clock
+static int read_source(struct SAudioMixer *mixer, struct SMixerSource *source) {
+	int size = av_audio_fifo_size(source->fifo);
+	if (!source->primed) {
+		if (size < SELECON_MIXER_PREFILL * mixer->tick_size)
+			return 0;
+		source->primed = true;
+	}
+	if (size > SELECON_MIXER_MAX_DELAY * mixer->tick_size)
+		av_audio_fifo_drain(source->fifo, size - SELECON_MIXER_PREFILL * mixer->tick_size);
+	int nb_read = av_audio_fifo_read(source->fifo, (void **)mixer->planes, mixer->tick_size);
+	if (nb_read < mixer->tick_size)
+		source->primed = false;
+	return nb_read < 0 ? 0 : nb_read;
+}
+
+// keeps mix within full scale. Gain drops at once when sum exceeds it and recovers with ramp, so
+// no sample of limited tick exceeds 1.0 and release is click free
+static void limit(struct SAudioMixer *mixer, float **planes) {
+	float peak = 0.0f;
+	for (int c = 0; c < mixer->nb_channels; ++c) {
+		float p = sconv_peak_flt(planes[c], mixer->tick_size);
+		peak    = p > peak ? p : peak;
+	}
+	float target = peak > 1.0f ? 1.0f / peak : 1.0f;
+	if (target < mixer->limiter_gain) {
+		mixer->limiter_gain = target;
+		for (int c = 0; c < mixer->nb_channels; ++c)
+			sconv_gain_flt(planes[c], mixer->tick_size, target);
+	} else if (mixer->limiter_gain < 1.0f) {
+		float from = mixer->limiter_gain;
+		float to   = from + (target - from) * SELECON_MIXER_LIMITER_RELEASE;
+		if (target - to < 1e-4f)
+			to = target;
+		for (int c = 0; c < mixer->nb_channels; ++c)
+			sconv_gain_ramp_flt(planes[c], mixer->tick_size, from, to);
+		mixer->limiter_gain = to;
+	}
+}
+
+int smixer_mix(struct SAudioMixer *mixer, struct AVFrame *frame) {
+	int ret = prepare_frame(mixer, frame);
+	if (ret < 0)
+		return ret;
+	float **mix = (float **)frame->extended_data;
+	for (int c = 0; c < mixer->nb_channels; ++c) memset(mix[c], 0, mixer->tick_size * sizeof(float));
+	int nb_mixed = 0;
+	pthread_mutex_lock(&mixer->mutex);
+	for (size_t i = 0; i < mixer->nb_sources; ++i) {
+		struct SMixerSource *source = &mixer->sources[i];
+		// muted sources are still read to keep their buffers in time
+		int nb_read = read_source(mixer, source);
+		if (nb_read == 0 || source->muted || source->gain == 0.0f)
+			continue;
+		for (int c = 0; c < mixer->nb_channels; ++c)
+			sconv_mix_flt(mix[c], mixer->planes[c], nb_read, source->gain);
+		nb_mixed++;
+	}
+	limit(mixer, mix);
+	frame->pts = frame->pkt_dts = mixer->pts;
+	mixer->pts += mixer->tick_size;
+	pthread_mutex_unlock(&mixer->mutex);
+	return nb_mixed;
+}
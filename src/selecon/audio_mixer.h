@@ -0,0 +1,80 @@
+#pragma once
+
+#include <libavutil/frame.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "error.h"
+#include "media_filters.h"
+#include "stypes.h"
+
+// audio of single participant waiting to be mixed
+struct SMixerSource {
+	part_id_t part_id;
+	float gain;  // linear
+	bool muted;
+	bool primed;  // enough audio buffered, cleared on underrun
+
+	// converts decoded frames to mixer format
+	struct MediaFilterGraph graph;
+	// jitter buffer between decoder output and mixer clock
+	struct AVAudioFifo *fifo;
+};
+
+// sums audio of all participants into single FLTP stream. Mixing is driven by own clock: every
+// tick one tick worth of samples is taken from each source, missing samples are silence. Sum goes
+// through limiter, so converting result to S16 never saturates for long
+struct SAudioMixer {
+	int sample_rate;
+	int nb_channels;
+	int tick_size;  // samples
+
+	struct SMixerSource *sources;
+	size_t nb_sources;
+
+	float limiter_gain;
+	int64_t pts;  // in samples
+
+	// scratch buffers, used under mutex
+	float **planes;
+	struct AVFrame *in_frame;
+	struct AVFrame *out_frame;
+
+	// mixed frames handler, called from mixer thread
+	media_handler_fn_t handler;
+	void *user_data;
+	part_id_t part_id;
+
+	pthread_mutex_t mutex;
+	pthread_t thread;
+	bool running;
+};
+
+enum SError smixer_init(struct SAudioMixer *mixer, int sample_rate, int nb_channels, int tick_size);
+
+void smixer_free(struct SAudioMixer *mixer);
+
+// starts mixer clock. Mixed frames are passed to handler with given part_id
+enum SError smixer_start(struct SAudioMixer *mixer,
+                         media_handler_fn_t handler,
+                         void *user_data,
+                         part_id_t part_id);
+
+void smixer_stop(struct SAudioMixer *mixer);
+
+bool smixer_running(struct SAudioMixer *mixer);
+
+// queues decoded audio of participant. Frame is not modified
+enum SError smixer_push(struct SAudioMixer *mixer, part_id_t part_id, const struct AVFrame *frame);
+
+// gain and mute are kept until source is removed, so they can be set before participant speaks
+enum SError smixer_set_gain(struct SAudioMixer *mixer, part_id_t part_id, float gain);
+enum SError smixer_set_mute(struct SAudioMixer *mixer, part_id_t part_id, bool muted);
+
+void smixer_remove_source(struct SAudioMixer *mixer, part_id_t part_id);
+
+// mixes one tick into frame (buffer is allocated or reused). Called by mixer thread, exposed
+// for tests and benchmarks. Returns number of sources heard in this tick or negative AVERROR
+int smixer_mix(struct SAudioMixer *mixer, struct AVFrame *frame);
@@ -193,7 +193,7 @@ static bool check_video_coder(
 	ctx->pix_fmt        = pixel_fmt;
 	ctx->width          = width;
 	ctx->height         = height;
-	ctx->framerate      = av_make_q(1, framerate);
+	ctx->framerate      = av_make_q(framerate, 1);
 	ctx->time_base      = av_make_q(1, 1000);
 	int ret             = avcodec_open2(ctx, codec, NULL);
 	if (ret < 0)
@@ -223,9 +223,9 @@ static bool check_video_coder(
 			        ctx->height);
 			ret = -1;
 		}
-		if (ctx->framerate.num * framerate != ctx->framerate.den) {
+		if (ctx->framerate.num != framerate * ctx->framerate.den) {
 			fprintf(stderr,
-			        "%s %s changed frame rate: 1/%d -> %d/%d\n",
+			        "%s %s changed frame rate: %d/1 -> %d/%d\n",
 			        codec->name,
 			        av_codec_is_encoder(codec) ? "encoder" : "decoder",
 			        framerate,
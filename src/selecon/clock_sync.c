@@ -0,0 +1,192 @@
+#include "clock_sync.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MS 1000000LL
+
+void sclock_init(struct SClockSync *sync) {
+	memset(sync, 0, sizeof(*sync));
+	sync->min_delay = INT64_MAX;
+}
+
+// offset of trusted exchanges only. Without enough span drift stays 0 and offset is taken from
+// fastest exchange
+static void fit(struct SClockSync *sync) {
+	const struct SClockSample *best = &sync->samples[0];
+	for (size_t i = 1; i < sync->count; ++i)
+		if (sync->samples[i].delay < best->delay)
+			best = &sync->samples[i];
+	sync->min_delay = best->delay;
+	sync->ref_ts    = best->local_ts;
+	sync->offset    = best->offset;
+	sync->drift     = 0.0;
+	double n = 0.0, sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+	int64_t first = 0, last = 0;
+	for (size_t i = 0; i < sync->count; ++i) {
+		const struct SClockSample *sample = &sync->samples[i];
+		if (sample->delay > best->delay + SELECON_CLOCK_DELAY_MARGIN * MS)
+			continue;
+		// relative to fastest exchange, so doubles keep ns precision
+		int64_t x = (int64_t)(sample->local_ts - best->local_ts);
+		double y  = (double)(sample->offset - best->offset);
+		first     = x < first ? x : first;
+		last      = x > last ? x : last;
+		n += 1.0;
+		sx += x;
+		sy += y;
+		sxx += (double)x * x;
+		sxy += x * y;
+	}
+	if (n < 3.0 || last - first < SELECON_CLOCK_DRIFT_SPAN * MS)
+		return;
+	double drift = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+	if (drift > SELECON_CLOCK_MAX_DRIFT / 1e6)
+		drift = SELECON_CLOCK_MAX_DRIFT / 1e6;
+	if (drift < -SELECON_CLOCK_MAX_DRIFT / 1e6)
+		drift = -SELECON_CLOCK_MAX_DRIFT / 1e6;
+	sync->drift = drift;
+	sync->offset += (int64_t)((sy - drift * sx) / n);
+}
+
+bool sclock_add(struct SClockSync *sync,
+                timestamp_t ping_ts,
+                timestamp_t recv_ts,
+                timestamp_t send_ts,
+                timestamp_t pong_ts) {
+	if (pong_ts < ping_ts || send_ts < recv_ts)
+		return false;
+	struct SClockSample sample;
+	sample.local_ts = ping_ts + (pong_ts - ping_ts) / 2;
+	sample.offset   = ((int64_t)(recv_ts - ping_ts) + (int64_t)(send_ts - pong_ts)) / 2;
+	sample.delay    = (int64_t)(pong_ts - ping_ts) - (int64_t)(send_ts - recv_ts);
+	if (sample.delay < 0)
+		sample.delay = 0;  // clock resolution
+	if (sync->count > 0 && sample.delay <= sync->min_delay + SELECON_CLOCK_DELAY_MARGIN * MS) {
+		int64_t error = sample.offset - sclock_offset(sync, sample.local_ts);
+		if (llabs(error) > SELECON_CLOCK_STEP * MS)
+			sync->count = sync->next = 0;
+	}
+	sync->samples[sync->next] = sample;
+	sync->next                = (sync->next + 1) % SELECON_CLOCK_SAMPLES;
+	if (sync->count < SELECON_CLOCK_SAMPLES)
+		sync->count++;
+	fit(sync);
+	return true;
+}
+
+bool sclock_valid(const struct SClockSync *sync) {
+	return sync->count > 0;
+}
+
+int64_t sclock_offset(const struct SClockSync *sync, timestamp_t local_ts) {
+	if (sync->count == 0)
+		return 0;
+	return sync->offset + (int64_t)(sync->drift * (double)(int64_t)(local_ts - sync->ref_ts));
+}
+
+timestamp_t sclock_to_local(const struct SClockSync *sync, timestamp_t peer_ts) {
+	// offset changes by ns per second of drift, taking it at peer time is close enough
+	return peer_ts - sclock_offset(sync, peer_ts - sync->offset);
+}
+
+enum SError sclocks_init(struct SClockTracker *tracker) {
+	memset(tracker, 0, sizeof(*tracker));
+	if (pthread_mutex_init(&tracker->mutex, NULL) != 0)
+		return SELECON_PTHREAD_ERROR;
+	return SELECON_OK;
+}
+
+void sclocks_free(struct SClockTracker *tracker) {
+	free(tracker->clocks);
+	tracker->clocks    = NULL;
+	tracker->nb_clocks = 0;
+	pthread_mutex_destroy(&tracker->mutex);
+}
+
+static struct SPeerClock *find_clock_locked(struct SClockTracker *tracker, part_id_t part_id) {
+	for (size_t i = 0; i < tracker->nb_clocks; ++i)
+		if (tracker->clocks[i].part_id == part_id)
+			return &tracker->clocks[i];
+	return NULL;
+}
+
+bool sclocks_exchange(struct SClockTracker *tracker,
+                      part_id_t part_id,
+                      timestamp_t ping_ts,
+                      timestamp_t recv_ts,
+                      timestamp_t send_ts,
+                      timestamp_t pong_ts) {
+	pthread_mutex_lock(&tracker->mutex);
+	struct SPeerClock *clock = find_clock_locked(tracker, part_id);
+	if (clock == NULL) {
+		struct SPeerClock *clocks =
+		    realloc(tracker->clocks, (tracker->nb_clocks + 1) * sizeof(struct SPeerClock));
+		if (clocks == NULL) {
+			pthread_mutex_unlock(&tracker->mutex);
+			return false;
+		}
+		tracker->clocks   = clocks;
+		clock             = &clocks[tracker->nb_clocks++];
+		clock->part_id    = part_id;
+		clock->latency_ms = -1.0f;
+		sclock_init(&clock->sync);
+	}
+	bool valid = sclock_add(&clock->sync, ping_ts, recv_ts, send_ts, pong_ts);
+	pthread_mutex_unlock(&tracker->mutex);
+	return valid;
+}
+
+void sclocks_arrived(struct SClockTracker *tracker,
+                     part_id_t part_id,
+                     timestamp_t sent_ts,
+                     timestamp_t now) {
+	pthread_mutex_lock(&tracker->mutex);
+	struct SPeerClock *clock = find_clock_locked(tracker, part_id);
+	if (clock != NULL && sclock_valid(&clock->sync)) {
+		float sample = (int64_t)(now - sclock_to_local(&clock->sync, sent_ts)) / 1e6f;
+		if (clock->latency_ms < 0.0f)
+			clock->latency_ms = sample;
+		else
+			clock->latency_ms += SELECON_RTT_SMOOTHING * (sample - clock->latency_ms);
+	}
+	pthread_mutex_unlock(&tracker->mutex);
+}
+
+timestamp_t sclocks_to_local(struct SClockTracker *tracker, part_id_t part_id, timestamp_t ts) {
+	pthread_mutex_lock(&tracker->mutex);
+	struct SPeerClock *clock = find_clock_locked(tracker, part_id);
+	if (clock != NULL)
+		ts = sclock_to_local(&clock->sync, ts);
+	pthread_mutex_unlock(&tracker->mutex);
+	return ts;
+}
+
+bool sclocks_stats(struct SClockTracker *tracker,
+                   part_id_t part_id,
+                   timestamp_t now,
+                   struct SClockStats *stats) {
+	pthread_mutex_lock(&tracker->mutex);
+	struct SPeerClock *clock = find_clock_locked(tracker, part_id);
+	bool found               = clock != NULL && sclock_valid(&clock->sync);
+	if (found) {
+		stats->offset_ns  = sclock_offset(&clock->sync, now);
+		stats->drift_ppm  = (float)(clock->sync.drift * 1e6);
+		stats->min_rtt_ms = clock->sync.min_delay / 1e6f;
+		stats->nb_samples = clock->sync.count;
+		stats->latency_ms = clock->latency_ms;
+	}
+	pthread_mutex_unlock(&tracker->mutex);
+	return found;
+}
+
+void sclocks_remove(struct SClockTracker *tracker, part_id_t part_id) {
+	pthread_mutex_lock(&tracker->mutex);
+	struct SPeerClock *clock = find_clock_locked(tracker, part_id);
+	if (clock != NULL) {
+		size_t index = clock - tracker->clocks;
+		memmove(clock, clock + 1, (tracker->nb_clocks - index - 1) * sizeof(*clock));
+		tracker->nb_clocks--;
+	}
+	pthread_mutex_unlock(&tracker->mutex);
+}
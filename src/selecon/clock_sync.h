@@ -0,0 +1,113 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "error.h"
+#include "stypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// one ping exchange with peer
+struct SClockSample {
+	timestamp_t local_ts;  // middle of exchange
+	int64_t offset;        // ns, peer clock minus local clock
+	int64_t delay;         // ns, round trip without time peer held ping
+};
+
+// estimates clock of single peer from ping exchanges. Offset is taken from exchanges with round
+// trip within SELECON_CLOCK_DELAY_MARGIN of shortest one kept, drift is least squares slope of
+// their offsets. Trusted exchange far from prediction means peer clock was stepped, history is
+// dropped then. Not thread safe
+struct SClockSync {
+	struct SClockSample samples[SELECON_CLOCK_SAMPLES];  // ring
+	size_t count;
+	size_t next;
+
+	// offset at ref_ts, changing by drift per local ns after it
+	timestamp_t ref_ts;
+	int64_t offset;
+	double drift;
+	int64_t min_delay;
+};
+
+void sclock_init(struct SClockSync *sync);
+
+// adds exchange: ping sent at ping_ts and pong received at pong_ts by local clock, ping received
+// at recv_ts and pong sent at send_ts by peer clock. Returns false for inconsistent exchange
+bool sclock_add(struct SClockSync *sync,
+                timestamp_t ping_ts,
+                timestamp_t recv_ts,
+                timestamp_t send_ts,
+                timestamp_t pong_ts);
+
+// true after first exchange
+bool sclock_valid(const struct SClockSync *sync);
+
+// peer clock minus local clock at given local time, 0 before first exchange
+int64_t sclock_offset(const struct SClockSync *sync, timestamp_t local_ts);
+
+// timestamp of peer clock in local time base
+timestamp_t sclock_to_local(const struct SClockSync *sync, timestamp_t peer_ts);
+
+struct SClockStats {
+	int64_t offset_ns;  // peer clock minus local clock now
+	float drift_ppm;    // peer clock rate minus local one
+	float min_rtt_ms;   // shortest round trip kept
+	size_t nb_samples;  // exchanges kept
+	float latency_ms;   // smoothed one way latency from capture at peer to arrival, negative
+	                    // until media comes
+};
+
+// clock of remote participant and latency of its media corrected by it
+struct SPeerClock {
+	part_id_t part_id;
+	struct SClockSync sync;
+	float latency_ms;
+};
+
+// clocks of all peers. Has own lock, so stream workers may translate timestamps from media
+// handlers without touching participants
+struct SClockTracker {
+	struct SPeerClock *clocks;
+	size_t nb_clocks;
+	pthread_mutex_t mutex;
+};
+
+enum SError sclocks_init(struct SClockTracker *tracker);
+void sclocks_free(struct SClockTracker *tracker);
+
+// adds ping exchange with participant, see sclock_add
+bool sclocks_exchange(struct SClockTracker *tracker,
+                      part_id_t part_id,
+                      timestamp_t ping_ts,
+                      timestamp_t recv_ts,
+                      timestamp_t send_ts,
+                      timestamp_t pong_ts);
+
+// media captured by participant at sent_ts of its clock arrived now. Ignored until clock of
+// participant is known
+void sclocks_arrived(struct SClockTracker *tracker,
+                     part_id_t part_id,
+                     timestamp_t sent_ts,
+                     timestamp_t now);
+
+// timestamp of participant clock in local time base. Unknown clocks are taken as local one
+timestamp_t sclocks_to_local(struct SClockTracker *tracker, part_id_t part_id, timestamp_t ts);
+
+// returns false if participant never answered ping
+bool sclocks_stats(struct SClockTracker *tracker,
+                   part_id_t part_id,
+                   timestamp_t now,
+                   struct SClockStats *stats);
+
+void sclocks_remove(struct SClockTracker *tracker, part_id_t part_id);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
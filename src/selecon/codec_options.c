@@ -0,0 +1,289 @@
+#include "codec_options.h"
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/dict.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#include "error.h"
+
+struct PresetParams {
+	double bits_per_pixel;  // video bitrate relative to pixel rate (width * height * fps)
+	int keyframe_interval;  // seconds between forced keyframes
+	const char *x264_preset;
+	const char *vpx_cpu_used;
+	int64_t aac_bit_rate;
+	int64_t opus_bit_rate;
+	const char *opus_application;
+	bool dtx;
+};
+
+static const struct PresetParams preset_params[] = {
+    [SCODEC_PRESET_CONFERENCE] = {0.08, 2, "veryfast", "8", 64000, 32000, "voip", true},
+    [SCODEC_PRESET_LOW_CPU]    = {0.05, 4, "ultrafast", "16", 48000, 24000, "lowdelay", true},
+    [SCODEC_PRESET_QUALITY]    = {0.12, 4, "faster", "4", 128000, 64000, "audio", false},
+};
+
+const char *scodec_preset_str(enum SCodecPreset preset) {
+	switch (preset) {
+		case SCODEC_PRESET_DEFAULT: return "default";
+		case SCODEC_PRESET_NONE: return "none";
+		case SCODEC_PRESET_CONFERENCE: return "conference";
+		case SCODEC_PRESET_LOW_CPU: return "low-cpu";
+		case SCODEC_PRESET_QUALITY: return "quality";
+		default: return "unknown";
+	}
+}
+
+enum SError scodec_options_set(struct SCodecOptions *opts, const char *key, const char *value) {
+	if (opts == NULL || key == NULL)
+		return SELECON_INVALID_ARG;
+	if (av_dict_set(&opts->priv_opts, key, value, 0) < 0)
+		return SELECON_MEMORY_ERROR;
+	return SELECON_OK;
+}
+
+enum SError scodec_options_copy(struct SCodecOptions *dst, const struct SCodecOptions *src) {
+	if (dst == NULL || src == NULL)
+		return SELECON_INVALID_ARG;
+	scodec_options_free(dst);
+	*dst           = *src;
+	dst->priv_opts = NULL;
+	if (av_dict_copy(&dst->priv_opts, src->priv_opts, 0) < 0)
+		return SELECON_MEMORY_ERROR;
+	return SELECON_OK;
+}
+
+enum SError scodec_options_merge(struct SCodecOptions *dst, const struct SCodecOptions *src) {
+	if (dst == NULL)
+		return SELECON_INVALID_ARG;
+	if (src == NULL)
+		return SELECON_OK;
+	if (src->preset != SCODEC_PRESET_DEFAULT)
+		dst->preset = src->preset;
+	if (src->bit_rate > 0)
+		dst->bit_rate = src->bit_rate;
+	if (src->max_rate > 0)
+		dst->max_rate = src->max_rate;
+	if (src->buffer_size > 0)
+		dst->buffer_size = src->buffer_size;
+	if (src->gop_size > 0)
+		dst->gop_size = src->gop_size;
+	if (src->thread_count > 0)
+		dst->thread_count = src->thread_count;
+	if (src->thread_type != 0)
+		dst->thread_type = src->thread_type;
+	dst->flags |= src->flags;
+	dst->flags2 |= src->flags2;
+	if (src->dtx != 0)
+		dst->dtx = src->dtx;
+	if (src->simulcast > 0)
+		dst->simulcast = src->simulcast;
+	if (src->temporal_layers > 0)
+		dst->temporal_layers = src->temporal_layers;
+	if (av_dict_copy(&dst->priv_opts, src->priv_opts, 0) < 0)
+		return SELECON_MEMORY_ERROR;
+	return SELECON_OK;
+}
+
+void scodec_options_free(struct SCodecOptions *opts) {
+	if (opts != NULL) {
+		av_dict_free(&opts->priv_opts);
+		memset(opts, 0, sizeof(struct SCodecOptions));
+	}
+}
+
+static enum SError preset_video_encoder(struct SCodecOptions *opts,
+                                        const struct PresetParams *params,
+                                        const struct AVCodecContext *codec_ctx) {
+	int fps = SELECON_DEFAULT_VIDEO_FPS;
+	if (codec_ctx->framerate.num > 0 && codec_ctx->framerate.den > 0)
+		fps = codec_ctx->framerate.num / codec_ctx->framerate.den;
+	opts->bit_rate    = params->bits_per_pixel * codec_ctx->width * codec_ctx->height * fps;
+	opts->max_rate    = opts->bit_rate;
+	opts->buffer_size = opts->bit_rate / 2;  // half a second of VBV keeps bursts short
+	opts->gop_size    = params->keyframe_interval * fps;
+	int ret           = 0;
+	if (strcmp(codec_ctx->codec->name, "libx264") == 0) {
+		// frame threads add one frame of delay each, slices do not
+		opts->thread_type = FF_THREAD_SLICE;
+		ret |= av_dict_set(&opts->priv_opts, "preset", params->x264_preset, 0);
+		ret |= av_dict_set(&opts->priv_opts, "tune", "zerolatency", 0);
+		// requested keyframes must be IDR, late joiner decoder starts from them
+		ret |= av_dict_set(&opts->priv_opts, "forced-idr", "1", 0);
+	} else if (strcmp(codec_ctx->codec->name, "libvpx") == 0) {
+		ret |= av_dict_set(&opts->priv_opts, "deadline", "realtime", 0);
+		ret |= av_dict_set(&opts->priv_opts, "cpu-used", params->vpx_cpu_used, 0);
+		ret |= av_dict_set(&opts->priv_opts, "lag-in-frames", "0", 0);
+	}
+	return ret < 0 ? SELECON_MEMORY_ERROR : SELECON_OK;
+}
+
+static enum SError preset_audio_encoder(struct SCodecOptions *opts,
+                                        const struct PresetParams *params,
+                                        const struct AVCodecContext *codec_ctx) {
+	int ret   = 0;
+	opts->dtx = params->dtx ? 1 : -1;
+	if (codec_ctx->codec_id == AV_CODEC_ID_AAC)
+		opts->bit_rate = params->aac_bit_rate;
+	else if (codec_ctx->codec_id == AV_CODEC_ID_OPUS) {
+		opts->bit_rate = params->opus_bit_rate;
+		if (strcmp(codec_ctx->codec->name, "libopus") == 0)
+			ret |= av_dict_set(&opts->priv_opts, "application", params->opus_application, 0);
+	}
+	return ret < 0 ? SELECON_MEMORY_ERROR : SELECON_OK;
+}
+
+static enum SError preset_decoder(struct SCodecOptions *opts,
+                                  enum SCodecPreset preset,
+                                  const struct AVCodecContext *codec_ctx) {
+	if (codec_ctx->codec_type == AVMEDIA_TYPE_VIDEO) {
+		// same as for encoders: frame threading delays output by thread_count frames
+		opts->thread_type = FF_THREAD_SLICE;
+		opts->flags |= AV_CODEC_FLAG_LOW_DELAY;
+		if (preset == SCODEC_PRESET_LOW_CPU)
+			opts->flags2 |= AV_CODEC_FLAG2_FAST;
+	}
+	return SELECON_OK;
+}
+
+enum SError scodec_options_preset(struct SCodecOptions *opts,
+                                  enum SCodecPreset preset,
+                                  const struct AVCodecContext *codec_ctx) {
+	if (opts == NULL || codec_ctx == NULL || codec_ctx->codec == NULL)
+		return SELECON_INVALID_ARG;
+	scodec_options_free(opts);
+	if (preset == SCODEC_PRESET_DEFAULT)
+		preset = SELECON_DEFAULT_CODEC_PRESET;
+	opts->preset = preset;
+	if (preset == SCODEC_PRESET_NONE)
+		return SELECON_OK;
+	if ((size_t)preset >= sizeof(preset_params) / sizeof(preset_params[0]))
+		return SELECON_INVALID_ARG;
+	if (!av_codec_is_encoder(codec_ctx->codec))
+		return preset_decoder(opts, preset, codec_ctx);
+	else if (codec_ctx->codec_type == AVMEDIA_TYPE_VIDEO)
+		return preset_video_encoder(opts, &preset_params[preset], codec_ctx);
+	else
+		return preset_audio_encoder(opts, &preset_params[preset], codec_ctx);
+}
+
+int scodec_temporal_layers(const struct AVCodec *codec, const struct SCodecOptions *opts) {
+	if (opts == NULL || opts->temporal_layers <= 1 || !av_codec_is_encoder(codec) ||
+	    strcmp(codec->name, "libvpx") != 0)
+		return 1;
+	return opts->temporal_layers < SELECON_MAX_TEMPORAL_LAYERS ? opts->temporal_layers
+	                                                           : SELECON_MAX_TEMPORAL_LAYERS;
+}
+
+int scodec_temporal_layer_id(int nb_layers, int64_t frame_index) {
+	// same patterns as libvpx layering modes 2 and 3: 0,1,0,1... and 0,2,1,2...
+	static const int l1t3[] = {0, 2, 1, 2};
+	if (nb_layers == 2)
+		return frame_index % 2;
+	if (nb_layers == 3)
+		return l1t3[frame_index % 4];
+	return 0;
+}
+
+void scodec_temporal_init(struct STemporalTracker *tracker, int nb_layers) {
+	tracker->nb_layers = nb_layers;
+	tracker->index     = 0;
+	tracker->next      = 0;
+	for (size_t i = 0; i < SELECON_TEMPORAL_PENDING; ++i) {
+		tracker->pts[i] = AV_NOPTS_VALUE;
+		tracker->ids[i] = 0;
+	}
+}
+
+int scodec_temporal_submit(struct STemporalTracker *tracker, int64_t pts, bool forced_keyframe) {
+	if (forced_keyframe)
+		tracker->index = 0;
+	int id                      = scodec_temporal_layer_id(tracker->nb_layers, tracker->index++);
+	tracker->pts[tracker->next] = pts;
+	tracker->ids[tracker->next] = id;
+	tracker->next               = (tracker->next + 1) % SELECON_TEMPORAL_PENDING;
+	return id;
+}
+
+int scodec_temporal_packet(const struct STemporalTracker *tracker, int64_t pts, bool keyframe) {
+	if (keyframe || pts == AV_NOPTS_VALUE)
+		return 0;
+	// newest first
+	for (size_t i = 1; i <= SELECON_TEMPORAL_PENDING; ++i) {
+		size_t slot = (tracker->next + SELECON_TEMPORAL_PENDING - i) % SELECON_TEMPORAL_PENDING;
+		if (tracker->pts[slot] == pts)
+			return tracker->ids[slot];
+	}
+	return 0;
+}
+
+// libvpx temporal layering with bitrate split between layers like in WebRTC: base layer takes 40%
+// of L1T3 stream and 60% of L1T2 one. Target bitrates are cumulative, in kbit/s
+static int set_vpx_temporal_layers(struct AVDictionary **priv_opts,
+                                   int nb_layers,
+                                   int64_t bit_rate) {
+	int64_t kbps = bit_rate > 0 ? bit_rate / 1000 : 256;
+	char params[128];
+	if (nb_layers == 2)
+		snprintf(params,
+		         sizeof(params),
+		         "ts_number_layers=2:ts_target_bitrate=%lld,%lld:ts_layering_mode=2",
+		         (long long)(kbps * 6 / 10),
+		         (long long)kbps);
+	else
+		snprintf(params,
+		         sizeof(params),
+		         "ts_number_layers=3:ts_target_bitrate=%lld,%lld,%lld:ts_layering_mode=3",
+		         (long long)(kbps * 4 / 10),
+		         (long long)(kbps * 6 / 10),
+		         (long long)kbps);
+	return av_dict_set(priv_opts, "ts-parameters", params, 0);
+}
+
+int scodec_open(struct AVCodecContext *codec_ctx,
+                const struct AVCodec *codec,
+                const struct SCodecOptions *opts) {
+	struct AVDictionary *priv_opts = NULL;
+	if (opts != NULL) {
+		if (opts->bit_rate > 0)
+			codec_ctx->bit_rate = opts->bit_rate;
+		if (opts->max_rate > 0)
+			codec_ctx->rc_max_rate = opts->max_rate;
+		if (opts->buffer_size > 0)
+			codec_ctx->rc_buffer_size = opts->buffer_size;
+		if (opts->gop_size > 0)
+			codec_ctx->gop_size = opts->gop_size;
+		if (opts->thread_count > 0)
+			codec_ctx->thread_count = opts->thread_count;
+		if (opts->thread_type != 0)
+			codec_ctx->thread_type = opts->thread_type;
+		codec_ctx->flags |= opts->flags;
+		codec_ctx->flags2 |= opts->flags2;
+		if (av_dict_copy(&priv_opts, opts->priv_opts, 0) < 0)
+			return AVERROR(ENOMEM);
+		// libopus sends only rare refresh packets during silence left after our VAD (noise floor
+		// just above threshold)
+		if (opts->dtx > 0 && av_codec_is_encoder(codec) && strcmp(codec->name, "libopus") == 0 &&
+		    av_dict_get(priv_opts, "dtx", NULL, 0) == NULL &&
+		    av_dict_set(&priv_opts, "dtx", "1", 0) < 0) {
+			av_dict_free(&priv_opts);
+			return AVERROR(ENOMEM);
+		}
+		int nb_layers = scodec_temporal_layers(codec, opts);
+		if (nb_layers > 1 && av_dict_get(priv_opts, "ts-parameters", NULL, 0) == NULL &&
+		    set_vpx_temporal_layers(&priv_opts, nb_layers, codec_ctx->bit_rate) < 0) {
+			av_dict_free(&priv_opts);
+			return AVERROR(ENOMEM);
+		}
+	}
+	int ret = avcodec_open2(codec_ctx, codec, &priv_opts);
+	// avcodec_open2 leaves only options not consumed by codec
+	struct AVDictionaryEntry *entry = NULL;
+	while ((entry = av_dict_get(priv_opts, "", entry, AV_DICT_IGNORE_SUFFIX)) != NULL)
+		fprintf(stderr, "%s: unknown codec option %s=%s\n", codec->name, entry->key, entry->value);
+	av_dict_free(&priv_opts);
+	return ret;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/dict.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "error.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// predefined codec tunings. Preset is applied first when codec is opened, all other non-zero
+// fields of SCodecOptions override values selected by preset
+enum SCodecPreset {
+	// use preset selected by SELECON_DEFAULT_CODEC_PRESET
+	SCODEC_PRESET_DEFAULT = 0,
+
+	// do not tune anything, leave libav defaults as is
+	SCODEC_PRESET_NONE,
+
+	// realtime coding without lookahead and B-frames, moderate bitrate
+	SCODEC_PRESET_CONFERENCE,
+
+	// fastest coding for weak machines and crowded conferences
+	SCODEC_PRESET_LOW_CPU,
+
+	// better picture for small conferences at the cost of CPU time and bandwidth
+	SCODEC_PRESET_QUALITY,
+};
+
+// options passed through to avcodec_open2. Zero fields are left untouched
+struct SCodecOptions {
+	enum SCodecPreset preset;
+
+	int64_t bit_rate;  // target bitrate in bits/s
+	int64_t max_rate;  // peak bitrate in bits/s (VBV)
+	int buffer_size;   // VBV buffer size in bits
+	int gop_size;      // keyframe interval in frames (video only)
+	int thread_count;  // amount of coding threads
+	int thread_type;   // FF_THREAD_SLICE or FF_THREAD_FRAME
+	int flags;         // AV_CODEC_FLAG_* ored into codec context flags
+	int flags2;        // AV_CODEC_FLAG2_* ored into codec context flags2
+
+	// audio encoders only. Positive value stops encoding silence detected by VAD and enables codec
+	// DTX where supported, negative disables both
+	int dtx;
+
+	// video encoders only. Amount of simulcast layers (1 - SELECON_MAX_SIMULCAST_LAYERS), zero
+	// means single layer
+	int simulcast;
+
+	// video encoders only. Amount of temporal layers (1 - SELECON_MAX_TEMPORAL_LAYERS), zero means
+	// single layer. Encoders without temporal scalability ignore it
+	int temporal_layers;
+
+	// codec private options (preset, tune, deadline, application, ...). Unknown options are
+	// reported to stderr and ignored
+	struct AVDictionary *priv_opts;
+};
+
+const char *scodec_preset_str(enum SCodecPreset preset);
+
+// sets private codec option (x264 "tune", libvpx "deadline", etc.)
+enum SError scodec_options_set(struct SCodecOptions *opts, const char *key, const char *value);
+
+// deep copy. dst must be initialized (zeroed) structure
+enum SError scodec_options_copy(struct SCodecOptions *dst, const struct SCodecOptions *src);
+
+// overrides dst fields with non-zero fields of src. Private options are merged
+enum SError scodec_options_merge(struct SCodecOptions *dst, const struct SCodecOptions *src);
+
+void scodec_options_free(struct SCodecOptions *opts);
+
+// fills opts with values of given preset for codec context. Context must have codec assigned and
+// media parameters (resolution, frame rate, sample rate) set up
+enum SError scodec_options_preset(struct SCodecOptions *opts,
+                                  enum SCodecPreset preset,
+                                  const struct AVCodecContext *codec_ctx);
+
+// amount of temporal layers codec produces with given options, 1 if it can not produce more
+int scodec_temporal_layers(const struct AVCodec *codec, const struct SCodecOptions *opts);
+
+// temporal layer of n-th frame encoded with given amount of temporal layers. Layer 0 frames are
+// referenced by all others, frames of top layer are not referenced at all
+int scodec_temporal_layer_id(int nb_layers, int64_t frame_index);
+
+// layers of frames submitted to layered encoder, kept by pts until their packets come out. Encoder
+// (libvpx layering mode) walks layer pattern once per submitted frame and restarts it on forced
+// keyframe, so frames it drops under rate control or holds back shift nothing here
+struct STemporalTracker {
+	int nb_layers;
+	int64_t index;  // pattern position of next frame
+	int64_t pts[SELECON_TEMPORAL_PENDING];
+	int ids[SELECON_TEMPORAL_PENDING];
+	size_t next;  // ring position
+};
+
+void scodec_temporal_init(struct STemporalTracker *tracker, int nb_layers);
+
+// frame with given pts goes to encoder. Returns its layer
+int scodec_temporal_submit(struct STemporalTracker *tracker, int64_t pts, bool forced_keyframe);
+
+// layer of packet with given pts. Keyframes and packets of frames not kept are base layer, so
+// receivers never drop them
+int scodec_temporal_packet(const struct STemporalTracker *tracker, int64_t pts, bool keyframe);
+
+// applies options to codec context and opens it. Returns avcodec_open2 result
+int scodec_open(struct AVCodecContext *codec_ctx,
+                const struct AVCodec *codec,
+                const struct SCodecOptions *opts);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -13,6 +13,12 @@
 #define SELECON_DEFAULT_SECURE_TIMEOUT 5000    // ms
 #define SELECON_DEFAULT_REENTER_TIMEOUT 30000  // ms
 
+// input streams are created on first media packet and closed after this long without packets
+#define SELECON_INPUT_STREAM_IDLE_TIMEOUT 10000  // ms
+
+// input streams of disconnected participants are kept with open decoders for fast reenter
+#define SELECON_STREAM_POOL_SIZE 8
+
 #define SELECON_USE_SECURE_CONNECTION
 
 // TODO: add check at context creation that selected codec supports our defaults
@@ -22,8 +28,147 @@
 #define SELECON_DEFAULT_AUDIO_SAMPLE_FMT AV_SAMPLE_FMT_FLTP
 #define SELECON_DEFAULT_AUDIO_FRAME_SIZE 1024  // samples
 
+// output audio streams with DTX enabled do not encode frames below VAD threshold. Receivers get
+// silence marker instead and play silence without decoding
+#define SELECON_VAD_THRESHOLD -55.0f          // dBov
+#define SELECON_VAD_HANGOVER 300              // ms of audio still sent after voice stops
+#define SELECON_DTX_MARKER_INTERVAL 400       // ms between silence markers
+#define SELECON_DTX_MAX_MARKER_SAMPLES 48000  // longer markers are clamped by receiver
+
+// active speakers are ranked by audio levels senders put into audio message headers
+#define SELECON_SPEAKER_TIMEOUT 500         // ms without packets, participant is silent
+#define SELECON_SPEAKER_SWITCH_MARGIN 6.0f  // dB louder than dominant speaker to take over
+#define SELECON_SPEAKER_ATTACK 0.5f         // part of level rise applied per packet
+#define SELECON_SPEAKER_RELEASE 0.1f        // part of level fall applied per packet
+
+// receivers may decode audio of K loudest speakers only (0 decodes everybody). Participant who
+// drops out of top K is still decoded for hold time
+#define SELECON_DEFAULT_AUDIO_TOP_K 0
+#define SELECON_AUDIO_TOP_K_HOLD 1000  // ms
+
+// receivers may subscribe to video of N most recent speakers only (0 receives everybody)
+#define SELECON_DEFAULT_VIDEO_LAST_N 0
+#define SELECON_VIDEO_LAST_N_INTERVAL 250  // ms between subscription updates
+
+// conference audio mixer sums all participants on common clock in ticks of this length
+#define SELECON_MIXER_TICK 20                // ms
+#define SELECON_MIXER_PREFILL 2              // ticks buffered before participant is mixed in
+#define SELECON_MIXER_MAX_DELAY 6            // ticks, older audio is dropped
+#define SELECON_MIXER_LIMITER_RELEASE 0.05f  // part of gain reduction recovered per tick
+
 #define SELECON_DEFAULT_VIDEO_CODEC_ID AV_CODEC_ID_H264
 #define SELECON_DEFAULT_VIDEO_PIXEL_FMT AV_PIX_FMT_YUV420P
 #define SELECON_DEFAULT_VIDEO_WIDTH 320
 #define SELECON_DEFAULT_VIDEO_HEIGHT 180
 #define SELECON_DEFAULT_VIDEO_FPS 30
+
+// limits for per-stream video parameters
+#define SELECON_MAX_VIDEO_WIDTH 1920
+#define SELECON_MAX_VIDEO_HEIGHT 1080
+#define SELECON_MAX_VIDEO_FPS 60
+
+// output video streams may encode simulcast layers, each at half resolution of previous one.
+// Layers lower than min height are not created
+#define SELECON_MAX_SIMULCAST_LAYERS 3
+#define SELECON_SIMULCAST_MIN_HEIGHT 90
+
+// video encoders supporting temporal scalability (libvpx) may split stream into up to 3 temporal
+// layers (L1T3). Receivers drop upper layers when asked to or when decoder falls behind
+#define SELECON_MAX_TEMPORAL_LAYERS 3
+#define SELECON_VIDEO_DECODE_BACKLOG 8  // queued packets, upper temporal layers are dropped
+#define SELECON_TEMPORAL_PENDING 16     // frames in encoder whose layer is kept for their packets
+
+// receivers without keyframe to start decoding from (late joiners, resumed subscriptions, decoder
+// errors) ask sender for one instead of waiting for next GOP. Sender forces keyframes no more
+// often than min interval, so requests of many joining receivers cost one keyframe
+#define SELECON_KEYFRAME_MIN_INTERVAL 1000     // ms between forced keyframes
+#define SELECON_KEYFRAME_REQUEST_INTERVAL 500  // ms before receiver repeats its request
+
+// input streams play packets out through jitter buffer. Playout delay is kept at factor times
+// measured jitter within limits. Audio packet which missed its playout time is concealed by fading
+// repeat of last decoded frame, no longer than max conceal in a row
+#define SELECON_JITTER_MIN_DELAY 20       // ms
+#define SELECON_JITTER_MAX_DELAY 400      // ms
+#define SELECON_JITTER_FACTOR 4.0f        // of interarrival jitter
+#define SELECON_JITTER_DELAY_DECAY 0.01f  // part of excess delay dropped per packet
+#define SELECON_JITTER_WINDOW 2000        // ms, fastest transit is tracked over two windows
+#define SELECON_JITTER_MAX_PACKETS 64     // buffered per stream
+#define SELECON_PLC_MAX_CONCEAL 120       // ms
+#define SELECON_PLC_FADE 0.5f             // gain of next concealed frame relative to previous
+
+// audio and video of one participant play at same sender capture time: stream which would play
+// earlier waits for other one, no longer than max delay. Smaller offsets than tolerance are left,
+// as every correction stretches or cuts playout
+#define SELECON_LIPSYNC_MAX_DELAY 300  // ms
+#define SELECON_LIPSYNC_TOLERANCE 10   // ms, below lip sync detection threshold
+
+// participants ping each other to measure round trip time and announce their capacity (uplink,
+// RTT, CPU headroom) to everybody
+#define SELECON_PING_INTERVAL 1000      // ms
+#define SELECON_RTT_SMOOTHING 0.125f    // part of new sample in smoothed RTT
+#define SELECON_CAPACITY_INTERVAL 2000  // ms between capacity announcements
+
+// ping exchanges also give clock offset of every peer (NTP on-wire calculation), so media
+// timestamps of other hosts map to local time. Exchanges with round trip close to shortest one
+// kept are trusted, as queueing in one direction skews offset by half of extra delay. Drift is
+// fitted over trusted exchanges once they span long enough
+#define SELECON_CLOCK_SAMPLES 32       // ping exchanges kept per peer
+#define SELECON_CLOCK_DELAY_MARGIN 2   // ms over shortest round trip
+#define SELECON_CLOCK_DRIFT_SPAN 8000  // ms between first and last trusted exchange
+#define SELECON_CLOCK_MAX_DRIFT 500    // ppm, quartz clocks stay within 100
+#define SELECON_CLOCK_STEP 100         // ms off prediction for trusted exchange to reset peer clock
+
+// receivers report how media of every sender comes through. Media goes over TCP, so congestion
+// shows as growing one way delay, not loss. Sender backs off below received bandwidth when delay
+// grows, queueing delay is high or packets miss playout, draining queue within drain time, and
+// probes up slowly otherwise. Frame rate follows bitrate below half of configured one
+#define SELECON_REPORT_INTERVAL 1000        // ms
+#define SELECON_RATE_BASE_WINDOW 10000      // ms, shortest transit is tracked over two windows
+#define SELECON_RATE_OVERUSE_GRADIENT 5000  // us per s of one way delay growth
+#define SELECON_RATE_MAX_QUEUE_DELAY 100    // ms over shortest transit
+#define SELECON_RATE_LOSS_HIGH 100          // per mille of packets missing playout, backs off
+#define SELECON_RATE_LOSS_LOW 20            // per mille, bitrate is held above
+#define SELECON_RATE_BACKOFF 0.85f          // of received bandwidth
+#define SELECON_RATE_DRAIN_TIME 2000        // ms
+#define SELECON_RATE_INCREASE 1.08f         // per report interval
+#define SELECON_RATE_MIN_FRACTION 0.1f      // of configured bitrate
+#define SELECON_RATE_MIN_FPS 5
+#define SELECON_RATE_MAX_RECEIVERS 32
+
+// organiser may choose conference topology automatically. Small conferences with enough uplink
+// everywhere stay full mesh, bigger ones send media through as few relays as their uplinks allow.
+// Relays are chosen among participants with CPU to spare and low RTT, so media takes at most three
+// short hops (sender, own relay, receiver relay) and latency stays bounded
+#define SELECON_DEFAULT_UPLINK_KBPS 5000      // assumed for participants not knowing their uplink
+#define SELECON_TOPOLOGY_MEDIA_KBPS 600       // audio and video sent by one participant
+#define SELECON_TOPOLOGY_MESH_MAX 6           // participants, bigger conferences use relays
+#define SELECON_TOPOLOGY_MAX_RELAYS 4         // relays in two level tree
+#define SELECON_TOPOLOGY_MIN_CPU_HEADROOM 30  // percent, busier participants do not relay
+#define SELECON_TOPOLOGY_MAX_RELAY_RTT 150    // ms, farther participants do not relay
+#define SELECON_TOPOLOGY_INTERVAL 5000        // ms between periodic replans
+
+// webinar listeners receive media through distribution tree. Presenters and listeners with spare
+// uplink feed up to this many listeners each
+#define SELECON_WEBINAR_MAX_FANOUT 8
+
+// canvas of video compositor
+#define SELECON_DEFAULT_COMPOSITE_WIDTH 640
+#define SELECON_DEFAULT_COMPOSITE_HEIGHT 360
+#define SELECON_DEFAULT_COMPOSITE_FPS 15
+
+// max amount of audio/video profiles offered in invite
+#define SELECON_MAX_MEDIA_PROFILES 8
+
+// codec tuning applied to streams without explicit SCodecOptions preset
+#define SELECON_DEFAULT_CODEC_PRESET SCODEC_PRESET_CONFERENCE
+
+// media is sealed end to end with conference key, rotated by organiser on membership change.
+// Senders switch to new key this long after it arrives, so every receiver has it by then
+#define SELECON_MEDIA_KEY_SWITCH_DELAY 500  // ms
+
+// sealed media travels outside TLS, so its length prefix is checked before anything is allocated.
+// Senders drop larger frames, receivers drop connection sending longer message. Video header is
+// longest media header
+#define SELECON_MAX_ENCODED_FRAME (4 << 20)  // bytes of serialized packet
+#define SELECON_MAX_MEDIA_MESSAGE_SIZE \
+	(sizeof(struct SMsgVideo) + SELECON_MAX_ENCODED_FRAME + SMCRYPT_TAG_SIZE)
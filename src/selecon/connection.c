@@ -3,12 +3,15 @@
 #include <openssl/bio.h>
 #include <openssl/err.h>
 #include <openssl/ssl.h>
+#include <pthread.h>
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "cert.h"
@@ -24,8 +27,14 @@ struct SConnection {
 	// if ssl is NULL - connection is raw and not secured
 	SSL *ssl;
 	SSL_CTX *ssl_ctx;
+
+	// messages sent from different threads must not interleave
+	pthread_mutex_t send_mutex;
 };
 
+// plain message on secure connection starts with this byte, TLS records never do
+#define PLAIN_MARKER 0
+
 static atomic_int ssl_usage_counter = 0;
 
 static void ssl_init(void) {
@@ -84,6 +93,7 @@ enum SError sconn_listen(struct SConnection **con, struct SEndpoint *ep) {
 		perror("socket");
 		goto socket_err;
 	}
+	pthread_mutex_init(&(*con)->send_mutex, NULL);
 	if (bind((*con)->fd, &(*con)->src_ep.addr, (*con)->src_ep.addr_len) != 0) {
 		perror("bind");
 		goto con_err;
@@ -94,6 +104,7 @@ enum SError sconn_listen(struct SConnection **con, struct SEndpoint *ep) {
 	}
 	return SELECON_OK;
 con_err:
+	pthread_mutex_destroy(&(*con)->send_mutex);
 	close((*con)->fd);
 socket_err:
 	free(*con);
@@ -119,10 +130,22 @@ enum SError sconn_accept(struct SConnection *con, struct SConnection **out_con,
 		*out_con = malloc(sizeof(struct SConnection));
 	**out_con      = *con;
 	(*out_con)->fd = other_sock;
+	pthread_mutex_init(&(*out_con)->send_mutex, NULL);
 	return SELECON_OK;
 }
 
 #ifdef SELECON_USE_SECURE_CONNECTION
+// plain media shares socket with TLS records and is told apart by peeking at socket between
+// records (see sconn_recv). That holds only while OpenSSL never reads past record it processes:
+// read ahead must stay off and records must come from fd through plain socket BIO
+static bool ssl_attach(struct SConnection *con) {
+	con->ssl = SSL_new(con->ssl_ctx);
+	if (con->ssl == NULL)
+		return false;
+	SSL_set_read_ahead(con->ssl, 0);
+	return SSL_set_fd(con->ssl, con->fd) == 1;
+}
+
 enum SError sconn_accept_secure(struct SConnection *con,
                                 struct SConnection **out_con,
                                 int timeout_ms) {
@@ -131,9 +154,7 @@ enum SError sconn_accept_secure(struct SConnection *con,
 		return err;
 	ssl_init();
 	if (((*out_con)->ssl_ctx = ssl_new_server_ctx()) != NULL) {
-		(*out_con)->ssl = SSL_new((*out_con)->ssl_ctx);
-		SSL_set_fd((*out_con)->ssl, (*out_con)->fd);
-		if (SSL_accept((*out_con)->ssl) > 0)
+		if (ssl_attach(*out_con) && SSL_accept((*out_con)->ssl) > 0)
 			return SELECON_OK;
 	}
 	ERR_print_errors_fp(stderr);
@@ -145,19 +166,23 @@ enum SError sconn_accept_secure(struct SConnection *con,
 enum SError sconn_connect(struct SConnection **con, struct SEndpoint *ep) {
 	if (con == NULL || ep == NULL)
 		return SELECON_INVALID_ARG;
-	*con           = malloc(sizeof(struct SConnection));
-	(*con)->dst_ep = *ep;
-	(*con)->fd     = socket(ep->af, SOCK_STREAM, 0);
+	*con            = malloc(sizeof(struct SConnection));
+	(*con)->dst_ep  = *ep;
+	(*con)->ssl     = NULL;
+	(*con)->ssl_ctx = NULL;
+	(*con)->fd      = socket(ep->af, SOCK_STREAM, 0);
 	if ((*con)->fd == -1) {
 		perror("socket");
 		goto socket_err;
 	}
+	pthread_mutex_init(&(*con)->send_mutex, NULL);
 	if (connect((*con)->fd, &(*con)->dst_ep.addr, (*con)->dst_ep.addr_len) != 0) {
 		perror("connect");
 		goto con_err;
 	}
 	return SELECON_OK;
 con_err:
+	pthread_mutex_destroy(&(*con)->send_mutex);
 	close((*con)->fd);
 socket_err:
 	free(*con);
@@ -172,9 +197,7 @@ enum SError sconn_connect_secure(struct SConnection **con, struct SEndpoint *ep)
 		return err;
 	ssl_init();
 	if (((*con)->ssl_ctx = ssl_new_client_ctx()) != NULL) {
-		(*con)->ssl = SSL_new((*con)->ssl_ctx);
-		SSL_set_fd((*con)->ssl, (*con)->fd);
-		if (SSL_connect((*con)->ssl) > 0)
+		if (ssl_attach(*con) && SSL_connect((*con)->ssl) > 0)
 			return SELECON_OK;
 	}
 	ERR_print_errors_fp(stderr);
@@ -196,15 +219,14 @@ enum SError sconn_disconnect(struct SConnection **con) {
 		ssl_destroy();
 	}
 #endif
+	pthread_mutex_destroy(&(*con)->send_mutex);
 	close((*con)->fd);
 	free(*con);
 	*con = NULL;
 	return SELECON_OK;
 }
 
-enum SError sconn_send(struct SConnection *con, struct SMessage *msg) {
-	if (con == NULL || msg == NULL)
-		return SELECON_INVALID_ARG;
+static enum SError sconn_send_locked(struct SConnection *con, struct SMessage *msg) {
 #ifdef SELECON_USE_SECURE_CONNECTION
 	if (con->ssl != NULL) {
 		int ret = 0;
@@ -228,6 +250,35 @@ enum SError sconn_send(struct SConnection *con, struct SMessage *msg) {
 	return SELECON_OK;
 }
 
+enum SError sconn_send(struct SConnection *con, struct SMessage *msg) {
+	if (con == NULL || msg == NULL)
+		return SELECON_INVALID_ARG;
+	pthread_mutex_lock(&con->send_mutex);
+	enum SError err = sconn_send_locked(con, msg);
+	pthread_mutex_unlock(&con->send_mutex);
+	return err;
+}
+
+enum SError sconn_send_plain(struct SConnection *con, struct SMessage *msg) {
+	if (con == NULL || msg == NULL)
+		return SELECON_INVALID_ARG;
+	pthread_mutex_lock(&con->send_mutex);
+	enum SError err = SELECON_OK;
+	if (con->ssl == NULL)
+		err = sconn_send_locked(con, msg);
+	else {
+		uint8_t marker      = PLAIN_MARKER;
+		struct iovec iov[2] = {{&marker, 1}, {msg, msg->size}};
+		struct msghdr hdr   = {.msg_iov = iov, .msg_iovlen = 2};
+		if (sendmsg(con->fd, &hdr, 0) != (ssize_t)(1 + msg->size)) {
+			perror("sendmsg");
+			err = SELECON_CON_ERROR;
+		}
+	}
+	pthread_mutex_unlock(&con->send_mutex);
+	return err;
+}
+
 static int sconn_recv_part(struct SConnection *con, void *buffer, size_t size) {
 	int ret = 0;
 #ifdef SELECON_USE_SECURE_CONNECTION
@@ -245,9 +296,56 @@ static int sconn_recv_part(struct SConnection *con, void *buffer, size_t size) {
 	return ret;
 }
 
+// plain message on secure connection is accepted for sealed media only, which is authenticated by
+// receiver. Everything else must come through TLS. Nothing authenticates length prefix before tag
+// is checked, so it is bounded by SELECON_MAX_MEDIA_MESSAGE_SIZE before allocation and stream is
+// given up on anything else, as message boundaries can not be trusted anymore
+static enum SError sconn_recv_plain(struct SConnection *con, struct SMessage **msg) {
+	uint8_t marker = 0;
+	size_t size    = 0;
+	if (recv(con->fd, &marker, 1, 0) != 1 ||
+	    recv(con->fd, &size, sizeof(size), MSG_WAITALL) != sizeof(size))
+		return SELECON_CON_ERROR;
+	if (size < sizeof(struct SMsgAudio) + SMCRYPT_TAG_SIZE ||
+	    size > SELECON_MAX_MEDIA_MESSAGE_SIZE) {
+		fprintf(stderr, "dropped connection sending plain message of %zu bytes\n", size);
+		return SELECON_CON_ERROR;
+	}
+	if (*msg == NULL || (*msg)->size < size) {
+		message_free(msg);
+		*msg = message_alloc(size);
+		if (*msg == NULL)
+			return SELECON_MEMORY_ERROR;
+	}
+	if (recv(con->fd, &(*msg)->type, size - sizeof(size), MSG_WAITALL) !=
+	    (ssize_t)(size - sizeof(size)))
+		return SELECON_CON_ERROR;
+	(*msg)->size = size;
+	if ((*msg)->type != SMSG_AUDIO && (*msg)->type != SMSG_VIDEO) {
+		fprintf(stderr, "dropped plain message of type %d\n", (*msg)->type);
+		return SELECON_UNEXPECTED_MSG_TYPE;
+	}
+	// header and tag must fit, payload is what is left between them
+	uint8_t *data  = NULL;
+	size_t payload = 0;
+	if (message_media_seal(*msg, &data, &payload) == NULL || payload > SELECON_MAX_ENCODED_FRAME) {
+		fprintf(stderr, "dropped malformed plain media message of %zu bytes\n", size);
+		return SELECON_UNEXPECTED_MSG_TYPE;
+	}
+	return SELECON_OK;
+}
+
 enum SError sconn_recv(struct SConnection *con, struct SMessage **msg) {
 	if (con == NULL || msg == NULL)
 		return SELECON_INVALID_ARG;
+#ifdef SELECON_USE_SECURE_CONNECTION
+	// plain message may start only where no TLS record is buffered, processed or not. Relies on
+	// read ahead being off, see ssl_attach
+	uint8_t first = 0;
+	if (con->ssl != NULL && !SSL_has_pending(con->ssl) &&
+	    recv(con->fd, &first, 1, MSG_PEEK) == 1 && first == PLAIN_MARKER)
+		return sconn_recv_plain(con, msg);
+#endif
 	size_t size = 0;
 	int ret     = sconn_recv_part(con, &size, sizeof(size_t));
 	if (ret == -1)
@@ -263,9 +361,13 @@ enum SError sconn_recv(struct SConnection *con, struct SMessage **msg) {
 #endif
 		return SELECON_CON_HANGUP;
 	}
+	if (size < sizeof(struct SMessage))
+		return SELECON_CON_ERROR;
 	if (*msg == NULL || (*msg)->size < size) {
 		message_free(msg);
 		*msg = message_alloc(size);
+		if (*msg == NULL)
+			return SELECON_MEMORY_ERROR;
 	}
 	ret = sconn_recv_part(con, &(*msg)->type, size - sizeof(size));
 	if (ret == -1)
@@ -274,6 +376,7 @@ enum SError sconn_recv(struct SConnection *con, struct SMessage **msg) {
 		message_free(msg);
 		return SELECON_CON_ERROR;
 	}
+	(*msg)->size = size;  // reused message may be larger
 	return SELECON_OK;
 }
 
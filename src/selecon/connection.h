@@ -45,6 +45,11 @@ enum SError sconn_disconnect(struct SConnection **con);
 // does not free message upon errors
 enum SError sconn_send(struct SConnection *con, struct SMessage *msg);
 
+// sends message outside of TLS on secure connection, same as sconn_send on raw one. Receiver
+// accepts only audio and video this way, which are sealed with conference media key. Does not
+// free message upon errors
+enum SError sconn_send_plain(struct SConnection *con, struct SMessage *msg);
+
 // allocates new message if ariving message does not fit into provided one.
 // Does not free message upon errors
 enum SError sconn_recv(struct SConnection *con, struct SMessage **msg);
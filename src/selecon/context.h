@@ -2,10 +2,17 @@
 
 #include <pthread.h>
 
+#include "active_speakers.h"
+#include "audio_mixer.h"
+#include "clock_sync.h"
 #include "endpoint.h"
+#include "media_crypto.h"
+#include "media_profile.h"
 #include "participant.h"
 #include "stream.h"
 #include "stypes.h"
+#include "topology.h"
+#include "video_compositor.h"
 
 struct SContext {
 	bool initialized;
@@ -43,5 +50,63 @@ struct SContext {
 	pthread_t conf_thread;
 	bool conf_thread_working;
 
+	// media profiles this participant is able and willing to use. Conference profile itself is
+	// kept in streams container
+	struct SMediaCaps caps;
+
 	struct SStreamContainer streams;
+
+	// decoded media of remote participants. Can be NULL
+	media_handler_fn_t media_handler;
+
+	// mixes audio of all participants when enabled
+	struct SAudioMixer mixer;
+
+	// tiles video of all participants into single frame when enabled
+	struct SVideoCompositor compositor;
+
+	// ranking of remote participants by audio levels from message headers
+	struct SSpeakerTracker speakers;
+
+	// clocks of remote participants estimated from ping exchanges
+	struct SClockTracker clocks;
+
+	// notified about dominant speaker changes. Can be NULL
+	speaker_handler_fn_t speaker_handler;
+
+	// audio of this many loudest speakers is decoded, 0 for everybody
+	size_t audio_top_k;
+
+	// video of this many recent speakers is received in full, others get video_rest subscription.
+	// 0 receives everything
+	size_t video_last_n;
+	enum SVideoSubscription video_rest;
+
+	// temporal layers of received video passed to decoders. Upper ones are dropped
+	int video_temporal_layers;
+
+	// process CPU time and wall time of last CPU headroom measurement
+	int64_t cpu_probe_ns;
+	timestamp_t cpu_probe_ts;
+
+	// only presenters send media, listeners get it through distribution tree. Set by organiser
+	// before conference starts and taken from invite by others
+	bool webinar;
+
+	// organiser chooses topology when enabled. Replanned periodically and as soon as somebody
+	// joins, leaves or changes role. Relay of self is kept in self.relay_id
+	bool auto_topology;
+	bool topology_dirty;
+	enum STopology topology;
+
+	// conference media key media is sealed with. Organiser rotates it when somebody joins,
+	// leaves or reenters
+	struct SMediaCrypto crypto;
+	bool rekey;
+
+	// emulated uplink bottleneck, see selecon_set_send_limit. link_free_ts is when emulated link
+	// is done with everything sent so far
+	uint32_t send_limit_kbps;
+	timestamp_t link_free_ts;
+	pthread_mutex_t link_mutex;
 };
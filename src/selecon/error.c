@@ -19,6 +19,8 @@ const char* serror_str(enum SError err) {
 		case SELECON_NOT_IMPLEMENTED: return "not implemented";
 		case SELECON_AVERROR: return "av error";
 		case SELECON_SSL_ERROR: return "SSL error";
+		case SELECON_NOT_PRESENTER: return "only presenters send media in webinar";
+		case SELECON_CRYPTO_ERROR: return "media encryption error";
 		case SELECON_UNEXPECTED_MSG_TYPE:
 			return "unexpected message type";
 			// default: return "unknown error";
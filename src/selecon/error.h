@@ -23,6 +23,8 @@ enum SError {
 	SELECON_NOT_IMPLEMENTED,
 	SELECON_AVERROR,
 	SELECON_SSL_ERROR,
+	SELECON_NOT_PRESENTER,
+	SELECON_CRYPTO_ERROR,
 };
 
 const char* serror_str(enum SError err);
@@ -0,0 +1,216 @@
+#include "jitter_buffer.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// arrival time minus sender time. Differs from one way delay by clock offset, which is same for
+// all packets, so fastest transit still marks fastest packet
+static int64_t transit(int64_t pts, timestamp_t arrival_ts) {
+	return (int64_t)arrival_ts - pts * 1000000LL;
+}
+
+// local time minus sender time of playout without lip sync delay, ns
+static int64_t playout_offset(const struct SJitterBuffer *jb) {
+	int64_t base = jb->min_transit < jb->prev_min_transit ? jb->min_transit : jb->prev_min_transit;
+	return base + (int64_t)(jb->delay_ms * 1000000.0f);
+}
+
+static timestamp_t playout_ts(const struct SJitterBuffer *jb, int64_t pts) {
+	return pts * 1000000LL + playout_offset(jb) + jb->sync_delay_ms * 1000000LL;
+}
+
+// target delay jumps up to cover jitter at once, excess is dropped slowly, as every cut of delay
+// takes playout time from packets on their way
+static void update_delay(struct SJitterBuffer *jb, float lateness_ms) {
+	float wanted = SELECON_JITTER_FACTOR * jb->jitter_ms;
+	// late packet shows delay was short by its lateness at least
+	if (lateness_ms > 0.0f && wanted < jb->delay_ms + lateness_ms)
+		wanted = jb->delay_ms + lateness_ms;
+	if (wanted < SELECON_JITTER_MIN_DELAY)
+		wanted = SELECON_JITTER_MIN_DELAY;
+	if (wanted > SELECON_JITTER_MAX_DELAY)
+		wanted = SELECON_JITTER_MAX_DELAY;
+	if (wanted > jb->delay_ms)
+		jb->delay_ms = wanted;
+	else
+		jb->delay_ms += (wanted - jb->delay_ms) * SELECON_JITTER_DELAY_DECAY;
+}
+
+static void update_clock(struct SJitterBuffer *jb, int64_t pts, timestamp_t arrival_ts) {
+	int64_t t     = transit(pts, arrival_ts);
+	bool in_order = jb->stats.nb_packets == 0 || pts > jb->last_pts;
+	// interarrival jitter of RFC 3550, reordered packets would count twice
+	if (jb->stats.nb_packets > 0 && in_order)
+		jb->jitter_ms += (fabsf((t - jb->last_transit) / 1e6f) - jb->jitter_ms) / 16.0f;
+	if (in_order) {
+		jb->last_pts     = pts;
+		jb->last_transit = t;
+	}
+	if (arrival_ts - jb->window_ts >= SELECON_JITTER_WINDOW * 1000000ULL) {
+		jb->prev_min_transit = jb->min_transit;
+		jb->min_transit      = t;
+		jb->window_ts        = arrival_ts;
+	} else if (t < jb->min_transit)
+		jb->min_transit = t;
+	jb->stats.nb_packets++;
+}
+
+// true if packet expected next would be reported lost when it misses its playout time
+static bool may_conceal(const struct SJitterBuffer *jb) {
+	return jb->conceal && jb->playing && !jb->last_silence && jb->last_duration > 0 &&
+	       jb->concealed_ms < SELECON_PLC_MAX_CONCEAL;
+}
+
+static void remove_first(struct SJitterBuffer *jb, struct SJitterPacket *packet) {
+	*packet = jb->packets[0];
+	jb->count--;
+	memmove(&jb->packets[0], &jb->packets[1], jb->count * sizeof(jb->packets[0]));
+}
+
+static void played(struct SJitterBuffer *jb, const struct SJitterPacket *packet) {
+	int64_t end = packet->pts + packet->duration;
+	if (!jb->playing || end > jb->next_pts)
+		jb->next_pts = end;
+	jb->playing       = true;
+	jb->last_duration = packet->duration;
+	jb->last_silence  = packet->silence;
+	jb->concealed_ms  = 0;
+}
+
+void sjbuf_init(struct SJitterBuffer *jb, bool conceal) {
+	memset(jb, 0, sizeof(*jb));
+	jb->conceal          = conceal;
+	jb->min_transit      = INT64_MAX;
+	jb->prev_min_transit = INT64_MAX;
+	jb->delay_ms         = SELECON_JITTER_MIN_DELAY;
+}
+
+bool sjbuf_push(struct SJitterBuffer *jb,
+                const struct SJitterPacket *packet,
+                timestamp_t arrival_ts) {
+	if (jb->stats.nb_packets == 0)
+		jb->window_ts = arrival_ts;
+	update_clock(jb, packet->pts, arrival_ts);
+	timestamp_t due   = playout_ts(jb, packet->pts);
+	float lateness_ms = 0.0f;
+	if (arrival_ts > due) {
+		jb->stats.nb_late++;
+		lateness_ms = (arrival_ts - due) / 1e6f;
+	}
+	update_delay(jb, lateness_ms);
+	// its time was concealed already, playing it now would shift everything after
+	bool concealed =
+	    jb->conceal && jb->playing && packet->pts + jb->last_duration / 2 < jb->next_pts;
+	if (concealed || jb->count == SELECON_JITTER_MAX_PACKETS) {
+		jb->stats.nb_dropped++;
+		return false;
+	}
+	size_t index = jb->count;
+	while (index > 0 && jb->packets[index - 1].pts > packet->pts) --index;
+	memmove(&jb->packets[index + 1],
+	        &jb->packets[index],
+	        (jb->count - index) * sizeof(jb->packets[0]));
+	jb->packets[index] = *packet;
+	jb->count++;
+	return true;
+}
+
+enum SJitterResult sjbuf_pop(struct SJitterBuffer *jb,
+                             timestamp_t now,
+                             struct SJitterPacket *packet,
+                             timestamp_t *due_ts) {
+	bool missing = jb->count == 0 || jb->packets[0].pts > jb->next_pts + jb->last_duration / 2;
+	if (missing && may_conceal(jb)) {
+		// next packet plays later than expected one, so loss is due first
+		timestamp_t due = playout_ts(jb, jb->next_pts);
+		if (now < due) {
+			*due_ts = due;
+			return SJBUF_WAIT;
+		}
+		int64_t duration = jb->last_duration;
+		if (jb->count > 0 && jb->packets[0].pts - jb->next_pts < duration)
+			duration = jb->packets[0].pts - jb->next_pts;
+		packet->data     = NULL;
+		packet->pts      = jb->next_pts;
+		packet->duration = duration;
+		packet->silence  = false;
+		jb->next_pts += duration;
+		jb->concealed_ms += duration;
+		jb->stats.nb_concealed++;
+		return SJBUF_LOST;
+	}
+	if (jb->count == 0)
+		return SJBUF_EMPTY;
+	timestamp_t due = playout_ts(jb, jb->packets[0].pts);
+	// full buffer plays at once, sender clock must have jumped
+	if (now < due && jb->count < SELECON_JITTER_MAX_PACKETS) {
+		*due_ts = due;
+		return SJBUF_WAIT;
+	}
+	remove_first(jb, packet);
+	played(jb, packet);
+	return SJBUF_PACKET;
+}
+
+size_t sjbuf_due(const struct SJitterBuffer *jb, timestamp_t now) {
+	size_t count = 0;
+	while (count < jb->count && playout_ts(jb, jb->packets[count].pts) <= now) ++count;
+	return count;
+}
+
+int64_t sjbuf_lag(const struct SJitterBuffer *jb, timestamp_t now) {
+	if (jb->count == 0)
+		return 0;
+	int64_t lag = (int64_t)(now - playout_ts(jb, jb->packets[0].pts));
+	return lag > 0 ? lag / 1000000 : 0;
+}
+
+bool sjbuf_take(struct SJitterBuffer *jb, struct SJitterPacket *packet) {
+	if (jb->count == 0)
+		return false;
+	remove_first(jb, packet);
+	return true;
+}
+
+void sjbuf_restart(struct SJitterBuffer *jb) {
+	jb->playing      = false;
+	jb->concealed_ms = 0;
+}
+
+void sjbuf_stats(const struct SJitterBuffer *jb, struct SJitterStats *stats) {
+	*stats               = jb->stats;
+	stats->depth         = jb->count;
+	stats->depth_ms      = jb->count > 0 ? jb->packets[jb->count - 1].pts - jb->packets[0].pts : 0;
+	stats->jitter_ms     = jb->jitter_ms;
+	stats->delay_ms      = (int64_t)jb->delay_ms;
+	stats->sync_delay_ms = jb->sync_delay_ms;
+}
+
+bool sjbuf_lipsync_stats(const struct SJitterBuffer *audio,
+                         const struct SJitterBuffer *video,
+                         struct SLipSyncStats *stats) {
+	if (audio->stats.nb_packets == 0 || video->stats.nb_packets == 0)
+		return false;
+	stats->av_offset_ms   = (playout_offset(video) - playout_offset(audio)) / 1000000LL;
+	stats->audio_delay_ms = audio->sync_delay_ms;
+	stats->video_delay_ms = video->sync_delay_ms;
+	stats->residual_ms    = stats->av_offset_ms + video->sync_delay_ms - audio->sync_delay_ms;
+	return true;
+}
+
+bool sjbuf_lipsync(struct SJitterBuffer *audio,
+                   struct SJitterBuffer *video,
+                   struct SLipSyncStats *stats) {
+	if (!sjbuf_lipsync_stats(audio, video, stats))
+		return false;
+	if (llabs(stats->residual_ms) < SELECON_LIPSYNC_TOLERANCE)
+		return true;
+	int64_t delay = llabs(stats->av_offset_ms);
+	if (delay > SELECON_LIPSYNC_MAX_DELAY)
+		delay = SELECON_LIPSYNC_MAX_DELAY;
+	// only earlier stream waits, delaying both would add latency for nothing
+	audio->sync_delay_ms = stats->av_offset_ms > 0 ? delay : 0;
+	video->sync_delay_ms = stats->av_offset_ms > 0 ? 0 : delay;
+	return sjbuf_lipsync_stats(audio, video, stats);
+}
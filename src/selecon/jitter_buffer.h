@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "stypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// packet of input stream waiting for its playout time
+struct SJitterPacket {
+	void *data;        // AVPacket, NULL for lost packet
+	int64_t pts;       // ms of sender clock since conference start
+	int64_t duration;  // ms
+	bool silence;      // DTX silence marker, sender sends nothing after it until voice resumes
+};
+
+struct SJitterStats {
+	size_t depth;           // buffered packets
+	int64_t depth_ms;       // sender time between first and last buffered packet
+	float jitter_ms;        // interarrival jitter estimate
+	int64_t delay_ms;       // target playout delay over fastest transit seen
+	uint64_t nb_packets;    // pushed
+	uint64_t nb_late;       // arrived after their playout time
+	uint64_t nb_dropped;    // late ones which were concealed already, or buffer overflow
+	uint64_t nb_concealed;  // lost packets reported for concealment
+	int64_t sync_delay_ms;  // added to target delay for lip sync
+};
+
+// audio and video playout of one sender
+struct SLipSyncStats {
+	int64_t av_offset_ms;    // video playout minus audio playout without lip sync
+	int64_t audio_delay_ms;  // added to audio, waiting for video
+	int64_t video_delay_ms;  // added to video, waiting for audio
+	int64_t residual_ms;     // video playout minus audio playout, beyond max delay or tolerance
+};
+
+// orders packets of one input stream by sender timestamp and releases them on playout clock:
+// packet plays at its pts mapped to local time by fastest transit seen during last two
+// SELECON_JITTER_WINDOWs plus target delay. Target delay follows interarrival jitter (RFC 3550),
+// grows at once and shrinks slowly. Concealing buffers (audio) report packet which missed its
+// playout time as lost, up to SELECON_PLC_MAX_CONCEAL in a row, and drop it if it comes later.
+// Not thread safe, owner locks it
+struct SJitterBuffer {
+	struct SJitterPacket packets[SELECON_JITTER_MAX_PACKETS];  // sorted by pts
+	size_t count;
+	bool conceal;
+
+	// playout clock
+	int64_t min_transit;       // ns, arrival minus pts, over current window
+	int64_t prev_min_transit;  // over previous window
+	timestamp_t window_ts;     // start of current window
+	int64_t last_transit;      // of last in order packet, for jitter
+	int64_t last_pts;
+	float jitter_ms;
+	float delay_ms;         // target
+	int64_t sync_delay_ms;  // lip sync
+
+	// next expected packet, valid once packet was played
+	bool playing;
+	int64_t next_pts;
+	int64_t last_duration;
+	bool last_silence;
+	int64_t concealed_ms;  // in a row
+
+	struct SJitterStats stats;
+};
+
+enum SJitterResult {
+	SJBUF_EMPTY,   // nothing to play until next packet comes
+	SJBUF_WAIT,    // next packet or its loss is due at due_ts
+	SJBUF_PACKET,  // packet is due
+	SJBUF_LOST,    // packet expected now missed its playout time, conceal it
+};
+
+// conceal is true for audio. Video packets are never reported lost and late ones are played at
+// once, as dropping them would break references of next frames
+void sjbuf_init(struct SJitterBuffer *jb, bool conceal);
+
+// inserts packet which arrived at given time. Returns false if packet is rejected: it was
+// concealed already or buffer is full. Caller keeps data of rejected packet
+bool sjbuf_push(struct SJitterBuffer *jb,
+                const struct SJitterPacket *packet,
+                timestamp_t arrival_ts);
+
+// takes packet due at given time or reports what to wait for
+enum SJitterResult sjbuf_pop(struct SJitterBuffer *jb,
+                             timestamp_t now,
+                             struct SJitterPacket *packet,
+                             timestamp_t *due_ts);
+
+// amount of packets whose playout time came
+size_t sjbuf_due(const struct SJitterBuffer *jb, timestamp_t now);
+
+// ms first packet waits past its playout time, grows when decoder can not keep up
+int64_t sjbuf_lag(const struct SJitterBuffer *jb, timestamp_t now);
+
+// takes first packet regardless of its playout time. Returns false if buffer is empty
+bool sjbuf_take(struct SJitterBuffer *jb, struct SJitterPacket *packet);
+
+// forgets expected packet, so gap before next one is not concealed. Delay estimates are kept
+void sjbuf_restart(struct SJitterBuffer *jb);
+
+void sjbuf_stats(const struct SJitterBuffer *jb, struct SJitterStats *stats);
+
+// aligns audio and video buffers of same sender: one which plays packets captured at same time
+// earlier is delayed up to SELECON_LIPSYNC_MAX_DELAY. Returns false until both got packets
+bool sjbuf_lipsync(struct SJitterBuffer *audio,
+                   struct SJitterBuffer *video,
+                   struct SLipSyncStats *stats);
+
+// same without changing delays
+bool sjbuf_lipsync_stats(const struct SJitterBuffer *audio,
+                         const struct SJitterBuffer *video,
+                         struct SLipSyncStats *stats);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -0,0 +1,253 @@
+#include "media_crypto.h"
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <string.h>
+
+#include "config.h"
+#include "stime.h"
+
+#define NONCE_SIZE 12
+
+_Static_assert(sizeof(part_id_t) + sizeof(uint32_t) == NONCE_SIZE, "nonce is sender and counter");
+
+static void make_nonce(uint8_t *nonce, part_id_t sender, uint32_t counter) {
+	memcpy(nonce, &sender, sizeof(sender));
+	memcpy(nonce + sizeof(sender), &counter, sizeof(counter));
+}
+
+static enum SError random_key(struct SMediaKey *key, uint32_t id) {
+	key->id = id;
+	return RAND_bytes(key->key, SMCRYPT_KEY_SIZE) == 1 ? SELECON_OK : SELECON_CRYPTO_ERROR;
+}
+
+static void forget_keys_locked(struct SMediaCrypto *crypto) {
+	OPENSSL_cleanse(crypto->keys, sizeof(crypto->keys));
+	crypto->known[0] = crypto->known[1] = false;
+	crypto->pending                     = false;
+	crypto->counter                     = 0;
+	crypto->nb_windows                  = 0;
+}
+
+// mutex must be locked. Pending key takes over once its time comes
+static void switch_key_locked(struct SMediaCrypto *crypto, timestamp_t now) {
+	if (!crypto->pending || now < crypto->switch_ts)
+		return;
+	crypto->send_id = crypto->keys[(crypto->send_id + 1) & 1].id;
+	crypto->counter = 0;
+	crypto->pending = false;
+}
+
+static uint32_t newest_id_locked(struct SMediaCrypto *crypto) {
+	return crypto->pending ? crypto->keys[(crypto->send_id + 1) & 1].id : crypto->send_id;
+}
+
+// mutex must be locked
+static struct SReplayWindow *find_window_locked(struct SMediaCrypto *crypto,
+                                                part_id_t sender,
+                                                uint32_t key_id) {
+	for (size_t i = 0; i < crypto->nb_windows; ++i)
+		if (crypto->windows[i].sender == sender && crypto->windows[i].key_id == key_id)
+			return &crypto->windows[i];
+	return NULL;
+}
+
+// mutex must be locked. Window of key which is not known anymore is reused first
+static struct SReplayWindow *add_window_locked(struct SMediaCrypto *crypto,
+                                               part_id_t sender,
+                                               uint32_t key_id,
+                                               uint32_t counter) {
+	struct SReplayWindow *window = NULL;
+	if (crypto->nb_windows < SMCRYPT_REPLAY_SENDERS)
+		window = &crypto->windows[crypto->nb_windows++];
+	else
+		for (size_t i = 0; i < crypto->nb_windows; ++i) {
+			struct SReplayWindow *other = &crypto->windows[i];
+			size_t slot                 = other->key_id & 1;
+			if (!crypto->known[slot] || crypto->keys[slot].id != other->key_id) {
+				window = other;
+				break;
+			}
+			if (window == NULL || other->use < window->use)
+				window = other;
+		}
+	window->sender  = sender;
+	window->key_id  = key_id;
+	window->highest = counter;
+	window->seen    = 0;
+	return window;
+}
+
+static bool replay_fresh(const struct SReplayWindow *window, uint32_t counter) {
+	if (window == NULL || counter > window->highest)
+		return true;
+	uint32_t age = window->highest - counter;
+	return age < SMCRYPT_REPLAY_WINDOW && !(window->seen & (1ULL << age));
+}
+
+static void replay_mark(struct SReplayWindow *window, uint32_t counter) {
+	if (counter > window->highest) {
+		uint32_t shift  = counter - window->highest;
+		window->seen    = shift >= SMCRYPT_REPLAY_WINDOW ? 0 : window->seen << shift;
+		window->highest = counter;
+	}
+	window->seen |= 1ULL << (window->highest - counter);
+}
+
+enum SError smcrypt_init(struct SMediaCrypto *crypto) {
+	memset(crypto, 0, sizeof(*crypto));
+	if (pthread_mutex_init(&crypto->mutex, NULL) != 0)
+		return SELECON_PTHREAD_ERROR;
+	crypto->seal_ctx = EVP_CIPHER_CTX_new();
+	crypto->open_ctx = EVP_CIPHER_CTX_new();
+	enum SError err  = SELECON_MEMORY_ERROR;
+	if (crypto->seal_ctx != NULL && crypto->open_ctx != NULL)
+		err = smcrypt_reset(crypto);
+	if (err != SELECON_OK)
+		smcrypt_free(crypto);
+	return err;
+}
+
+void smcrypt_free(struct SMediaCrypto *crypto) {
+	forget_keys_locked(crypto);
+	EVP_CIPHER_CTX_free(crypto->seal_ctx);
+	EVP_CIPHER_CTX_free(crypto->open_ctx);
+	crypto->seal_ctx = crypto->open_ctx = NULL;
+	pthread_mutex_destroy(&crypto->mutex);
+}
+
+enum SError smcrypt_reset(struct SMediaCrypto *crypto) {
+	struct SMediaKey key;
+	enum SError err = random_key(&key, 0);
+	if (err != SELECON_OK)
+		return err;
+	pthread_mutex_lock(&crypto->mutex);
+	forget_keys_locked(crypto);
+	crypto->keys[0]  = key;
+	crypto->known[0] = true;
+	crypto->send_id  = 0;
+	pthread_mutex_unlock(&crypto->mutex);
+	OPENSSL_cleanse(&key, sizeof(key));
+	return SELECON_OK;
+}
+
+enum SError smcrypt_generate(struct SMediaCrypto *crypto, struct SMediaKey *key) {
+	pthread_mutex_lock(&crypto->mutex);
+	uint32_t id = newest_id_locked(crypto) + 1;
+	pthread_mutex_unlock(&crypto->mutex);
+	return random_key(key, id);
+}
+
+bool smcrypt_install(struct SMediaCrypto *crypto, const struct SMediaKey *key, timestamp_t now) {
+	pthread_mutex_lock(&crypto->mutex);
+	bool newer = key->id == newest_id_locked(crypto) + 1;
+	if (newer) {
+		// pending key takes over at once, there are only two slots
+		crypto->switch_ts = now;
+		switch_key_locked(crypto, now);
+		size_t slot         = key->id & 1;
+		crypto->keys[slot]  = *key;
+		crypto->known[slot] = true;
+		crypto->switch_ts   = now + SELECON_MEDIA_KEY_SWITCH_DELAY * 1000000ULL;
+		crypto->pending     = slot != (crypto->send_id & 1);
+		if (!crypto->pending) {  // rotation was missed and send key is replaced, use new one now
+			crypto->send_id = key->id;
+			crypto->counter = 0;
+		}
+	}
+	pthread_mutex_unlock(&crypto->mutex);
+	return newer;
+}
+
+void smcrypt_export(struct SMediaCrypto *crypto, struct SMediaKey keys[2]) {
+	pthread_mutex_lock(&crypto->mutex);
+	size_t slot = crypto->send_id & 1;
+	keys[0]     = crypto->keys[slot];
+	keys[1]     = crypto->known[slot ^ 1] ? crypto->keys[slot ^ 1] : keys[0];
+	pthread_mutex_unlock(&crypto->mutex);
+}
+
+void smcrypt_import(struct SMediaCrypto *crypto, const struct SMediaKey keys[2]) {
+	pthread_mutex_lock(&crypto->mutex);
+	forget_keys_locked(crypto);
+	for (size_t i = 2; i-- > 0;) {
+		crypto->keys[keys[i].id & 1]  = keys[i];
+		crypto->known[keys[i].id & 1] = true;
+	}
+	crypto->send_id   = keys[0].id;
+	crypto->pending   = keys[1].id > keys[0].id && (keys[1].id & 1) != (keys[0].id & 1);
+	crypto->switch_ts = get_curr_timestamp() + SELECON_MEDIA_KEY_SWITCH_DELAY * 1000000ULL;
+	pthread_mutex_unlock(&crypto->mutex);
+}
+
+enum SError smcrypt_seal(struct SMediaCrypto *crypto,
+                         part_id_t sender,
+                         timestamp_t now,
+                         struct SMediaSeal *seal,
+                         const void *aad,
+                         size_t aad_size,
+                         uint8_t *data,
+                         size_t size,
+                         uint8_t *tag) {
+	pthread_mutex_lock(&crypto->mutex);
+	switch_key_locked(crypto, now);
+	if (crypto->counter == UINT32_MAX) {  // nonce would repeat, wait for next key
+		pthread_mutex_unlock(&crypto->mutex);
+		return SELECON_CRYPTO_ERROR;
+	}
+	seal->key_id  = crypto->send_id;
+	seal->counter = crypto->counter++;
+	uint8_t nonce[NONCE_SIZE];
+	make_nonce(nonce, sender, seal->counter);
+	EVP_CIPHER_CTX *ctx = crypto->seal_ctx;
+	const uint8_t *key  = crypto->keys[crypto->send_id & 1].key;
+	int len             = 0;
+	// additional data is authenticated only
+	bool ok =
+	    EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, key, nonce) == 1 &&
+	    EVP_EncryptUpdate(ctx, NULL, &len, aad, (int)aad_size) == 1 &&
+	    EVP_EncryptUpdate(ctx, data, &len, data, (int)size) == 1 &&
+	    EVP_EncryptFinal_ex(ctx, data + len, &len) == 1 &&
+	    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, SMCRYPT_TAG_SIZE, tag) == 1;
+	pthread_mutex_unlock(&crypto->mutex);
+	return ok ? SELECON_OK : SELECON_CRYPTO_ERROR;
+}
+
+enum SError smcrypt_open(struct SMediaCrypto *crypto,
+                         part_id_t sender,
+                         const struct SMediaSeal *seal,
+                         const void *aad,
+                         size_t aad_size,
+                         uint8_t *data,
+                         size_t size,
+                         const uint8_t *tag) {
+	uint8_t nonce[NONCE_SIZE];
+	make_nonce(nonce, sender, seal->counter);
+	pthread_mutex_lock(&crypto->mutex);
+	size_t slot = seal->key_id & 1;
+	struct SReplayWindow *window = find_window_locked(crypto, sender, seal->key_id);
+	if (!crypto->known[slot] || crypto->keys[slot].id != seal->key_id ||
+	    !replay_fresh(window, seal->counter)) {
+		pthread_mutex_unlock(&crypto->mutex);
+		return SELECON_CRYPTO_ERROR;
+	}
+	EVP_CIPHER_CTX *ctx = crypto->open_ctx;
+	int len             = 0;
+	// tag covers additional data as well
+	bool ok =
+	    EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, crypto->keys[slot].key, nonce) == 1 &&
+	    EVP_DecryptUpdate(ctx, NULL, &len, aad, (int)aad_size) == 1 &&
+	    EVP_DecryptUpdate(ctx, data, &len, data, (int)size) == 1 &&
+	    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, SMCRYPT_TAG_SIZE, (void *)tag) == 1 &&
+	    EVP_DecryptFinal_ex(ctx, data + len, &len) == 1;
+	// only frames which authenticate move window, forged ones can not push genuine out of it
+	if (ok) {
+		if (window == NULL)
+			window = add_window_locked(crypto, sender, seal->key_id, seal->counter);
+		replay_mark(window, seal->counter);
+		window->use = ++crypto->nb_opened;
+	}
+	pthread_mutex_unlock(&crypto->mutex);
+	return ok ? SELECON_OK : SELECON_CRYPTO_ERROR;
+}
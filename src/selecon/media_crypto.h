@@ -0,0 +1,116 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "error.h"
+#include "stypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// AES-256-GCM: hardware accelerated on every CPU we run on, and same cipher TLS picks there
+#define SMCRYPT_KEY_SIZE 32
+#define SMCRYPT_TAG_SIZE 16
+// senders whose opened frames are remembered, frames out of order by more than window are rejected
+#define SMCRYPT_REPLAY_SENDERS 64
+#define SMCRYPT_REPLAY_WINDOW 64  // bits of SReplayWindow.seen
+
+#pragma pack(push, 1)
+
+// conference media key. Organiser generates new one whenever somebody joins or leaves and sends
+// it over TLS control connections only
+struct SMediaKey {
+	uint32_t id;  // grows with every rotation
+	uint8_t key[SMCRYPT_KEY_SIZE];
+};
+
+// sealing header of media payload. Nonce is sender id followed by counter, so senders never
+// share one
+struct SMediaSeal {
+	uint32_t key_id;
+	uint32_t counter;  // frames sender sealed with this key before
+};
+
+#pragma pack(pop)
+
+// frames of sender opened with one key. Sealed media travels outside TLS, so copies of frames
+// injected again must not open twice
+struct SReplayWindow {
+	part_id_t sender;
+	uint32_t key_id;
+	uint32_t highest;  // counter of newest opened frame
+	uint64_t seen;     // bit i is set when frame with counter highest - i was opened
+	uint64_t use;      // least recently used window is replaced when table is full
+};
+
+// media is sealed once by sender and opened by receivers only, relays pass it as is. Two keys
+// are known at once: one media is sealed with and previous or next one. New key is used for
+// sealing SELECON_MEDIA_KEY_SWITCH_DELAY after it arrives, so everybody has it by then, and
+// previous one still opens media which was on its way during switch
+struct SMediaCrypto {
+	struct SMediaKey keys[2];  // indexed by key id parity
+	bool known[2];
+	uint32_t send_id;  // key media is sealed with
+	bool pending;      // newer key is sealing from switch_ts
+	timestamp_t switch_ts;
+	uint32_t counter;  // frames sealed with send key
+	struct SReplayWindow windows[SMCRYPT_REPLAY_SENDERS];
+	size_t nb_windows;
+	uint64_t nb_opened;
+	void *seal_ctx;  // EVP_CIPHER_CTX
+	void *open_ctx;
+	pthread_mutex_t mutex;
+};
+
+// starts with random key
+enum SError smcrypt_init(struct SMediaCrypto *crypto);
+void smcrypt_free(struct SMediaCrypto *crypto);
+
+// forgets all keys and starts new conference with random key
+enum SError smcrypt_reset(struct SMediaCrypto *crypto);
+
+// random key which is newer than every known one
+enum SError smcrypt_generate(struct SMediaCrypto *crypto, struct SMediaKey *key);
+
+// installs key taken from organiser. Returns false unless it is next one after newest known key,
+// so key with far id can not block later rotations
+bool smcrypt_install(struct SMediaCrypto *crypto, const struct SMediaKey *key, timestamp_t now);
+
+// known keys, key media is sealed with goes first. Second one is copy of first if there is no
+// other. Sent in invite, so newcomer opens media sealed with both
+void smcrypt_export(struct SMediaCrypto *crypto, struct SMediaKey keys[2]);
+
+// replaces all keys with exported ones of conference being joined
+void smcrypt_import(struct SMediaCrypto *crypto, const struct SMediaKey keys[2]);
+
+// encrypts data in place and fills seal header and tag. Additional data must include seal header
+// and is authenticated only, so relays read it without key
+enum SError smcrypt_seal(struct SMediaCrypto *crypto,
+                         part_id_t sender,
+                         timestamp_t now,
+                         struct SMediaSeal *seal,
+                         const void *aad,
+                         size_t aad_size,
+                         uint8_t *data,
+                         size_t size,
+                         uint8_t *tag);
+
+// decrypts data in place. Fails if key of seal is unknown, data, additional data or tag were
+// altered, or frame with same sender, key and counter was opened already (or is older than replay
+// window)
+enum SError smcrypt_open(struct SMediaCrypto *crypto,
+                         part_id_t sender,
+                         const struct SMediaSeal *seal,
+                         const void *aad,
+                         size_t aad_size,
+                         uint8_t *data,
+                         size_t size,
+                         const uint8_t *tag);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -11,26 +11,34 @@
 #include <libavutil/opt.h>
 #include <libavutil/pixdesc.h>
 #include <libavutil/samplefmt.h>
+#include <libswresample/swresample.h>
 
 #include "avutility.h"
 #include "config.h"
 #include "error.h"
+#include "sample_convert.h"
 
-static void prepare_frame(struct MediaFilterGraph *mf_graph, struct AVFrame *frame) {
+static void prepare_audio_frame(struct MediaFilterGraph *mf_graph, struct AVFrame *frame) {
 	av_frame_unref(frame);
-	if (mf_graph->type == AVMEDIA_TYPE_AUDIO) {
-		frame->format      = mf_graph->sample_fmt;
-		frame->sample_rate = mf_graph->sample_rate;
-		av_channel_layout_default(&frame->ch_layout, mf_graph->nb_channels);
-		frame->nb_samples = mf_graph->frame_size;
-	} else {
-		frame->format = mf_graph->pixel_fmt;
-		frame->width  = mf_graph->width;
-		frame->height = mf_graph->height;
-	}
+	frame->format      = mf_graph->sample_fmt;
+	frame->sample_rate = mf_graph->sample_rate;
+	av_channel_layout_default(&frame->ch_layout, mf_graph->nb_channels);
+	frame->nb_samples = mf_graph->frame_size;
 	av_frame_get_buffer(frame, 0);
 }
 
+// fifo survives graph rebuilds, its format does not depend on source
+static enum SError alloc_audio_fifo(struct MediaFilterGraph *mf_graph) {
+	if (mf_graph->audio_fifo == NULL)
+		mf_graph->audio_fifo = av_audio_fifo_alloc(
+		    mf_graph->sample_fmt, mf_graph->nb_channels, 2 * mf_graph->frame_size);
+	if (mf_graph->audio_fifo == NULL) {
+		fprintf(stderr, "failed to allocate audio fifo\n");
+		return SELECON_MEMORY_ERROR;
+	}
+	return SELECON_OK;
+}
+
 static enum SError build_filter_graph_audio(struct MediaFilterGraph *mf_graph,
                                             struct AVFrame *frame) {
 	const struct AVFilter *buffer_src  = avfilter_get_by_name("abuffer");
@@ -124,13 +132,6 @@ static enum SError build_filter_graph_audio(struct MediaFilterGraph *mf_graph,
 		return SELECON_AVERROR;
 	}
 
-	mf_graph->audio_fifo =
-	    av_audio_fifo_alloc(mf_graph->sample_fmt, mf_graph->nb_channels, 2 * mf_graph->frame_size);
-	if (mf_graph->audio_fifo == NULL) {
-		fprintf(stderr, "failed to allocate audio fifo\n");
-		avfilter_graph_free(&mf_graph->filter_graph);
-		return SELECON_MEMORY_ERROR;
-	}
 	return SELECON_OK;
 }
 
@@ -224,63 +225,243 @@ enum SError build_filter_graph_video(struct MediaFilterGraph *mf_graph, struct A
 	return SELECON_OK;
 }
 
+static void init_common(struct MediaFilterGraph *mf_graph) {
+	mf_graph->allow_bypass   = true;
+	mf_graph->path           = MFPATH_NONE;
+	mf_graph->pending_frame  = NULL;
+	mf_graph->swr            = NULL;
+	mf_graph->audio_buf      = NULL;
+	mf_graph->audio_buf_size = 0;
+	mf_graph->filter_graph   = NULL;
+	mf_graph->filter_src     = NULL;
+	mf_graph->filter_sink    = NULL;
+	mf_graph->audio_fifo     = NULL;
+}
+
 void mfgraph_init_audio(struct MediaFilterGraph *mf_graph,
                         enum AVSampleFormat sample_fmt,
                         int sample_rate,
                         int nb_channels,
                         int frame_size) {
-	mf_graph->type         = AVMEDIA_TYPE_AUDIO;
-	mf_graph->sample_fmt   = sample_fmt;
-	mf_graph->sample_rate  = sample_rate;
-	mf_graph->nb_channels  = nb_channels;
-	mf_graph->frame_size   = frame_size;
-	mf_graph->filter_graph = NULL;
-	mf_graph->filter_src   = NULL;
-	mf_graph->filter_sink  = NULL;
-	mf_graph->audio_fifo   = NULL;
+	mf_graph->type        = AVMEDIA_TYPE_AUDIO;
+	mf_graph->sample_fmt  = sample_fmt;
+	mf_graph->sample_rate = sample_rate;
+	mf_graph->nb_channels = nb_channels;
+	mf_graph->frame_size  = frame_size;
+	init_common(mf_graph);
 }
 
 void mfgraph_init_video(struct MediaFilterGraph *mf_graph,
                         enum AVPixelFormat pixel_fmt,
                         int width,
                         int height) {
-	mf_graph->type         = AVMEDIA_TYPE_VIDEO;
-	mf_graph->pixel_fmt    = pixel_fmt;
-	mf_graph->width        = width;
-	mf_graph->height       = height;
-	mf_graph->filter_graph = NULL;
-	mf_graph->filter_src   = NULL;
-	mf_graph->filter_sink  = NULL;
-	mf_graph->audio_fifo   = NULL;
+	mf_graph->type      = AVMEDIA_TYPE_VIDEO;
+	mf_graph->pixel_fmt = pixel_fmt;
+	mf_graph->width     = width;
+	mf_graph->height    = height;
+	init_common(mf_graph);
 }
 
-void mfgraph_free(struct MediaFilterGraph *mf_graph) {
+static void free_audio_buf(struct MediaFilterGraph *mf_graph) {
+	if (mf_graph->audio_buf != NULL)
+		av_freep(&mf_graph->audio_buf[0]);
+	av_freep(&mf_graph->audio_buf);
+	mf_graph->audio_buf_size = 0;
+}
+
+// drops everything built for current source format
+static void reset_path(struct MediaFilterGraph *mf_graph) {
 	avfilter_graph_free(&mf_graph->filter_graph);
 	mf_graph->filter_src  = NULL;
 	mf_graph->filter_sink = NULL;
+	swr_free(&mf_graph->swr);
+	mf_graph->path = MFPATH_NONE;
+}
+
+void mfgraph_free(struct MediaFilterGraph *mf_graph) {
+	reset_path(mf_graph);
+	av_frame_free(&mf_graph->pending_frame);
+	free_audio_buf(mf_graph);
 	if (mf_graph->audio_fifo != NULL) {
 		av_audio_fifo_free(mf_graph->audio_fifo);
 		mf_graph->audio_fifo = NULL;
 	}
 }
 
+static bool source_changed(struct MediaFilterGraph *mf_graph, struct AVFrame *frame) {
+	if (mf_graph->type == AVMEDIA_TYPE_AUDIO)
+		return frame->format != mf_graph->src_format ||
+		       frame->sample_rate != mf_graph->src_sample_rate ||
+		       frame->ch_layout.nb_channels != mf_graph->src_nb_channels;
+	else
+		return frame->format != mf_graph->src_format || frame->width != mf_graph->src_width ||
+		       frame->height != mf_graph->src_height;
+}
+
+static bool source_matches_target(struct MediaFilterGraph *mf_graph, struct AVFrame *frame) {
+	if (mf_graph->type == AVMEDIA_TYPE_AUDIO)
+		return frame->format == mf_graph->sample_fmt &&
+		       frame->sample_rate == mf_graph->sample_rate &&
+		       frame->ch_layout.nb_channels == mf_graph->nb_channels;
+	else
+		return frame->format == mf_graph->pixel_fmt && frame->width == mf_graph->width &&
+		       frame->height == mf_graph->height;
+}
+
+// device audio (interleaved S16) to codec format (FLTP) and back
+static bool audio_convertible(struct MediaFilterGraph *mf_graph, struct AVFrame *frame) {
+	if (frame->sample_rate != mf_graph->sample_rate ||
+	    frame->ch_layout.nb_channels != mf_graph->nb_channels)
+		return false;
+	return (frame->format == AV_SAMPLE_FMT_S16 && mf_graph->sample_fmt == AV_SAMPLE_FMT_FLTP) ||
+	       (frame->format == AV_SAMPLE_FMT_FLTP && mf_graph->sample_fmt == AV_SAMPLE_FMT_S16);
+}
+
+static enum SError init_resampler(struct MediaFilterGraph *mf_graph, struct AVFrame *frame) {
+	struct AVChannelLayout layout;
+	av_channel_layout_default(&layout, mf_graph->nb_channels);
+	int ret = swr_alloc_set_opts2(&mf_graph->swr,
+	                              &layout,
+	                              mf_graph->sample_fmt,
+	                              mf_graph->sample_rate,
+	                              &frame->ch_layout,
+	                              frame->format,
+	                              frame->sample_rate,
+	                              0,
+	                              NULL);
+	if (ret < 0 || (ret = swr_init(mf_graph->swr)) < 0) {
+		fprintf(stderr, "failed to initialize resampler: ret = %d\n", ret);
+		swr_free(&mf_graph->swr);
+		return SELECON_AVERROR;
+	}
+	return SELECON_OK;
+}
+
+// picks processing path for source frame format and builds what it needs
+static enum SError configure_path(struct MediaFilterGraph *mf_graph, struct AVFrame *frame) {
+	mf_graph->src_format      = frame->format;
+	mf_graph->src_width       = frame->width;
+	mf_graph->src_height      = frame->height;
+	mf_graph->src_sample_rate = frame->sample_rate;
+	mf_graph->src_nb_channels = frame->ch_layout.nb_channels;
+	if (mf_graph->type == AVMEDIA_TYPE_VIDEO) {
+		if (mf_graph->allow_bypass && source_matches_target(mf_graph, frame)) {
+			mf_graph->path = MFPATH_PASSTHROUGH;
+			return SELECON_OK;
+		}
+		mf_graph->path = MFPATH_GRAPH;
+		return build_filter_graph_video(mf_graph, frame);
+	}
+	enum SError err = alloc_audio_fifo(mf_graph);
+	if (err != SELECON_OK)
+		return err;
+	if (mf_graph->allow_bypass) {
+		if (source_matches_target(mf_graph, frame))
+			mf_graph->path = MFPATH_PASSTHROUGH;
+		else if (audio_convertible(mf_graph, frame))
+			mf_graph->path = MFPATH_CONVERT;
+		else if (init_resampler(mf_graph, frame) == SELECON_OK)
+			mf_graph->path = MFPATH_RESAMPLE;
+		if (mf_graph->path != MFPATH_NONE)
+			return SELECON_OK;
+	}
+	mf_graph->path = MFPATH_GRAPH;
+	return build_filter_graph_audio(mf_graph, frame);
+}
+
+static enum SError reserve_audio_buf(struct MediaFilterGraph *mf_graph, int nb_samples) {
+	if (nb_samples <= mf_graph->audio_buf_size)
+		return SELECON_OK;
+	free_audio_buf(mf_graph);
+	if (av_samples_alloc_array_and_samples(&mf_graph->audio_buf,
+	                                       NULL,
+	                                       mf_graph->nb_channels,
+	                                       nb_samples,
+	                                       mf_graph->sample_fmt,
+	                                       0) < 0)
+		return SELECON_MEMORY_ERROR;
+	mf_graph->audio_buf_size = nb_samples;
+	return SELECON_OK;
+}
+
+// converts samples into audio_buf and moves them to fifo
+static enum SError send_audio_direct(struct MediaFilterGraph *mf_graph, struct AVFrame *frame) {
+	int nb_samples = frame->nb_samples;
+	if (mf_graph->path == MFPATH_RESAMPLE)
+		nb_samples = swr_get_out_samples(mf_graph->swr, frame->nb_samples);
+	enum SError err = reserve_audio_buf(mf_graph, nb_samples);
+	if (err == SELECON_OK) {
+		if (mf_graph->path == MFPATH_RESAMPLE)
+			nb_samples = swr_convert(mf_graph->swr,
+			                         mf_graph->audio_buf,
+			                         nb_samples,
+			                         (const uint8_t **)frame->extended_data,
+			                         frame->nb_samples);
+		else if (frame->format == AV_SAMPLE_FMT_S16)
+			sconv_s16_to_fltp((const int16_t *)frame->data[0],
+			                  (float *const *)mf_graph->audio_buf,
+			                  mf_graph->nb_channels,
+			                  nb_samples);
+		else
+			sconv_fltp_to_s16((const float *const *)frame->extended_data,
+			                  (int16_t *)mf_graph->audio_buf[0],
+			                  mf_graph->nb_channels,
+			                  nb_samples);
+		if (nb_samples < 0 ||
+		    av_audio_fifo_write(mf_graph->audio_fifo, (void **)mf_graph->audio_buf, nb_samples) < 0)
+			err = SELECON_AVERROR;
+	}
+	av_frame_unref(frame);
+	return err;
+}
+
+// frame goes straight to audio fifo or waits for mfgraph_receive as is
+static enum SError send_passthrough(struct MediaFilterGraph *mf_graph, struct AVFrame *frame) {
+	if (mf_graph->type == AVMEDIA_TYPE_AUDIO) {
+		int ret = av_audio_fifo_write(mf_graph->audio_fifo, (void **)frame->data, frame->nb_samples);
+		av_frame_unref(frame);
+		return ret < 0 ? SELECON_MEMORY_ERROR : SELECON_OK;
+	}
+	if (mf_graph->pending_frame == NULL && (mf_graph->pending_frame = av_frame_alloc()) == NULL) {
+		av_frame_unref(frame);
+		return SELECON_MEMORY_ERROR;
+	}
+	// previous frame was never received - only the newest one is worth encoding
+	av_frame_unref(mf_graph->pending_frame);
+	if (frame->buf[0] != NULL) {
+		av_frame_move_ref(mf_graph->pending_frame, frame);
+		return SELECON_OK;
+	}
+	int ret = av_frame_ref(mf_graph->pending_frame, frame);  // copies non-refcounted data
+	av_frame_unref(frame);
+	return ret < 0 ? SELECON_MEMORY_ERROR : SELECON_OK;
+}
+
 enum SError mfgraph_send(struct MediaFilterGraph *mf_graph, struct AVFrame *frame) {
+	if (mf_graph->path != MFPATH_NONE && source_changed(mf_graph, frame))
+		reset_path(mf_graph);
 	// lazy initialization
-	if (mf_graph->filter_graph == NULL) {
-		enum SError err = mf_graph->type == AVMEDIA_TYPE_AUDIO
-		                      ? build_filter_graph_audio(mf_graph, frame)
-		                      : build_filter_graph_video(mf_graph, frame);
+	if (mf_graph->path == MFPATH_NONE) {
+		enum SError err = configure_path(mf_graph, frame);
 		if (err != SELECON_OK) {
 			fprintf(stderr, "failed to create filter graph: err = %s\n", serror_str(err));
+			reset_path(mf_graph);
 			return err;
 		}
 	}
-	int ret = av_buffersrc_write_frame(mf_graph->filter_src, frame);
+	switch (mf_graph->path) {
+		case MFPATH_PASSTHROUGH: return send_passthrough(mf_graph, frame);
+		case MFPATH_CONVERT:
+		case MFPATH_RESAMPLE: return send_audio_direct(mf_graph, frame);
+		default: break;
+	}
+	// reference is moved into graph, refcounted frames are neither copied nor cloned
+	int ret = av_buffersrc_add_frame(mf_graph->filter_src, frame);
 	if (ret < 0) {
 		perror("av_buffersrc_add_frame");
+		av_frame_unref(frame);
 		return SELECON_AVERROR;
 	}
-	av_frame_unref(frame);
 	return SELECON_OK;
 }
 
@@ -288,6 +469,8 @@ static int mfgraph_receive_audio(struct MediaFilterGraph *mf_graph, struct AVFra
 	int ret;
 	// Ensure we have enough samples before reading from the buffer
 	while (av_audio_fifo_size(mf_graph->audio_fifo) < mf_graph->frame_size) {
+		if (mf_graph->path != MFPATH_GRAPH)
+			return AVERROR(EAGAIN);  // fifo is fed directly by mfgraph_send
 		// Attempt to get a frame from the filter sink
 		av_frame_unref(frame);
 		ret = av_buffersink_get_frame(mf_graph->filter_sink, frame);
@@ -306,7 +489,7 @@ static int mfgraph_receive_audio(struct MediaFilterGraph *mf_graph, struct AVFra
 	}
 
 	// Read samples from the FIFO into the provided frame (to fill it adequately)
-	prepare_frame(mf_graph, frame);
+	prepare_audio_frame(mf_graph, frame);
 	ret = av_audio_fifo_read(mf_graph->audio_fifo, (void **)frame->data, mf_graph->frame_size);
 	if (ret < 0) {
 		perror("Error reading from audio FIFO");
@@ -315,8 +498,15 @@ static int mfgraph_receive_audio(struct MediaFilterGraph *mf_graph, struct AVFra
 	return 0;
 }
 
+// sink hands out references to buffers from pools of graph links, nothing is allocated here
 static int mfgraph_receive_video(struct MediaFilterGraph *mf_graph, struct AVFrame *frame) {
-	prepare_frame(mf_graph, frame);
+	av_frame_unref(frame);
+	if (mf_graph->path == MFPATH_PASSTHROUGH) {
+		if (mf_graph->pending_frame == NULL || mf_graph->pending_frame->buf[0] == NULL)
+			return AVERROR(EAGAIN);
+		av_frame_move_ref(frame, mf_graph->pending_frame);
+		return 0;
+	}
 	int ret = av_buffersink_get_frame(mf_graph->filter_sink, frame);
 	if (ret < 0 && ret != AVERROR(EAGAIN))
 		perror("Error getting frame from buffer sink");
@@ -6,9 +6,21 @@
 #include <libavutil/audio_fifo.h>
 #include <libavutil/avutil.h>
 #include <libavutil/frame.h>
+#include <libswresample/swresample.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 #include "error.h"
 
+// how frames are processed. Chosen on first frame and after every source format change
+enum MediaFilterPath {
+	MFPATH_NONE,         // not configured yet
+	MFPATH_GRAPH,        // libavfilter graph
+	MFPATH_PASSTHROUGH,  // source is already in target format
+	MFPATH_CONVERT,      // audio S16 <-> FLTP with same rate and channels, SIMD kernels
+	MFPATH_RESAMPLE,     // audio through libswresample without filter graph
+};
+
 struct MediaFilterGraph {
 	enum AVMediaType type;
 	union {
@@ -24,6 +36,23 @@ struct MediaFilterGraph {
 			int height;
 		};
 	};
+	// source frame parameters graph was built for. Graph is rebuilt when they change
+	int src_format;
+	int src_width;
+	int src_height;
+	int src_sample_rate;
+	int src_nb_channels;
+
+	// frames skip filter graph when direct path exists. Enabled by init, clear to force graph
+	bool allow_bypass;
+	enum MediaFilterPath path;
+	struct AVFrame *pending_frame;  // video frame sent in passthrough mode, not received yet
+
+	// audio direct paths write converted samples here before they go to fifo
+	struct SwrContext *swr;
+	uint8_t **audio_buf;
+	int audio_buf_size;  // in samples
+
 	struct AVFilterGraph *filter_graph;
 	struct AVFilterContext *filter_src;
 	struct AVFilterContext *filter_sink;
@@ -43,8 +72,10 @@ void mfgraph_init_video(struct MediaFilterGraph *mf_graph,
 
 void mfgraph_free(struct MediaFilterGraph *mf_graph);
 
-// frame ownership remains with caller
+// frame data reference is moved into graph and frame is reset, AVFrame itself remains with
+// caller. Frames may change format, resolution or sample rate between calls
 enum SError mfgraph_send(struct MediaFilterGraph *mf_graph, struct AVFrame *frame);
 
-// frame must be allocated by caller and will be filled with reference-counted buffers
+// frame must be allocated by caller and will be filled with reference-counted buffers. Video
+// frames reference pooled buffers of graph, so caller should unref them as soon as possible
 int mfgraph_receive(struct MediaFilterGraph *mf_graph, struct AVFrame *frame);
@@ -1,13 +1,18 @@
 #include "media_profile.h"
 
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixdesc.h>
+#include <string.h>
+
 #include "avutility.h"
 
 static bool media_profiles_registered = false;
 
-// priority-ordered list of audio codec parameters
+// priority-ordered list of audio codec parameters. Opus goes first: 20 ms frames give much lower
+// latency than AAC 1024-sample frames
 static struct SAudioProfile audio_profiles[] = {
-    {AV_CODEC_ID_AAC, AV_SAMPLE_FMT_FLTP, 48000, 2, 1024},
     {AV_CODEC_ID_OPUS, AV_SAMPLE_FMT_S16, 48000, 2, 960},
+    {AV_CODEC_ID_AAC, AV_SAMPLE_FMT_FLTP, 48000, 2, 1024},
     {AV_CODEC_ID_PCM_S16LE, AV_SAMPLE_FMT_S16, 16000, 1, 160},
     {AV_CODEC_ID_NONE},
 };
@@ -25,17 +30,133 @@ void register_media_profiles(void) {
 			if (!check_audio_codec(
 			        p->codec_id, p->sample_fmt, p->sample_rate, p->nb_channels, p->frame_size)) {
 				const int n = sizeof(audio_profiles) / sizeof(audio_profiles[0]);
-				memcpy(p, p + 1, (char*)(audio_profiles + n) - (char*)(p + 1));
+				memmove(p, p + 1, (char*)(audio_profiles + n) - (char*)(p + 1));
 				--p;
 			}
 		}
 		for (struct SVideoProfile* p = video_profiles; p->codec_id != AV_CODEC_ID_NONE; ++p) {
 			if (!check_video_codec(p->codec_id, p->pixel_fmt, p->width, p->height, p->framerate)) {
 				const int n = sizeof(video_profiles) / sizeof(video_profiles[0]);
-				memcpy(p, p + 1, (char*)(video_profiles + n) - (char*)(p + 1));
+				memmove(p, p + 1, (char*)(video_profiles + n) - (char*)(p + 1));
 				--p;
 			}
 		}
 		media_profiles_registered = true;
 	}
 }
+
+void media_caps_default(struct SMediaCaps* caps) {
+	memset(caps, 0, sizeof(struct SMediaCaps));
+	for (struct SAudioProfile* p = audio_profiles;
+	     p->codec_id != AV_CODEC_ID_NONE && caps->nb_audio < SELECON_MAX_MEDIA_PROFILES;
+	     ++p)
+		caps->audio[caps->nb_audio++] = *p;
+	for (struct SVideoProfile* p = video_profiles;
+	     p->codec_id != AV_CODEC_ID_NONE && caps->nb_video < SELECON_MAX_MEDIA_PROFILES;
+	     ++p)
+		caps->video[caps->nb_video++] = *p;
+}
+
+bool media_caps_prioritize(struct SMediaCaps* caps,
+                           enum AVMediaType media_type,
+                           const enum AVCodecID* codec_ids,
+                           size_t count) {
+	struct SMediaCaps all;
+	struct SMediaCaps res = *caps;
+	media_caps_default(&all);
+	if (media_type == AVMEDIA_TYPE_AUDIO) {
+		res.nb_audio = 0;
+		for (size_t i = 0; i < count; ++i)
+			for (size_t j = 0; j < all.nb_audio; ++j)
+				if (all.audio[j].codec_id == codec_ids[i] &&
+				    res.nb_audio < SELECON_MAX_MEDIA_PROFILES)
+					res.audio[res.nb_audio++] = all.audio[j];
+		if (res.nb_audio == 0)
+			return false;
+	} else if (media_type == AVMEDIA_TYPE_VIDEO) {
+		res.nb_video = 0;
+		for (size_t i = 0; i < count; ++i)
+			for (size_t j = 0; j < all.nb_video; ++j)
+				if (all.video[j].codec_id == codec_ids[i] &&
+				    res.nb_video < SELECON_MAX_MEDIA_PROFILES)
+					res.video[res.nb_video++] = all.video[j];
+		if (res.nb_video == 0)
+			return false;
+	} else
+		return false;
+	*caps = res;
+	return true;
+}
+
+void media_caps_from_profile(struct SMediaCaps* caps, const struct SMediaProfile* profile) {
+	memset(caps, 0, sizeof(struct SMediaCaps));
+	caps->nb_audio = 1;
+	caps->audio[0] = profile->audio;
+	caps->nb_video = 1;
+	caps->video[0] = profile->video;
+}
+
+bool media_caps_first(const struct SMediaCaps* caps, struct SMediaProfile* profile) {
+	if (caps->nb_audio == 0 || caps->nb_video == 0)
+		return false;
+	profile->audio = caps->audio[0];
+	profile->video = caps->video[0];
+	return true;
+}
+
+bool audio_profile_equal(const struct SAudioProfile* a, const struct SAudioProfile* b) {
+	return a->codec_id == b->codec_id && a->sample_fmt == b->sample_fmt &&
+	       a->sample_rate == b->sample_rate && a->nb_channels == b->nb_channels &&
+	       a->frame_size == b->frame_size;
+}
+
+bool video_profile_equal(const struct SVideoProfile* a, const struct SVideoProfile* b) {
+	return a->codec_id == b->codec_id && a->pixel_fmt == b->pixel_fmt && a->width == b->width &&
+	       a->height == b->height && a->framerate == b->framerate;
+}
+
+bool video_profile_compatible(const struct SVideoProfile* a, const struct SVideoProfile* b) {
+	return a->codec_id == b->codec_id && a->pixel_fmt == b->pixel_fmt;
+}
+
+bool video_params_valid(const struct SVideoParams* params) {
+	return params->width > 0 && params->height > 0 && params->width % 2 == 0 &&
+	       params->height % 2 == 0 && params->framerate > 0 &&
+	       params->width <= SELECON_MAX_VIDEO_WIDTH && params->height <= SELECON_MAX_VIDEO_HEIGHT &&
+	       params->framerate <= SELECON_MAX_VIDEO_FPS;
+}
+
+bool media_profile_negotiate(const struct SMediaCaps* offer,
+                             const struct SMediaCaps* local,
+                             struct SMediaProfile* profile) {
+	bool audio_found = false;
+	for (size_t i = 0; i < offer->nb_audio && i < SELECON_MAX_MEDIA_PROFILES && !audio_found; ++i)
+		for (size_t j = 0; j < local->nb_audio && !audio_found; ++j)
+			if (audio_profile_equal(&offer->audio[i], &local->audio[j])) {
+				profile->audio = offer->audio[i];
+				audio_found    = true;
+			}
+	bool video_found = false;
+	for (size_t i = 0; i < offer->nb_video && i < SELECON_MAX_MEDIA_PROFILES && !video_found; ++i)
+		for (size_t j = 0; j < local->nb_video && !video_found; ++j)
+			if (video_profile_compatible(&offer->video[i], &local->video[j])) {
+				profile->video = offer->video[i];
+				video_found    = true;
+			}
+	return audio_found && video_found;
+}
+
+void media_profile_dump(FILE* fp, const struct SMediaProfile* profile) {
+	fprintf(fp,
+	        "audio: %s %s %dHz %dch %d samples, video: %s %s %dx%d@%d",
+	        avcodec_get_name(profile->audio.codec_id),
+	        av_get_sample_fmt_name(profile->audio.sample_fmt),
+	        profile->audio.sample_rate,
+	        profile->audio.nb_channels,
+	        profile->audio.frame_size,
+	        avcodec_get_name(profile->video.codec_id),
+	        av_get_pix_fmt_name(profile->video.pixel_fmt),
+	        profile->video.width,
+	        profile->video.height,
+	        profile->video.framerate);
+}
@@ -1,7 +1,23 @@
 #pragma once
 
 #include <libavcodec/codec_id.h>
+#include <libavutil/avutil.h>
+#include <libavutil/pixfmt.h>
 #include <libavutil/samplefmt.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#pragma pack(push, 1)
+
+// profiles are sent over the wire as is during invite handshake
 
 struct SAudioProfile {
 	enum AVCodecID codec_id;
@@ -19,4 +35,72 @@ struct SVideoProfile {
 	int framerate;
 };
 
+// codec parameters used by all participants of conference. Video resolution and frame rate are
+// chosen by each sender on its own and can change mid-stream, so they are not negotiated
+struct SMediaProfile {
+	struct SAudioProfile audio;
+	struct SVideoProfile video;
+};
+
+// priority-ordered profiles supported by participant
+struct SMediaCaps {
+	uint8_t nb_audio;
+	uint8_t nb_video;
+	struct SAudioProfile audio[SELECON_MAX_MEDIA_PROFILES];
+	struct SVideoProfile video[SELECON_MAX_MEDIA_PROFILES];
+};
+
+#pragma pack(pop)
+
+// per-stream video parameters
+struct SVideoParams {
+	int width;
+	int height;
+	int framerate;
+};
+
+// grid of participant videos composed into single frame
+struct SCompositorLayout {
+	struct SVideoParams canvas;
+	int columns;  // 0 picks near square grid for current number of participants
+};
+
+// checks which of known profiles are usable with linked libav. Must be called before any
+// other function declared here
 void register_media_profiles(void);
+
+// fills caps with all registered profiles
+void media_caps_default(struct SMediaCaps *caps);
+
+// reorders caps by codec priority. Profiles with codecs not listed in codec_ids are dropped.
+// Returns false (leaving caps untouched) if no profile left for given media type
+bool media_caps_prioritize(struct SMediaCaps *caps,
+                           enum AVMediaType media_type,
+                           const enum AVCodecID *codec_ids,
+                           size_t count);
+
+// caps containing single profile (offered when conference profile can not be changed anymore)
+void media_caps_from_profile(struct SMediaCaps *caps, const struct SMediaProfile *profile);
+
+// most preferred profile from caps
+bool media_caps_first(const struct SMediaCaps *caps, struct SMediaProfile *profile);
+
+// selects common profile. Offer order wins, so inviter priorities are respected
+bool media_profile_negotiate(const struct SMediaCaps *offer,
+                             const struct SMediaCaps *local,
+                             struct SMediaProfile *profile);
+
+bool audio_profile_equal(const struct SAudioProfile *a, const struct SAudioProfile *b);
+bool video_profile_equal(const struct SVideoProfile *a, const struct SVideoProfile *b);
+
+// same codec and pixel format, resolution and frame rate may differ
+bool video_profile_compatible(const struct SVideoProfile *a, const struct SVideoProfile *b);
+
+// checks that parameters are usable for encoding (positive, even dimensions for chroma planes)
+bool video_params_valid(const struct SVideoParams *params);
+
+void media_profile_dump(FILE *fp, const struct SMediaProfile *profile);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
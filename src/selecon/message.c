@@ -1,19 +1,23 @@
 #include "message.h"
 
+#include <math.h>
 #include <stdlib.h>
 
 #include "avutility.h"
 
 struct SMessage* message_alloc(size_t size) {
 	struct SMessage* msg = calloc(1, size);
-	msg->size            = size;
+	if (msg != NULL)
+		msg->size = size;
 	return msg;
 }
 
 struct SMessage* message_alloc2(size_t size, enum SMsgType type) {
 	struct SMessage* msg = calloc(1, size);
-	msg->size            = size;
-	msg->type            = type;
+	if (msg == NULL)
+		return NULL;
+	msg->size = size;
+	msg->type = type;
 	return msg;
 }
 
@@ -26,28 +30,41 @@ void message_free(struct SMessage** msg) {
 
 struct SMessage* message_invite_alloc(conf_id_t conf_id,
                                       timestamp_t conf_start_ts,
+                                      bool webinar,
+                                      const struct SMediaKey media_keys[2],
                                       part_id_t part_id,
                                       enum SRole role,
                                       const struct SEndpoint* listen_ep,
+                                      const struct SMediaCaps* caps,
                                       const char* part_name) {
 	size_t size            = sizeof(struct SMsgInvite) + strlen(part_name) + 1;
 	struct SMsgInvite* msg = (struct SMsgInvite*)message_alloc2(size, SMSG_INVITE);
 	msg->conf_id           = conf_id;
 	msg->conf_start_ts     = conf_start_ts;
+	msg->webinar           = webinar;
+	msg->media_keys[0]     = media_keys[0];
+	msg->media_keys[1]     = media_keys[1];
 	msg->part_id           = part_id;
 	msg->part_role         = role;
 	msg->listen_ep         = *listen_ep;
+	msg->caps              = *caps;
 	strcpy(msg->part_name, part_name);
 	return (struct SMessage*)msg;
 }
 
-struct SMessage* message_invite_accept_alloc(part_id_t id, const char* name, struct SEndpoint* ep) {
+struct SMessage* message_invite_accept_alloc(part_id_t id,
+                                             enum SRole role,
+                                             const char* name,
+                                             struct SEndpoint* ep,
+                                             const struct SMediaProfile* profile) {
 	size_t size = sizeof(struct SMsgInviteAccept) + strlen(name) + 1;
 	struct SMsgInviteAccept* msg =
 	    (struct SMsgInviteAccept*)message_alloc2(size, SMSG_INVITE_ACCEPT);
-	msg->part_id = id;
+	msg->part_id   = id;
+	msg->part_role = role;
 	memcpy(&msg->ep, ep, sizeof(struct SEndpoint));
-	msg->ep = *ep;
+	msg->ep      = *ep;
+	msg->profile = *profile;
 	strcpy(msg->part_name, name);
 	return (struct SMessage*)msg;
 }
@@ -61,6 +78,19 @@ struct SMsgPartPresence* message_part_presence_alloc(void) {
 	return (struct SMsgPartPresence*)message_alloc2(size, SMSG_PART_PRESENCE);
 }
 
+struct SMessage* message_part_info_alloc(part_id_t part_id,
+                                         enum SRole role,
+                                         const struct SPartCapacity* capacity,
+                                         const char* name) {
+	size_t size              = sizeof(struct SMsgPartInfo) + strlen(name) + 1;
+	struct SMsgPartInfo* msg = (struct SMsgPartInfo*)message_alloc2(size, SMSG_PART_INFO);
+	msg->part_id             = part_id;
+	msg->part_role           = role;
+	msg->capacity            = *capacity;
+	strcpy(msg->part_name, name);
+	return (struct SMessage*)msg;
+}
+
 struct SMsgReenter* message_reenter_alloc(conf_id_t conf_id, part_id_t part_id) {
 	size_t size             = sizeof(struct SMsgReenter);
 	struct SMsgReenter* msg = (struct SMsgReenter*)message_alloc2(size, SMSG_REENTER);
@@ -81,18 +111,149 @@ struct SMessage* message_text_alloc(part_id_t source, const char* text) {
 	return (struct SMessage*)msg;
 }
 
-struct SMessage* message_audio_alloc(part_id_t source, struct AVPacket* packet) {
-	size_t size           = sizeof(struct SMsgAudio) + av_packet_serialize(NULL, packet);
+// serialized packet is followed by tag of its seal
+static size_t media_message_size(size_t header, struct AVPacket* packet) {
+	return header + av_packet_serialize(NULL, packet) + SMCRYPT_TAG_SIZE;
+}
+
+struct SMessage* message_audio_alloc(part_id_t source, float level, struct AVPacket* packet) {
+	size_t size           = media_message_size(sizeof(struct SMsgAudio), packet);
 	struct SMsgAudio* msg = (struct SMsgAudio*)message_alloc2(size, SMSG_AUDIO);
 	msg->part_id          = source;
+	msg->level            = level >= 0.0f ? 0 : level <= -127.0f ? 127 : (uint8_t)lrintf(-level);
 	av_packet_serialize(msg->data, packet);
 	return (struct SMessage*)msg;
 }
 
-struct SMessage* message_video_alloc(part_id_t source, struct AVPacket* packet) {
-	size_t size           = sizeof(struct SMsgVideo) + av_packet_serialize(NULL, packet);
+struct SMessage* message_video_subscription_alloc(part_id_t subscriber,
+                                                  enum SVideoSubscription state,
+                                                  int layer) {
+	struct SMsgVideoSubscription* msg = (struct SMsgVideoSubscription*)message_alloc2(
+	    sizeof(struct SMsgVideoSubscription), SMSG_VIDEO_SUBSCRIPTION);
+	msg->part_id = subscriber;
+	msg->state   = state;
+	msg->layer   = layer;
+	return (struct SMessage*)msg;
+}
+
+struct SMessage* message_ping_alloc(timestamp_t send_ts) {
+	struct SMsgPing* msg = (struct SMsgPing*)message_alloc2(sizeof(struct SMsgPing), SMSG_PING);
+	msg->send_ts         = send_ts;
+	return (struct SMessage*)msg;
+}
+
+struct SMessage* message_pong_alloc(timestamp_t ping_ts, timestamp_t recv_ts, timestamp_t send_ts) {
+	struct SMsgPong* msg = (struct SMsgPong*)message_alloc2(sizeof(struct SMsgPong), SMSG_PONG);
+	msg->ping_ts         = ping_ts;
+	msg->recv_ts         = recv_ts;
+	msg->send_ts         = send_ts;
+	return (struct SMessage*)msg;
+}
+
+struct SMessage* message_topology_alloc(enum STopology topology,
+                                        const struct STopologyNode* nodes,
+                                        size_t count) {
+	size_t size              = sizeof(struct SMsgTopology) + count * sizeof(struct STopologyEntry);
+	struct SMsgTopology* msg = (struct SMsgTopology*)message_alloc2(size, SMSG_TOPOLOGY);
+	msg->topology            = topology;
+	msg->nb_entries          = count;
+	for (size_t i = 0; i < count; ++i) {
+		msg->entries[i].part_id  = nodes[i].part_id;
+		msg->entries[i].relay_id = nodes[i].relay_id;
+		msg->entries[i].relay    = nodes[i].relay;
+	}
+	return (struct SMessage*)msg;
+}
+
+struct SMessage* message_media_key_alloc(const struct SMediaKey* key) {
+	struct SMsgMediaKey* msg =
+	    (struct SMsgMediaKey*)message_alloc2(sizeof(struct SMsgMediaKey), SMSG_MEDIA_KEY);
+	msg->key = *key;
+	return (struct SMessage*)msg;
+}
+
+struct SMessage* message_keyframe_request_alloc(part_id_t author) {
+	struct SMsgKeyframeRequest* msg = (struct SMsgKeyframeRequest*)message_alloc2(
+	    sizeof(struct SMsgKeyframeRequest), SMSG_KEYFRAME_REQUEST);
+	msg->part_id = author;
+	return (struct SMessage*)msg;
+}
+
+struct SMessage* message_receiver_report_alloc(part_id_t author,
+                                               bool video,
+                                               const struct SReceiverReport* report) {
+	struct SMsgReceiverReport* msg = (struct SMsgReceiverReport*)message_alloc2(
+	    sizeof(struct SMsgReceiverReport), SMSG_RECEIVER_REPORT);
+	msg->part_id = author;
+	msg->video   = video;
+	msg->report  = *report;
+	return (struct SMessage*)msg;
+}
+
+bool message_size_valid(const struct SMessage* msg) {
+	size_t size = sizeof(struct SMessage);
+	switch (msg->type) {
+		case SMSG_INVITE: size = sizeof(struct SMsgInvite); break;
+		case SMSG_INVITE_ACCEPT: size = sizeof(struct SMsgInviteAccept); break;
+		case SMSG_PART_PRESENCE: size = sizeof(struct SMsgPartPresence); break;
+		case SMSG_PART_INFO: size = sizeof(struct SMsgPartInfo); break;
+		case SMSG_REENTER: size = sizeof(struct SMsgReenter); break;
+		case SMSG_LEAVE: size = sizeof(struct SMsgLeave); break;
+		case SMSG_TEXT: size = sizeof(struct SMsgText); break;
+		case SMSG_AUDIO: size = sizeof(struct SMsgAudio) + SMCRYPT_TAG_SIZE; break;
+		case SMSG_VIDEO: size = sizeof(struct SMsgVideo) + SMCRYPT_TAG_SIZE; break;
+		case SMSG_AUDIO_SILENCE: size = sizeof(struct SMsgAudioSilence); break;
+		case SMSG_VIDEO_SUBSCRIPTION: size = sizeof(struct SMsgVideoSubscription); break;
+		case SMSG_PING: size = sizeof(struct SMsgPing); break;
+		case SMSG_PONG: size = sizeof(struct SMsgPong); break;
+		case SMSG_TOPOLOGY: size = sizeof(struct SMsgTopology); break;
+		case SMSG_MEDIA_KEY: size = sizeof(struct SMsgMediaKey); break;
+		case SMSG_KEYFRAME_REQUEST: size = sizeof(struct SMsgKeyframeRequest); break;
+		case SMSG_RECEIVER_REPORT: size = sizeof(struct SMsgReceiverReport); break;
+		default: break;
+	}
+	return msg->size >= size;
+}
+
+struct SMediaSeal* message_media_seal(struct SMessage* msg, uint8_t** data, size_t* size) {
+	struct SMediaSeal* seal = NULL;
+	if (msg->type == SMSG_AUDIO) {
+		seal  = &((struct SMsgAudio*)msg)->seal;
+		*data = ((struct SMsgAudio*)msg)->data;
+	} else if (msg->type == SMSG_VIDEO) {
+		seal  = &((struct SMsgVideo*)msg)->seal;
+		*data = ((struct SMsgVideo*)msg)->data;
+	} else
+		return NULL;
+	size_t header = *data - (uint8_t*)msg;
+	if (msg->size < header + SMCRYPT_TAG_SIZE)
+		return NULL;
+	*size = msg->size - header - SMCRYPT_TAG_SIZE;
+	return seal;
+}
+
+float message_audio_level(const struct SMsgAudio* msg) {
+	return msg->level > 127 ? -127.0f : -(float)msg->level;
+}
+
+struct SMessage* message_video_alloc(part_id_t source,
+                                     int layer,
+                                     int temporal_id,
+                                     struct AVPacket* packet) {
+	size_t size           = media_message_size(sizeof(struct SMsgVideo), packet);
 	struct SMsgVideo* msg = (struct SMsgVideo*)message_alloc2(size, SMSG_VIDEO);
 	msg->part_id          = source;
+	msg->layer            = layer;
+	msg->temporal_id      = temporal_id;
 	av_packet_serialize(msg->data, packet);
 	return (struct SMessage*)msg;
 }
+
+struct SMessage* message_audio_silence_alloc(part_id_t source, int64_t pts, int32_t nb_samples) {
+	struct SMsgAudioSilence* msg = (struct SMsgAudioSilence*)message_alloc2(
+	    sizeof(struct SMsgAudioSilence), SMSG_AUDIO_SILENCE);
+	msg->part_id    = source;
+	msg->pts        = pts;
+	msg->nb_samples = nb_samples;
+	return (struct SMessage*)msg;
+}
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #include "endpoint.h"
+#include "media_crypto.h"
+#include "media_profile.h"
 #include "participant.h"
+#include "rate_control.h"
 #include "stypes.h"
+#include "topology.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,7 +34,8 @@ enum SMsgType {
 	// the conference
 	SMSG_PART_PRESENCE = 3,
 
-	// participant information updated, not including connection state
+	// participant information updated, not including connection state. Sent to everybody when
+	// participant changes role and periodically with its measured capacity
 	SMSG_PART_INFO = 4,
 
 	// participant disconnected accidently and need to reconnect. Upon successfull reconnection
@@ -44,13 +50,43 @@ enum SMsgType {
 	// textual data (aka conference chat)
 	SMSG_TEXT = 8,
 
-	// audio packet received. Contains recording timestamp and id of participants besides actual
-	// audio data
+	// audio packet received. Contains recording timestamp, id of participant and audio level
+	// besides actual audio data. Level lets receivers rank speakers without decoding. Data is
+	// sealed with conference media key and message goes outside of TLS
 	SMSG_AUDIO = 9,
 
 	// video packet received. Contains recording timestamp and id of participants with regions in
-	// merged frames
+	// merged frames. Sealed as audio
 	SMSG_VIDEO = 10,
+
+	// sender stopped sending audio because of silence (DTX). Receiver plays given amount of
+	// silence without decoding. Repeated while silence lasts
+	SMSG_AUDIO_SILENCE = 11,
+
+	// receiver tells sender which video it wants: all of it, reduced layer or nothing. Sender
+	// stops sending video to paused receivers
+	SMSG_VIDEO_SUBSCRIPTION = 12,
+
+	// round trip time probe. Receiver answers with SMSG_PONG at once. Timestamps follow NTP: ping
+	// send time of requester, receive and send times of responder on its own clock
+	SMSG_PING = 13,
+	SMSG_PONG = 14,
+
+	// organiser tells everybody chosen topology: which participants are relays and which relay
+	// every other participant sends its media through
+	SMSG_TOPOLOGY = 15,
+
+	// organiser tells everybody new conference media key. Goes over TLS only, as invite which
+	// carries keys known at that time
+	SMSG_MEDIA_KEY = 16,
+
+	// receiver of video asks its author for keyframe, as decoder has nothing to start from.
+	// Participants which passed video on pass request on to author
+	SMSG_KEYFRAME_REQUEST = 17,
+
+	// receiver tells author how its audio or video came through during last report interval.
+	// Sent to directly connected authors only, author adapts encoder to worst receiver
+	SMSG_RECEIVER_REPORT = 18,
 };
 
 // general message interface for passing between participants.
@@ -68,15 +104,20 @@ struct SMsgInvite {
 	part_id_t part_id;
 	enum SRole part_role;
 	timestamp_t conf_start_ts;
+	uint8_t webinar;  // only presenters send media, listeners get it through distribution tree
+	struct SMediaKey media_keys[2];  // as exported by inviter
 	struct SEndpoint listen_ep;
+	struct SMediaCaps caps;  // profiles inviter can use, most preferred first
 	char part_name[];
 };
 
 struct SMsgInviteAccept {
 	struct SMessage base;
-	part_id_t part_id;    // invited participant id
-	struct SEndpoint ep;  // listening endpoint
-	char part_name[];     // invited participant name (NULL-terminated)
+	part_id_t part_id;             // invited participant id
+	enum SRole part_role;          // role invited participant takes in conference
+	struct SEndpoint ep;           // listening endpoint
+	struct SMediaProfile profile;  // profile selected from invite caps
+	char part_name[];              // invited participant name (NULL-terminated)
 };
 
 // struct SMsgReject;
@@ -89,6 +130,8 @@ struct SMsgPartPresence {
 	enum PresenceState {
 		PART_JOIN,
 		PART_LEAVE,
+		PART_FEED,    // webinar: meet listener and forward it all media received
+		PART_PARENT,  // webinar: sender feeds listener from now on
 	} state;
 };
 
@@ -96,6 +139,7 @@ struct SMsgPartInfo {
 	struct SMessage base;
 	part_id_t part_id;
 	enum SRole part_role;
+	struct SPartCapacity capacity;
 	char part_name[];
 };
 
@@ -124,13 +168,75 @@ struct SMsgAudio {
 	struct SMessage base;
 	part_id_t part_id;  // some participants can play 'retransmitor' role and transfer
 	                    // others' packets
-	uint8_t data[];     // size of payload must be calculated dynamically from base.size field
+	uint8_t level;      // sender audio level in -dBov: 0 is full scale, 127 is silence (RFC 6464)
+	struct SMediaSeal seal;
+	uint8_t data[];  // size of payload must be calculated dynamically from base.size field. Tag
+	                 // of SMCRYPT_TAG_SIZE follows it
 };
 
 struct SMsgVideo {
 	struct SMessage base;
 	part_id_t part_id;
-	uint8_t data[];
+	uint8_t layer;        // simulcast layer, 0 is highest resolution
+	uint8_t temporal_id;  // temporal layer, 0 is base one referenced by others
+	struct SMediaSeal seal;
+	uint8_t data[];  // followed by tag as in audio
+};
+
+struct SMsgAudioSilence {
+	struct SMessage base;
+	part_id_t part_id;
+	int64_t pts;         // of first suppressed frame, same clock as audio packets
+	int32_t nb_samples;  // suppressed since previous marker
+};
+
+struct SMsgVideoSubscription {
+	struct SMessage base;
+	part_id_t part_id;  // subscriber
+	enum SVideoSubscription state;
+	uint8_t layer;  // simulcast layer wanted with full subscription
+};
+
+struct SMsgPing {
+	struct SMessage base;
+	timestamp_t send_ts;
+};
+
+struct SMsgPong {
+	struct SMessage base;
+	timestamp_t ping_ts;  // send_ts of ping
+	timestamp_t recv_ts;
+	timestamp_t send_ts;
+};
+
+struct STopologyEntry {
+	part_id_t part_id;
+	part_id_t relay_id;  // 0 for relays and in mesh
+	uint8_t relay;
+};
+
+struct SMsgTopology {
+	struct SMessage base;
+	uint8_t topology;  // enum STopology
+	uint32_t nb_entries;
+	struct STopologyEntry entries[];
+};
+
+struct SMsgMediaKey {
+	struct SMessage base;
+	struct SMediaKey key;
+};
+
+struct SMsgKeyframeRequest {
+	struct SMessage base;
+	part_id_t part_id;  // author of video
+};
+
+struct SMsgReceiverReport {
+	struct SMessage base;
+	part_id_t part_id;  // author of media
+	uint8_t video;      // report on video, audio otherwise
+	struct SReceiverReport report;
 };
 
 #pragma pack(pop)
@@ -141,15 +247,27 @@ void message_free(struct SMessage** msg);
 
 struct SMessage* message_invite_alloc(conf_id_t conf_id,
                                       timestamp_t conf_start_ts,
+                                      bool webinar,
+                                      const struct SMediaKey media_keys[2],
                                       part_id_t part_id,
                                       enum SRole role,
                                       const struct SEndpoint* listen_ep,
+                                      const struct SMediaCaps* caps,
                                       const char* part_name);
-struct SMessage* message_invite_accept_alloc(part_id_t id, const char* name, struct SEndpoint* ep);
+struct SMessage* message_invite_accept_alloc(part_id_t id,
+                                             enum SRole role,
+                                             const char* name,
+                                             struct SEndpoint* ep,
+                                             const struct SMediaProfile* profile);
 struct SMessage* message_invite_reject_alloc(void);
 
 struct SMsgPartPresence* message_part_presence_alloc(void);
 
+struct SMessage* message_part_info_alloc(part_id_t part_id,
+                                         enum SRole role,
+                                         const struct SPartCapacity* capacity,
+                                         const char* name);
+
 struct SMsgReenter* message_reenter_alloc(conf_id_t conf_id, part_id_t part_id);
 
 struct SMessage* message_reenter_confirm_alloc(void);
@@ -157,9 +275,44 @@ struct SMessage* message_reenter_confirm_alloc(void);
 // allocate text message
 struct SMessage* message_text_alloc(part_id_t source, const char* text);
 
-// allocate audio/video packet message and fill it with data from packet
-struct SMessage* message_audio_alloc(part_id_t source, struct AVPacket* packet);
-struct SMessage* message_video_alloc(part_id_t source, struct AVPacket* packet);
+// allocate audio/video packet message and fill it with data from packet. level is in dBov
+struct SMessage* message_audio_alloc(part_id_t source, float level, struct AVPacket* packet);
+struct SMessage* message_video_alloc(part_id_t source,
+                                     int layer,
+                                     int temporal_id,
+                                     struct AVPacket* packet);
+
+struct SMessage* message_audio_silence_alloc(part_id_t source, int64_t pts, int32_t nb_samples);
+
+struct SMessage* message_video_subscription_alloc(part_id_t subscriber,
+                                                  enum SVideoSubscription state,
+                                                  int layer);
+
+struct SMessage* message_ping_alloc(timestamp_t send_ts);
+struct SMessage* message_pong_alloc(timestamp_t ping_ts, timestamp_t recv_ts, timestamp_t send_ts);
+
+struct SMessage* message_topology_alloc(enum STopology topology,
+                                        const struct STopologyNode* nodes,
+                                        size_t count);
+
+struct SMessage* message_media_key_alloc(const struct SMediaKey* key);
+
+struct SMessage* message_keyframe_request_alloc(part_id_t author);
+
+struct SMessage* message_receiver_report_alloc(part_id_t author,
+                                               bool video,
+                                               const struct SReceiverReport* report);
+
+// true if message is not shorter than fixed part of its type. Connections reuse receive buffers,
+// so fields past end of short message would hold bytes of previous one
+bool message_size_valid(const struct SMessage* msg);
+
+// sealing header of audio or video message, NULL for other messages. Sets payload between it and
+// tag. Everything before payload is authenticated as additional data
+struct SMediaSeal* message_media_seal(struct SMessage* msg, uint8_t** data, size_t* size);
+
+// dBov level from audio message header
+float message_audio_level(const struct SMsgAudio* msg);
 
 #ifdef __cplusplus
 }  // extern "C"
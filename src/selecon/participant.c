@@ -13,6 +13,15 @@ static unsigned long long generate_id() {
 	return rand() % ULONG_MAX;
 }
 
+const char* svideo_sub_str(enum SVideoSubscription sub) {
+	switch (sub) {
+		case SVIDEO_SUB_FULL: return "full";
+		case SVIDEO_SUB_REDUCED: return "reduced";
+		case SVIDEO_SUB_PAUSED: return "paused";
+		default: return "unknown";
+	}
+}
+
 struct SParticipant spart_init(const char* name, enum SRole role) {
 	struct SParticipant par;
 	par.id               = generate_id();
@@ -20,6 +29,15 @@ struct SParticipant spart_init(const char* name, enum SRole role) {
 	par.role             = role;
 	par.connection       = NULL;
 	par.hangup_timestamp = 0;
+	par.video_out        = SVIDEO_SUB_FULL;
+	par.video_in         = SVIDEO_SUB_FULL;
+	par.video_out_layer  = 0;
+	par.video_in_layer   = 0;
+	par.video_epoch      = 0;
+	par.rtt_ms           = -1.0f;
+	par.capacity         = (struct SPartCapacity){0};
+	par.relay_id         = 0;
+	par.parent_id        = 0;
 	return par;
 }
 
@@ -35,6 +53,7 @@ void spart_hangup(struct SParticipant* par) {
 	if (par->connection) {
 		sconn_disconnect(&par->connection);
 		par->hangup_timestamp = get_curr_timestamp();
+		par->video_epoch++;  // decoder of reentered participant starts from keyframe
 	}
 }
 
@@ -67,5 +86,16 @@ void spart_dump(FILE* fd, struct SParticipant* par) {
 	if (par == NULL)
 		fprintf(fd, "(null)");
 	else
-		fprintf(fd, "%10llu %s [%s]", par->id, par->name, srole_str(par->role));
+		fprintf(fd,
+		        "%10llu %s [%s] video in:%s/%d out:%s/%d rtt:%.1fms relay:%llu parent:%llu",
+		        par->id,
+		        par->name,
+		        srole_str(par->role),
+		        svideo_sub_str(par->video_in),
+		        par->video_in_layer,
+		        svideo_sub_str(par->video_out),
+		        par->video_out_layer,
+		        par->rtt_ms,
+		        par->relay_id,
+		        par->parent_id);
 }
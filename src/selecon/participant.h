@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include "endpoint.h"
@@ -15,6 +16,23 @@ struct SConnection;
 
 typedef unsigned long long part_id_t;
 
+// video one participant wants to receive from other one
+enum SVideoSubscription {
+	SVIDEO_SUB_FULL    = 0,  // everything sender has (default)
+	SVIDEO_SUB_REDUCED = 1,  // lowest simulcast layer is enough (thumbnail)
+	SVIDEO_SUB_PAUSED  = 2,  // no video
+};
+
+const char* svideo_sub_str(enum SVideoSubscription sub);
+
+// what participant measured about itself. Announced in SMSG_PART_INFO, so organiser can choose
+// conference topology. All zeros until first announcement
+struct SPartCapacity {
+	uint32_t uplink_kbps;  // 0 if unknown
+	uint32_t rtt_ms;       // worst smoothed round trip time to peers
+	uint8_t cpu_headroom;  // percent of CPU time left idle
+};
+
 struct SParticipant {
 	// id used for uniquely identify participants in single conference.
 	// Id alsa determines order in broadcasting messages.
@@ -30,6 +48,28 @@ struct SParticipant {
 
 	// reconnection state. When connection is NULL and this is not self - hangup timestamp is valid
 	timestamp_t hangup_timestamp;
+
+	// video this participant asked us to send (video is not sent to paused peers) and video we
+	// asked it to send us
+	enum SVideoSubscription video_out;
+	enum SVideoSubscription video_in;
+
+	// simulcast layer for full subscription in same directions (0 is highest resolution). Output
+	// streams switch layer actually sent to participant on keyframes only (see sstream_sent_layer)
+	int video_out_layer;
+	int video_in_layer;
+	// changes when video decoder of participant starts over (it reentered or paused video), so
+	// output streams wait for keyframe before sending it video again
+	unsigned video_epoch;
+
+	// smoothed round trip time measured with ping messages, negative until first pong
+	float rtt_ms;
+	struct SPartCapacity capacity;
+	// relay this participant sends its media through as planned by organiser, 0 if none
+	part_id_t relay_id;
+	// webinar listener gets media from this participant (as far as we placed it or feed it), 0 if
+	// unknown. Parent of self is announced by parent itself with PART_PARENT presence
+	part_id_t parent_id;
 };
 
 struct SParticipant spart_init(const char* name, enum SRole role);
@@ -0,0 +1,172 @@
+#include "rate_control.h"
+
+#include <string.h>
+
+#define MS 1000000LL
+
+void srate_meter_init(struct SRateMeter *meter, timestamp_t now) {
+	memset(meter, 0, sizeof(*meter));
+	meter->since            = now;
+	meter->min_transit      = INT64_MAX;
+	meter->prev_min_transit = INT64_MAX;
+	meter->window_ts        = now;
+}
+
+void srate_meter_packet(struct SRateMeter *meter,
+                        size_t size,
+                        int64_t transit,
+                        timestamp_t arrival_ts) {
+	if (meter->n == 0.0)
+		meter->first_transit = transit;
+	double x = (int64_t)(arrival_ts - meter->since) / 1e9;
+	double y = (transit - meter->first_transit) / 1e6;
+	meter->n += 1.0;
+	meter->sx += x;
+	meter->sy += y;
+	meter->sxx += x * x;
+	meter->sxy += x * y;
+	meter->bytes += size;
+	if (arrival_ts - meter->window_ts >= SELECON_RATE_BASE_WINDOW * MS) {
+		meter->prev_min_transit = meter->min_transit;
+		meter->min_transit      = transit;
+		meter->window_ts        = arrival_ts;
+	} else if (transit < meter->min_transit)
+		meter->min_transit = transit;
+}
+
+static uint16_t clamp_u16(double value) {
+	return value < 0.0 ? 0 : value > UINT16_MAX ? UINT16_MAX : (uint16_t)value;
+}
+
+// counters restart with reused stream
+static uint64_t delta(uint64_t value, uint64_t prev) {
+	return value >= prev ? value - prev : value;
+}
+
+bool srate_meter_report(struct SRateMeter *meter,
+                        const struct SJitterStats *jitter,
+                        size_t queue_depth,
+                        int64_t decode_lag_ms,
+                        timestamp_t now,
+                        struct SReceiverReport *report) {
+	bool arrived = meter->n > 0.0;
+	if (arrived) {
+		const struct SJitterStats *prev = &meter->jitter;
+		uint64_t concealed = delta(jitter->nb_concealed, prev->nb_concealed);
+		uint64_t expected  = delta(jitter->nb_packets, prev->nb_packets) + concealed;
+		uint64_t missed    = delta(jitter->nb_late, prev->nb_late) +
+		                  delta(jitter->nb_dropped, prev->nb_dropped) + concealed;
+		report->loss          = expected > 0 ? clamp_u16(missed * 1000.0 / expected) : 0;
+		report->jitter_ms     = clamp_u16(jitter->jitter_ms + 0.5f);
+		report->queue_depth   = clamp_u16(queue_depth);
+		report->decode_lag_ms = clamp_u16(decode_lag_ms);
+		int64_t base = meter->min_transit < meter->prev_min_transit ? meter->min_transit
+		                                                            : meter->prev_min_transit;
+		double mean  = meter->first_transit + meter->sy / meter->n * 1e6;
+		report->queue_delay_ms = clamp_u16((mean - base) / 1e6);
+		// slope of transit is in ms per s
+		double denom    = meter->n * meter->sxx - meter->sx * meter->sx;
+		double gradient = 0.0;
+		if (denom > 0.0)
+			gradient = (meter->n * meter->sxy - meter->sx * meter->sy) / denom * 1000.0;
+		report->delay_gradient = gradient > INT32_MAX   ? INT32_MAX
+		                         : gradient < INT32_MIN ? INT32_MIN
+		                                                : (int32_t)gradient;
+		double elapsed         = (int64_t)(now - meter->since) / 1e9;
+		report->bandwidth_kbps = elapsed > 0.0 ? (uint32_t)(meter->bytes * 8 / elapsed / 1000) : 0;
+	}
+	meter->since = now;
+	meter->bytes = 0;
+	meter->n = meter->sx = meter->sy = meter->sxx = meter->sxy = 0.0;
+	meter->jitter = *jitter;
+	return arrived;
+}
+
+void srate_init(struct SRateControl *rc, int64_t max_bitrate, int max_framerate) {
+	memset(rc, 0, sizeof(*rc));
+	rc->max_bitrate   = max_bitrate;
+	rc->max_framerate = max_framerate;
+	rc->bitrate       = max_bitrate;
+	rc->framerate     = max_framerate;
+}
+
+// receiver which did not report longest is replaced when table is full
+static struct SRateReceiver *find_receiver(struct SRateControl *rc, part_id_t part_id) {
+	struct SRateReceiver *oldest = NULL;
+	for (size_t i = 0; i < rc->nb_receivers; ++i) {
+		if (rc->receivers[i].part_id == part_id)
+			return &rc->receivers[i];
+		if (oldest == NULL || rc->receivers[i].report_ts < oldest->report_ts)
+			oldest = &rc->receivers[i];
+	}
+	if (rc->nb_receivers < SELECON_RATE_MAX_RECEIVERS)
+		oldest = &rc->receivers[rc->nb_receivers++];
+	oldest->part_id = part_id;
+	return oldest;
+}
+
+// receivers which stopped reporting (left or paused video) do not hold bitrate
+static bool all_normal(const struct SRateControl *rc, timestamp_t now) {
+	for (size_t i = 0; i < rc->nb_receivers; ++i)
+		if (!rc->receivers[i].normal &&
+		    now - rc->receivers[i].report_ts < 2 * SELECON_REPORT_INTERVAL * MS)
+			return false;
+	return true;
+}
+
+// full frame rate down to half of configured bitrate, proportional below
+static int target_framerate(const struct SRateControl *rc) {
+	if (rc->max_framerate <= 0 || 2 * rc->bitrate >= rc->max_bitrate)
+		return rc->max_framerate;
+	int framerate = (int)(2 * rc->max_framerate * rc->bitrate / rc->max_bitrate);
+	if (framerate < SELECON_RATE_MIN_FPS)
+		framerate = SELECON_RATE_MIN_FPS;
+	return framerate < rc->max_framerate ? framerate : rc->max_framerate;
+}
+
+bool srate_report(struct SRateControl *rc,
+                  part_id_t receiver,
+                  const struct SReceiverReport *report,
+                  timestamp_t now) {
+	if (rc->max_bitrate <= 0)
+		return false;
+	const timestamp_t interval = SELECON_REPORT_INTERVAL * MS;
+	bool overuse = report->delay_gradient > SELECON_RATE_OVERUSE_GRADIENT ||
+	               report->queue_delay_ms > SELECON_RATE_MAX_QUEUE_DELAY ||
+	               report->loss > SELECON_RATE_LOSS_HIGH;
+	struct SRateReceiver *entry = find_receiver(rc, receiver);
+	entry->report_ts            = now;
+	entry->normal               = !overuse && report->loss <= SELECON_RATE_LOSS_LOW;
+	int64_t bitrate             = rc->bitrate;
+	if (overuse) {
+		// congestion is still reported for a while after back off, react once per interval
+		if (now - rc->decrease_ts >= interval) {
+			double received = report->bandwidth_kbps * 1000.0;
+			if (received <= 0.0 || received > rc->bitrate)
+				received = rc->bitrate;
+			// go below received bandwidth enough to drain queue within SELECON_RATE_DRAIN_TIME
+			double k = SELECON_RATE_BACKOFF -
+			           report->queue_delay_ms / (double)SELECON_RATE_DRAIN_TIME;
+			if (k < 0.5)
+				k = 0.5;
+			if (received * k < bitrate)
+				bitrate = (int64_t)(received * k);
+			rc->decrease_ts = now;
+		}
+	} else if (entry->normal && now - rc->increase_ts >= interval &&
+	           now - rc->decrease_ts >= interval && all_normal(rc, now)) {
+		bitrate         = (int64_t)(bitrate * SELECON_RATE_INCREASE);
+		rc->increase_ts = now;
+	}
+	int64_t min_bitrate = (int64_t)(rc->max_bitrate * SELECON_RATE_MIN_FRACTION);
+	if (bitrate < min_bitrate)
+		bitrate = min_bitrate;
+	if (bitrate > rc->max_bitrate)
+		bitrate = rc->max_bitrate;
+	bool changed  = bitrate != rc->bitrate;
+	rc->bitrate   = bitrate;
+	int framerate = target_framerate(rc);
+	changed       = changed || framerate != rc->framerate;
+	rc->framerate = framerate;
+	return changed;
+}
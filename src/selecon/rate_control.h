@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "jitter_buffer.h"
+#include "stypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#pragma pack(push, 1)
+
+// how media of one type from one sender came through during last report interval
+struct SReceiverReport {
+	uint16_t loss;            // per mille of packets concealed, dropped or late
+	uint16_t jitter_ms;       // interarrival jitter
+	uint16_t queue_depth;     // packets waiting for decoder
+	uint16_t decode_lag_ms;   // oldest due packet waits for decoder that long
+	uint16_t queue_delay_ms;  // mean transit over shortest one seen
+	int32_t delay_gradient;   // one way delay change, us per s
+	uint32_t bandwidth_kbps;  // received
+};
+
+#pragma pack(pop)
+
+// measures media of input stream over report interval. Transit is arrival time minus sender
+// time, clock offset does not matter for its changes. Not thread safe
+struct SRateMeter {
+	timestamp_t since;  // start of interval
+	uint64_t bytes;
+	// least squares of transit (ms, relative to first one) over arrival time (s)
+	double n, sx, sy, sxx, sxy;
+	int64_t first_transit;
+	// shortest transit over current and previous SELECON_RATE_BASE_WINDOW
+	int64_t min_transit;
+	int64_t prev_min_transit;
+	timestamp_t window_ts;
+	struct SJitterStats jitter;  // counters at interval start
+};
+
+void srate_meter_init(struct SRateMeter *meter, timestamp_t now);
+
+// packet of given size arrived at arrival_ts with given transit (ns)
+void srate_meter_packet(struct SRateMeter *meter,
+                        size_t size,
+                        int64_t transit,
+                        timestamp_t arrival_ts);
+
+// closes interval and starts next one. Returns false if nothing arrived during it
+bool srate_meter_report(struct SRateMeter *meter,
+                        const struct SJitterStats *jitter,
+                        size_t queue_depth,
+                        int64_t decode_lag_ms,
+                        timestamp_t now,
+                        struct SReceiverReport *report);
+
+// latest state of one receiver
+struct SRateReceiver {
+	part_id_t part_id;
+	timestamp_t report_ts;
+	bool normal;  // neither overuse nor loss above SELECON_RATE_LOSS_LOW
+};
+
+// sender side congestion control of one output stream. Encoding serves all receivers, so worst
+// one rules: any overusing receiver makes bitrate back off, bitrate grows only when everybody who
+// reported within two intervals is fine. Not thread safe
+struct SRateControl {
+	int64_t max_bitrate;  // configured, 0 disables control
+	int max_framerate;    // 0 for audio
+	int64_t bitrate;      // target
+	int framerate;
+	timestamp_t decrease_ts;
+	timestamp_t increase_ts;
+	struct SRateReceiver receivers[SELECON_RATE_MAX_RECEIVERS];
+	size_t nb_receivers;
+};
+
+// congestion control state of output stream as seen by application
+struct SRateStats {
+	int64_t max_bitrate;  // configured
+	int64_t bitrate;      // target
+	int max_framerate;
+	int framerate;
+	size_t nb_receivers;  // which reported at least once
+};
+
+// starts from configured bitrate and frame rate
+void srate_init(struct SRateControl *rc, int64_t max_bitrate, int max_framerate);
+
+// applies report of receiver. Returns true if target changed
+bool srate_report(struct SRateControl *rc,
+                  part_id_t receiver,
+                  const struct SReceiverReport *report,
+                  timestamp_t now);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
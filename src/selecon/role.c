@@ -4,6 +4,12 @@ const char* srole_str(enum SRole role) {
 	switch (role) {
 		case SROLE_ORGANISATOR: return "org";
 		case SROLE_LISTENER: return "listener";
+		case SROLE_RELAY: return "relay";
+		case SROLE_PRESENTER: return "presenter";
 		default: return "unknown";
 	}
 }
+
+bool srole_is_presenter(enum SRole role) {
+	return role == SROLE_ORGANISATOR || role == SROLE_PRESENTER;
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdbool.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -7,10 +9,18 @@ extern "C" {
 enum SRole {
 	SROLE_ORGANISATOR = 0,
 	SROLE_LISTENER    = 1,
+	// forwards media of others without decoding. Participants send media once to relay instead
+	// of every peer, so their uplink does not grow with conference size
+	SROLE_RELAY       = 2,
+	// sends media in webinar, where listeners only receive it
+	SROLE_PRESENTER   = 3,
 };
 
 const char* srole_str(enum SRole role);
 
+// organisers and presenters send media in webinar
+bool srole_is_presenter(enum SRole role);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -0,0 +1,460 @@
+#include "sample_convert.h"
+
+#include <math.h>
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCONV_X86
+#include <immintrin.h>
+#endif
+
+#define S16_SCALE 32768.0f
+#define S16_MIN -32768.0f
+#define S16_MAX 32767.0f
+
+typedef void (*s16_to_fltp_fn)(const int16_t *, float *const *, int, int);
+typedef void (*fltp_to_s16_fn)(const float *const *, int16_t *, int, int);
+typedef void (*gain_flt_fn)(float *, int, float);
+typedef void (*gain_ramp_flt_fn)(float *, int, float, float);
+typedef void (*mix_flt_fn)(float *, const float *, int, float);
+typedef float (*peak_flt_fn)(const float *, int);
+typedef double (*sumsq_flt_fn)(const float *, int);
+
+struct SConvKernels {
+	enum SConvSimd level;
+	s16_to_fltp_fn s16_to_fltp;
+	fltp_to_s16_fn fltp_to_s16;
+	gain_flt_fn gain_flt;
+	gain_ramp_flt_fn gain_ramp_flt;
+	mix_flt_fn mix_flt;
+	peak_flt_fn peak_flt;
+	sumsq_flt_fn sumsq_flt;
+};
+
+static inline int16_t flt_to_s16(float f) {
+	f *= S16_SCALE;
+	// clamping before rounding gives the same result as clipping after it
+	f = f < S16_MIN ? S16_MIN : f > S16_MAX ? S16_MAX : f;
+	return (int16_t)lrintf(f);
+}
+
+static void gain_flt_c(float *samples, int nb_samples, float gain) {
+	for (int i = 0; i < nb_samples; ++i) samples[i] *= gain;
+}
+
+// gain of sample i is from + step * i in every implementation, so results are bit-exact
+static void gain_ramp_flt_tail(float *samples, int offset, int nb_samples, float from, float step) {
+	for (int i = offset; i < nb_samples; ++i) samples[i] *= from + step * (float)i;
+}
+
+static void gain_ramp_flt_c(float *samples, int nb_samples, float from, float to) {
+	gain_ramp_flt_tail(samples, 0, nb_samples, from, (to - from) / nb_samples);
+}
+
+static void mix_flt_c(float *dst, const float *src, int nb_samples, float gain) {
+	for (int i = 0; i < nb_samples; ++i) dst[i] += src[i] * gain;
+}
+
+static float peak_flt_c(const float *samples, int nb_samples) {
+	float peak = 0.0f;
+	for (int i = 0; i < nb_samples; ++i) {
+		float a = fabsf(samples[i]);
+		peak    = a > peak ? a : peak;
+	}
+	return peak;
+}
+
+static double sumsq_flt_c(const float *samples, int nb_samples) {
+	double sum = 0.0;
+	for (int i = 0; i < nb_samples; ++i) sum += samples[i] * samples[i];
+	return sum;
+}
+
+// scalar conversion starting from sample offset. Handles tails and layouts without vector code
+static void s16_to_fltp_tail(
+    const int16_t *src, float *const *dst, int nb_channels, int offset, int nb_samples) {
+	for (int i = offset; i < nb_samples; ++i)
+		for (int c = 0; c < nb_channels; ++c)
+			dst[c][i] = src[i * nb_channels + c] * (1.0f / S16_SCALE);
+}
+
+static void fltp_to_s16_tail(
+    const float *const *src, int16_t *dst, int nb_channels, int offset, int nb_samples) {
+	for (int i = offset; i < nb_samples; ++i)
+		for (int c = 0; c < nb_channels; ++c) dst[i * nb_channels + c] = flt_to_s16(src[c][i]);
+}
+
+static void s16_to_fltp_c(const int16_t *src, float *const *dst, int nb_channels, int nb_samples) {
+	s16_to_fltp_tail(src, dst, nb_channels, 0, nb_samples);
+}
+
+static void fltp_to_s16_c(const float *const *src, int16_t *dst, int nb_channels, int nb_samples) {
+	fltp_to_s16_tail(src, dst, nb_channels, 0, nb_samples);
+}
+
+#ifdef SCONV_X86
+
+__attribute__((target("sse2"))) static inline __m128i flt_to_s32_sse2(__m128 f) {
+	f = _mm_mul_ps(f, _mm_set1_ps(S16_SCALE));
+	f = _mm_min_ps(_mm_max_ps(f, _mm_set1_ps(S16_MIN)), _mm_set1_ps(S16_MAX));
+	return _mm_cvtps_epi32(f);  // rounds to nearest even, as lrintf does
+}
+
+__attribute__((target("sse2"))) static void s16_to_fltp_sse2(const int16_t *src,
+                                                              float *const *dst,
+                                                              int nb_channels,
+                                                              int nb_samples) {
+	const __m128 scale = _mm_set1_ps(1.0f / S16_SCALE);
+	int i              = 0;
+	if (nb_channels == 1) {
+		for (; i + 8 <= nb_samples; i += 8) {
+			__m128i s  = _mm_loadu_si128((const __m128i *)(src + i));
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+			_mm_storeu_ps(dst[0] + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+			_mm_storeu_ps(dst[0] + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+		}
+	} else if (nb_channels == 2) {
+		for (; i + 4 <= nb_samples; i += 4) {
+			__m128i s  = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+			__m128 lo  = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+			__m128 hi  = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+			__m128 lft = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 rgt = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+			_mm_storeu_ps(dst[0] + i, _mm_mul_ps(lft, scale));
+			_mm_storeu_ps(dst[1] + i, _mm_mul_ps(rgt, scale));
+		}
+	}
+	s16_to_fltp_tail(src, dst, nb_channels, i, nb_samples);
+}
+
+__attribute__((target("sse2"))) static void fltp_to_s16_sse2(const float *const *src,
+                                                              int16_t *dst,
+                                                              int nb_channels,
+                                                              int nb_samples) {
+	int i = 0;
+	if (nb_channels == 1) {
+		for (; i + 8 <= nb_samples; i += 8) {
+			__m128i lo = flt_to_s32_sse2(_mm_loadu_ps(src[0] + i));
+			__m128i hi = flt_to_s32_sse2(_mm_loadu_ps(src[0] + i + 4));
+			_mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(lo, hi));
+		}
+	} else if (nb_channels == 2) {
+		for (; i + 4 <= nb_samples; i += 4) {
+			__m128i lft = flt_to_s32_sse2(_mm_loadu_ps(src[0] + i));
+			__m128i rgt = flt_to_s32_sse2(_mm_loadu_ps(src[1] + i));
+			__m128i lo  = _mm_unpacklo_epi32(lft, rgt);
+			__m128i hi  = _mm_unpackhi_epi32(lft, rgt);
+			_mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_packs_epi32(lo, hi));
+		}
+	}
+	fltp_to_s16_tail(src, dst, nb_channels, i, nb_samples);
+}
+
+__attribute__((target("sse2"))) static void gain_flt_sse2(float *samples,
+                                                           int nb_samples,
+                                                           float gain) {
+	const __m128 g = _mm_set1_ps(gain);
+	int i          = 0;
+	for (; i + 4 <= nb_samples; i += 4)
+		_mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), g));
+	gain_flt_c(samples + i, nb_samples - i, gain);
+}
+
+__attribute__((target("sse2"))) static void gain_ramp_flt_sse2(float *samples,
+                                                                int nb_samples,
+                                                                float from,
+                                                                float to) {
+	const float step  = (to - from) / nb_samples;
+	const __m128 f    = _mm_set1_ps(from);
+	const __m128 s    = _mm_set1_ps(step);
+	__m128 idx        = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	const __m128 four = _mm_set1_ps(4.0f);
+	int i             = 0;
+	for (; i + 4 <= nb_samples; i += 4, idx = _mm_add_ps(idx, four)) {
+		__m128 g = _mm_add_ps(f, _mm_mul_ps(s, idx));
+		_mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), g));
+	}
+	gain_ramp_flt_tail(samples, i, nb_samples, from, step);
+}
+
+__attribute__((target("sse2"))) static void mix_flt_sse2(float *dst,
+                                                          const float *src,
+                                                          int nb_samples,
+                                                          float gain) {
+	const __m128 g = _mm_set1_ps(gain);
+	int i          = 0;
+	for (; i + 4 <= nb_samples; i += 4) {
+		__m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), g);
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), v));
+	}
+	mix_flt_c(dst + i, src + i, nb_samples - i, gain);
+}
+
+__attribute__((target("sse2"))) static float peak_flt_sse2(const float *samples, int nb_samples) {
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 peak           = _mm_setzero_ps();
+	int i                 = 0;
+	for (; i + 4 <= nb_samples; i += 4)
+		peak = _mm_max_ps(peak, _mm_and_ps(_mm_loadu_ps(samples + i), abs_mask));
+	peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(1, 0, 3, 2)));
+	peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(2, 3, 0, 1)));
+	float result = _mm_cvtss_f32(peak);
+	float tail   = peak_flt_c(samples + i, nb_samples - i);
+	return tail > result ? tail : result;
+}
+
+// float partial sums per lane are precise enough for level metering of one frame
+__attribute__((target("sse2"))) static double sumsq_flt_sse2(const float *samples, int nb_samples) {
+	__m128 acc = _mm_setzero_ps();
+	int i      = 0;
+	for (; i + 4 <= nb_samples; i += 4) {
+		__m128 v = _mm_loadu_ps(samples + i);
+		acc      = _mm_add_ps(acc, _mm_mul_ps(v, v));
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, acc);
+	return (double)lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+	       sumsq_flt_c(samples + i, nb_samples - i);
+}
+
+__attribute__((target("avx2"))) static inline __m256i flt_to_s32_avx2(__m256 f) {
+	f = _mm256_mul_ps(f, _mm256_set1_ps(S16_SCALE));
+	f = _mm256_min_ps(_mm256_max_ps(f, _mm256_set1_ps(S16_MIN)), _mm256_set1_ps(S16_MAX));
+	return _mm256_cvtps_epi32(f);
+}
+
+// packs/unpacks work inside 128 bit lanes, this puts 64 bit quarters back in order
+#define AVX2_FIX_LANES(v) _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0))
+
+__attribute__((target("avx2"))) static void s16_to_fltp_avx2(const int16_t *src,
+                                                              float *const *dst,
+                                                              int nb_channels,
+                                                              int nb_samples) {
+	const __m256 scale = _mm256_set1_ps(1.0f / S16_SCALE);
+	int i              = 0;
+	if (nb_channels == 1) {
+		for (; i + 8 <= nb_samples; i += 8) {
+			__m256i s = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+			_mm256_storeu_ps(dst[0] + i, _mm256_mul_ps(_mm256_cvtepi32_ps(s), scale));
+		}
+	} else if (nb_channels == 2) {
+		for (; i + 8 <= nb_samples; i += 8) {
+			// L0 R0 .. L3 R3 and L4 R4 .. L7 R7
+			__m256 a = _mm256_cvtepi32_ps(
+			    _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + 2 * i))));
+			__m256 b = _mm256_cvtepi32_ps(
+			    _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + 2 * i + 8))));
+			// L0 L1 L4 L5 | L2 L3 L6 L7
+			__m256 lft = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			__m256 rgt = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+			lft        = _mm256_castsi256_ps(AVX2_FIX_LANES(_mm256_castps_si256(lft)));
+			rgt        = _mm256_castsi256_ps(AVX2_FIX_LANES(_mm256_castps_si256(rgt)));
+			_mm256_storeu_ps(dst[0] + i, _mm256_mul_ps(lft, scale));
+			_mm256_storeu_ps(dst[1] + i, _mm256_mul_ps(rgt, scale));
+		}
+	}
+	s16_to_fltp_tail(src, dst, nb_channels, i, nb_samples);
+}
+
+__attribute__((target("avx2"))) static void fltp_to_s16_avx2(const float *const *src,
+                                                              int16_t *dst,
+                                                              int nb_channels,
+                                                              int nb_samples) {
+	int i = 0;
+	if (nb_channels == 1) {
+		for (; i + 16 <= nb_samples; i += 16) {
+			__m256i lo = flt_to_s32_avx2(_mm256_loadu_ps(src[0] + i));
+			__m256i hi = flt_to_s32_avx2(_mm256_loadu_ps(src[0] + i + 8));
+			_mm256_storeu_si256((__m256i *)(dst + i), AVX2_FIX_LANES(_mm256_packs_epi32(lo, hi)));
+		}
+	} else if (nb_channels == 2) {
+		for (; i + 8 <= nb_samples; i += 8) {
+			__m256i lft = flt_to_s32_avx2(_mm256_loadu_ps(src[0] + i));
+			__m256i rgt = flt_to_s32_avx2(_mm256_loadu_ps(src[1] + i));
+			// lanes hold samples 0-3 and 4-7, so in-lane pack keeps interleaved order
+			__m256i lo = _mm256_unpacklo_epi32(lft, rgt);
+			__m256i hi = _mm256_unpackhi_epi32(lft, rgt);
+			_mm256_storeu_si256((__m256i *)(dst + 2 * i), _mm256_packs_epi32(lo, hi));
+		}
+	}
+	fltp_to_s16_tail(src, dst, nb_channels, i, nb_samples);
+}
+
+__attribute__((target("avx2"))) static void gain_flt_avx2(float *samples,
+                                                           int nb_samples,
+                                                           float gain) {
+	const __m256 g = _mm256_set1_ps(gain);
+	int i          = 0;
+	for (; i + 8 <= nb_samples; i += 8)
+		_mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), g));
+	gain_flt_c(samples + i, nb_samples - i, gain);
+}
+
+__attribute__((target("avx2"))) static void gain_ramp_flt_avx2(float *samples,
+                                                                int nb_samples,
+                                                                float from,
+                                                                float to) {
+	const float step   = (to - from) / nb_samples;
+	const __m256 f     = _mm256_set1_ps(from);
+	const __m256 s     = _mm256_set1_ps(step);
+	__m256 idx         = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	const __m256 eight = _mm256_set1_ps(8.0f);
+	int i              = 0;
+	for (; i + 8 <= nb_samples; i += 8, idx = _mm256_add_ps(idx, eight)) {
+		// separate mul and add: fused multiply-add would round differently from scalar code
+		__m256 g = _mm256_add_ps(f, _mm256_mul_ps(s, idx));
+		_mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), g));
+	}
+	gain_ramp_flt_tail(samples, i, nb_samples, from, step);
+}
+
+__attribute__((target("avx2"))) static void mix_flt_avx2(float *dst,
+                                                          const float *src,
+                                                          int nb_samples,
+                                                          float gain) {
+	const __m256 g = _mm256_set1_ps(gain);
+	int i          = 0;
+	for (; i + 8 <= nb_samples; i += 8) {
+		__m256 v = _mm256_mul_ps(_mm256_loadu_ps(src + i), g);
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), v));
+	}
+	mix_flt_c(dst + i, src + i, nb_samples - i, gain);
+}
+
+__attribute__((target("avx2"))) static float peak_flt_avx2(const float *samples, int nb_samples) {
+	const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	__m256 peak           = _mm256_setzero_ps();
+	int i                 = 0;
+	for (; i + 8 <= nb_samples; i += 8)
+		peak = _mm256_max_ps(peak, _mm256_and_ps(_mm256_loadu_ps(samples + i), abs_mask));
+	__m128 half = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+	half        = _mm_max_ps(half, _mm_shuffle_ps(half, half, _MM_SHUFFLE(1, 0, 3, 2)));
+	half        = _mm_max_ps(half, _mm_shuffle_ps(half, half, _MM_SHUFFLE(2, 3, 0, 1)));
+	float result = _mm_cvtss_f32(half);
+	float tail   = peak_flt_c(samples + i, nb_samples - i);
+	return tail > result ? tail : result;
+}
+
+__attribute__((target("avx2"))) static double sumsq_flt_avx2(const float *samples, int nb_samples) {
+	__m256 acc = _mm256_setzero_ps();
+	int i      = 0;
+	for (; i + 8 <= nb_samples; i += 8) {
+		__m256 v = _mm256_loadu_ps(samples + i);
+		acc      = _mm256_add_ps(acc, _mm256_mul_ps(v, v));
+	}
+	float lanes[8];
+	_mm256_storeu_ps(lanes, acc);
+	double sum = 0.0;
+	for (int l = 0; l < 8; ++l) sum += lanes[l];
+	return sum + sumsq_flt_c(samples + i, nb_samples - i);
+}
+
+#endif  // SCONV_X86
+
+static const struct SConvKernels kernels[] = {
+    [SCONV_SIMD_NONE] = {SCONV_SIMD_NONE,
+                         s16_to_fltp_c,
+                         fltp_to_s16_c,
+                         gain_flt_c,
+                         gain_ramp_flt_c,
+                         mix_flt_c,
+                         peak_flt_c,
+                         sumsq_flt_c},
+#ifdef SCONV_X86
+    [SCONV_SIMD_SSE2] = {SCONV_SIMD_SSE2,
+                         s16_to_fltp_sse2,
+                         fltp_to_s16_sse2,
+                         gain_flt_sse2,
+                         gain_ramp_flt_sse2,
+                         mix_flt_sse2,
+                         peak_flt_sse2,
+                         sumsq_flt_sse2},
+    [SCONV_SIMD_AVX2] = {SCONV_SIMD_AVX2,
+                         s16_to_fltp_avx2,
+                         fltp_to_s16_avx2,
+                         gain_flt_avx2,
+                         gain_ramp_flt_avx2,
+                         mix_flt_avx2,
+                         peak_flt_avx2,
+                         sumsq_flt_avx2},
+#endif
+};
+
+static const struct SConvKernels *active = &kernels[SCONV_SIMD_NONE];
+static pthread_once_t detect_once        = PTHREAD_ONCE_INIT;
+
+const char *sconv_simd_str(enum SConvSimd level) {
+	switch (level) {
+		case SCONV_SIMD_NONE: return "none";
+		case SCONV_SIMD_SSE2: return "sse2";
+		case SCONV_SIMD_AVX2: return "avx2";
+		default: return "unknown";
+	}
+}
+
+enum SConvSimd sconv_simd_detect(void) {
+#ifdef SCONV_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return SCONV_SIMD_AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return SCONV_SIMD_SSE2;
+#endif
+	return SCONV_SIMD_NONE;
+}
+
+static void select_kernels(void) {
+	active = &kernels[sconv_simd_detect()];
+}
+
+enum SConvSimd sconv_simd_level(void) {
+	pthread_once(&detect_once, select_kernels);
+	return active->level;
+}
+
+enum SConvSimd sconv_set_simd_level(enum SConvSimd level) {
+	pthread_once(&detect_once, select_kernels);
+	enum SConvSimd detected = sconv_simd_detect();
+	if (level > detected)
+		level = detected;
+	active = &kernels[level];
+	return level;
+}
+
+void sconv_s16_to_fltp(const int16_t *src, float *const *dst, int nb_channels, int nb_samples) {
+	pthread_once(&detect_once, select_kernels);
+	active->s16_to_fltp(src, dst, nb_channels, nb_samples);
+}
+
+void sconv_fltp_to_s16(const float *const *src, int16_t *dst, int nb_channels, int nb_samples) {
+	pthread_once(&detect_once, select_kernels);
+	active->fltp_to_s16(src, dst, nb_channels, nb_samples);
+}
+
+void sconv_gain_flt(float *samples, int nb_samples, float gain) {
+	pthread_once(&detect_once, select_kernels);
+	active->gain_flt(samples, nb_samples, gain);
+}
+
+void sconv_gain_ramp_flt(float *samples, int nb_samples, float from, float to) {
+	if (nb_samples <= 0)
+		return;
+	pthread_once(&detect_once, select_kernels);
+	active->gain_ramp_flt(samples, nb_samples, from, to);
+}
+
+void sconv_mix_flt(float *dst, const float *src, int nb_samples, float gain) {
+	pthread_once(&detect_once, select_kernels);
+	active->mix_flt(dst, src, nb_samples, gain);
+}
+
+float sconv_peak_flt(const float *samples, int nb_samples) {
+	pthread_once(&detect_once, select_kernels);
+	return active->peak_flt(samples, nb_samples);
+}
+
+double sconv_sumsq_flt(const float *samples, int nb_samples) {
+	pthread_once(&detect_once, select_kernels);
+	return active->sumsq_flt(samples, nb_samples);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// vectorized audio sample kernels. Implementation is selected at runtime by CPU features,
+// results are bit-exact with scalar code and with libswresample conversion:
+//   s16 -> float: s / 32768
+//   float -> s16: clip(lrintf(f * 32768)), round half to even
+enum SConvSimd {
+	SCONV_SIMD_NONE,
+	SCONV_SIMD_SSE2,
+	SCONV_SIMD_AVX2,
+};
+
+const char *sconv_simd_str(enum SConvSimd level);
+
+// best level supported by CPU
+enum SConvSimd sconv_simd_detect(void);
+
+enum SConvSimd sconv_simd_level(void);
+
+// forces kernels of given level (clamped to detected one). Meant for tests and benchmarks,
+// must not be called while kernels are in use. Returns level actually set
+enum SConvSimd sconv_set_simd_level(enum SConvSimd level);
+
+// interleaved S16 to planar float (FLTP). dst holds nb_channels planes
+void sconv_s16_to_fltp(const int16_t *src, float *const *dst, int nb_channels, int nb_samples);
+
+// planar float to interleaved S16 with saturation
+void sconv_fltp_to_s16(const float *const *src, int16_t *dst, int nb_channels, int nb_samples);
+
+// multiplies plane of float samples by gain in place
+void sconv_gain_flt(float *samples, int nb_samples, float gain);
+
+// multiplies plane by gain going linearly from `from` at first sample towards `to` after last
+void sconv_gain_ramp_flt(float *samples, int nb_samples, float from, float to);
+
+// dst += src * gain. Mixing primitive, sum is not clipped
+void sconv_mix_flt(float *dst, const float *src, int nb_samples, float gain);
+
+// max absolute sample value of plane
+float sconv_peak_flt(const float *samples, int nb_samples);
+
+// sum of squared samples for level metering. Summation order differs between levels, so unlike
+// other kernels results are only close, not bit-exact
+double sconv_sumsq_flt(const float *samples, int nb_samples);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
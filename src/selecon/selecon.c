@@ -6,6 +6,7 @@
 #include <libavcodec/packet.h>
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -50,7 +51,13 @@ void scontext_destroy(struct SContext *context) {
 		free(context->participants);
 		spart_destroy(&context->self);
 		pthread_rwlock_destroy(&context->part_rwlock);
+		pthread_mutex_destroy(&context->link_mutex);
 		scont_free(&context->streams);
+		smixer_free(&context->mixer);
+		scomp_free(&context->compositor);
+		sspeak_free(&context->speakers);
+		sclocks_free(&context->clocks);
+		smcrypt_free(&context->crypto);
 	}
 }
 
@@ -71,22 +78,166 @@ static void add_participant(struct SContext *ctx,
                             struct SConnection *con) {
 	ctx->participants =
 	    reallocarray(ctx->participants, ctx->nb_participants, sizeof(struct SParticipant));
-	size_t index                        = ctx->nb_participants - 1;
-	ctx->participants[index].id         = id;
-	ctx->participants[index].listen_ep  = *listen_ep;
-	ctx->participants[index].connection = con;
-	ctx->participants[index].name       = strdup(name);
-	ctx->participants[index].role       = role;
+	size_t index                              = ctx->nb_participants - 1;
+	ctx->participants[index].id               = id;
+	ctx->participants[index].listen_ep        = *listen_ep;
+	ctx->participants[index].connection       = con;
+	ctx->participants[index].name             = strdup(name);
+	ctx->participants[index].role             = role;
+	ctx->participants[index].video_out        = SVIDEO_SUB_FULL;
+	ctx->participants[index].video_in         = SVIDEO_SUB_FULL;
+	ctx->participants[index].video_out_layer  = 0;
+	ctx->participants[index].video_in_layer   = 0;
+	ctx->participants[index].video_epoch      = 0;
+	ctx->participants[index].rtt_ms           = -1.0f;
+	ctx->participants[index].capacity         = (struct SPartCapacity){0};
+	ctx->participants[index].relay_id         = 0;
+	ctx->participants[index].parent_id        = 0;
 	ctx->nb_participants++;
+	ctx->topology_dirty = true;
+	ctx->rekey          = true;
+}
+
+// drops participant from mix, video grid, speaker ranking and clocks
+static void forget_media_source(struct SContext *ctx, part_id_t part_id) {
+	smixer_remove_source(&ctx->mixer, part_id);
+	scomp_remove_source(&ctx->compositor, part_id);
+	sclocks_remove(&ctx->clocks, part_id);
+	if (sspeak_remove(&ctx->speakers, part_id) && ctx->speaker_handler != NULL)
+		ctx->speaker_handler(ctx, 0);
+}
+
+// ctx->part_rwlock must be locked. Returns index of participant or nb_participants - 1
+static size_t find_participant_locked(struct SContext *ctx, part_id_t part_id) {
+	size_t index = 0;
+	while (index < ctx->nb_participants - 1 && ctx->participants[index].id != part_id) ++index;
+	return index;
+}
+
+// relays and presenters keep their role when they join other conference
+static bool role_sticky(enum SRole role) {
+	return role == SROLE_RELAY || role == SROLE_PRESENTER;
+}
+
+// peers tell their roles themselves. Organiser is only the one conference id was generated for, so
+// other members can not pass organiser checks by claiming it. Roles outside of enum are rejected
+static bool peer_role_valid(conf_id_t conf_id,
+                            timestamp_t conf_start_ts,
+                            part_id_t part_id,
+                            enum SRole role) {
+	if (role == SROLE_ORGANISATOR)
+		return verify_conf_id(conf_id, part_id, conf_start_ts);
+	return role == SROLE_LISTENER || role == SROLE_RELAY || role == SROLE_PRESENTER;
+}
+
+// role self takes in conference of invite: everybody but relays and presenters listens there
+static enum SRole joined_role(struct SContext *ctx, conf_id_t conf_id) {
+	if (ctx->conf_id == conf_id || role_sticky(ctx->self.role))
+		return ctx->self.role;
+	return SROLE_LISTENER;
+}
+
+// ctx->part_rwlock must be locked. Hops webinar media takes from presenters to participant as far
+// as known here, SIZE_MAX if participant is in subtree of participant with given id (or is it) or
+// its place in tree is unknown
+static size_t tree_depth_locked(struct SContext *ctx,
+                                const struct SParticipant *part,
+                                part_id_t subtree_id) {
+	size_t depth = 0;
+	for (size_t steps = 0; steps < ctx->nb_participants; ++steps, ++depth) {
+		if (part->id == subtree_id)
+			return SIZE_MAX;
+		if (srole_is_presenter(part->role))
+			return depth;
+		if (part == &ctx->self)
+			return depth + 1;  // listener placing others is fed by somebody at least
+		if (part->parent_id == ctx->self.id)
+			part = &ctx->self;
+		else {
+			size_t index = find_participant_locked(ctx, part->parent_id);
+			if (index == ctx->nb_participants - 1)
+				return SIZE_MAX;
+			part = &ctx->participants[index];
+		}
+	}
+	return SIZE_MAX;
+}
+
+// ctx->part_rwlock must be in writer locked state. Tells listener we feed it, so it takes media
+// of others and keys from us
+static void adopt_listener_locked(struct SContext *ctx, size_t index) {
+	ctx->participants[index].parent_id = ctx->self.id;
+	struct SMsgPartPresence *msg       = message_part_presence_alloc();
+	msg->part_id                       = ctx->self.id;
+	msg->part_role                     = ctx->self.role;
+	msg->ep                            = ctx->listen_ep;
+	msg->state                         = PART_PARENT;
+	sconn_send(ctx->participants[index].connection, (struct SMessage *)msg);
+	message_free((struct SMessage **)&msg);
+}
+
+// ctx->part_rwlock must be in writer locked state. Chooses who feeds media to webinar listener:
+// self, presenter or listener placed before. Others are asked to meet listener with PART_FEED
+// presence, self feeds it at once. Self takes listener when everybody is full
+static void place_listener_locked(struct SContext *ctx, size_t index) {
+	struct SParticipant *listener = &ctx->participants[index];
+	size_t count                  = ctx->nb_participants;  // participants and self last
+	struct STreeNode *nodes       = calloc(count, sizeof(struct STreeNode));
+	size_t parent                 = count - 1;
+	if (nodes != NULL) {
+		size_t nb_presenters = srole_is_presenter(ctx->self.role) ? 1 : 0;
+		for (size_t i = 0; i < count - 1; ++i)
+			nb_presenters += srole_is_presenter(ctx->participants[i].role);
+		for (size_t i = 0; i < count; ++i) {
+			const struct SParticipant *part = i < count - 1 ? &ctx->participants[i] : &ctx->self;
+			bool alive                      = part == &ctx->self || part->connection != NULL;
+			nodes[i].depth                  = tree_depth_locked(ctx, part, listener->id);
+			nodes[i].can_feed               = alive && nodes[i].depth != SIZE_MAX;
+			nodes[i].uplink_kbps            = part->capacity.uplink_kbps;
+			for (size_t j = 0; j < count - 1; ++j)
+				nodes[i].nb_children += ctx->participants[j].parent_id == part->id;
+		}
+		parent = stopology_pick_parent(nodes, count, nb_presenters, SELECON_TOPOLOGY_MEDIA_KBPS);
+		free(nodes);
+	}
+	if (parent >= count - 1) {
+		adopt_listener_locked(ctx, index);
+		return;
+	}
+	listener->parent_id          = ctx->participants[parent].id;
+	struct SMsgPartPresence *msg = message_part_presence_alloc();
+	msg->part_id                 = listener->id;
+	msg->part_role               = listener->role;
+	msg->ep                      = listener->listen_ep;
+	msg->state                   = PART_FEED;
+	sconn_send(ctx->participants[parent].connection, (struct SMessage *)msg);
+	message_free((struct SMessage **)&msg);
+}
+
+// ctx->part_rwlock must be in writer locked state. Listeners fed by lost participant get new place
+static void place_orphans_locked(struct SContext *ctx, part_id_t lost_id) {
+	if (!ctx->webinar)
+		return;
+	for (size_t i = 0; i < ctx->nb_participants - 1; ++i) {
+		if (ctx->participants[i].parent_id != lost_id)
+			continue;
+		ctx->participants[i].parent_id = 0;
+		place_listener_locked(ctx, i);
+	}
 }
 
 static void remove_participant_locked(struct SContext *ctx, size_t index) {
+	part_id_t id = ctx->participants[index].id;
 	// remove all asociated streams
-	scont_close_streams(&ctx->streams, ctx->participants[index].id);
+	scont_close_streams(&ctx->streams, id);
+	forget_media_source(ctx, id);
 	spart_destroy(&ctx->participants[index]);
 	for (size_t i = index + 1; i < ctx->nb_participants - 1; ++i)
 		ctx->participants[i - 1] = ctx->participants[i];
 	ctx->nb_participants--;
+	ctx->topology_dirty = true;
+	ctx->rekey          = true;
+	place_orphans_locked(ctx, id);
 }
 
 static void remove_participant(struct SContext *ctx, size_t index) {
@@ -102,20 +253,38 @@ static void remove_participant(struct SContext *ctx, size_t index) {
 // | 1    | sends invite msg  | recvs invite msg  |
 // | 2    |                   | decides accept    |
 // | 3    | recvs confirm msg | sends confirm msg |
+//
+// media profile is negotiated at step 2: invitee picks first profile from invite caps it
+// supports and sends it back in confirm msg
 static enum SError do_handshake_srv(struct SContext *ctx,
                                     struct SConnection *con,
                                     struct SMsgInvite *invite,
-                                    bool *accepted) {
-	struct SMessage *msg = NULL;
+                                    bool *accepted,
+                                    struct SMediaProfile *profile) {
+	// inside conference profile is fixed already
+	struct SMediaCaps local = ctx->caps;
 	if (ctx->conf_id == invite->conf_id) {
-		msg       = message_invite_accept_alloc(ctx->self.id, ctx->self.name, &ctx->listen_ep);
+		struct SMediaProfile conf_profile;
+		scont_get_profile(&ctx->streams, &conf_profile);
+		media_caps_from_profile(&local, &conf_profile);
+	}
+	enum SRole role      = joined_role(ctx, invite->conf_id);
+	struct SMessage *msg = NULL;
+	if (!media_profile_negotiate(&invite->caps, &local, profile)) {
+		fprintf(stderr, "no common media profile with participant %llu\n", invite->part_id);
+		msg       = message_invite_reject_alloc();
+		*accepted = false;
+	} else if (ctx->conf_id == invite->conf_id) {
+		msg = message_invite_accept_alloc(
+		    ctx->self.id, role, ctx->self.name, &ctx->listen_ep, profile);
 		*accepted = true;
 	} else if (!verify_conf_id(invite->conf_id, invite->part_id, invite->conf_start_ts)) {
 		fprintf(stderr, "invalid invite recieved for conf %llu\n", invite->conf_id);
 		msg       = message_invite_reject_alloc();
 		*accepted = false;
 	} else if (ctx->invite_handler(invite)) {
-		msg       = message_invite_accept_alloc(ctx->self.id, ctx->self.name, &ctx->listen_ep);
+		msg = message_invite_accept_alloc(
+		    ctx->self.id, role, ctx->self.name, &ctx->listen_ep, profile);
 		*accepted = true;
 	} else {
 		msg       = message_invite_reject_alloc();
@@ -134,7 +303,7 @@ static enum SError do_handshake_client(struct SConnection *con,
 		return err;
 	err = sconn_recv(con, &msg);
 	if (err == SELECON_OK) {
-		if (msg->type == SMSG_INVITE_ACCEPT)
+		if (msg->type == SMSG_INVITE_ACCEPT && message_size_valid(msg))
 			*acceptMsg = (struct SMsgInviteAccept *)msg;
 		else {
 			message_free(&msg);
@@ -145,6 +314,8 @@ static enum SError do_handshake_client(struct SConnection *con,
 	return err;
 }
 
+static enum SError invite_endpoint(struct SContext *ctx, struct SEndpoint *ep, bool feed);
+
 static void handle_part_presence_message(struct SContext *ctx,
                                          size_t part_index,
                                          struct SMsgPartPresence *msg) {
@@ -166,6 +337,33 @@ static void handle_part_presence_message(struct SContext *ctx,
 				fprintf(
 				    stderr, "failed to meet participant %llu: %s\n", msg->part_id, serror_str(err));
 		}
+	} else if (msg->state == PART_PARENT && ctx->webinar) {
+		// listeners we feed can not feed us. New parent takes over from presenters, otherwise only
+		// when previous one is gone
+		pthread_rwlock_wrlock(&ctx->part_rwlock);
+		const struct SParticipant *from = &ctx->participants[part_index];
+		size_t parent                   = find_participant_locked(ctx, ctx->self.parent_id);
+		bool orphan                     = parent == ctx->nb_participants - 1 ||
+		              ctx->participants[parent].connection == NULL;
+		if (from->parent_id != ctx->self.id && (srole_is_presenter(from->role) || orphan))
+			ctx->self.parent_id = from->id;
+		else
+			fprintf(stderr, "prevented participant %llu from taking distribution tree\n", from->id);
+		pthread_rwlock_unlock(&ctx->part_rwlock);
+	} else if (msg->state == PART_FEED && ctx->webinar) {
+		// listener placed under us in distribution tree, meet it unless we know it already
+		pthread_rwlock_wrlock(&ctx->part_rwlock);
+		size_t index = find_participant_locked(ctx, msg->part_id);
+		bool known   = index < ctx->nb_participants - 1;
+		if (known)
+			adopt_listener_locked(ctx, index);
+		pthread_rwlock_unlock(&ctx->part_rwlock);
+		if (!known) {
+			enum SError err = invite_endpoint(ctx, &msg->ep, true);
+			if (err != SELECON_OK)
+				fprintf(
+				    stderr, "failed to feed listener %llu: %s\n", msg->part_id, serror_str(err));
+		}
 	}
 }
 
@@ -174,18 +372,176 @@ static void handle_text_message(struct SContext *ctx, struct SMsgText *msg) {
 		ctx->text_handler(ctx, msg->part_id, msg->data);
 }
 
-static void handle_audio_packet_message(struct SContext *ctx, struct SMsgAudio *msg) {
-	sstream_id_t stream =
-	    scont_find_stream(&ctx->streams, msg->part_id, SSTREAM_AUDIO, SSTREAM_INPUT);
-	if (stream == NULL)
+// media messages must come from participant they claim to be sent by or from relay forwarding
+// media of other participant
+static bool check_sender(struct SContext *ctx, size_t part_index, part_id_t part_id) {
+	pthread_rwlock_rdlock(&ctx->part_rwlock);
+	bool valid = ctx->participants[part_index].id == part_id;
+	if (!valid && ctx->participants[part_index].role == SROLE_RELAY)
+		valid = find_participant_locked(ctx, part_id) < ctx->nb_participants - 1;
+	// webinar media of presenters we may not know comes down distribution tree from our parent.
+	// Presenters get media of each other directly, passed one may come from known presenters only
+	if (!valid && ctx->webinar) {
+		const struct SParticipant *from = &ctx->participants[part_index];
+		valid = ctx->self.parent_id != 0 && from->id == ctx->self.parent_id;
+		if (!valid && srole_is_presenter(ctx->self.role) && srole_is_presenter(from->role)) {
+			size_t index = find_participant_locked(ctx, part_id);
+			valid        = index < ctx->nb_participants - 1 &&
+			        srole_is_presenter(ctx->participants[index].role);
+		}
+	}
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+	if (!valid)
+		fprintf(stderr, "prevented media packet on behalf of different participant\n");
+	return valid;
+}
+
+// input stream for media sent by participant. Created on first packet, so participants who
+// never send video (or anything at all) cost no decoder and thread
+static sstream_id_t get_input_stream(struct SContext *ctx, part_id_t part_id, enum SStreamType type) {
+	sstream_id_t stream = NULL;
+	enum SError err =
+	    scont_get_input_stream(&ctx->streams, part_id, ctx->conf_start_ts, type, &stream);
+	if (err != SELECON_OK)
 		fprintf(stderr,
-		        "stream not found for arrived audio packet from part_id = %llu\n",
-		        msg->part_id);
-	else {
+		        "failed to create input stream for part_id = %llu: err = %s\n",
+		        part_id,
+		        serror_str(err));
+	return stream;
+}
+
+// sealed media leaves TLS, silence markers and everything else go through it
+static enum SError send_media(struct SConnection *con, struct SMessage *msg) {
+	if (msg->type == SMSG_AUDIO || msg->type == SMSG_VIDEO)
+		return sconn_send_plain(con, msg);
+	return sconn_send(con, msg);
+}
+
+// seals payload of own media message once for all receivers
+static enum SError seal_media_message(struct SContext *ctx, struct SMessage *msg) {
+	uint8_t *data           = NULL;
+	size_t size             = 0;
+	struct SMediaSeal *seal = message_media_seal(msg, &data, &size);
+	if (seal == NULL)
+		return SELECON_OK;
+	return smcrypt_seal(&ctx->crypto,
+	                    ctx->self.id,
+	                    get_curr_timestamp(),
+	                    seal,
+	                    msg,
+	                    data - (uint8_t *)msg,
+	                    data,
+	                    size,
+	                    data + size);
+}
+
+// opens media sealed by its author in place. Relays pass it on before, without opening
+static bool open_media_message(struct SContext *ctx, part_id_t part_id, struct SMessage *msg) {
+	uint8_t *data           = NULL;
+	size_t size             = 0;
+	struct SMediaSeal *seal = message_media_seal(msg, &data, &size);
+	enum SError err         = SELECON_CRYPTO_ERROR;
+	if (seal != NULL)
+		err = smcrypt_open(
+		    &ctx->crypto, part_id, seal, msg, data - (uint8_t *)msg, data, size, data + size);
+	if (err != SELECON_OK)
+		fprintf(stderr, "failed to open media of %llu: err = %s\n", part_id, serror_str(err));
+	return err == SELECON_OK;
+}
+
+// webinar participant passes all media coming down distribution tree to listeners it feeds
+static void feed_listeners(struct SContext *ctx, size_t part_index, struct SMessage *msg) {
+	pthread_rwlock_rdlock(&ctx->part_rwlock);
+	for (size_t i = 0; i < ctx->nb_participants - 1; ++i) {
+		const struct SParticipant *part = &ctx->participants[i];
+		if (i == part_index || part->parent_id != ctx->self.id || part->connection == NULL)
+			continue;
+		enum SError err = send_media(part->connection, msg);
+		if (err != SELECON_OK)
+			fprintf(stderr, "failed to feed listener: err = %s\n", serror_str(err));
+	}
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+}
+
+// ctx->part_rwlock must be locked. Relay sends media to its own group, to other relays and to
+// participants outside of any group. Without planned topology that is everybody
+static bool relay_target_locked(struct SContext *ctx, size_t index) {
+	const struct SParticipant *part = &ctx->participants[index];
+	return part->role == SROLE_RELAY || part->relay_id == 0 || part->relay_id == ctx->self.id;
+}
+
+// relay passes media message to others as is, without decoding. Media of participant coming
+// directly from it goes to relay targets. Media coming from other relay (or of other relay) goes to
+// own group only, so relays never pass messages back and forth
+static void relay_media_message(struct SContext *ctx,
+                                size_t part_index,
+                                part_id_t part_id,
+                                struct SMessage *msg) {
+	if (ctx->webinar)
+		return feed_listeners(ctx, part_index, msg);
+	if (ctx->self.role != SROLE_RELAY)
+		return;
+	pthread_rwlock_rdlock(&ctx->part_rwlock);
+	bool direct     = ctx->participants[part_index].id == part_id;
+	bool from_relay = ctx->participants[part_index].role == SROLE_RELAY;
+	for (size_t i = 0; i < ctx->nb_participants - 1 && (direct || from_relay); ++i) {
+		if (i == part_index || ctx->participants[i].connection == NULL)
+			continue;
+		if (from_relay ? ctx->participants[i].relay_id != ctx->self.id
+		               : !relay_target_locked(ctx, i))
+			continue;
+		enum SError err = send_media(ctx->participants[i].connection, msg);
+		if (err != SELECON_OK)
+			fprintf(stderr, "failed to relay media message: err = %s\n", serror_str(err));
+	}
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+}
+
+// ranks sender by level from message header (audio is not decoded for this) and applies top K
+// policy: audio of senders outside top K is dropped before deserializing and decoding.
+//
+// Level is trusted as its author put it. Header is authenticated together with sealed payload,
+// so it is ranked only after message opens, and relays in between can not raise it. Members
+// holding media key can still claim any level for own audio. Silence markers are not sealed, but
+// they only lower level of their author and come from checked senders only
+static bool accept_audio(struct SContext *ctx, part_id_t part_id, float level) {
+	timestamp_t now = get_curr_timestamp();
+	if (sspeak_update(&ctx->speakers, part_id, level, now) && ctx->speaker_handler != NULL)
+		ctx->speaker_handler(ctx, sspeak_dominant(&ctx->speakers));
+	size_t top_k = ctx->audio_top_k;
+	if (top_k == 0 || sspeak_in_top(&ctx->speakers, part_id, top_k, now))
+		return true;
+	sstream_id_t stream = scont_find_stream(&ctx->streams, part_id, SSTREAM_AUDIO, SSTREAM_INPUT);
+	if (stream != NULL)
+		scont_skip_packet(&ctx->streams, stream);
+	return false;
+}
+
+// packet pts is capture time by clock of its author. Latency is known for authors we ping only
+static void media_arrived(struct SContext *ctx, part_id_t part_id, const struct AVPacket *packet) {
+	if (packet->pts != AV_NOPTS_VALUE)
+		sclocks_arrived(&ctx->clocks,
+		                part_id,
+		                ctx->conf_start_ts + packet->pts * 1000000ULL,
+		                get_curr_timestamp());
+}
+
+static void handle_audio_packet_message(struct SContext *ctx,
+                                        size_t part_index,
+                                        struct SMsgAudio *msg) {
+	if (!check_sender(ctx, part_index, msg->part_id))
+		return;
+	relay_media_message(ctx, part_index, msg->part_id, &msg->base);
+	if (!open_media_message(ctx, msg->part_id, &msg->base) ||
+	    !accept_audio(ctx, msg->part_id, message_audio_level(msg)))
+		return;
+	sstream_id_t stream = get_input_stream(ctx, msg->part_id, SSTREAM_AUDIO);
+	if (stream != NULL) {
 		struct AVPacket *packet = av_packet_deserialize(msg->data);
 		if (packet == NULL)
 			fprintf(stderr, "failed to deserialize packet\n");
 		else {
+			media_arrived(ctx, msg->part_id, packet);
 			enum SError err = scont_push_packet(&ctx->streams, stream, &packet);
 			if (err == SELECON_OK)
 				fprintf(stderr, "recvd audio packet from %llu\n", msg->part_id);
@@ -198,22 +554,280 @@ static void handle_audio_packet_message(struct SContext *ctx, struct SMsgAudio *
 	}
 }
 
-static void handle_video_packet_message(struct SContext *ctx, struct SMsgVideo *msg) {
+// silence marker never creates input stream, so participant muted since joining costs no decoder
+static void handle_audio_silence_message(struct SContext *ctx,
+                                         size_t part_index,
+                                         struct SMsgAudioSilence *msg) {
+	if (!check_sender(ctx, part_index, msg->part_id) || msg->nb_samples <= 0)
+		return;
+	relay_media_message(ctx, part_index, msg->part_id, &msg->base);
+	if (!accept_audio(ctx, msg->part_id, -127.0f))
+		return;
 	sstream_id_t stream =
-	    scont_find_stream(&ctx->streams, msg->part_id, SSTREAM_VIDEO, SSTREAM_INPUT);
+	    scont_find_stream(&ctx->streams, msg->part_id, SSTREAM_AUDIO, SSTREAM_INPUT);
 	if (stream == NULL)
-		fprintf(stderr,
-		        "stream not found for arrived video packet from part_id = %llu\n",
-		        msg->part_id);
-	else {
+		return;
+	// empty packet tells input worker to play silence instead of decoding
+	struct AVPacket *packet = av_packet_alloc();
+	if (packet == NULL)
+		return;
+	packet->pts = packet->dts = msg->pts;
+	packet->duration          = msg->nb_samples < SELECON_DTX_MAX_MARKER_SAMPLES
+	                                ? msg->nb_samples
+	                                : SELECON_DTX_MAX_MARKER_SAMPLES;
+	if (scont_push_packet(&ctx->streams, stream, &packet) != SELECON_OK)
+		av_packet_free(&packet);
+}
+
+// packets of upper temporal layers are dropped before deserializing when receiver limits frame
+// rate or when decoder falls behind. Frames of lower layers never reference them, so decoder goes
+// on without resync
+static bool accept_video(struct SContext *ctx, sstream_id_t stream, int temporal_id) {
+	if (temporal_id == 0)
+		return true;
+	if (temporal_id >= ctx->video_temporal_layers)
+		return false;
+	return scont_queued_packets(&ctx->streams, stream) < SELECON_VIDEO_DECODE_BACKLOG;
+}
+
+// asks author of video for keyframe. Request goes directly when author is connected, otherwise
+// through participant video came from
+static void request_keyframe(struct SContext *ctx, size_t part_index, part_id_t author) {
+	struct SMessage *msg = message_keyframe_request_alloc(author);
+	pthread_rwlock_rdlock(&ctx->part_rwlock);
+	size_t index = find_participant_locked(ctx, author);
+	if (index == ctx->nb_participants - 1 || ctx->participants[index].connection == NULL)
+		index = part_index;
+	enum SError err = sconn_send(ctx->participants[index].connection, msg);
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+	if (err != SELECON_OK)
+		fprintf(stderr, "failed to request keyframe: err = %s\n", serror_str(err));
+	message_free(&msg);
+}
+
+static void handle_video_packet_message(struct SContext *ctx,
+                                        size_t part_index,
+                                        struct SMsgVideo *msg) {
+	if (!check_sender(ctx, part_index, msg->part_id))
+		return;
+	relay_media_message(ctx, part_index, msg->part_id, &msg->base);
+	// temporal id is in authenticated header, nothing is trusted or allocated before it opens
+	if (!open_media_message(ctx, msg->part_id, &msg->base))
+		return;
+	sstream_id_t stream = get_input_stream(ctx, msg->part_id, SSTREAM_VIDEO);
+	if (stream != NULL && accept_video(ctx, stream, msg->temporal_id)) {
 		struct AVPacket *packet = av_packet_deserialize(msg->data);
 		if (packet == NULL)
 			fprintf(stderr, "failed to deserialize packet\n");
 		else {
 			fprintf(stderr, "recvd video packet from %llu\n", msg->part_id);
+			media_arrived(ctx, msg->part_id, packet);
 			scont_push_packet(&ctx->streams, stream, &packet);
 		}
 	}
+	if (stream != NULL && scont_keyframe_needed(&ctx->streams, stream))
+		request_keyframe(ctx, part_index, msg->part_id);
+}
+
+static void handle_video_subscription_message(struct SContext *ctx,
+                                              size_t part_index,
+                                              struct SMsgVideoSubscription *msg) {
+	pthread_rwlock_wrlock(&ctx->part_rwlock);
+	struct SParticipant *part = &ctx->participants[part_index];
+	if (part->id != msg->part_id)
+		fprintf(stderr, "prevented video subscription on behalf of different participant\n");
+	else if (msg->state < SVIDEO_SUB_FULL || msg->state > SVIDEO_SUB_PAUSED ||
+	         msg->layer >= SELECON_MAX_SIMULCAST_LAYERS)
+		fprintf(stderr, "invalid video subscription: %d/%d\n", msg->state, msg->layer);
+	else {
+		part->video_out       = msg->state;
+		part->video_out_layer = msg->layer;
+		// decoder of receiver skips paused frames, resumed video starts from keyframe
+		if (msg->state == SVIDEO_SUB_PAUSED)
+			part->video_epoch++;
+	}
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+}
+
+static void handle_part_info_message(struct SContext *ctx,
+                                     size_t part_index,
+                                     struct SMsgPartInfo *msg) {
+	size_t name_len = msg->base.size - sizeof(struct SMsgPartInfo);
+	if (name_len == 0 || msg->part_name[name_len - 1] != '\0') {
+		fprintf(stderr, "invalid participant info message\n");
+		return;
+	}
+	pthread_rwlock_wrlock(&ctx->part_rwlock);
+	struct SParticipant *part = &ctx->participants[part_index];
+	if (part->id != msg->part_id)
+		fprintf(stderr, "prevented participant info on behalf of different participant\n");
+	else if (!peer_role_valid(ctx->conf_id, ctx->conf_start_ts, part->id, msg->part_role))
+		fprintf(stderr,
+		        "prevented participant %llu from taking role %d\n",
+		        part->id,
+		        msg->part_role);
+	else {
+		if (part->role != msg->part_role) {
+			fprintf(stderr, "participant %llu is %s now\n", part->id, srole_str(msg->part_role));
+			ctx->topology_dirty = true;
+		}
+		part->role     = msg->part_role;
+		part->capacity = msg->capacity;
+		if (msg->part_name[0] != '\0')
+			spart_rename(part, msg->part_name);
+	}
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+}
+
+static void handle_ping_message(struct SContext *ctx, size_t part_index, struct SMsgPing *msg) {
+	timestamp_t recv_ts = get_curr_timestamp();
+	pthread_rwlock_rdlock(&ctx->part_rwlock);
+	struct SMessage *pong = message_pong_alloc(msg->send_ts, recv_ts, get_curr_timestamp());
+	sconn_send(ctx->participants[part_index].connection, pong);
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+	message_free(&pong);
+}
+
+// round trip time without time responder held ping. Same exchange gives clock offset of responder
+static void handle_pong_message(struct SContext *ctx, size_t part_index, struct SMsgPong *msg) {
+	timestamp_t now = get_curr_timestamp();
+	if (now < msg->ping_ts || msg->send_ts < msg->recv_ts)
+		return;
+	int64_t rtt_ns = (int64_t)(now - msg->ping_ts) - (int64_t)(msg->send_ts - msg->recv_ts);
+	float sample   = rtt_ns > 0 ? rtt_ns / 1e6f : 0.0f;
+	pthread_rwlock_wrlock(&ctx->part_rwlock);
+	struct SParticipant *part = &ctx->participants[part_index];
+	sclocks_exchange(&ctx->clocks, part->id, msg->ping_ts, msg->recv_ts, msg->send_ts, now);
+	if (part->rtt_ms < 0.0f)
+		part->rtt_ms = sample;
+	else
+		part->rtt_ms += SELECON_RTT_SMOOTHING * (sample - part->rtt_ms);
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+}
+
+// ctx->part_rwlock must be in writer locked state. Does nothing if subscription is not changed
+static void subscribe_video_locked(struct SContext *ctx,
+                                   size_t index,
+                                   enum SVideoSubscription state,
+                                   int layer) {
+	struct SParticipant *part = &ctx->participants[index];
+	// relay forwards video to its group as it arrives, there is no per-receiver forwarding yet.
+	// What relay subscribes to is what whole group gets, so it takes full top layer from everybody
+	if (ctx->self.role == SROLE_RELAY) {
+		state = SVIDEO_SUB_FULL;
+		layer = 0;
+	}
+	if ((part->video_in == state && part->video_in_layer == layer) || part->connection == NULL)
+		return;
+	struct SMessage *msg = message_video_subscription_alloc(ctx->self.id, state, layer);
+	enum SError err      = sconn_send(part->connection, msg);
+	message_free(&msg);
+	if (err != SELECON_OK)
+		fprintf(stderr, "failed to send video subscription: err = %s\n", serror_str(err));
+	else {
+		part->video_in       = state;
+		part->video_in_layer = layer;
+	}
+}
+
+// ctx->part_rwlock must be in writer locked state. Participant who just became relay drops its own
+// reduced subscriptions at once, they would starve its group until next last N update
+static void subscribe_relayed_video_locked(struct SContext *ctx) {
+	if (ctx->self.role != SROLE_RELAY)
+		return;
+	for (size_t i = 0; i < ctx->nb_participants - 1; ++i)
+		subscribe_video_locked(ctx, i, SVIDEO_SUB_FULL, 0);
+}
+
+// ctx->part_rwlock must be in writer locked state. Roles of organisers are kept, they plan and
+// never relay
+static void apply_topology_locked(struct SContext *ctx, const struct SMsgTopology *msg) {
+	ctx->topology = msg->topology;
+	for (uint32_t i = 0; i < msg->nb_entries; ++i) {
+		const struct STopologyEntry *entry = &msg->entries[i];
+		struct SParticipant *part          = &ctx->self;
+		if (entry->part_id != ctx->self.id) {
+			size_t index = find_participant_locked(ctx, entry->part_id);
+			if (index == ctx->nb_participants - 1)
+				continue;
+			part = &ctx->participants[index];
+		}
+		if (part->role != SROLE_ORGANISATOR)
+			part->role = entry->relay ? SROLE_RELAY : SROLE_LISTENER;
+		part->relay_id = entry->relay_id;
+	}
+	subscribe_relayed_video_locked(ctx);
+}
+
+static void handle_topology_message(struct SContext *ctx,
+                                    size_t part_index,
+                                    struct SMsgTopology *msg) {
+	if (msg->base.size < sizeof(struct SMsgTopology) ||
+	    (msg->base.size - sizeof(struct SMsgTopology)) / sizeof(struct STopologyEntry) <
+	        msg->nb_entries) {
+		fprintf(stderr, "invalid topology message\n");
+		return;
+	}
+	pthread_rwlock_wrlock(&ctx->part_rwlock);
+	if (ctx->participants[part_index].role != SROLE_ORGANISATOR)
+		fprintf(stderr, "prevented topology message from participant other than organiser\n");
+	else {
+		apply_topology_locked(ctx, msg);
+		fprintf(stderr,
+		        "conference topology: %s, media goes through %llu\n",
+		        stopology_str(ctx->topology),
+		        ctx->self.relay_id);
+	}
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+}
+
+// new media key comes from organiser, or in webinar from our tree parent, as listener may have no
+// connection to organiser. It is passed on down distribution tree
+static void handle_media_key_message(struct SContext *ctx,
+                                     size_t part_index,
+                                     struct SMsgMediaKey *msg) {
+	pthread_rwlock_rdlock(&ctx->part_rwlock);
+	const struct SParticipant *from = &ctx->participants[part_index];
+	bool parent = ctx->webinar && ctx->self.parent_id != 0 && from->id == ctx->self.parent_id;
+	if (from->role != SROLE_ORGANISATOR && !parent)
+		fprintf(stderr, "prevented media key message from participant other than organiser\n");
+	else if (smcrypt_install(&ctx->crypto, &msg->key, get_curr_timestamp()) && ctx->webinar) {
+		for (size_t i = 0; i < ctx->nb_participants - 1; ++i)
+			if (i != part_index && ctx->participants[i].parent_id == ctx->self.id &&
+			    ctx->participants[i].connection != NULL)
+				sconn_send(ctx->participants[i].connection, &msg->base);
+	}
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+	explicit_bzero(&msg->key, sizeof(msg->key));
+}
+
+// own video gets keyframe on request. Relays and webinar feeders pass request for video of other
+// participant on to its author, never back to requester
+static void handle_keyframe_request_message(struct SContext *ctx,
+                                            size_t part_index,
+                                            struct SMsgKeyframeRequest *msg) {
+	if (msg->part_id == ctx->self.id)
+		return scont_request_keyframe(&ctx->streams, NULL);
+	pthread_rwlock_rdlock(&ctx->part_rwlock);
+	size_t index = find_participant_locked(ctx, msg->part_id);
+	if (index < ctx->nb_participants - 1 && index != part_index &&
+	    ctx->participants[index].connection != NULL)
+		sconn_send(ctx->participants[index].connection, &msg->base);
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+}
+
+// report of receiver on own media goes to congestion control of output streams. Reports are not
+// passed on: relay sends media as it came, so its report covers only its own link to author
+static void handle_receiver_report_message(struct SContext *ctx,
+                                           size_t part_index,
+                                           struct SMsgReceiverReport *msg) {
+	if (msg->part_id != ctx->self.id)
+		return;
+	pthread_rwlock_rdlock(&ctx->part_rwlock);
+	part_id_t receiver = ctx->participants[part_index].id;
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+	scont_rate_report(
+	    &ctx->streams, msg->video ? SSTREAM_VIDEO : SSTREAM_AUDIO, receiver, &msg->report);
 }
 
 static void handle_part_leave(struct SContext *ctx, size_t part_index, struct SMsgLeave *msg) {
@@ -233,45 +847,184 @@ static void handle_part_leave(struct SContext *ctx, size_t part_index, struct SM
 
 // general message handler routine
 static void handle_message(struct SContext *ctx, size_t part_index, struct SMessage *msg) {
+	if (!message_size_valid(msg)) {
+		fprintf(stderr, "message of type %d is too short: %zu bytes\n", msg->type, msg->size);
+		return;
+	}
 	switch (msg->type) {
 		case SMSG_PART_PRESENCE:
 			return handle_part_presence_message(ctx, part_index, (struct SMsgPartPresence *)msg);
+		case SMSG_PART_INFO:
+			return handle_part_info_message(ctx, part_index, (struct SMsgPartInfo *)msg);
 		case SMSG_LEAVE: return handle_part_leave(ctx, part_index, (struct SMsgLeave *)msg);
 		case SMSG_TEXT: return handle_text_message(ctx, (struct SMsgText *)msg);
-		case SMSG_AUDIO: return handle_audio_packet_message(ctx, (struct SMsgAudio *)msg);
-		case SMSG_VIDEO: return handle_video_packet_message(ctx, (struct SMsgVideo *)msg);
+		case SMSG_AUDIO:
+			return handle_audio_packet_message(ctx, part_index, (struct SMsgAudio *)msg);
+		case SMSG_AUDIO_SILENCE:
+			return handle_audio_silence_message(
+			    ctx, part_index, (struct SMsgAudioSilence *)msg);
+		case SMSG_VIDEO:
+			return handle_video_packet_message(ctx, part_index, (struct SMsgVideo *)msg);
+		case SMSG_VIDEO_SUBSCRIPTION:
+			return handle_video_subscription_message(
+			    ctx, part_index, (struct SMsgVideoSubscription *)msg);
+		case SMSG_PING: return handle_ping_message(ctx, part_index, (struct SMsgPing *)msg);
+		case SMSG_PONG: return handle_pong_message(ctx, part_index, (struct SMsgPong *)msg);
+		case SMSG_TOPOLOGY:
+			return handle_topology_message(ctx, part_index, (struct SMsgTopology *)msg);
+		case SMSG_MEDIA_KEY:
+			return handle_media_key_message(ctx, part_index, (struct SMsgMediaKey *)msg);
+		case SMSG_KEYFRAME_REQUEST:
+			return handle_keyframe_request_message(
+			    ctx, part_index, (struct SMsgKeyframeRequest *)msg);
+		case SMSG_RECEIVER_REPORT:
+			return handle_receiver_report_message(
+			    ctx, part_index, (struct SMsgReceiverReport *)msg);
 		default: printf("unknown message type received: %d\n", msg->type);
 	}
 }
 
+// decoded frame of remote participant. Also goes to mixer or compositor when they are enabled
+static void input_media_handler(void *ctx_raw,
+                                part_id_t part_id,
+                                enum AVMediaType mtype,
+                                struct AVFrame *frame) {
+	struct SContext *ctx = ctx_raw;
+	if (mtype == AVMEDIA_TYPE_AUDIO && smixer_running(&ctx->mixer))
+		smixer_push(&ctx->mixer, part_id, frame);
+	else if (mtype == AVMEDIA_TYPE_VIDEO && scomp_running(&ctx->compositor))
+		scomp_push(&ctx->compositor, part_id, frame);
+	if (ctx->media_handler != NULL)
+		ctx->media_handler(ctx, part_id, mtype, frame);
+}
+
+// true if video packet of given simulcast layer goes to participant. Reduced subscribers get lowest
+// layer. Switch to other layer waits for its keyframe, old layer is sent until then, so decoder of
+// receiver never starts in the middle of GOP. Keyframe is requested from stream meanwhile, so
+// joining or switching receiver does not wait for next GOP. Sent layer is kept by stream itself,
+// participant is only read here. Called by video output worker with ctx->part_rwlock read locked
+static bool forward_video_layer(const struct SParticipant *part,
+                                struct SStream *stream,
+                                int layer,
+                                const struct AVPacket *packet) {
+	if (part->video_out == SVIDEO_SUB_PAUSED)
+		return false;
+	int nb_layers = stream->nb_layers;
+	int wanted = part->video_out == SVIDEO_SUB_REDUCED ? nb_layers - 1 : part->video_out_layer;
+	if (wanted >= nb_layers)
+		wanted = nb_layers - 1;
+	int sent = sstream_sent_layer(
+	    stream, part->id, part->video_epoch, wanted, layer, packet->flags & AV_PKT_FLAG_KEY);
+	if (sent != wanted && part->connection != NULL)
+		sstream_request_keyframe(stream);
+	return layer == sent;
+}
+
+// ctx->part_rwlock must be locked. Returns index of relay media goes through or nb_participants - 1
+// when media is sent directly: there is no relay, it is disconnected or we are relay. Relay planned
+// by organiser is preferred, otherwise first one
+static size_t find_relay_locked(struct SContext *ctx) {
+	size_t index = ctx->nb_participants - 1;
+	if (ctx->self.role == SROLE_RELAY)
+		return index;
+	for (size_t i = 0; i < ctx->nb_participants - 1; ++i) {
+		const struct SParticipant *part = &ctx->participants[i];
+		if (part->role != SROLE_RELAY || part->connection == NULL)
+			continue;
+		if (part->id == ctx->self.relay_id)
+			return i;
+		if (index == ctx->nb_participants - 1)
+			index = i;
+	}
+	return index;
+}
+
+// emulated uplink holds output worker for as long as bytes it sent take at limited rate, so next
+// packets queue behind them like on bottleneck link
+static void emulate_send_limit(struct SContext *ctx, size_t bytes) {
+	pthread_mutex_lock(&ctx->link_mutex);
+	uint32_t limit  = ctx->send_limit_kbps;
+	timestamp_t now = get_curr_timestamp();
+	if (limit != 0) {
+		if (ctx->link_free_ts < now)
+			ctx->link_free_ts = now;
+		ctx->link_free_ts += bytes * 8 * 1000000ULL / limit;
+	}
+	timestamp_t free_ts = ctx->link_free_ts;
+	pthread_mutex_unlock(&ctx->link_mutex);
+	if (limit != 0 && free_ts > now)
+		usleep((free_ts - now) / 1000);
+}
+
 // received packet from self output stream
 static void packet_handler(void *ctx_raw, struct SStream *stream, struct AVPacket *packet) {
 	struct SContext *ctx = ctx_raw;
+	if (ctx->webinar && !srole_is_presenter(ctx->self.role))
+		return;  // webinar listeners only receive
 	// send packet to all other participants in conference
 	struct SMessage *msg = NULL;
 	switch (stream->type) {
-		case SSTREAM_AUDIO: msg = message_audio_alloc(ctx->self.id, packet); break;
-		case SSTREAM_VIDEO: msg = message_video_alloc(ctx->self.id, packet); break;
+		case SSTREAM_AUDIO:
+			// empty packet is emitted by output worker for audio suppressed by DTX
+			if (packet->size == 0)
+				msg = message_audio_silence_alloc(ctx->self.id, packet->pts, packet->duration);
+			else
+				msg = message_audio_alloc(ctx->self.id, stream->vad.level, packet);
+			break;
+		case SSTREAM_VIDEO:
+			// receivers would drop connection on it
+			if (av_packet_serialize(NULL, packet) > SELECON_MAX_ENCODED_FRAME) {
+				fprintf(stderr, "dropped video packet of %d bytes\n", packet->size);
+				return;
+			}
+			msg = message_video_alloc(
+			    ctx->self.id, packet->stream_index, stream->temporal_id, packet);
+			break;
 		default: fprintf(stderr, "unrecognized stream type: %d\n", stream->type); break;
 	}
+	enum SError seal_err = msg == NULL ? SELECON_OK : seal_media_message(ctx, msg);
+	if (seal_err != SELECON_OK) {
+		fprintf(stderr, "failed to seal media message: err = %s\n", serror_str(seal_err));
+		message_free(&msg);
+		return;
+	}
+	size_t nb_sent = 0;
 	pthread_rwlock_rdlock(&ctx->part_rwlock);
-	for (int i = 0; i < ctx->nb_participants - 1; ++i) {
-		enum SError err = sconn_send(ctx->participants[i].connection, msg);
+	size_t relay = find_relay_locked(ctx);
+	for (size_t i = 0; i < ctx->nb_participants - 1; ++i) {
+		if (relay < ctx->nb_participants - 1 && i != relay)
+			continue;
+		if (ctx->self.role == SROLE_RELAY && !relay_target_locked(ctx, i))
+			continue;
+		// webinar presenters send to each other and to listeners they feed
+		if (ctx->webinar && !srole_is_presenter(ctx->participants[i].role) &&
+		    ctx->participants[i].parent_id != ctx->self.id)
+			continue;
+		if (stream->type == SSTREAM_VIDEO &&
+		    !forward_video_layer(&ctx->participants[i], stream, packet->stream_index, packet))
+			continue;
+		enum SError err = send_media(ctx->participants[i].connection, msg);
 		if (err != SELECON_OK)
 			fprintf(
 			    stderr, "failed to send media message to participant: err = %s\n", serror_str(err));
+		else
+			++nb_sent;
 	}
 	pthread_rwlock_unlock(&ctx->part_rwlock);
+	if (nb_sent > 0)
+		emulate_send_limit(ctx, nb_sent * msg->size);
 	message_free(&msg);
 }
 
 static void handle_part_disconnected(struct SContext *ctx, size_t index) {
 	printf("participant %zu lost connection!\n", index);
-	pthread_rwlock_rdlock(&ctx->part_rwlock);
+	pthread_rwlock_wrlock(&ctx->part_rwlock);
 	// mark participant as hangup, but keep track of him
 	spart_hangup(&ctx->participants[index]);
 	// reset all streams assosiated with disconnected participant
 	scont_close_streams(&ctx->streams, ctx->participants[index].id);
+	ctx->topology_dirty = true;
+	place_orphans_locked(ctx, ctx->participants[index].id);
 	pthread_rwlock_unlock(&ctx->part_rwlock);
 }
 
@@ -279,14 +1032,10 @@ static void check_timedout_participants(struct SContext *ctx) {
 	pthread_rwlock_wrlock(&ctx->part_rwlock);
 	for (size_t index = 0; index < ctx->nb_participants - 1; ++index) {
 		if (spart_hangup_timedout(&ctx->participants[index])) {
-			// need to forget about this participant
+			// need to forget about this participant, media key rotates as if it left
 			fprintf(
 			    stderr, "timedout hangup participant with id %llu\n", ctx->participants[index].id);
-			// remove_participant(ctx, index);
-			spart_destroy(&ctx->participants[index]);
-			for (size_t i = index + 1; i < ctx->nb_participants - 1; ++i)
-				ctx->participants[i - 1] = ctx->participants[i];
-			ctx->nb_participants--;
+			remove_participant_locked(ctx, index);
 			--index;
 		}
 	}
@@ -296,6 +1045,170 @@ static void check_timedout_participants(struct SContext *ctx) {
 	}
 }
 
+// last N policy: video of N most recent speakers is received, others are paused. Free slots are
+// given to participants in join order, so N videos are shown before anybody speaks
+static void update_video_subscriptions(struct SContext *ctx) {
+	size_t last_n = ctx->video_last_n;
+	if (last_n == 0)
+		return;
+	part_id_t *recent = calloc(last_n, sizeof(part_id_t));
+	if (recent == NULL)
+		return;
+	size_t nb_recent = sspeak_recent(&ctx->speakers, recent, last_n);
+	pthread_rwlock_wrlock(&ctx->part_rwlock);
+	size_t nb_free = last_n - nb_recent;
+	for (size_t i = 0; i < ctx->nb_participants - 1; ++i) {
+		bool wanted = false;
+		for (size_t j = 0; j < nb_recent && !wanted; ++j)
+			wanted = recent[j] == ctx->participants[i].id;
+		if (!wanted && nb_free > 0) {  // all speakers fit into recent, so this one never spoke
+			wanted = true;
+			--nb_free;
+		}
+		subscribe_video_locked(ctx,
+		                       i,
+		                       wanted ? SVIDEO_SUB_FULL : ctx->video_rest,
+		                       ctx->participants[i].video_in_layer);
+	}
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+	free(recent);
+}
+
+// organiser replaces media key when somebody joins, leaves, times out or reenters, so participant
+// who left can not open media sent after that. Everybody seals with new key
+// SELECON_MEDIA_KEY_SWITCH_DELAY later, by then key reaches them all. Nobody else rotates: after
+// organiser leaves, conference keeps its last key whoever comes and goes
+static void rotate_media_key(struct SContext *ctx) {
+	ctx->rekey = false;
+	if (ctx->self.role != SROLE_ORGANISATOR)
+		return;
+	struct SMediaKey key;
+	struct SMessage *msg = NULL;
+	if (smcrypt_generate(&ctx->crypto, &key) != SELECON_OK ||
+	    (msg = message_media_key_alloc(&key)) == NULL) {
+		fprintf(stderr, "failed to rotate media key\n");
+		return;
+	}
+	pthread_rwlock_rdlock(&ctx->part_rwlock);
+	for (size_t i = 0; i < ctx->nb_participants - 1; ++i)
+		if (ctx->participants[i].connection != NULL)
+			sconn_send(ctx->participants[i].connection, msg);
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+	smcrypt_install(&ctx->crypto, &key, get_curr_timestamp());
+	explicit_bzero(&key, sizeof(key));
+	explicit_bzero(msg, msg->size);
+	message_free(&msg);
+}
+
+static void send_pings(struct SContext *ctx) {
+	struct SMessage *msg = message_ping_alloc(get_curr_timestamp());
+	pthread_rwlock_rdlock(&ctx->part_rwlock);
+	for (size_t i = 0; i < ctx->nb_participants - 1; ++i)
+		if (ctx->participants[i].connection != NULL)
+			sconn_send(ctx->participants[i].connection, msg);
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+	message_free(&msg);
+}
+
+// closes report interval of every input stream. Reports go to authors connected directly, media
+// of others is measured only to keep intervals short
+static void send_receiver_reports(struct SContext *ctx) {
+	static const enum SStreamType types[] = {SSTREAM_AUDIO, SSTREAM_VIDEO};
+	pthread_rwlock_rdlock(&ctx->part_rwlock);
+	for (size_t i = 0; i < ctx->nb_participants - 1; ++i) {
+		const struct SParticipant *part = &ctx->participants[i];
+		for (size_t t = 0; t < 2; ++t) {
+			sstream_id_t stream =
+			    scont_find_stream(&ctx->streams, part->id, types[t], SSTREAM_INPUT);
+			struct SReceiverReport report;
+			if (stream == NULL || !scont_receiver_report(&ctx->streams, stream, &report) ||
+			    part->connection == NULL)
+				continue;
+			struct SMessage *msg =
+			    message_receiver_report_alloc(part->id, types[t] == SSTREAM_VIDEO, &report);
+			sconn_send(part->connection, msg);
+			message_free(&msg);
+		}
+	}
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+}
+
+// part of CPU time left idle by this process since previous call, in percent of all cores
+static uint8_t measure_cpu_headroom(struct SContext *ctx) {
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	int64_t cpu_ns   = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	timestamp_t now  = get_curr_timestamp();
+	uint8_t headroom = ctx->self.capacity.cpu_headroom;
+	if (ctx->cpu_probe_ts != 0 && now > ctx->cpu_probe_ts) {
+		long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		double busy  = (double)(cpu_ns - ctx->cpu_probe_ns) / (now - ctx->cpu_probe_ts);
+		busy /= nb_cpus > 0 ? nb_cpus : 1;
+		headroom = busy >= 1.0 ? 0 : (uint8_t)((1.0 - busy) * 100);
+	}
+	ctx->cpu_probe_ns = cpu_ns;
+	ctx->cpu_probe_ts = now;
+	return headroom;
+}
+
+// tells everybody uplink, worst RTT to peers and CPU headroom of self
+static void announce_capacity(struct SContext *ctx) {
+	uint8_t headroom = measure_cpu_headroom(ctx);
+	pthread_rwlock_wrlock(&ctx->part_rwlock);
+	float rtt_ms = 0.0f;
+	for (size_t i = 0; i < ctx->nb_participants - 1; ++i)
+		if (ctx->participants[i].rtt_ms > rtt_ms)
+			rtt_ms = ctx->participants[i].rtt_ms;
+	ctx->self.capacity.rtt_ms       = (uint32_t)(rtt_ms + 0.5f);
+	ctx->self.capacity.cpu_headroom = headroom;
+	struct SMessage *msg =
+	    message_part_info_alloc(ctx->self.id, ctx->self.role, &ctx->self.capacity, ctx->self.name);
+	for (size_t i = 0; i < ctx->nb_participants - 1; ++i)
+		if (ctx->participants[i].connection != NULL)
+			sconn_send(ctx->participants[i].connection, msg);
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+	message_free(&msg);
+}
+
+// organiser chooses topology from announced capacities and tells everybody when it changes.
+// Disconnected participants and organiser itself are not chosen as relays
+static void plan_topology(struct SContext *ctx) {
+	ctx->topology_dirty = false;
+	if (!ctx->auto_topology || ctx->webinar || ctx->self.role != SROLE_ORGANISATOR)
+		return;
+	pthread_rwlock_wrlock(&ctx->part_rwlock);
+	size_t count                = ctx->nb_participants;
+	struct STopologyNode *nodes = calloc(count, sizeof(struct STopologyNode));
+	if (nodes == NULL) {
+		pthread_rwlock_unlock(&ctx->part_rwlock);
+		return;
+	}
+	for (size_t i = 0; i < count - 1; ++i) {
+		nodes[i].part_id   = ctx->participants[i].id;
+		nodes[i].capacity  = ctx->participants[i].capacity;
+		nodes[i].can_relay = ctx->participants[i].connection != NULL;
+	}
+	nodes[count - 1].part_id  = ctx->self.id;
+	nodes[count - 1].capacity = ctx->self.capacity;
+	enum STopology topology   = stopology_plan(nodes, count, SELECON_TOPOLOGY_MEDIA_KBPS);
+	// broadcast only changed plan
+	bool changed = topology != ctx->topology || nodes[count - 1].relay_id != ctx->self.relay_id;
+	for (size_t i = 0; i < count - 1 && !changed; ++i)
+		changed = nodes[i].relay != (ctx->participants[i].role == SROLE_RELAY) ||
+		          nodes[i].relay_id != ctx->participants[i].relay_id;
+	if (changed) {
+		struct SMessage *msg = message_topology_alloc(topology, nodes, count);
+		apply_topology_locked(ctx, (struct SMsgTopology *)msg);
+		for (size_t i = 0; i < count - 1; ++i)
+			if (ctx->participants[i].connection != NULL)
+				sconn_send(ctx->participants[i].connection, msg);
+		message_free(&msg);
+		fprintf(stderr, "conference topology: %s\n", stopology_str(topology));
+	}
+	pthread_rwlock_unlock(&ctx->part_rwlock);
+	free(nodes);
+}
+
 static void *conf_worker(void *arg) {
 	struct SContext *ctx     = arg;
 	ctx->conf_thread_working = true;
@@ -304,10 +1217,16 @@ static void *conf_worker(void *arg) {
 	struct SConnection **cons = calloc(cons_count, sizeof(struct SConnection *));
 	for (size_t i = 0; i < cons_count; ++i) cons[i] = ctx->participants[i].connection;
 	pthread_rwlock_unlock(&ctx->part_rwlock);
-	struct SMessage *msg = NULL;
-	size_t index         = 0;
-	enum SError err      = SELECON_OK;
-	size_t hangup_count  = 0;
+	struct SMessage *msg      = NULL;
+	size_t index              = 0;
+	enum SError err           = SELECON_OK;
+	size_t hangup_count       = 0;
+	timestamp_t idle_check_ts = get_curr_timestamp();
+	timestamp_t last_n_ts     = 0;
+	timestamp_t ping_ts       = 0;
+	timestamp_t capacity_ts   = 0;
+	timestamp_t report_ts     = get_curr_timestamp();
+	timestamp_t topology_ts   = get_curr_timestamp();
 	while (ctx->initialized && ctx->nb_participants > 1 &&
 	       (err == SELECON_OK || err == SELECON_CON_TIMEOUT || err == SELECON_CON_HANGUP)) {
 		if (cons_count != ctx->nb_participants - 1 || err == SELECON_CON_HANGUP) {
@@ -329,6 +1248,34 @@ static void *conf_worker(void *arg) {
 			handle_message(ctx, index, msg);
 		if (hangup_count > 0)
 			check_timedout_participants(ctx);
+		// reclaim decoders of participants who stopped sending media
+		if (get_curr_timestamp() - idle_check_ts > 1000000000ULL) {
+			scont_close_idle_streams(&ctx->streams, SELECON_INPUT_STREAM_IDLE_TIMEOUT);
+			idle_check_ts = get_curr_timestamp();
+		}
+		if (get_curr_timestamp() - last_n_ts > SELECON_VIDEO_LAST_N_INTERVAL * 1000000ULL) {
+			update_video_subscriptions(ctx);
+			last_n_ts = get_curr_timestamp();
+		}
+		if (get_curr_timestamp() - ping_ts > SELECON_PING_INTERVAL * 1000000ULL) {
+			send_pings(ctx);
+			ping_ts = get_curr_timestamp();
+		}
+		if (get_curr_timestamp() - capacity_ts > SELECON_CAPACITY_INTERVAL * 1000000ULL) {
+			announce_capacity(ctx);
+			capacity_ts = get_curr_timestamp();
+		}
+		if (get_curr_timestamp() - report_ts > SELECON_REPORT_INTERVAL * 1000000ULL) {
+			send_receiver_reports(ctx);
+			report_ts = get_curr_timestamp();
+		}
+		if (ctx->topology_dirty ||
+		    get_curr_timestamp() - topology_ts > SELECON_TOPOLOGY_INTERVAL * 1000000ULL) {
+			plan_topology(ctx);
+			topology_ts = get_curr_timestamp();
+		}
+		if (ctx->rekey)
+			rotate_media_key(ctx);
 	}
 	message_free(&msg);
 	free(cons);
@@ -338,8 +1285,14 @@ static void *conf_worker(void *arg) {
 static enum SError handle_invite(struct SContext *ctx,
                                  struct SConnection *con,
                                  struct SMsgInvite *invite) {
-	bool accepted   = false;
-	enum SError err = do_handshake_srv(ctx, con, invite, &accepted);
+	if (!peer_role_valid(
+	        invite->conf_id, invite->conf_start_ts, invite->part_id, invite->part_role)) {
+		fprintf(stderr, "invalid role %d of inviter %llu\n", invite->part_role, invite->part_id);
+		return SELECON_INVITE_INVALID;
+	}
+	bool accepted                = false;
+	struct SMediaProfile profile = {0};
+	enum SError err              = do_handshake_srv(ctx, con, invite, &accepted, &profile);
 	if (err != SELECON_OK)
 		return err;
 	if (!accepted)
@@ -348,29 +1301,13 @@ static enum SError handle_invite(struct SContext *ctx,
 		selecon_leave_conference(ctx);  // leave old conference
 		ctx->conf_id       = invite->conf_id;
 		ctx->conf_start_ts = invite->conf_start_ts;
-		ctx->self.role     = SROLE_LISTENER;
-	}
-	sstream_id_t audio_stream = NULL;
-	sstream_id_t video_stream = NULL;
-
-	err = scont_alloc_stream(&ctx->streams,
-	                         invite->part_id,
-	                         ctx->conf_start_ts,
-	                         SSTREAM_AUDIO,
-	                         SSTREAM_INPUT,
-	                         &audio_stream);
-	if (err != SELECON_OK)
-		return err;
-	err = scont_alloc_stream(&ctx->streams,
-	                         invite->part_id,
-	                         ctx->conf_start_ts,
-	                         SSTREAM_VIDEO,
-	                         SSTREAM_INPUT,
-	                         &video_stream);
-	if (err != SELECON_OK) {
-		scont_close_stream(&ctx->streams, &audio_stream);
-		return err;
+		ctx->webinar       = invite->webinar;
+		smcrypt_import(&ctx->crypto, invite->media_keys);
+		if (!role_sticky(ctx->self.role))
+			ctx->self.role = SROLE_LISTENER;
+		scont_set_profile(&ctx->streams, &profile);
 	}
+	// input streams are created when participant starts sending media
 	pthread_rwlock_wrlock(&ctx->part_rwlock);
 	add_participant(
 	    ctx, invite->part_id, invite->part_name, invite->part_role, &invite->listen_ep, con);
@@ -403,25 +1340,10 @@ static enum SError handle_reenter(struct SContext *ctx,
 		fprintf(stderr, "participant hijack attempt is forbidden\n");
 		err = SELECON_CON_ERROR;
 	} else {
-		// recreate media streams for participant
-		sstream_id_t audio_stream = NULL;
-		sstream_id_t video_stream = NULL;
-
-		err = scont_alloc_stream(&ctx->streams,
-		                         reenter->part_id,
-		                         ctx->conf_start_ts,
-		                         SSTREAM_AUDIO,
-		                         SSTREAM_INPUT,
-		                         &audio_stream);
-		assert(err == SELECON_OK);
-		err = scont_alloc_stream(&ctx->streams,
-		                         reenter->part_id,
-		                         ctx->conf_start_ts,
-		                         SSTREAM_VIDEO,
-		                         SSTREAM_INPUT,
-		                         &video_stream);
-		assert(err == SELECON_OK);
+		// media streams are recreated with first packets after reconnect. Key rotated while it
+		// was away comes with next rotation
 		fprintf(stderr, "participant %zu reconnected!\n", index);
+		ctx->rekey = true;
 	}
 	pthread_rwlock_unlock(&ctx->part_rwlock);
 	return err;
@@ -437,7 +1359,7 @@ static void *invite_worker(void *arg) {
 		if (err == SELECON_OK) {
 			struct SMessage *msg = NULL;
 			err                  = sconn_recv(con, &msg);
-			if (err != SELECON_OK) {
+			if (err != SELECON_OK || !message_size_valid(msg)) {
 				sconn_disconnect(&con);
 			} else {
 				// check message type
@@ -497,18 +1419,78 @@ enum SError selecon_context_init(struct SContext *ctx,
 	int ret            = pthread_rwlock_init(&ctx->part_rwlock, NULL);
 	if (ret != 0)
 		return SELECON_PTHREAD_ERROR;
-	ctx->nb_participants     = 1;
-	ctx->participants        = NULL;
-	ctx->self                = spart_init(SELECON_DEFAULT_PART_NAME, SROLE_ORGANISATOR);
-	ctx->listen_ep           = *ep;
-	ctx->invite_handler      = invite_handler == NULL ? selecon_accept_any : invite_handler;
-	ctx->text_handler        = text_handler;
-	ctx->initialized         = true;
-	ctx->conf_thread_working = false;
-	ctx->conf_id             = generate_conf_id(ctx->self.id, ctx->conf_start_ts);
+	if (pthread_mutex_init(&ctx->link_mutex, NULL) != 0) {
+		pthread_rwlock_destroy(&ctx->part_rwlock);
+		return SELECON_PTHREAD_ERROR;
+	}
+	ctx->nb_participants       = 1;
+	ctx->participants          = NULL;
+	ctx->self                  = spart_init(SELECON_DEFAULT_PART_NAME, SROLE_ORGANISATOR);
+	ctx->listen_ep             = *ep;
+	ctx->invite_handler        = invite_handler == NULL ? selecon_accept_any : invite_handler;
+	ctx->text_handler          = text_handler;
+	ctx->media_handler         = media_handler;
+	ctx->speaker_handler       = NULL;
+	ctx->audio_top_k           = SELECON_DEFAULT_AUDIO_TOP_K;
+	ctx->video_last_n          = SELECON_DEFAULT_VIDEO_LAST_N;
+	ctx->video_rest            = SVIDEO_SUB_PAUSED;
+	ctx->video_temporal_layers = SELECON_MAX_TEMPORAL_LAYERS;
+	ctx->cpu_probe_ns          = 0;
+	ctx->cpu_probe_ts          = 0;
+	ctx->webinar               = false;
+	ctx->auto_topology         = false;
+	ctx->topology_dirty        = false;
+	ctx->topology              = STOPOLOGY_MESH;
+	ctx->rekey                 = false;
+	ctx->send_limit_kbps       = 0;
+	ctx->link_free_ts          = 0;
+	ctx->initialized           = true;
+	ctx->conf_thread_working   = false;
+	ctx->conf_id               = generate_conf_id(ctx->self.id, ctx->conf_start_ts);
+	media_caps_default(&ctx->caps);
+	enum SError err = smixer_init(&ctx->mixer,
+	                              SELECON_DEFAULT_AUDIO_SAMPLE_RATE,
+	                              SELECON_DEFAULT_AUDIO_CHANNELS,
+	                              SELECON_DEFAULT_AUDIO_SAMPLE_RATE * SELECON_MIXER_TICK / 1000);
+	struct SCompositorLayout layout = {
+	    {SELECON_DEFAULT_COMPOSITE_WIDTH,
+	     SELECON_DEFAULT_COMPOSITE_HEIGHT,
+	     SELECON_DEFAULT_COMPOSITE_FPS},
+	    0,
+	};
+	if (err == SELECON_OK && (err = scomp_init(&ctx->compositor, &layout)) != SELECON_OK)
+		smixer_free(&ctx->mixer);
+	if (err == SELECON_OK && (err = sspeak_init(&ctx->speakers)) != SELECON_OK) {
+		smixer_free(&ctx->mixer);
+		scomp_free(&ctx->compositor);
+	}
+	if (err == SELECON_OK && (err = sclocks_init(&ctx->clocks)) != SELECON_OK) {
+		smixer_free(&ctx->mixer);
+		scomp_free(&ctx->compositor);
+		sspeak_free(&ctx->speakers);
+	}
+	if (err == SELECON_OK && (err = smcrypt_init(&ctx->crypto)) != SELECON_OK) {
+		smixer_free(&ctx->mixer);
+		scomp_free(&ctx->compositor);
+		sspeak_free(&ctx->speakers);
+		sclocks_free(&ctx->clocks);
+	}
+	if (err != SELECON_OK) {
+		spart_destroy(&ctx->self);
+		pthread_rwlock_destroy(&ctx->part_rwlock);
+		pthread_mutex_destroy(&ctx->link_mutex);
+		ctx->initialized = false;
+		return err;
+	}
 	if (pthread_create(&ctx->listener_thread, NULL, invite_worker, ctx) != 0) {
+		smixer_free(&ctx->mixer);
+		scomp_free(&ctx->compositor);
+		sspeak_free(&ctx->speakers);
+		sclocks_free(&ctx->clocks);
+		smcrypt_free(&ctx->crypto);
 		spart_destroy(&ctx->self);
 		pthread_rwlock_destroy(&ctx->part_rwlock);
+		pthread_mutex_destroy(&ctx->link_mutex);
 		ctx->initialized = false;
 		return SELECON_PTHREAD_ERROR;
 	}
@@ -518,7 +1500,7 @@ enum SError selecon_context_init(struct SContext *ctx,
 	selecon_endpoint_dump(stdout, ep);
 	printf("]\n");
 #endif
-	scont_init(&ctx->streams, media_handler, packet_handler, ctx);
+	scont_init(&ctx->streams, input_media_handler, packet_handler, ctx);
 	return SELECON_OK;
 }
 
@@ -568,6 +1550,11 @@ void selecon_context_dump(FILE *fd, struct SContext *context) {
 	fprintf(fd, "\n");
 	pthread_rwlock_rdlock(&context->part_rwlock);
 	fprintf(fd, "nb_participants: %zu\n", context->nb_participants);
+	fprintf(fd,
+	        "topology: %s%s\n",
+	        stopology_str(context->topology),
+	        context->auto_topology ? " (auto)" : "");
+	fprintf(fd, "media key: %u\n", context->crypto.send_id);
 	fprintf(fd, "  - ");
 	spart_dump(fd, &context->self);
 	fprintf(fd, " (self)\n");
@@ -576,6 +1563,11 @@ void selecon_context_dump(FILE *fd, struct SContext *context) {
 		spart_dump(fd, &context->participants[i]);
 		fprintf(fd, "\n");
 	}
+	struct SMediaProfile profile;
+	scont_get_profile(&context->streams, &profile);
+	fprintf(fd, "media profile: ");
+	media_profile_dump(fd, &profile);
+	fprintf(fd, "\n");
 	scont_dump(fd, &context->streams);
 	pthread_rwlock_unlock(&context->part_rwlock);
 }
@@ -588,30 +1580,71 @@ bool selecon_reject_any(struct SMsgInvite *invite) {
 	return false;
 }
 
+// feed is set when invitee is webinar listener placed under us in distribution tree
 static enum SError invite_connected(struct SContext *context,
                                     struct SConnection *con,
                                     const struct SEndpoint *ep,
+                                    bool feed,
                                     part_id_t *out_part_id) {
+	// profile can be renegotiated only while there is nobody to talk to
+	struct SMediaCaps offer = context->caps;
+	bool alone              = context->nb_participants == 1;
+	if (!alone) {
+		struct SMediaProfile conf_profile;
+		scont_get_profile(&context->streams, &conf_profile);
+		media_caps_from_profile(&offer, &conf_profile);
+	}
+	struct SMediaKey media_keys[2];
+	smcrypt_export(&context->crypto, media_keys);
 	struct SMessage *inviteMsg         = message_invite_alloc(context->conf_id,
                                                       context->conf_start_ts,
+                                                      context->webinar,
+                                                      media_keys,
                                                       context->self.id,
                                                       context->self.role,
                                                       &context->listen_ep,
+                                                      &offer,
                                                       context->self.name);
 	struct SMsgInviteAccept *acceptMsg = NULL;
 	enum SError err                    = do_handshake_client(con, inviteMsg, &acceptMsg);
+	message_free(&inviteMsg);
 	if (err != SELECON_OK || acceptMsg == NULL)
 		return err;
-	// send other participants info about invitee
+	// make sure invitee has chosen one of offered profiles
+	struct SMediaCaps accepted;
+	struct SMediaProfile profile;
+	media_caps_from_profile(&accepted, &acceptMsg->profile);
+	if (!media_profile_negotiate(&accepted, &offer, &profile)) {
+		fprintf(stderr, "invitee selected profile which was not offered\n");
+		message_free((struct SMessage **)&acceptMsg);
+		return SELECON_INVITE_INVALID;
+	}
+	if (!peer_role_valid(
+	        context->conf_id, context->conf_start_ts, acceptMsg->part_id, acceptMsg->part_role)) {
+		fprintf(stderr, "invitee took invalid role %d\n", acceptMsg->part_role);
+		message_free((struct SMessage **)&acceptMsg);
+		return SELECON_INVITE_INVALID;
+	}
+	if (alone)
+		scont_set_profile(&context->streams, &profile);
+	// send other participants info about invitee. Webinar listeners do not meet anybody, they are
+	// placed in distribution tree instead
+	enum SRole role              = acceptMsg->part_role;
+	bool listener                = context->webinar && !srole_is_presenter(role);
 	struct SMsgPartPresence *msg = message_part_presence_alloc();
 	msg->part_id                 = acceptMsg->part_id;
 	msg->ep                      = acceptMsg->ep;
-	msg->part_role               = SROLE_LISTENER;
+	msg->part_role               = role;
 	msg->state                   = PART_JOIN;
 	pthread_rwlock_wrlock(&context->part_rwlock);
-	for (size_t i = 0; i < context->nb_participants - 1; ++i)
-		sconn_send(context->participants[i].connection, (struct SMessage *)msg);
-	add_participant(context, acceptMsg->part_id, acceptMsg->part_name, SROLE_LISTENER, ep, con);
+	for (size_t i = 0; i < context->nb_participants - 1 && !listener; ++i)
+		if (!context->webinar || srole_is_presenter(context->participants[i].role))
+			sconn_send(context->participants[i].connection, (struct SMessage *)msg);
+	add_participant(context, acceptMsg->part_id, acceptMsg->part_name, role, ep, con);
+	if (listener && feed)
+		adopt_listener_locked(context, context->nb_participants - 2);
+	else if (listener)
+		place_listener_locked(context, context->nb_participants - 2);
 	if (context->nb_participants == 2 && !context->conf_thread_working) {
 		if (pthread_create(&context->conf_thread, NULL, conf_worker, context) != 0)
 			exit(-1);  // TODO: leave conference? kick invited participant? what to do here
@@ -625,42 +1658,26 @@ static enum SError invite_connected(struct SContext *context,
 	return SELECON_OK;
 }
 
-enum SError selecon_invite(struct SContext *context, struct SEndpoint *ep) {
-	if (context == NULL || ep == NULL)
-		return SELECON_INVALID_ARG;
-	if (!context->initialized)
-		return SELECON_EMPTY_CONTEXT;
-	// create input streams for recving content from new participant
-	sstream_id_t audio_stream = NULL;
-	enum SError err           = scont_alloc_stream(
-        &context->streams, -1, context->conf_start_ts, SSTREAM_AUDIO, SSTREAM_INPUT, &audio_stream);
-	if (err != SELECON_OK)
-		return err;
-	sstream_id_t video_stream = NULL;
-	err                       = scont_alloc_stream(
-        &context->streams, -1, context->conf_start_ts, SSTREAM_VIDEO, SSTREAM_INPUT, &video_stream);
-	if (err != SELECON_OK)
-		goto stream_alloc_failed;
+static enum SError invite_endpoint(struct SContext *ctx, struct SEndpoint *ep, bool feed) {
 	struct SConnection *con = NULL;
-	err                     = sconn_connect_secure(&con, ep);
+	enum SError err         = sconn_connect_secure(&con, ep);
 	if (err != SELECON_OK)
-		goto connect_failed;
+		return err;
 	part_id_t part_id = 0;
-	err               = invite_connected(context, con, ep, &part_id);
+	err               = invite_connected(ctx, con, ep, feed, &part_id);
 	if (err != SELECON_OK)
-		goto invite_failed;
-	audio_stream->part_id = part_id;
-	video_stream->part_id = part_id;
-	return SELECON_OK;
-invite_failed:
-	sconn_disconnect(&con);
-connect_failed:
-	scont_close_stream(&context->streams, &video_stream);
-stream_alloc_failed:
-	scont_close_stream(&context->streams, &audio_stream);
+		sconn_disconnect(&con);
 	return err;
 }
 
+enum SError selecon_invite(struct SContext *context, struct SEndpoint *ep) {
+	if (context == NULL || ep == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	return invite_endpoint(context, ep, false);
+}
+
 enum SError selecon_invite2(struct SContext *context, const char *address) {
 	struct SEndpoint ep = {0};
 	enum SError err     = selecon_parse_endpoint2(&ep, address);
@@ -685,6 +1702,7 @@ enum SError selecon_leave_conference(struct SContext *context) {
 		sconn_send(context->participants[i].connection, (struct SMessage *)msg);
 	for (size_t i = 0; i < context->nb_participants - 1; ++i) {
 		scont_close_streams(&context->streams, context->participants[i].id);
+		forget_media_source(context, context->participants[i].id);
 		spart_destroy(&context->participants[i]);
 	}
 	context->nb_participants = 1;
@@ -692,7 +1710,72 @@ enum SError selecon_leave_conference(struct SContext *context) {
 	message_free((struct SMessage **)&msg);
 	context->conf_start_ts = get_curr_timestamp();
 	context->conf_id       = generate_conf_id(context->self.id, context->conf_start_ts);
-	context->self.role     = SROLE_ORGANISATOR;
+	if (!role_sticky(context->self.role))
+		context->self.role = SROLE_ORGANISATOR;
+	context->self.relay_id  = 0;
+	context->self.parent_id = 0;
+	context->topology       = STOPOLOGY_MESH;
+	return smcrypt_reset(&context->crypto);
+}
+
+enum SError selecon_set_role(struct SContext *context, enum SRole role) {
+	if (context == NULL ||
+	    (role != SROLE_RELAY && role != SROLE_LISTENER && role != SROLE_PRESENTER))
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	struct SMessage *msg = message_part_info_alloc(
+	    context->self.id, role, &context->self.capacity, context->self.name);
+	if (msg == NULL)
+		return SELECON_MEMORY_ERROR;
+	pthread_rwlock_wrlock(&context->part_rwlock);
+	context->self.role = role;
+	for (size_t i = 0; i < context->nb_participants - 1; ++i)
+		if (context->participants[i].connection != NULL)
+			sconn_send(context->participants[i].connection, msg);
+	subscribe_relayed_video_locked(context);
+	pthread_rwlock_unlock(&context->part_rwlock);
+	message_free(&msg);
+	return SELECON_OK;
+}
+
+enum SError selecon_set_uplink_capacity(struct SContext *context, uint32_t kbps) {
+	if (context == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	context->self.capacity.uplink_kbps = kbps;
+	return SELECON_OK;
+}
+
+enum SError selecon_set_send_limit(struct SContext *context, uint32_t kbps) {
+	if (context == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	pthread_mutex_lock(&context->link_mutex);
+	context->send_limit_kbps = kbps;
+	context->link_free_ts    = 0;
+	pthread_mutex_unlock(&context->link_mutex);
+	return SELECON_OK;
+}
+
+enum SError selecon_set_auto_topology(struct SContext *context, bool enabled) {
+	if (context == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	context->auto_topology  = enabled;
+	context->topology_dirty = true;
+	return SELECON_OK;
+}
+
+enum SError selecon_set_webinar(struct SContext *context, bool enabled) {
+	if (context == NULL || context->nb_participants > 1)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	context->webinar = enabled;
 	return SELECON_OK;
 }
 
@@ -747,28 +1830,9 @@ enum SError selecon_reenter(struct SContext *context) {
 			sconn_disconnect(&con);
 			break;
 		}
-		// restore participant state and streams
+		// restore participant state. Streams are recreated when media arrives
 		if (!spart_hangup_validate(&context->participants[i], con))
 			err = SELECON_CON_TIMEOUT;
-		else {
-			sstream_id_t audio_stream = NULL;
-			sstream_id_t video_stream = NULL;
-
-			err = scont_alloc_stream(&context->streams,
-			                         context->participants[i].id,
-			                         context->conf_start_ts,
-			                         SSTREAM_AUDIO,
-			                         SSTREAM_INPUT,
-			                         &audio_stream);
-			assert(err == SELECON_OK);
-			err = scont_alloc_stream(&context->streams,
-			                         context->participants[i].id,
-			                         context->conf_start_ts,
-			                         SSTREAM_VIDEO,
-			                         SSTREAM_INPUT,
-			                         &video_stream);
-			assert(err == SELECON_OK);
-		}
 	}
 	pthread_rwlock_unlock(&context->part_rwlock);
 	message_free((struct SMessage **)&msg);
@@ -793,33 +1857,311 @@ enum SError selecon_send_text(struct SContext *context, const char *text) {
 	return SELECON_OK;
 }
 
+enum SError selecon_set_codec_priority(struct SContext *context,
+                                       enum AVMediaType media_type,
+                                       const enum AVCodecID *codec_ids,
+                                       size_t count) {
+	if (context == NULL || codec_ids == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	if (!media_caps_prioritize(&context->caps, media_type, codec_ids, count))
+		return SELECON_INVALID_ARG;
+	if (context->nb_participants == 1) {
+		struct SMediaProfile profile;
+		media_caps_first(&context->caps, &profile);
+		scont_set_profile(&context->streams, &profile);
+	}
+	return SELECON_OK;
+}
+
+enum SError selecon_get_media_profile(struct SContext *context, struct SMediaProfile *profile) {
+	if (context == NULL || profile == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	scont_get_profile(&context->streams, profile);
+	return SELECON_OK;
+}
+
+enum SError selecon_set_codec_options(struct SContext *context,
+                                      enum AVMediaType media_type,
+                                      bool encoder,
+                                      const struct SCodecOptions *opts) {
+	if (context == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	enum SStreamType type;
+	if (media_type == AVMEDIA_TYPE_AUDIO)
+		type = SSTREAM_AUDIO;
+	else if (media_type == AVMEDIA_TYPE_VIDEO)
+		type = SSTREAM_VIDEO;
+	else
+		return SELECON_INVALID_ARG;
+	return scont_set_codec_options(
+	    &context->streams, type, encoder ? SSTREAM_OUTPUT : SSTREAM_INPUT, opts);
+}
+
+enum SError selecon_set_audio_mixer(struct SContext *context, media_handler_fn_t handler) {
+	if (context == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	smixer_stop(&context->mixer);
+	if (handler == NULL)
+		return SELECON_OK;
+	return smixer_start(&context->mixer, handler, context, context->self.id);
+}
+
+enum SError selecon_set_participant_gain(struct SContext *context, part_id_t part_id, float gain) {
+	if (context == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	return smixer_set_gain(&context->mixer, part_id, gain);
+}
+
+enum SError selecon_set_participant_mute(struct SContext *context, part_id_t part_id, bool muted) {
+	if (context == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	return smixer_set_mute(&context->mixer, part_id, muted);
+}
+
+enum SError selecon_set_speaker_handler(struct SContext *context, speaker_handler_fn_t handler) {
+	if (context == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	context->speaker_handler = handler;
+	return SELECON_OK;
+}
+
+enum SError selecon_set_audio_top_k(struct SContext *context, size_t k) {
+	if (context == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	context->audio_top_k = k;
+	return SELECON_OK;
+}
+
+enum SError selecon_set_video_temporal_layers(struct SContext *context, int layers) {
+	if (context == NULL || layers < 1 || layers > SELECON_MAX_TEMPORAL_LAYERS)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	context->video_temporal_layers = layers;
+	return SELECON_OK;
+}
+
+enum SError selecon_set_video_last_n(struct SContext *context,
+                                     size_t n,
+                                     enum SVideoSubscription rest) {
+	if (context == NULL || rest == SVIDEO_SUB_FULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	context->video_last_n = n;
+	context->video_rest   = rest;
+	if (n == 0) {
+		// policy off - everybody gets full video back
+		pthread_rwlock_wrlock(&context->part_rwlock);
+		for (size_t i = 0; i < context->nb_participants - 1; ++i)
+			subscribe_video_locked(
+			    context, i, SVIDEO_SUB_FULL, context->participants[i].video_in_layer);
+		pthread_rwlock_unlock(&context->part_rwlock);
+	}
+	return SELECON_OK;
+}
+
+enum SError selecon_set_video_subscription(struct SContext *context,
+                                           part_id_t part_id,
+                                           enum SVideoSubscription state) {
+	if (context == NULL || state < SVIDEO_SUB_FULL || state > SVIDEO_SUB_PAUSED)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	enum SError err = SELECON_INVALID_ARG;
+	pthread_rwlock_wrlock(&context->part_rwlock);
+	for (size_t i = 0; i < context->nb_participants - 1; ++i)
+		if (context->participants[i].id == part_id) {
+			subscribe_video_locked(context, i, state, context->participants[i].video_in_layer);
+			err = context->participants[i].video_in == state ? SELECON_OK : SELECON_CON_ERROR;
+		}
+	pthread_rwlock_unlock(&context->part_rwlock);
+	return err;
+}
+
+enum SError selecon_set_video_layer(struct SContext *context, part_id_t part_id, int layer) {
+	if (context == NULL || layer < 0 || layer >= SELECON_MAX_SIMULCAST_LAYERS)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	enum SError err = SELECON_INVALID_ARG;
+	pthread_rwlock_wrlock(&context->part_rwlock);
+	for (size_t i = 0; i < context->nb_participants - 1; ++i)
+		if (context->participants[i].id == part_id) {
+			struct SParticipant *part = &context->participants[i];
+			subscribe_video_locked(context, i, part->video_in, layer);
+			err = part->video_in_layer == layer ? SELECON_OK : SELECON_CON_ERROR;
+		}
+	pthread_rwlock_unlock(&context->part_rwlock);
+	return err;
+}
+
+part_id_t selecon_get_dominant_speaker(struct SContext *context) {
+	if (context == NULL || !context->initialized)
+		return 0;
+	return sspeak_dominant(&context->speakers);
+}
+
+size_t selecon_get_active_speakers(struct SContext *context,
+                                   struct SSpeaker *speakers,
+                                   size_t max) {
+	if (context == NULL || !context->initialized || speakers == NULL)
+		return 0;
+	return sspeak_ranking(&context->speakers, speakers, max, get_curr_timestamp());
+}
+
+enum SError selecon_get_jitter_stats(struct SContext *context,
+                                     part_id_t part_id,
+                                     enum AVMediaType media_type,
+                                     struct SJitterStats *stats) {
+	if (context == NULL || stats == NULL ||
+	    (media_type != AVMEDIA_TYPE_AUDIO && media_type != AVMEDIA_TYPE_VIDEO))
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	enum SStreamType type = media_type == AVMEDIA_TYPE_AUDIO ? SSTREAM_AUDIO : SSTREAM_VIDEO;
+	sstream_id_t stream   = scont_find_stream(&context->streams, part_id, type, SSTREAM_INPUT);
+	return scont_jitter_stats(&context->streams, stream, stats);
+}
+
+enum SError selecon_stream_get_rate_stats(struct SContext *context,
+                                          sstream_id_t stream_id,
+                                          struct SRateStats *stats) {
+	if (context == NULL || stats == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	return scont_rate_stats(&context->streams, stream_id, stats);
+}
+
+enum SError selecon_get_lipsync_stats(struct SContext *context,
+                                      part_id_t part_id,
+                                      struct SLipSyncStats *stats) {
+	if (context == NULL || stats == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	return scont_lipsync_stats(&context->streams, part_id, stats);
+}
+
+enum SError selecon_get_clock_stats(struct SContext *context,
+                                    part_id_t part_id,
+                                    struct SClockStats *stats) {
+	if (context == NULL || stats == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	if (!sclocks_stats(&context->clocks, part_id, get_curr_timestamp(), stats))
+		return SELECON_INVALID_ARG;
+	return SELECON_OK;
+}
+
+timestamp_t selecon_to_local_ts(struct SContext *context, part_id_t part_id, timestamp_t ts) {
+	if (context == NULL || !context->initialized)
+		return ts;
+	return sclocks_to_local(&context->clocks, part_id, ts);
+}
+
+enum SError selecon_set_video_compositor(struct SContext *context,
+                                        const struct SCompositorLayout *layout,
+                                        media_handler_fn_t handler) {
+	if (context == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	if (layout != NULL) {
+		enum SError err = scomp_set_layout(&context->compositor, layout);
+		if (err != SELECON_OK)
+			return err;
+	}
+	scomp_stop(&context->compositor);
+	if (handler == NULL)
+		return SELECON_OK;
+	return scomp_start(&context->compositor, handler, context, context->self.id);
+}
+
 // 48kHz 16bit mono audio signal supported for now (opus codec)
 enum SError selecon_stream_alloc_audio(struct SContext *context, sstream_id_t *stream_id) {
+	return selecon_stream_alloc_audio2(context, NULL, stream_id);
+}
+
+enum SError selecon_stream_alloc_audio2(struct SContext *context,
+                                        const struct SCodecOptions *opts,
+                                        sstream_id_t *stream_id) {
 	if (context == NULL || stream_id == NULL)
 		return SELECON_INVALID_ARG;
 	if (!context->initialized)
 		return SELECON_EMPTY_CONTEXT;
+	if (context->webinar && !srole_is_presenter(context->self.role))
+		return SELECON_NOT_PRESENTER;
 	return scont_alloc_stream(&context->streams,
 	                          context->self.id,
 	                          context->conf_start_ts,
 	                          SSTREAM_AUDIO,
 	                          SSTREAM_OUTPUT,
+	                          NULL,
+	                          opts,
 	                          stream_id);
 }
 
 enum SError selecon_stream_alloc_video(struct SContext *context, sstream_id_t *stream_id) {
+	return selecon_stream_alloc_video2(context, NULL, NULL, stream_id);
+}
+
+enum SError selecon_stream_alloc_video2(struct SContext *context,
+                                        const struct SVideoParams *params,
+                                        const struct SCodecOptions *opts,
+                                        sstream_id_t *stream_id) {
 	if (context == NULL || stream_id == NULL)
 		return SELECON_INVALID_ARG;
 	if (!context->initialized)
 		return SELECON_EMPTY_CONTEXT;
+	if (context->webinar && !srole_is_presenter(context->self.role))
+		return SELECON_NOT_PRESENTER;
 	return scont_alloc_stream(&context->streams,
 	                          context->self.id,
 	                          context->conf_start_ts,
 	                          SSTREAM_VIDEO,
 	                          SSTREAM_OUTPUT,
+	                          params,
+	                          opts,
 	                          stream_id);
 }
 
+enum SError selecon_stream_set_video_params(struct SContext *context,
+                                            sstream_id_t stream_id,
+                                            const struct SVideoParams *params) {
+	if (context == NULL || stream_id == NULL || params == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	return scont_set_video_params(&context->streams, stream_id, params);
+}
+
+enum SError selecon_set_video_params(struct SContext *context, const struct SVideoParams *params) {
+	if (context == NULL || params == NULL)
+		return SELECON_INVALID_ARG;
+	if (!context->initialized)
+		return SELECON_EMPTY_CONTEXT;
+	return scont_set_video_params(&context->streams, NULL, params);
+}
+
 // closes stream
 void selecon_stream_free(struct SContext *context, sstream_id_t *stream_id) {
 	if (context == NULL || stream_id == NULL || *stream_id == NULL)
@@ -1,9 +1,15 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
+#include "active_speakers.h"
+#include "clock_sync.h"
+#include "codec_options.h"
 #include "error.h"
+#include "jitter_buffer.h"
+#include "media_profile.h"
 #include "message.h"
 #include "role.h"
 #include "stypes.h"
@@ -67,6 +73,32 @@ enum SError selecon_invite2(struct SContext *context, const char *address);
 // tell everybody in conference your intention to leave and disconnect from all of them
 enum SError selecon_leave_conference(struct SContext *context);
 
+// becomes relay (SROLE_RELAY) or stops being one (SROLE_LISTENER) and tells everybody in
+// conference. Others send their media to relay only and it forwards media without decoding.
+// Relay receives full top layer video of everybody whatever video subscriptions are set, because
+// its group gets same video as it does. SROLE_PRESENTER lets participant send media in webinar it
+// joins next. Relays and presenters keep their roles in conferences they join
+enum SError selecon_set_role(struct SContext *context, enum SRole role);
+
+// uplink capacity announced to other participants along with measured RTT and CPU headroom.
+// 0 means unknown, organiser then assumes SELECON_DEFAULT_UPLINK_KBPS
+enum SError selecon_set_uplink_capacity(struct SContext *context, uint32_t kbps);
+
+// emulates uplink of given capacity for testing congestion control: media packets leave at most at
+// this rate and wait in output workers like on bottleneck link. 0 disables emulation (default)
+enum SError selecon_set_send_limit(struct SContext *context, uint32_t kbps);
+
+// lets organiser choose between full mesh and one or two level relay tree by announced capacities
+// of participants. Chosen relays and relay of everybody else are sent in SMSG_TOPOLOGY. Takes
+// effect on participant who is organiser of conference, others follow its plan
+enum SError selecon_set_auto_topology(struct SContext *context, bool enabled);
+
+// makes conference organised by this participant webinar: only organiser and presenters allocate
+// output streams (others get SELECON_NOT_PRESENTER). Listeners do not meet each other, they are
+// placed in distribution tree where presenters and listeners with spare uplink feed them all media
+// they receive. Can be set only while alone, invitees take it from invite
+enum SError selecon_set_webinar(struct SContext *context, bool enabled);
+
 // emulate hard hangup
 enum SError selecon_hangup(struct SContext *context);
 
@@ -76,11 +108,133 @@ enum SError selecon_reenter(struct SContext *context);
 // send textual message to conference participants
 enum SError selecon_send_text(struct SContext *context, const char *text);
 
+// restricts and reorders codecs offered during invite handshake. Codecs not listed are never
+// used. Takes effect on next conference profile negotiation (while there are no participants)
+enum SError selecon_set_codec_priority(struct SContext *context,
+                                       enum AVMediaType media_type,
+                                       const enum AVCodecID *codec_ids,
+                                       size_t count);
+
+// profile negotiated for current conference. Received frames are decoded in its formats
+enum SError selecon_get_media_profile(struct SContext *context, struct SMediaProfile *profile);
+
+// sets codec options for streams allocated afterwards. encoder selects output (true) or
+// input (false) streams. NULL resets options to SELECON_DEFAULT_CODEC_PRESET
+enum SError selecon_set_codec_options(struct SContext *context,
+                                      enum AVMediaType media_type,
+                                      bool encoder,
+                                      const struct SCodecOptions *opts);
+
 // 48kHz 16bit mono audio signal supported for now (opus codec)
 enum SError selecon_stream_alloc_audio(struct SContext *context, sstream_id_t *stream_id);
 
+// same as selecon_stream_alloc_audio, but with explicit encoder options
+enum SError selecon_stream_alloc_audio2(struct SContext *context,
+                                        const struct SCodecOptions *opts,
+                                        sstream_id_t *stream_id);
+
 enum SError selecon_stream_alloc_video(struct SContext *context, sstream_id_t *stream_id);
 
+// same as selecon_stream_alloc_video, but with explicit resolution/frame rate and encoder
+// options. Any of params and opts can be NULL
+enum SError selecon_stream_alloc_video2(struct SContext *context,
+                                        const struct SVideoParams *params,
+                                        const struct SCodecOptions *opts,
+                                        sstream_id_t *stream_id);
+
+// changes resolution and frame rate of output video stream on the fly. Encoder is reopened
+// before next frame, receivers get frames of new size from their decoders
+enum SError selecon_stream_set_video_params(struct SContext *context,
+                                            sstream_id_t stream_id,
+                                            const struct SVideoParams *params);
+
+// same as above for all output video streams. Also becomes default for new video streams
+enum SError selecon_set_video_params(struct SContext *context, const struct SVideoParams *params);
+
+// mixes audio of all participants into single stream on common clock. Mixed frames are passed
+// to handler every SELECON_MIXER_TICK ms with self part_id. Media handler given at init still
+// receives audio of each participant. NULL handler disables mixing
+enum SError selecon_set_audio_mixer(struct SContext *context, media_handler_fn_t handler);
+
+// linear gain of participant audio in mix, 1 by default
+enum SError selecon_set_participant_gain(struct SContext *context, part_id_t part_id, float gain);
+
+enum SError selecon_set_participant_mute(struct SContext *context, part_id_t part_id, bool muted);
+
+// handler is called from conference thread when dominant speaker changes. Speakers are ranked by
+// audio levels senders put into message headers, so it works without decoding anybody
+enum SError selecon_set_speaker_handler(struct SContext *context, speaker_handler_fn_t handler);
+
+// decodes audio of k loudest speakers only, packets of others are dropped before decoder. Speaker
+// leaving top k is still heard for SELECON_AUDIO_TOP_K_HOLD. 0 decodes everybody (default)
+enum SError selecon_set_audio_top_k(struct SContext *context, size_t k);
+
+// decodes given amount of temporal layers of received video (1 - SELECON_MAX_TEMPORAL_LAYERS,
+// all by default). With L1T3 senders 2 layers halve decoded frame rate, 1 layer quarters it.
+// Upper layers are also dropped while decoder falls behind. Senders without temporal layers
+// are decoded in full
+enum SError selecon_set_video_temporal_layers(struct SContext *context, int layers);
+
+// receives full video of n most recent speakers only (participants who never spoke fill free
+// slots). Others are asked for rest subscription (paused or reduced). 0 turns policy off and
+// subscribes to everybody in full (default)
+enum SError selecon_set_video_last_n(struct SContext *context,
+                                     size_t n,
+                                     enum SVideoSubscription rest);
+
+// manually changes video subscription to participant. Overridden by last N policy when it is on
+enum SError selecon_set_video_subscription(struct SContext *context,
+                                           part_id_t part_id,
+                                           enum SVideoSubscription state);
+
+// selects simulcast layer of participant video received with full subscription (0 is highest
+// resolution, default). Sender switches on next keyframe of that layer and sends its lowest
+// layer if it has fewer ones
+enum SError selecon_set_video_layer(struct SContext *context, part_id_t part_id, int layer);
+
+// loudest recent speaker (kept through pauses), 0 if nobody spoke yet
+part_id_t selecon_get_dominant_speaker(struct SContext *context);
+
+// fills speakers with participants speaking now, loudest first. Returns amount of entries
+size_t selecon_get_active_speakers(struct SContext *context,
+                                   struct SSpeaker *speakers,
+                                   size_t max);
+
+// jitter buffer statistics of input stream receiving media of given type from participant
+enum SError selecon_get_jitter_stats(struct SContext *context,
+                                     part_id_t part_id,
+                                     enum AVMediaType media_type,
+                                     struct SJitterStats *stats);
+
+// congestion control state of own output stream: bitrate and frame rate receiver reports brought
+// encoder to
+enum SError selecon_stream_get_rate_stats(struct SContext *context,
+                                          sstream_id_t stream_id,
+                                          struct SRateStats *stats);
+
+// A/V offset of participant media and delays lip sync added to align it. Known once both audio
+// and video of participant arrived
+enum SError selecon_get_lipsync_stats(struct SContext *context,
+                                      part_id_t part_id,
+                                      struct SLipSyncStats *stats);
+
+// clock of participant estimated from ping exchanges and one way latency of its media corrected by
+// it. Participants we do not ping (media comes through relay) have no estimate
+enum SError selecon_get_clock_stats(struct SContext *context,
+                                    part_id_t part_id,
+                                    struct SClockStats *stats);
+
+// translates timestamp of participant clock into local time base. Clocks without estimate are
+// taken as local one. Safe to call from media handlers
+timestamp_t selecon_to_local_ts(struct SContext *context, part_id_t part_id, timestamp_t ts);
+
+// tiles latest video frame of every participant into single YUV420P frame. Composed frames are
+// passed to handler at layout frame rate with self part_id. NULL layout keeps current one
+// (SELECON_DEFAULT_COMPOSITE_* auto grid initially), NULL handler disables compositing
+enum SError selecon_set_video_compositor(struct SContext *context,
+                                        const struct SCompositorLayout *layout,
+                                        media_handler_fn_t handler);
+
 // closes stream
 void selecon_stream_free(struct SContext *context, sstream_id_t *stream_id);
 
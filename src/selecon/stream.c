@@ -23,6 +23,7 @@
 #include "error.h"
 #include "media_filters.h"
 #include "participant.h"
+#include "sample_convert.h"
 #include "stime.h"
 #include "stypes.h"
 
@@ -72,7 +73,8 @@ static void insert_packet(struct SStream *stream, struct AVPacket **packet) {
 			fprintf(stderr, "failed to allocate SFrame in insert_packet\n");
 			av_packet_free(packet);
 		} else {
-			sframe->avpacket = *packet;
+			sframe->avpacket   = *packet;
+			sframe->arrival_ts = get_curr_timestamp();
 			insert_common(stream, sframe);
 			*packet = NULL;
 		}
@@ -103,77 +105,420 @@ static struct AVFrame *pop_frame(struct SStream *stream) {
 	return frame;
 }
 
-static struct AVPacket *pop_packet(struct SStream *stream) {
-	if (stream == NULL)
-		return NULL;
+// duration of input packet in ms. Silence markers carry it in samples
+static int64_t packet_duration(const struct SStream *stream, const struct AVPacket *packet) {
+	if (stream->type != SSTREAM_AUDIO)
+		return packet->duration;
+	const struct SAudioProfile *aprof = &stream->profile.audio;
+	int rate = aprof->sample_rate > 0 ? aprof->sample_rate : SELECON_DEFAULT_AUDIO_SAMPLE_RATE;
+	if (packet->size == 0)
+		return packet->duration * 1000 / rate;
+	if (packet->duration > 0)
+		return packet->duration;
+	int frame_size = aprof->frame_size > 0 ? aprof->frame_size : SELECON_DEFAULT_AUDIO_FRAME_SIZE;
+	return frame_size * 1000 / rate;
+}
+
+// mutex must be locked. Moves arrived packets into jitter buffer
+static void jitter_fill_locked(struct SStream *stream) {
+	while (stream->queue != NULL) {
+		struct SFrame *head       = stream->queue;
+		struct AVPacket *avpacket = head->avpacket;
+		// packet without timestamp plays right after previous one
+		int64_t pts = avpacket->pts != AV_NOPTS_VALUE ? avpacket->pts : stream->jitter.last_pts;
+		struct SJitterPacket packet = {
+		    avpacket, pts, packet_duration(stream, avpacket), avpacket->size == 0};
+		if (!sjbuf_push(&stream->jitter, &packet, head->arrival_ts))
+			av_packet_free(&avpacket);
+		stream->queue = head->next;
+		free(head);
+	}
+	stream->tail = NULL;
+}
+
+// waits until packet in jitter buffer (or loss of expected one) is due. Returns SJBUF_EMPTY when
+// stream is stopped
+static enum SJitterResult pop_packet(struct SStream *stream, struct SJitterPacket *packet) {
+	enum SJitterResult res = SJBUF_EMPTY;
 	pthread_mutex_lock(&stream->mutex);
-	if (stream->queue == NULL)
-		pthread_cond_wait(&stream->cond, &stream->mutex);
-	struct AVPacket *packet = NULL;
-	struct SFrame *head     = stream->queue;
-	if (head != NULL) {
-		if (head->avframe != NULL)
-			fprintf(stderr, "AVFrame detected in AVPacket queue\n");
+	while (!stream->stop) {
+		jitter_fill_locked(stream);
+		timestamp_t due = 0;
+		res             = sjbuf_pop(&stream->jitter, get_curr_timestamp(), packet, &due);
+		if (res == SJBUF_PACKET || res == SJBUF_LOST)
+			break;
+		if (res == SJBUF_EMPTY)
+			pthread_cond_wait(&stream->cond, &stream->mutex);
 		else {
-			packet        = head->avpacket;
-			stream->queue = head->next;
-			if (stream->queue == NULL)
-				stream->tail = NULL;
+			struct timespec ts = {due / 1000000000ULL, due % 1000000000ULL};
+			pthread_cond_timedwait(&stream->cond, &stream->mutex, &ts);
 		}
 	}
+	if (stream->stop)
+		res = SJBUF_EMPTY;
 	pthread_mutex_unlock(&stream->mutex);
-	if (head != NULL)
-		free(head);
-	return packet;
+	return res;
 }
 
-static void stream_input_worker(struct SStream *stream) {
-	int64_t pts           = 0;
-	struct AVFrame *frame = av_frame_alloc();
+// silence marker of DTX sender. Decoder is not run, silent frames in decoder format are passed to
+// media handler instead
+static void play_silence(struct SStream *stream,
+                         struct AVFrame *frame,
+                         int64_t nb_samples,
+                         int64_t *pts) {
+	const struct AVCodecContext *ctx = stream->codec_ctx;
+	if (stream->type != SSTREAM_AUDIO || ctx->sample_fmt == AV_SAMPLE_FMT_NONE)
+		return;
+	int chunk = stream->profile.audio.frame_size > 0 ? stream->profile.audio.frame_size
+	                                                 : SELECON_DEFAULT_AUDIO_FRAME_SIZE;
+	while (nb_samples > 0) {
+		int size           = nb_samples < chunk ? nb_samples : chunk;
+		frame->format      = ctx->sample_fmt;
+		frame->sample_rate = ctx->sample_rate;
+		frame->nb_samples  = size;
+		if (av_channel_layout_copy(&frame->ch_layout, &ctx->ch_layout) < 0 ||
+		    av_frame_get_buffer(frame, 0) < 0) {
+			fprintf(stderr, "failed to allocate silence frame\n");
+			av_frame_unref(frame);
+			return;
+		}
+		av_samples_set_silence(
+		    frame->extended_data, 0, size, ctx->ch_layout.nb_channels, ctx->sample_fmt);
+		frame->time_base = av_make_q(1, ctx->sample_rate);
+		frame->pts = frame->pkt_dts = *pts;
+		*pts += size;
+		stream->media_handler(stream->media_user_data, stream->part_id, AVMEDIA_TYPE_AUDIO, frame);
+		av_frame_unref(frame);
+		nb_samples -= size;
+	}
+}
+
+// conceals lost audio by repeating last decoded frame, quieter with every repeat, so short loss
+// is not heard as click and longer one fades out. Silence is played when there is no float frame
+static void conceal_audio(struct SStream *stream,
+                          const struct AVFrame *last,
+                          struct AVFrame *frame,
+                          int64_t duration,
+                          int64_t *pts,
+                          float *gain) {
+	const struct AVCodecContext *ctx = stream->codec_ctx;
+	if (stream->type != SSTREAM_AUDIO || ctx->sample_rate <= 0)
+		return;
+	int64_t nb_samples = av_rescale(duration, ctx->sample_rate, 1000);
+	bool planar        = last->format == AV_SAMPLE_FMT_FLTP;
+	if (last->nb_samples == 0 || (!planar && last->format != AV_SAMPLE_FMT_FLT) ||
+	    av_frame_ref(frame, last) < 0 || av_frame_make_writable(frame) < 0) {
+		av_frame_unref(frame);
+		return play_silence(stream, frame, nb_samples, pts);
+	}
+	if (frame->nb_samples > nb_samples)
+		frame->nb_samples = nb_samples;
+	int nb_channels = frame->ch_layout.nb_channels;
+	for (int i = 0; i < (planar ? nb_channels : 1); ++i)
+		sconv_gain_ramp_flt((float *)frame->extended_data[i],
+		                    planar ? frame->nb_samples : frame->nb_samples * nb_channels,
+		                    *gain,
+		                    *gain * SELECON_PLC_FADE);
+	*gain *= SELECON_PLC_FADE;
+	frame->time_base = av_make_q(1, ctx->sample_rate);
+	frame->pts = frame->pkt_dts = *pts;
+	*pts += frame->nb_samples;
+	stream->media_handler(stream->media_user_data, stream->part_id, AVMEDIA_TYPE_AUDIO, frame);
+	av_frame_unref(frame);
+}
+
+// decodes packet and passes frames to media handler. Last audio frame is kept for loss
+// concealment. NULL packet drains decoder
+static void decode_packet(struct SStream *stream,
+                          struct AVPacket *packet,
+                          struct AVFrame *frame,
+                          struct AVFrame *last,
+                          int64_t *pts) {
 	enum AVMediaType mtype =
 	    stream->type == SSTREAM_AUDIO ? AVMEDIA_TYPE_AUDIO : AVMEDIA_TYPE_VIDEO;
-	// TODO: flush decoder properly
-	struct AVPacket *packet = NULL;
-	do {
-		av_packet_free(&packet);
-		packet  = pop_packet(stream);
-		int ret = avcodec_send_packet(stream->codec_ctx, packet);
-		if (ret < 0) {
-			perror("avcodec_send_packet");
-			av_frame_free(&frame);
-			break;
+	int ret = avcodec_send_packet(stream->codec_ctx, packet);
+	if (ret < 0) {
+		// corrupted or foreign codec packet (sender switched codec) - wait for next keyframe
+		fprintf(stderr, "avcodec_send_packet: ret = %d\n", ret);
+		if (packet != NULL && stream->type == SSTREAM_VIDEO) {
+			pthread_mutex_lock(&stream->mutex);
+			stream->keyframe_wait = true;
+			pthread_mutex_unlock(&stream->mutex);
 		}
-		while (ret == 0) {
-			ret = avcodec_receive_frame(stream->codec_ctx, frame);
-			if (ret < 0)
-				break;
-			frame->time_base = stream->codec_ctx->time_base;
-			if (mtype == AVMEDIA_TYPE_AUDIO) {
-				frame->pts = frame->pkt_dts = pts;
-				pts += frame->nb_samples;  // time is in 1/sample_rate units
-			}
-			stream->media_handler(stream->media_user_data, stream->part_id, mtype, frame);
-			av_frame_unref(frame);
+		return;
+	}
+	while (ret == 0) {
+		ret = avcodec_receive_frame(stream->codec_ctx, frame);
+		if (ret < 0)
+			break;
+		frame->time_base = stream->codec_ctx->time_base;
+		if (mtype == AVMEDIA_TYPE_AUDIO) {
+			frame->time_base = av_make_q(1, frame->sample_rate);
+			frame->pts = frame->pkt_dts = *pts;
+			*pts += frame->nb_samples;
+			av_frame_unref(last);
+			av_frame_ref(last, frame);
 		}
-		if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
-			perror("avcodec_receive_packet");
+		stream->media_handler(stream->media_user_data, stream->part_id, mtype, frame);
+		av_frame_unref(frame);
+	}
+	if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+		perror("avcodec_receive_packet");
+}
 
-	} while (packet != NULL);
+// decodes packets at their playout time and conceals lost audio. Audio frames are stamped by
+// sender capture time of their packets in samples, video frames keep packet pts in ms, so both
+// media of participant share sender clock
+static void stream_input_worker(struct SStream *stream) {
+	int64_t pts           = 0;
+	struct AVFrame *frame = av_frame_alloc();
+	struct AVFrame *last  = av_frame_alloc();
+	float conceal_gain    = 1.0f;
+	struct SJitterPacket jpacket;
+	enum SJitterResult res;
+	while ((res = pop_packet(stream, &jpacket)) != SJBUF_EMPTY) {
+		if (stream->type == SSTREAM_AUDIO && stream->codec_ctx->sample_rate > 0)
+			pts = av_rescale(jpacket.pts, stream->codec_ctx->sample_rate, 1000);
+		if (res == SJBUF_LOST) {
+			conceal_audio(stream, last, frame, jpacket.duration, &pts, &conceal_gain);
+			continue;
+		}
+		struct AVPacket *packet = jpacket.data;
+		pthread_mutex_lock(&stream->mutex);
+		bool resync    = stream->resync;
+		stream->resync = false;
+		pthread_mutex_unlock(&stream->mutex);
+		// skipped packets left overlap and prediction state of other moment, start clean
+		if (resync)
+			avcodec_flush_buffers(stream->codec_ctx);
+		// empty packet would flush decoder, it is silence marker instead
+		if (packet->size == 0)
+			play_silence(stream, frame, packet->duration, &pts);
+		else {
+			decode_packet(stream, packet, frame, last, &pts);
+			conceal_gain = 1.0f;
+		}
+		av_packet_free(&packet);
+	}
+	decode_packet(stream, NULL, frame, last, &pts);
+	// packets still waiting for playout go with stream
+	pthread_mutex_lock(&stream->mutex);
+	while (sjbuf_take(&stream->jitter, &jpacket)) {
+		struct AVPacket *packet = jpacket.data;
+		av_packet_free(&packet);
+	}
+	pthread_mutex_unlock(&stream->mutex);
+	av_frame_free(&last);
 	av_frame_free(&frame);
 }
 
+// keyframe serves pending request, next one is forced no sooner than min interval after it
+static void keyframe_sent(struct SStream *stream) {
+	pthread_mutex_lock(&stream->mutex);
+	stream->keyframe_request = false;
+	stream->keyframe_ts      = get_curr_timestamp();
+	pthread_mutex_unlock(&stream->mutex);
+}
+
+// returns true if requested keyframe must be forced on next frame. Called from worker thread only
+static bool force_keyframe(struct SStream *stream) {
+	if (stream->type != SSTREAM_VIDEO)
+		return false;
+	pthread_mutex_lock(&stream->mutex);
+	bool force = stream->keyframe_request && get_curr_timestamp() - stream->keyframe_ts >=
+	                                             SELECON_KEYFRAME_MIN_INTERVAL * 1000000ULL;
+	pthread_mutex_unlock(&stream->mutex);
+	if (force)
+		keyframe_sent(stream);
+	return force;
+}
+
+// encodes frame with encoder of given layer and passes all ready packets to packet handler
+static int encode_layer(struct SStream *stream,
+                        struct AVCodecContext *codec_ctx,
+                        int layer,
+                        struct AVFrame *frame,
+                        struct AVPacket *packet) {
+	if (frame != NULL && stream->type == SSTREAM_VIDEO)
+		scodec_temporal_submit(
+		    &stream->temporal[layer], frame->pts, frame->pict_type == AV_PICTURE_TYPE_I);
+	int ret = avcodec_send_frame(codec_ctx, frame);
+	if (ret < 0) {
+		fprintf(stderr, "avcodec_send_frame: ret = %d\n", ret);
+		return ret;
+	}
+	while ((ret = avcodec_receive_packet(codec_ctx, packet)) == 0) {
+		packet->stream_index = layer;
+		// keyframe refreshes all references, nobody may drop it
+		bool keyframe       = packet->flags & AV_PKT_FLAG_KEY;
+		stream->temporal_id =
+		    scodec_temporal_packet(&stream->temporal[layer], packet->pts, keyframe);
+		if (keyframe && layer == 0 && stream->type == SSTREAM_VIDEO)
+			keyframe_sent(stream);
+		stream->packet_handler(stream->packet_user_data, stream, packet);
+		av_packet_unref(packet);
+	}
+	if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+		perror("avcodec_receive_packet");
+		return ret;
+	}
+	return 0;
+}
+
+// scales frame of previous layer down into layer frame. Encoder may still hold previous
+// layer frame, so buffer is reallocated in that case
+static int scale_layer(struct SVideoLayer *layer, const struct AVFrame *src) {
+	int ret = av_frame_make_writable(layer->frame);
+	if (ret < 0)
+		return ret;
+	ret = sws_scale(layer->sws,
+	                (const uint8_t *const *)src->data,
+	                src->linesize,
+	                0,
+	                src->height,
+	                layer->frame->data,
+	                layer->frame->linesize);
+	if (ret < 0)
+		return ret;
+	layer->frame->pts       = src->pts;
+	layer->frame->pkt_dts   = src->pkt_dts;
+	layer->frame->time_base = src->time_base;
+	layer->frame->pict_type = src->pict_type;
+	return 0;
+}
+
+// encodes frame and passes all ready packets to packet handler. Simulcast video streams also
+// encode downscaled copies of frame. NULL frame flushes encoders
+static int encode_frame(struct SStream *stream, struct AVFrame *frame, struct AVPacket *packet) {
+	// forced keyframe goes to all layers at once, so every receiver starts decoding from it
+	if (frame != NULL && stream->type == SSTREAM_VIDEO)
+		frame->pict_type = force_keyframe(stream) ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+	int ret = encode_layer(stream, stream->codec_ctx, 0, frame, packet);
+	const struct AVFrame *src = frame;
+	for (int i = 1; i < stream->nb_layers && ret == 0; ++i) {
+		struct SVideoLayer *layer = &stream->layers[i - 1];
+		if (src != NULL && (ret = scale_layer(layer, src)) < 0) {
+			fprintf(stderr, "failed to scale simulcast layer %d: ret = %d\n", i, ret);
+			return ret;
+		}
+		src = src != NULL ? layer->frame : NULL;
+		ret = encode_layer(stream, layer->codec_ctx, i, (struct AVFrame *)src, packet);
+	}
+	return ret;
+}
+
+// passes accumulated silence to packet handler as empty packet
+static void send_silence_marker(struct SStream *stream, struct AVPacket *packet) {
+	packet->pts = packet->dts = stream->silence_pts;
+	packet->duration          = stream->silence_samples;
+	stream->packet_handler(stream->packet_user_data, stream, packet);
+	av_packet_unref(packet);
+	stream->silence_samples   = 0;
+	stream->silence_marker_ts = get_curr_timestamp();
+}
+
+// returns true if audio frame must be encoded. Silent frames are only counted and reported by
+// markers: at silence start, every SELECON_DTX_MARKER_INTERVAL and before voice resumes, so
+// receiver timeline has no gaps
+static bool dtx_filter_frame(struct SStream *stream,
+                             struct AVFrame *frame,
+                             struct AVPacket *packet) {
+	if (svad_process(&stream->vad, frame)) {
+		if (stream->silence_samples > 0)
+			send_silence_marker(stream, packet);
+		stream->silent = false;
+		return true;
+	}
+	if (stream->silence_samples == 0)
+		stream->silence_pts = frame->pts;
+	stream->silence_samples += frame->nb_samples;
+	if (!stream->silent || get_curr_timestamp() - stream->silence_marker_ts >=
+	                           SELECON_DTX_MARKER_INTERVAL * 1000000LL)
+		send_silence_marker(stream, packet);
+	stream->silent = true;
+	return false;
+}
+
+static enum SError sstream_open_codec(struct SStream *stream);
+static void sstream_close_codec(struct SStream *stream);
+
+// drains encoder and reopens it with next_profile. Called from worker thread only
+static void sstream_apply_profile(struct SStream *stream, struct AVPacket *packet) {
+	pthread_mutex_lock(&stream->mutex);
+	struct SMediaProfile prev = stream->profile;
+	stream->profile           = stream->next_profile;
+	stream->reconfigure       = false;
+	pthread_mutex_unlock(&stream->mutex);
+	if (stream->codec_ctx != NULL)
+		encode_frame(stream, NULL, packet);
+	sstream_close_codec(stream);
+	if (sstream_open_codec(stream) != SELECON_OK) {
+		fprintf(stderr, "failed to switch stream codec, restoring previous one\n");
+		stream->profile = prev;
+		if (sstream_open_codec(stream) != SELECON_OK)
+			fprintf(stderr, "failed to restore stream codec, frames will be dropped\n");
+	}
+}
+
+// libx264 reconfigures itself when it sees these changed, other encoders keep rate they were
+// opened with
+static void scale_rate(struct AVCodecContext *codec_ctx, int64_t to, int64_t from) {
+	codec_ctx->bit_rate       = av_rescale(codec_ctx->bit_rate, to, from);
+	codec_ctx->rc_max_rate    = av_rescale(codec_ctx->rc_max_rate, to, from);
+	codec_ctx->rc_buffer_size = (int)av_rescale(codec_ctx->rc_buffer_size, to, from);
+}
+
+// brings encoders to congestion control target, simulcast layers keep their share. Returns
+// target frame rate. Called from worker thread only
+static int apply_rate(struct SStream *stream) {
+	pthread_mutex_lock(&stream->mutex);
+	int64_t bitrate = stream->rate.bitrate;
+	int framerate   = stream->rate.framerate;
+	pthread_mutex_unlock(&stream->mutex);
+	if (bitrate != stream->rate_bitrate && stream->rate_bitrate > 0) {
+		scale_rate(stream->codec_ctx, bitrate, stream->rate_bitrate);
+		for (int i = 1; i < stream->nb_layers; ++i)
+			scale_rate(stream->layers[i - 1].codec_ctx, bitrate, stream->rate_bitrate);
+		stream->rate_bitrate = bitrate;
+	}
+	return framerate;
+}
+
+// returns true if video frame arrived earlier than given frame rate allows
+static bool skip_video_frame(int framerate, timestamp_t *next_frame_ts) {
+	timestamp_t interval = 1000000000LL / framerate;
+	timestamp_t now      = get_curr_timestamp();
+	// quarter of interval tolerance for source jitter
+	if (now + interval / 4 < *next_frame_ts)
+		return true;
+	// keep cadence unless stream stalled for more than one frame
+	*next_frame_ts = (*next_frame_ts + interval > now ? *next_frame_ts : now) + interval;
+	return false;
+}
+
 static void stream_output_worker(struct SStream *stream) {
-	struct AVPacket *packet = av_packet_alloc();
-	timestamp_t ts          = 0;
+	struct AVPacket *packet   = av_packet_alloc();
+	timestamp_t ts            = 0;
+	timestamp_t next_frame_ts = 0;
 	while (true) {
 		struct AVFrame *frame = pop_frame(stream);
 		if (frame == NULL) {  // close requested
 			av_packet_free(&packet);
 			break;
 		}
+		if (stream->reconfigure)
+			sstream_apply_profile(stream, packet);
+		int framerate = stream->codec_ctx != NULL ? apply_rate(stream) : 0;
+		// sources faster than target frame rate are decimated instead of being queued
+		if (stream->codec_ctx == NULL ||
+		    (stream->type == SSTREAM_VIDEO && skip_video_frame(framerate, &next_frame_ts))) {
+			av_frame_free(&frame);
+			continue;
+		}
 		int ret = mfgraph_send(&stream->filter_graph, frame);
 		if (ret < 0) {
 			fprintf(stderr, "mgraph_send: err = %d\n", ret);
+			av_frame_free(&frame);
 			continue;
 		}
 		while ((ret = mfgraph_receive(&stream->filter_graph, frame)) >= 0) {
@@ -190,28 +535,19 @@ static void stream_output_worker(struct SStream *stream) {
 			if (frame->nb_samples > 0)
 				expected_delta = av_rescale(frame->nb_samples, 1000000000LL, frame->sample_rate);
 			else
-				expected_delta = 1000000000LL / SELECON_DEFAULT_VIDEO_FPS;
+				expected_delta = 1000000000LL / stream->profile.video.framerate;
 			// TODO: make ptses smoother (introduce some delay)
 			reduce_fps(expected_delta, &ts);
-			int ret = avcodec_send_frame(stream->codec_ctx, frame);
-			if (ret < 0) {
-				fprintf(stderr, "avcodec_send_frame: ret = %d\n", ret);
+			if (stream->dtx) {
+				if (!dtx_filter_frame(stream, frame, packet))
+					continue;
+			} else if (stream->type == SSTREAM_AUDIO)
+				stream->vad.level = svad_frame_level(frame);
+			if (encode_frame(stream, frame, packet) < 0) {
 				av_packet_free(&packet);
 				av_frame_free(&frame);
 				return;
 			}
-			while (ret == 0) {
-				ret = avcodec_receive_packet(stream->codec_ctx, packet);
-				if (ret == AVERROR(EAGAIN))
-					break;
-				else if (ret < 0) {
-					break;
-				}
-				stream->packet_handler(stream->packet_user_data, stream, packet);
-				av_packet_unref(packet);
-			}
-			if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
-				perror("avcodec_receive_packet");
 		}
 		if (ret != AVERROR(EAGAIN))
 			fprintf(stderr, "mfgraph_receive: err = %d\n", ret);
@@ -228,45 +564,144 @@ static void *stream_worker(void *arg) {
 	return NULL;
 }
 
-static void sstream_free(struct SStream **stream) {
-	if (*stream == NULL)
-		return;
-	// clear queue
-	pthread_mutex_lock(&(*stream)->mutex);
-	while ((*stream)->queue != NULL) {
-		struct SFrame *next = (*stream)->queue->next;
-		av_frame_free(&(*stream)->queue->avframe);
-		av_packet_free(&(*stream)->queue->avpacket);
-		free((*stream)->queue);
-		(*stream)->queue = next;
-	}
-	pthread_cond_signal(&(*stream)->cond);  // wakeup worker thread
-	pthread_mutex_unlock(&(*stream)->mutex);
-	pthread_join((*stream)->handler_thread, NULL);
-	mfgraph_free(&(*stream)->filter_graph);
-	avcodec_free_context(&(*stream)->codec_ctx);
+static enum SError sstream_start(struct SStream *stream) {
+	stream->stop = false;
+	if (stream->dir == SSTREAM_INPUT) {
+		sjbuf_init(&stream->jitter, stream->type == SSTREAM_AUDIO);
+		srate_meter_init(&stream->meter, get_curr_timestamp());
+	}
+	if (pthread_create(&stream->handler_thread, NULL, stream_worker, stream) != 0)
+		return SELECON_MEMORY_ERROR;
+	pthread_setname_np(stream->handler_thread, "stream");
+	return SELECON_OK;
+}
+
+// drops queued data and waits for worker thread to finish
+static void sstream_stop(struct SStream *stream) {
+	pthread_mutex_lock(&stream->mutex);
+	while (stream->queue != NULL) {
+		struct SFrame *next = stream->queue->next;
+		av_frame_free(&stream->queue->avframe);
+		av_packet_free(&stream->queue->avpacket);
+		free(stream->queue);
+		stream->queue = next;
+	}
+	stream->tail = NULL;
+	stream->stop = true;
+	pthread_cond_signal(&stream->cond);  // wakeup worker thread
+	pthread_mutex_unlock(&stream->mutex);
+	pthread_join(stream->handler_thread, NULL);
+}
+
+// frees stream with stopped (or never started) worker
+static void sstream_destroy(struct SStream **stream) {
+	sstream_close_codec(*stream);
+	scodec_options_free(&(*stream)->codec_opts);
 	pthread_cond_destroy(&(*stream)->cond);
 	pthread_mutex_destroy(&(*stream)->mutex);
 	free(*stream);
 	*stream = NULL;
 }
 
+static void sstream_free(struct SStream **stream) {
+	if (*stream == NULL)
+		return;
+	sstream_stop(*stream);
+	sstream_destroy(stream);
+}
+
+// removes stream from pool keeping order (oldest first)
+static struct SStream *pool_take_locked(struct SStreamContainer *cont, size_t index) {
+	struct SStream *stream = cont->pool[index];
+	if (index + 1 < cont->nb_pool)
+		memmove(&cont->pool[index],
+		        &cont->pool[index + 1],
+		        (cont->nb_pool - index - 1) * sizeof(struct SStream *));
+	cont->nb_pool--;
+	return stream;
+}
+
+static void pool_shrink_locked(struct SStreamContainer *cont, size_t size) {
+	while (cont->nb_pool > size) {
+		struct SStream *stream = pool_take_locked(cont, 0);
+		sstream_destroy(&stream);
+	}
+}
+
+// stops input stream worker and keeps decoder for reuse. Stream must be already removed from
+// input streams array
+static void sstream_park_locked(struct SStreamContainer *cont, struct SStream *stream) {
+	sstream_stop(stream);
+	if (cont->pool_size == 0) {
+		sstream_destroy(&stream);
+		return;
+	}
+	// worker drained decoder on exit, bring it back from EOF state
+	avcodec_flush_buffers(stream->codec_ctx);
+	stream->last_packet_ts = get_curr_timestamp();
+	pool_shrink_locked(cont, cont->pool_size - 1);
+	struct SStream **new = reallocarray(cont->pool, cont->nb_pool + 1, sizeof(struct SStream *));
+	if (new == NULL) {
+		sstream_destroy(&stream);
+		return;
+	}
+	new[cont->nb_pool++] = stream;
+	cont->pool           = new;
+}
+
+// returns parked input stream decoding current conference codec. Stream of same participant
+// is preferred
+static struct SStream *pool_find_locked(struct SStreamContainer *cont,
+                                        part_id_t part_id,
+                                        enum SStreamType type) {
+	size_t found = cont->nb_pool;
+	for (size_t i = cont->nb_pool; i-- > 0;) {
+		struct SStream *stream = cont->pool[i];
+		if (stream->type != type)
+			continue;
+		if (type == SSTREAM_AUDIO
+		        ? !audio_profile_equal(&stream->profile.audio, &cont->profile.audio)
+		        : !video_profile_compatible(&stream->profile.video, &cont->profile.video))
+			continue;
+		if (found == cont->nb_pool || stream->part_id == part_id)
+			found = i;
+		if (stream->part_id == part_id)
+			break;
+	}
+	return found == cont->nb_pool ? NULL : pool_take_locked(cont, found);
+}
+
 static void stream_dump(FILE *fp, struct SStream *stream) {
 	pthread_mutex_lock(&stream->mutex);
 	int queue_len = 0;
 	for (struct SFrame *f = stream->queue; f != NULL; f = f->next) queue_len++;
+	struct SJitterStats jitter;
+	sjbuf_stats(&stream->jitter, &jitter);
 	if (stream->dir == SSTREAM_INPUT)
 		fprintf(fp,
-		        "{part=%llu ts=%llu %s queued %d packets}\n",
+		        "{part=%llu ts=%llu %s %s queued %d packets, jitter buffer %zu packets "
+		        "delay=%lldms sync=%lldms jitter=%.1fms late=%llu concealed=%llu}\n",
 		        stream->part_id,
 		        stream->start_ts,
 		        stream->type == SSTREAM_AUDIO ? "audio" : "video",
-		        queue_len);
+		        stream->codec_ctx->codec->name,
+		        queue_len,
+		        jitter.depth,
+		        (long long)jitter.delay_ms,
+		        (long long)jitter.sync_delay_ms,
+		        jitter.jitter_ms,
+		        (unsigned long long)jitter.nb_late,
+		        (unsigned long long)jitter.nb_concealed);
 	else
 		fprintf(fp,
-		        "{ts=%llu %s queued %d frames}\n",
+		        "{ts=%llu %s %s preset=%s bitrate=%lld of %lld fps=%d queued %d frames}\n",
 		        stream->start_ts,
 		        stream->type == SSTREAM_AUDIO ? "audio" : "video",
+		        stream->codec_ctx == NULL ? "(none)" : stream->codec_ctx->codec->name,
+		        scodec_preset_str(stream->codec_opts.preset),
+		        stream->codec_ctx == NULL ? 0LL : (long long)stream->rate.bitrate,
+		        stream->codec_ctx == NULL ? 0LL : (long long)stream->rate.max_bitrate,
+		        stream->rate.framerate,
 		        queue_len);
 	pthread_mutex_unlock(&stream->mutex);
 }
@@ -280,6 +715,10 @@ void scont_init(struct SStreamContainer *cont,
 	cont->media_handler  = media_handler;
 	cont->packet_handler = packet_handler;
 	cont->user_data      = user_data;
+	cont->pool_size      = SELECON_STREAM_POOL_SIZE;
+	struct SMediaCaps caps;
+	media_caps_default(&caps);
+	media_caps_first(&caps, &cont->profile);
 }
 
 void scont_free(struct SStreamContainer *cont) {
@@ -293,6 +732,11 @@ void scont_free(struct SStreamContainer *cont) {
 	cont->nb_in = 0;
 	free(cont->in);
 	cont->in = NULL;
+	pool_shrink_locked(cont, 0);
+	free(cont->pool);
+	cont->pool = NULL;
+	for (int dir = 0; dir < 2; ++dir)
+		for (int type = 0; type < 2; ++type) scodec_options_free(&cont->codec_opts[dir][type]);
 	pthread_rwlock_unlock(&cont->mutex);
 	pthread_rwlock_destroy(&cont->mutex);
 }
@@ -309,78 +753,316 @@ void scont_dump(FILE *fp, struct SStreamContainer *cont) {
 		fprintf(fp, " - ");
 		stream_dump(fp, cont->out[i]);
 	}
+	fprintf(fp, "parked streams: %zu/%zu\n", cont->nb_pool, cont->pool_size);
 	pthread_rwlock_unlock(&cont->mutex);
 }
 
-static sstream_id_t sstream_create(struct SStreamContainer *cont,
-                                   enum SStreamType type,
-                                   enum SStreamDirection dir) {
-	struct SStream *stream = calloc(1, sizeof(struct SStream));
-	if (stream == NULL)
-		return stream;
-	stream->type = type;
-	stream->dir  = dir;
-
-	// init codec context
-	int codec_id =
-	    type == SSTREAM_AUDIO ? SELECON_DEFAULT_AUDIO_CODEC_ID : SELECON_DEFAULT_VIDEO_CODEC_ID;
-	const struct AVCodec *codec =
-	    dir == SSTREAM_INPUT ? avcodec_find_decoder(codec_id) : avcodec_find_encoder(codec_id);
+void scont_set_pool_size(struct SStreamContainer *cont, size_t size) {
+	pthread_rwlock_wrlock(&cont->mutex);
+	cont->pool_size = size;
+	pool_shrink_locked(cont, size);
+	pthread_rwlock_unlock(&cont->mutex);
+}
+
+enum SError scont_set_codec_options(struct SStreamContainer *cont,
+                                    enum SStreamType type,
+                                    enum SStreamDirection dir,
+                                    const struct SCodecOptions *opts) {
+	enum SError err = SELECON_OK;
+	pthread_rwlock_wrlock(&cont->mutex);
+	scodec_options_free(&cont->codec_opts[dir][type]);
+	if (opts != NULL)
+		err = scodec_options_copy(&cont->codec_opts[dir][type], opts);
+	if (dir == SSTREAM_INPUT)
+		pool_shrink_locked(cont, 0);  // parked decoders were opened with old options
+	pthread_rwlock_unlock(&cont->mutex);
+	return err;
+}
+
+void scont_get_profile(struct SStreamContainer *cont, struct SMediaProfile *profile) {
+	pthread_rwlock_rdlock(&cont->mutex);
+	*profile = cont->profile;
+	pthread_rwlock_unlock(&cont->mutex);
+}
+
+static void set_video_codec(struct SVideoProfile *dst, const struct SVideoProfile *src) {
+	dst->codec_id  = src->codec_id;
+	dst->pixel_fmt = src->pixel_fmt;
+}
+
+static void set_video_params(struct SVideoProfile *dst, const struct SVideoParams *params) {
+	dst->width     = params->width;
+	dst->height    = params->height;
+	dst->framerate = params->framerate;
+}
+
+// schedules codec reopen for output stream if its next profile differs from current one
+static void sstream_schedule_profile(struct SStream *stream,
+                                     const struct SMediaProfile *profile,
+                                     const struct SVideoParams *params) {
+	pthread_mutex_lock(&stream->mutex);
+	if (!stream->reconfigure)
+		stream->next_profile = stream->profile;
+	if (profile != NULL) {
+		stream->next_profile.audio = profile->audio;
+		set_video_codec(&stream->next_profile.video, &profile->video);
+	}
+	if (params != NULL)
+		set_video_params(&stream->next_profile.video, params);
+	stream->reconfigure =
+	    stream->type == SSTREAM_AUDIO
+	        ? !audio_profile_equal(&stream->profile.audio, &stream->next_profile.audio)
+	        : !video_profile_equal(&stream->profile.video, &stream->next_profile.video);
+	pthread_mutex_unlock(&stream->mutex);
+}
+
+void scont_set_profile(struct SStreamContainer *cont, const struct SMediaProfile *profile) {
+	pthread_rwlock_wrlock(&cont->mutex);
+	cont->profile.audio = profile->audio;
+	set_video_codec(&cont->profile.video, &profile->video);
+	for (size_t i = 0; i < cont->nb_out; ++i) sstream_schedule_profile(cont->out[i], profile, NULL);
+	pthread_rwlock_unlock(&cont->mutex);
+}
+
+static bool has_output_stream_locked(struct SStreamContainer *cont, sstream_id_t stream) {
+	for (size_t i = 0; i < cont->nb_out; ++i)
+		if (cont->out[i] == stream)
+			return true;
+	return false;
+}
+
+enum SError scont_set_video_params(struct SStreamContainer *cont,
+                                   sstream_id_t stream,
+                                   const struct SVideoParams *params) {
+	if (params == NULL || !video_params_valid(params))
+		return SELECON_INVALID_ARG;
+	enum SError err = SELECON_OK;
+	pthread_rwlock_wrlock(&cont->mutex);
+	if (stream == NULL) {
+		set_video_params(&cont->profile.video, params);
+		for (size_t i = 0; i < cont->nb_out; ++i)
+			if (cont->out[i]->type == SSTREAM_VIDEO)
+				sstream_schedule_profile(cont->out[i], NULL, params);
+	} else if (!has_output_stream_locked(cont, stream))
+		err = SELECON_INVALID_STREAM;
+	else if (stream->type != SSTREAM_VIDEO || stream->dir != SSTREAM_OUTPUT)
+		err = SELECON_INVALID_ARG;
+	else
+		sstream_schedule_profile(stream, NULL, params);
+	pthread_rwlock_unlock(&cont->mutex);
+	return err;
+}
+
+static void free_video_layer(struct SVideoLayer *layer) {
+	avcodec_free_context(&layer->codec_ctx);
+	sws_freeContext(layer->sws);
+	layer->sws = NULL;
+	av_frame_free(&layer->frame);
+}
+
+static void close_video_layers(struct SStream *stream) {
+	for (int i = 1; i < stream->nb_layers; ++i) free_video_layer(&stream->layers[i - 1]);
+	stream->nb_layers = 0;
+}
+
+static enum SError open_video_layer(struct SStream *stream,
+                                    struct SVideoLayer *layer,
+                                    const struct AVCodecContext *prev,
+                                    int index) {
+	const struct AVCodecContext *main_ctx = stream->codec_ctx;
+	layer->codec_ctx                      = avcodec_alloc_context3(main_ctx->codec);
+	layer->frame                          = av_frame_alloc();
+	if (layer->codec_ctx == NULL || layer->frame == NULL)
+		return SELECON_MEMORY_ERROR;
+	struct AVCodecContext *ctx = layer->codec_ctx;
+	ctx->pix_fmt               = main_ctx->pix_fmt;
+	ctx->framerate             = main_ctx->framerate;
+	ctx->width                 = (main_ctx->width >> index) & ~1;
+	ctx->height                = (main_ctx->height >> index) & ~1;
+	ctx->sample_aspect_ratio   = main_ctx->sample_aspect_ratio;
+	ctx->time_base             = main_ctx->time_base;
+	// preset bitrate follows layer resolution, explicit one is divided like pixel count
+	struct SCodecOptions opts = {0};
+	enum SError err = scodec_options_preset(&opts, stream->codec_opts.preset, ctx);
+	if (err == SELECON_OK)
+		err = scodec_options_merge(&opts, &stream->codec_opts);
+	if (stream->codec_opts.bit_rate > 0) {
+		opts.bit_rate >>= 2 * index;
+		opts.max_rate >>= 2 * index;
+		opts.buffer_size >>= 2 * index;
+	}
+	if (err == SELECON_OK && scodec_open(ctx, ctx->codec, &opts) < 0)
+		err = SELECON_AVERROR;
+	scodec_options_free(&opts);
+	if (err != SELECON_OK)
+		return err;
+	layer->frame->format = ctx->pix_fmt;
+	layer->frame->width  = ctx->width;
+	layer->frame->height = ctx->height;
+	if (av_frame_get_buffer(layer->frame, 0) < 0)
+		return SELECON_MEMORY_ERROR;
+	layer->sws = sws_getContext(prev->width,
+	                            prev->height,
+	                            prev->pix_fmt,
+	                            ctx->width,
+	                            ctx->height,
+	                            ctx->pix_fmt,
+	                            SWS_BILINEAR,
+	                            NULL,
+	                            NULL,
+	                            NULL);
+	return layer->sws == NULL ? SELECON_AVERROR : SELECON_OK;
+}
+
+// opens encoders of simulcast layers below main one. Stream keeps layers opened successfully
+static void open_video_layers(struct SStream *stream, int nb_layers) {
+	stream->nb_layers = 1;
+	if (nb_layers > SELECON_MAX_SIMULCAST_LAYERS)
+		nb_layers = SELECON_MAX_SIMULCAST_LAYERS;
+	const struct AVCodecContext *prev = stream->codec_ctx;
+	for (int i = 1; i < nb_layers; ++i) {
+		if ((stream->codec_ctx->height >> i) < SELECON_SIMULCAST_MIN_HEIGHT)
+			break;
+		struct SVideoLayer *layer = &stream->layers[i - 1];
+		enum SError err           = open_video_layer(stream, layer, prev, i);
+		if (err != SELECON_OK) {
+			fprintf(stderr, "failed to open simulcast layer %d: %s\n", i, serror_str(err));
+			free_video_layer(layer);
+			break;
+		}
+		stream->nb_layers++;
+		prev = layer->codec_ctx;
+	}
+}
+
+// opens codec and filter graph according to stream->profile
+static enum SError sstream_open_codec(struct SStream *stream) {
+	const struct SAudioProfile *aprof = &stream->profile.audio;
+	const struct SVideoProfile *vprof = &stream->profile.video;
+	enum AVCodecID codec_id = stream->type == SSTREAM_AUDIO ? aprof->codec_id : vprof->codec_id;
+	const struct AVCodec *codec     = stream->dir == SSTREAM_INPUT ? avcodec_find_decoder(codec_id)
+	                                                               : avcodec_find_encoder(codec_id);
 	if (codec == NULL) {
-		perror("avcodec_find_coder");
-		goto codec_err;
+		fprintf(stderr, "coder for %s not found\n", avcodec_get_name(codec_id));
+		return SELECON_INVALID_ARG;
 	}
 	stream->codec_ctx = avcodec_alloc_context3(codec);
 	if (stream->codec_ctx == NULL) {
 		perror("avcodec_alloc_context3");
-		goto codec_err;
+		return SELECON_MEMORY_ERROR;
 	}
-	if (type == SSTREAM_AUDIO) {
-		stream->codec_ctx->sample_fmt  = SELECON_DEFAULT_AUDIO_SAMPLE_FMT;
-		stream->codec_ctx->sample_rate = SELECON_DEFAULT_AUDIO_SAMPLE_RATE;
-		stream->codec_ctx->frame_size  = SELECON_DEFAULT_AUDIO_FRAME_SIZE;
-		av_channel_layout_default(&stream->codec_ctx->ch_layout, SELECON_DEFAULT_AUDIO_CHANNELS);
+	if (stream->type == SSTREAM_AUDIO) {
+		stream->codec_ctx->sample_fmt  = aprof->sample_fmt;
+		stream->codec_ctx->sample_rate = aprof->sample_rate;
+		stream->codec_ctx->frame_size  = aprof->frame_size;
+		av_channel_layout_default(&stream->codec_ctx->ch_layout, aprof->nb_channels);
 	} else {  // video
-		stream->codec_ctx->pix_fmt             = SELECON_DEFAULT_VIDEO_PIXEL_FMT;
-		stream->codec_ctx->framerate           = av_make_q(1, SELECON_DEFAULT_VIDEO_FPS);
-		stream->codec_ctx->width               = SELECON_DEFAULT_VIDEO_WIDTH;
-		stream->codec_ctx->height              = SELECON_DEFAULT_VIDEO_HEIGHT;
+		stream->codec_ctx->pix_fmt             = vprof->pixel_fmt;
+		stream->codec_ctx->framerate           = av_make_q(vprof->framerate, 1);
+		stream->codec_ctx->width               = vprof->width;
+		stream->codec_ctx->height              = vprof->height;
 		stream->codec_ctx->sample_aspect_ratio = av_make_q(1, 1);
 	}
 	stream->codec_ctx->time_base = av_make_q(1, 1000);
-	if (dir == SSTREAM_INPUT)
+	if (stream->dir == SSTREAM_INPUT)
 		stream->codec_ctx->pkt_timebase = av_make_q(1, 1000);
-	if (avcodec_open2(stream->codec_ctx, codec, NULL) < 0) {
-		perror("avcodec_open2");
-		goto codec_err;
+	// preset goes first, explicitly given options override it
+	struct SCodecOptions opts = {0};
+	enum SError err = scodec_options_preset(&opts, stream->codec_opts.preset, stream->codec_ctx);
+	if (err == SELECON_OK)
+		err = scodec_options_merge(&opts, &stream->codec_opts);
+	if (err == SELECON_OK && stream->type == SSTREAM_AUDIO && stream->dir == SSTREAM_OUTPUT &&
+	    strcmp(codec->name, "libopus") == 0) {
+		// libopus ignores frame_size and takes frame duration option instead
+		char duration[16];
+		snprintf(duration, sizeof(duration), "%g", aprof->frame_size * 1000.0 / aprof->sample_rate);
+		err = scodec_options_set(&opts, "frame_duration", duration);
+	}
+	if (err == SELECON_OK && scodec_open(stream->codec_ctx, codec, &opts) < 0)
+		err = SELECON_AVERROR;
+	stream->dtx = stream->type == SSTREAM_AUDIO && stream->dir == SSTREAM_OUTPUT && opts.dtx > 0;
+	int nb_layers           = opts.simulcast;
+	stream->temporal_layers = scodec_temporal_layers(codec, &opts);
+	scodec_options_free(&opts);
+	if (err != SELECON_OK) {
+		fprintf(stderr, "failed to open %s: %s\n", codec->name, serror_str(err));
+		avcodec_free_context(&stream->codec_ctx);
+		return err;
 	}
 	// make some checks to be sure format is not changed
-	if (type == SSTREAM_AUDIO) {
-		assert(stream->codec_ctx->sample_fmt == SELECON_DEFAULT_AUDIO_SAMPLE_FMT);
-		assert(stream->codec_ctx->sample_rate == SELECON_DEFAULT_AUDIO_SAMPLE_RATE);
-		assert(stream->codec_ctx->ch_layout.nb_channels == SELECON_DEFAULT_AUDIO_CHANNELS);
+	if (stream->type == SSTREAM_AUDIO) {
+		if (stream->codec_ctx->sample_fmt != aprof->sample_fmt ||
+		    stream->codec_ctx->sample_rate != aprof->sample_rate ||
+		    stream->codec_ctx->ch_layout.nb_channels != aprof->nb_channels) {
+			fprintf(stderr, "%s changed audio format\n", codec->name);
+			avcodec_free_context(&stream->codec_ctx);
+			return SELECON_AVERROR;
+		}
 		mfgraph_init_audio(&stream->filter_graph,
-		                   SELECON_DEFAULT_AUDIO_SAMPLE_FMT,
-		                   SELECON_DEFAULT_AUDIO_SAMPLE_RATE,
-		                   SELECON_DEFAULT_AUDIO_CHANNELS,
+		                   aprof->sample_fmt,
+		                   aprof->sample_rate,
+		                   aprof->nb_channels,
 		                   stream->codec_ctx->frame_size);
+		svad_init(&stream->vad,
+		          SELECON_VAD_THRESHOLD,
+		          aprof->sample_rate * SELECON_VAD_HANGOVER / 1000);
 	} else {
-		assert(stream->codec_ctx->pix_fmt == SELECON_DEFAULT_VIDEO_PIXEL_FMT);
-		assert(stream->codec_ctx->width == SELECON_DEFAULT_VIDEO_WIDTH);
-		assert(stream->codec_ctx->height == SELECON_DEFAULT_VIDEO_HEIGHT);
-		mfgraph_init_video(&stream->filter_graph,
-		                   SELECON_DEFAULT_VIDEO_PIXEL_FMT,
-		                   SELECON_DEFAULT_VIDEO_WIDTH,
-		                   SELECON_DEFAULT_VIDEO_HEIGHT);
-	}
-	// init handler thread stuff
+		if (stream->codec_ctx->pix_fmt != vprof->pixel_fmt ||
+		    stream->codec_ctx->width != vprof->width ||
+		    stream->codec_ctx->height != vprof->height) {
+			fprintf(stderr, "%s changed video format\n", codec->name);
+			avcodec_free_context(&stream->codec_ctx);
+			return SELECON_AVERROR;
+		}
+		mfgraph_init_video(&stream->filter_graph, vprof->pixel_fmt, vprof->width, vprof->height);
+		if (stream->dir == SSTREAM_OUTPUT) {
+			for (int i = 0; i < SELECON_MAX_SIMULCAST_LAYERS; ++i)
+				scodec_temporal_init(&stream->temporal[i], stream->temporal_layers);
+			open_video_layers(stream, nb_layers);
+		}
+	}
+	// reopened encoder starts from configured rate, receivers bring it down again if needed
+	if (stream->dir == SSTREAM_OUTPUT) {
+		pthread_mutex_lock(&stream->mutex);
+		srate_init(&stream->rate,
+		           stream->codec_ctx->bit_rate,
+		           stream->type == SSTREAM_VIDEO ? vprof->framerate : 0);
+		stream->rate_bitrate   = stream->codec_ctx->bit_rate;
+		stream->nb_sent_layers = 0;  // layers may change, receivers start from keyframe
+		pthread_mutex_unlock(&stream->mutex);
+	}
+	return SELECON_OK;
+}
+
+static void sstream_close_codec(struct SStream *stream) {
+	close_video_layers(stream);
+	mfgraph_free(&stream->filter_graph);
+	avcodec_free_context(&stream->codec_ctx);
+}
+
+static sstream_id_t sstream_create(struct SStreamContainer *cont,
+                                   enum SStreamType type,
+                                   enum SStreamDirection dir,
+                                   const struct SMediaProfile *profile,
+                                   const struct SCodecOptions *opts) {
+	struct SStream *stream = calloc(1, sizeof(struct SStream));
+	if (stream == NULL)
+		return stream;
+	stream->type    = type;
+	stream->dir     = dir;
+	stream->profile = *profile;
+	// init handler thread stuff. Opened codec sets up rate control under mutex already
 	init_recursive_mutex(&stream->mutex);
 	pthread_cond_init(&stream->cond, NULL);
-	pthread_create(&stream->handler_thread, NULL, stream_worker, stream);
-	// TODO: pthread_create ret code check
-	pthread_setname_np(stream->handler_thread, "stream");
+	if (opts != NULL && scodec_options_copy(&stream->codec_opts, opts) != SELECON_OK)
+		goto codec_err;
+	if (sstream_open_codec(stream) != SELECON_OK)
+		goto codec_err;
 	return stream;
 codec_err:
+	scodec_options_free(&stream->codec_opts);
+	pthread_cond_destroy(&stream->cond);
+	pthread_mutex_destroy(&stream->mutex);
 	free(stream);
 	return NULL;
 }
@@ -414,12 +1096,45 @@ enum SError scont_alloc_stream(struct SStreamContainer *cont,
                                timestamp_t start_ts,
                                enum SStreamType type,
                                enum SStreamDirection dir,
+                               const struct SVideoParams *params,
+                               const struct SCodecOptions *opts,
                                sstream_id_t *stream) {
-	*stream = sstream_create(cont, type, dir);
-	if (*stream == NULL)
-		return SELECON_MEMORY_ERROR;
-	(*stream)->part_id  = part_id;
-	(*stream)->start_ts = start_ts;
+	if (type == SSTREAM_VIDEO && params != NULL && !video_params_valid(params))
+		return SELECON_INVALID_ARG;
+	struct SCodecOptions default_opts = {0};
+	pthread_rwlock_wrlock(&cont->mutex);
+	struct SMediaProfile profile = cont->profile;
+	enum SError err              = SELECON_OK;
+	*stream                      = NULL;
+	if (type == SSTREAM_VIDEO && params != NULL)
+		set_video_params(&profile.video, params);
+	if (opts == NULL) {
+		// parked decoders are opened with default options
+		if (dir == SSTREAM_INPUT)
+			*stream = pool_find_locked(cont, part_id, type);
+		err  = scodec_options_copy(&default_opts, &cont->codec_opts[dir][type]);
+		opts = &default_opts;
+	}
+	pthread_rwlock_unlock(&cont->mutex);
+	if (err == SELECON_OK && *stream == NULL) {
+		*stream = sstream_create(cont, type, dir, &profile, opts);
+		if (*stream == NULL)
+			err = SELECON_MEMORY_ERROR;
+	}
+	scodec_options_free(&default_opts);
+	if (err != SELECON_OK) {
+		if (*stream != NULL)
+			sstream_destroy(stream);
+		return err;
+	}
+	(*stream)->part_id        = part_id;
+	(*stream)->start_ts       = start_ts;
+	(*stream)->last_packet_ts = get_curr_timestamp();
+	// decoder of new or reused stream starts from keyframe only
+	(*stream)->keyframe_wait       = dir == SSTREAM_INPUT && type == SSTREAM_VIDEO;
+	(*stream)->keyframe_request_ts = 0;
+	(*stream)->keyframe_request    = false;
+	(*stream)->keyframe_ts         = 0;
 	if (dir == SSTREAM_INPUT) {
 		(*stream)->media_handler   = cont->media_handler;
 		(*stream)->media_user_data = cont->user_data;
@@ -427,12 +1142,32 @@ enum SError scont_alloc_stream(struct SStreamContainer *cont,
 		(*stream)->packet_handler   = cont->packet_handler;
 		(*stream)->packet_user_data = cont->user_data;
 	}
-	enum SError err = insert_stream(cont, *stream);
+	err = sstream_start(*stream);
+	if (err != SELECON_OK) {
+		sstream_destroy(stream);
+		return err;
+	}
+	err = insert_stream(cont, *stream);
 	if (err != SELECON_OK)
 		sstream_free(stream);
 	return err;
 }
 
+enum SError scont_get_input_stream(struct SStreamContainer *cont,
+                                   part_id_t part_id,
+                                   timestamp_t start_ts,
+                                   enum SStreamType type,
+                                   sstream_id_t *stream) {
+	*stream = scont_find_stream(cont, part_id, type, SSTREAM_INPUT);
+	if (*stream != NULL)
+		return SELECON_OK;
+	fprintf(stderr,
+	        "creating %s input stream for part_id = %llu\n",
+	        type == SSTREAM_AUDIO ? "audio" : "video",
+	        part_id);
+	return scont_alloc_stream(cont, part_id, start_ts, type, SSTREAM_INPUT, NULL, NULL, stream);
+}
+
 void scont_close_stream(struct SStreamContainer *cont, sstream_id_t *stream) {
 	if (*stream == NULL)
 		return;
@@ -469,7 +1204,7 @@ void scont_close_streams(struct SStreamContainer *cont, part_id_t part_id) {
 	pthread_rwlock_wrlock(&cont->mutex);
 	for (size_t i = 0; i < cont->nb_in; ++i) {
 		if (cont->in[i]->part_id == part_id) {
-			sstream_free(&cont->in[i]);
+			sstream_park_locked(cont, cont->in[i]);
 			if (i + 1 < cont->nb_in)
 				memmove(&cont->in[i],
 				        &cont->in[i + 1],
@@ -492,6 +1227,39 @@ void scont_close_streams(struct SStreamContainer *cont, part_id_t part_id) {
 	pthread_rwlock_unlock(&cont->mutex);
 }
 
+size_t scont_close_idle_streams(struct SStreamContainer *cont, timestamp_t timeout) {
+	size_t closed = 0;
+	pthread_rwlock_wrlock(&cont->mutex);
+	for (size_t i = 0; i < cont->nb_in; ++i) {
+		struct SStream *stream = cont->in[i];
+		pthread_mutex_lock(&stream->mutex);
+		timestamp_t now = get_curr_timestamp();
+		bool idle = stream->queue == NULL && now - stream->last_packet_ts > timeout * 1000000ULL;
+		pthread_mutex_unlock(&stream->mutex);
+		if (!idle)
+			continue;
+		fprintf(stderr,
+		        "closing idle %s input stream of part_id = %llu\n",
+		        stream->type == SSTREAM_AUDIO ? "audio" : "video",
+		        stream->part_id);
+		sstream_free(&cont->in[i]);
+		if (i + 1 < cont->nb_in)
+			memmove(
+			    &cont->in[i], &cont->in[i + 1], (cont->nb_in - i - 1) * sizeof(struct SStream *));
+		cont->nb_in--;
+		--i;
+		++closed;
+	}
+	// pool is sorted by parking time
+	timestamp_t now = get_curr_timestamp();
+	while (cont->nb_pool > 0 && now - cont->pool[0]->last_packet_ts > timeout * 1000000ULL) {
+		struct SStream *stream = pool_take_locked(cont, 0);
+		sstream_destroy(&stream);
+	}
+	pthread_rwlock_unlock(&cont->mutex);
+	return closed;
+}
+
 bool scont_has_stream(struct SStreamContainer *cont, sstream_id_t stream) {
 	pthread_rwlock_rdlock(&cont->mutex);
 	bool has = false;
@@ -543,6 +1311,32 @@ enum SError scont_push_frame(struct SStreamContainer *cont,
 	return err;
 }
 
+// cont->mutex must be locked. Aligns playout of audio and video input streams of participant
+// stream belongs to. Stream mutexes are taken audio first. Stream left alone plays without delay
+static void lipsync_locked(struct SStreamContainer *cont, struct SStream *stream) {
+	struct SStream *media[2] = {NULL, NULL};
+	for (size_t i = 0; i < cont->nb_in; ++i)
+		if (cont->in[i]->part_id == stream->part_id)
+			media[cont->in[i]->type == SSTREAM_AUDIO ? 0 : 1] = cont->in[i];
+	if (media[0] == NULL || media[1] == NULL) {
+		pthread_mutex_lock(&stream->mutex);
+		stream->jitter.sync_delay_ms = 0;
+		pthread_mutex_unlock(&stream->mutex);
+		return;
+	}
+	pthread_mutex_lock(&media[0]->mutex);
+	pthread_mutex_lock(&media[1]->mutex);
+	int64_t delays[2] = {media[0]->jitter.sync_delay_ms, media[1]->jitter.sync_delay_ms};
+	struct SLipSyncStats stats;
+	sjbuf_lipsync(&media[0]->jitter, &media[1]->jitter, &stats);
+	// workers sleep until packets are due, which changed
+	for (int i = 0; i < 2; ++i)
+		if (media[i]->jitter.sync_delay_ms != delays[i])
+			pthread_cond_signal(&media[i]->cond);
+	pthread_mutex_unlock(&media[1]->mutex);
+	pthread_mutex_unlock(&media[0]->mutex);
+}
+
 enum SError scont_push_packet(struct SStreamContainer *cont,
                               sstream_id_t stream,
                               struct AVPacket **packet) {
@@ -550,8 +1344,231 @@ enum SError scont_push_packet(struct SStreamContainer *cont,
 	pthread_rwlock_rdlock(&cont->mutex);
 	if (!scont_has_stream(cont, stream))
 		err = SELECON_INVALID_STREAM;
-	else
-		insert_packet(stream, packet);
+	else {
+		pthread_mutex_lock(&stream->mutex);
+		stream->last_packet_ts = get_curr_timestamp();
+		if ((*packet)->pts != AV_NOPTS_VALUE) {
+			int64_t transit = (int64_t)(stream->last_packet_ts - stream->start_ts) -
+			                  (*packet)->pts * 1000000LL;
+			srate_meter_packet(
+			    &stream->meter, (*packet)->size, transit, stream->last_packet_ts);
+		}
+		if (stream->keyframe_wait && ((*packet)->flags & AV_PKT_FLAG_KEY))
+			stream->keyframe_wait = false;
+		// decoder would only fail on frames referencing ones it never got
+		if (stream->keyframe_wait)
+			av_packet_free(packet);
+		else
+			insert_packet(stream, packet);
+		pthread_mutex_unlock(&stream->mutex);
+		lipsync_locked(cont, stream);
+	}
 	pthread_rwlock_unlock(&cont->mutex);
 	return err;
 }
+
+enum SError scont_skip_packet(struct SStreamContainer *cont, sstream_id_t stream) {
+	enum SError err = SELECON_OK;
+	pthread_rwlock_rdlock(&cont->mutex);
+	if (!scont_has_stream(cont, stream))
+		err = SELECON_INVALID_STREAM;
+	else {
+		// skipped packet still proves sender is alive, stream must not be closed as idle
+		pthread_mutex_lock(&stream->mutex);
+		stream->last_packet_ts = get_curr_timestamp();
+		stream->resync         = true;
+		stream->keyframe_wait  = stream->type == SSTREAM_VIDEO;
+		sjbuf_restart(&stream->jitter);  // gap is expected, nothing to conceal
+		pthread_mutex_unlock(&stream->mutex);
+	}
+	pthread_rwlock_unlock(&cont->mutex);
+	return err;
+}
+
+size_t scont_queued_packets(struct SStreamContainer *cont, sstream_id_t stream) {
+	size_t count = 0;
+	pthread_rwlock_rdlock(&cont->mutex);
+	if (scont_has_stream(cont, stream)) {
+		pthread_mutex_lock(&stream->mutex);
+		for (struct SFrame *f = stream->queue; f != NULL; f = f->next) ++count;
+		if (stream->dir == SSTREAM_INPUT)
+			count += sjbuf_due(&stream->jitter, get_curr_timestamp());
+		pthread_mutex_unlock(&stream->mutex);
+	}
+	pthread_rwlock_unlock(&cont->mutex);
+	return count;
+}
+
+enum SError scont_jitter_stats(struct SStreamContainer *cont,
+                               sstream_id_t stream,
+                               struct SJitterStats *stats) {
+	enum SError err = SELECON_OK;
+	pthread_rwlock_rdlock(&cont->mutex);
+	if (!scont_has_stream(cont, stream))
+		err = SELECON_INVALID_STREAM;
+	else if (stream->dir != SSTREAM_INPUT)
+		err = SELECON_INVALID_ARG;
+	else {
+		pthread_mutex_lock(&stream->mutex);
+		sjbuf_stats(&stream->jitter, stats);
+		pthread_mutex_unlock(&stream->mutex);
+	}
+	pthread_rwlock_unlock(&cont->mutex);
+	return err;
+}
+
+bool scont_receiver_report(struct SStreamContainer *cont,
+                           sstream_id_t stream,
+                           struct SReceiverReport *report) {
+	bool arrived = false;
+	pthread_rwlock_rdlock(&cont->mutex);
+	if (scont_has_stream(cont, stream) && stream->dir == SSTREAM_INPUT) {
+		pthread_mutex_lock(&stream->mutex);
+		timestamp_t now = get_curr_timestamp();
+		size_t depth    = sjbuf_due(&stream->jitter, now);
+		for (struct SFrame *f = stream->queue; f != NULL; f = f->next) ++depth;
+		struct SJitterStats jitter;
+		sjbuf_stats(&stream->jitter, &jitter);
+		arrived = srate_meter_report(
+		    &stream->meter, &jitter, depth, sjbuf_lag(&stream->jitter, now), now, report);
+		pthread_mutex_unlock(&stream->mutex);
+	}
+	pthread_rwlock_unlock(&cont->mutex);
+	return arrived;
+}
+
+enum SError scont_rate_stats(struct SStreamContainer *cont,
+                             sstream_id_t stream,
+                             struct SRateStats *stats) {
+	enum SError err = SELECON_INVALID_STREAM;
+	pthread_rwlock_rdlock(&cont->mutex);
+	if (scont_has_stream(cont, stream) && stream->dir == SSTREAM_OUTPUT) {
+		pthread_mutex_lock(&stream->mutex);
+		stats->max_bitrate   = stream->rate.max_bitrate;
+		stats->bitrate       = stream->rate.bitrate;
+		stats->max_framerate = stream->rate.max_framerate;
+		stats->framerate     = stream->rate.framerate;
+		stats->nb_receivers  = stream->rate.nb_receivers;
+		pthread_mutex_unlock(&stream->mutex);
+		err = SELECON_OK;
+	}
+	pthread_rwlock_unlock(&cont->mutex);
+	return err;
+}
+
+// stream->mutex must be locked
+static struct SSentLayer *find_sent_layer(struct SStream *stream, part_id_t receiver) {
+	for (size_t i = 0; i < stream->nb_sent_layers; ++i)
+		if (stream->sent_layers[i].part_id == receiver)
+			return &stream->sent_layers[i];
+	return NULL;
+}
+
+void scont_rate_report(struct SStreamContainer *cont,
+                       enum SStreamType type,
+                       part_id_t receiver,
+                       const struct SReceiverReport *report) {
+	pthread_rwlock_rdlock(&cont->mutex);
+	timestamp_t now = get_curr_timestamp();
+	for (size_t i = 0; i < cont->nb_out; ++i) {
+		struct SStream *stream = cont->out[i];
+		if (stream->type != type)
+			continue;
+		pthread_mutex_lock(&stream->mutex);
+		struct SReceiverReport scaled = *report;
+		struct SSentLayer *sent       = find_sent_layer(stream, receiver);
+		// lower simulcast layer carries quarter of bitrate of layer above it
+		if (sent != NULL && sent->layer > 0) {
+			uint64_t bandwidth    = (uint64_t)report->bandwidth_kbps << 2 * sent->layer;
+			scaled.bandwidth_kbps = bandwidth > UINT32_MAX ? UINT32_MAX : (uint32_t)bandwidth;
+		}
+		srate_report(&stream->rate, receiver, &scaled, now);
+		pthread_mutex_unlock(&stream->mutex);
+	}
+	pthread_rwlock_unlock(&cont->mutex);
+}
+
+enum SError scont_lipsync_stats(struct SStreamContainer *cont,
+                                part_id_t part_id,
+                                struct SLipSyncStats *stats) {
+	enum SError err          = SELECON_INVALID_STREAM;
+	struct SStream *media[2] = {NULL, NULL};
+	pthread_rwlock_rdlock(&cont->mutex);
+	for (size_t i = 0; i < cont->nb_in; ++i)
+		if (cont->in[i]->part_id == part_id)
+			media[cont->in[i]->type == SSTREAM_AUDIO ? 0 : 1] = cont->in[i];
+	if (media[0] != NULL && media[1] != NULL) {
+		pthread_mutex_lock(&media[0]->mutex);
+		pthread_mutex_lock(&media[1]->mutex);
+		if (sjbuf_lipsync_stats(&media[0]->jitter, &media[1]->jitter, stats))
+			err = SELECON_OK;
+		pthread_mutex_unlock(&media[1]->mutex);
+		pthread_mutex_unlock(&media[0]->mutex);
+	}
+	pthread_rwlock_unlock(&cont->mutex);
+	return err;
+}
+
+int sstream_sent_layer(struct SStream *stream,
+                       part_id_t receiver,
+                       unsigned epoch,
+                       int wanted,
+                       int layer,
+                       bool keyframe) {
+	pthread_mutex_lock(&stream->mutex);
+	struct SSentLayer *entry = find_sent_layer(stream, receiver);
+	if (entry == NULL) {
+		if (stream->nb_sent_layers < SELECON_RATE_MAX_RECEIVERS)
+			entry = &stream->sent_layers[stream->nb_sent_layers++];
+		else {
+			entry = &stream->sent_layers[0];
+			for (size_t i = 1; i < stream->nb_sent_layers; ++i)
+				if (stream->sent_layers[i].seq < entry->seq)
+					entry = &stream->sent_layers[i];
+		}
+		entry->part_id = receiver;
+		entry->epoch   = epoch;
+		entry->layer   = -1;
+	} else if (entry->epoch != epoch) {
+		entry->epoch = epoch;
+		entry->layer = -1;
+	}
+	if (layer == wanted && keyframe)
+		entry->layer = wanted;
+	entry->seq = ++stream->sent_seq;
+	int sent   = entry->layer;
+	pthread_mutex_unlock(&stream->mutex);
+	return sent;
+}
+
+void sstream_request_keyframe(struct SStream *stream) {
+	if (stream->type != SSTREAM_VIDEO || stream->dir != SSTREAM_OUTPUT)
+		return;
+	pthread_mutex_lock(&stream->mutex);
+	stream->keyframe_request = true;
+	pthread_mutex_unlock(&stream->mutex);
+}
+
+void scont_request_keyframe(struct SStreamContainer *cont, sstream_id_t stream) {
+	pthread_rwlock_rdlock(&cont->mutex);
+	for (size_t i = 0; i < cont->nb_out; ++i)
+		if (stream == NULL || cont->out[i] == stream)
+			sstream_request_keyframe(cont->out[i]);
+	pthread_rwlock_unlock(&cont->mutex);
+}
+
+bool scont_keyframe_needed(struct SStreamContainer *cont, sstream_id_t stream) {
+	bool needed = false;
+	pthread_rwlock_rdlock(&cont->mutex);
+	if (scont_has_stream(cont, stream)) {
+		pthread_mutex_lock(&stream->mutex);
+		timestamp_t now = get_curr_timestamp();
+		needed          = stream->keyframe_wait && now - stream->keyframe_request_ts >=
+		                                      SELECON_KEYFRAME_REQUEST_INTERVAL * 1000000ULL;
+		if (needed)
+			stream->keyframe_request_ts = now;
+		pthread_mutex_unlock(&stream->mutex);
+	}
+	pthread_rwlock_unlock(&cont->mutex);
+	return needed;
+}
@@ -4,17 +4,23 @@
 #include <libavcodec/packet.h>
 #include <libavfilter/avfilter.h>
 #include <libavutil/frame.h>
-#include <libswresample/swresample.h>
+#include <libswscale/swscale.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
+#include "codec_options.h"
+#include "config.h"
 #include "error.h"
+#include "jitter_buffer.h"
 #include "media_filters.h"
+#include "media_profile.h"
 #include "participant.h"
+#include "rate_control.h"
 #include "stypes.h"
+#include "vad.h"
 
 enum SStreamType {
 	SSTREAM_AUDIO,
@@ -29,9 +35,27 @@ enum SStreamDirection {
 struct SFrame {
 	struct AVFrame *avframe;    // valid for output streams
 	struct AVPacket *avpacket;  // valid for input streams
+	timestamp_t arrival_ts;     // of packet
 	struct SFrame *next;
 };
 
+// lower resolution encoder of output video stream. Its frames are scaled from frames of previous
+// layer, so every layer downscales by two only once
+struct SVideoLayer {
+	struct AVCodecContext *codec_ctx;
+	struct SwsContext *sws;
+	struct AVFrame *frame;
+};
+
+// simulcast layer output video stream sends to receiver, -1 until keyframe of wanted layer. Entry
+// starts over when video epoch of receiver changes
+struct SSentLayer {
+	part_id_t part_id;
+	unsigned epoch;
+	int layer;
+	uint64_t seq;  // of last packet offered to receiver, least recent entry is replaced
+};
+
 struct SStream {
 	enum SStreamType type;
 	enum SStreamDirection dir;
@@ -40,6 +64,25 @@ struct SStream {
 	// conference start timestamp
 	timestamp_t start_ts;
 
+	// input streams only. Time of last pushed packet (or parking time for pooled streams),
+	// idle streams are closed
+	timestamp_t last_packet_ts;
+
+	// input streams only. Packets were skipped by receive policy, decoder state is stale and is
+	// flushed before next packet
+	bool resync;
+
+	// input video streams. Decoder has no keyframe to start from: stream is new or reused, packets
+	// were skipped or decoder failed. Packets are dropped until keyframe comes
+	bool keyframe_wait;
+	timestamp_t keyframe_request_ts;  // last time sender was asked for keyframe
+
+	// input streams. Worker moves arrived packets here and decodes them at their playout time
+	struct SJitterBuffer jitter;
+
+	// input streams. Arrivals measured for receiver reports
+	struct SRateMeter meter;
+
 	// callback valid for input streams. Called for each received media frame
 	media_handler_fn_t media_handler;
 	void *media_user_data;
@@ -49,15 +92,59 @@ struct SStream {
 	void *packet_user_data;
 
 	struct AVCodecContext *codec_ctx;
-	struct SwrContext *swr_context;  // resampling to default audio format
+	struct SCodecOptions codec_opts;  // options requested for this stream
+	struct SMediaProfile profile;     // codec parameters, only part matching type is used
+
+	// output streams reopen codec with next_profile before encoding next frame
+	struct SMediaProfile next_profile;
+	bool reconfigure;
 	struct MediaFilterGraph filter_graph;
 
+	// output video streams with simulcast. codec_ctx encodes layer 0 (full resolution), layers[i]
+	// encodes layer i + 1. Packet handler gets layer index in packet->stream_index
+	struct SVideoLayer layers[SELECON_MAX_SIMULCAST_LAYERS - 1];
+	int nb_layers;  // including layer 0
+
+	// output video streams with temporal scalability. Layer of packet is taken from layer its frame
+	// got when submitted to encoder of its simulcast layer, temporal_id is valid for packet passed
+	// to packet handler
+	int temporal_layers;
+	struct STemporalTracker temporal[SELECON_MAX_SIMULCAST_LAYERS];
+	int temporal_id;
+
+	// output video streams. Layers sent to receivers, guarded by mutex
+	struct SSentLayer sent_layers[SELECON_RATE_MAX_RECEIVERS];
+	size_t nb_sent_layers;
+	uint64_t sent_seq;
+
+	// output video streams. Requested keyframe is forced on all layers with next frame, but not
+	// earlier than SELECON_KEYFRAME_MIN_INTERVAL after previous keyframe
+	bool keyframe_request;
+	timestamp_t keyframe_ts;
+
+	// output streams. Congestion control fed by receiver reports. Worker scales encoder rate
+	// settings from rate_bitrate, which encoders run at, to rate.bitrate and decimates video
+	// frames down to rate.framerate
+	struct SRateControl rate;
+	int64_t rate_bitrate;
+
+	// output audio streams with DTX do not encode frames VAD finds silent. Suppressed samples are
+	// reported to packet handler by empty packets (silence markers). vad.level of last encoded
+	// frame is measured for all output audio streams and goes into audio message headers
+	bool dtx;
+	struct SVad vad;
+	bool silent;
+	int64_t silence_pts;            // of first suppressed frame not reported yet
+	int silence_samples;            // suppressed, not reported yet
+	timestamp_t silence_marker_ts;  // last marker time
+
 	// if this is input stream - queue holds recvd frames from paired participant.
 	// if this is output stream - queue holds frames ready to be send
 	struct SFrame *queue;
 	struct SFrame *tail;
 	pthread_mutex_t mutex;
 	pthread_cond_t cond;  // handler_thread must wait until queue is not empty
+	bool stop;            // input stream worker exits
 
 	// worker thread that does encoding/decoding job and calls callbacks
 	pthread_t handler_thread;
@@ -79,6 +166,18 @@ struct SStreamContainer {
 	struct SStream **out;
 	size_t nb_out;
 
+	// input streams closed on hangup. Worker is stopped and decoder flushed, but kept open,
+	// so stream can be restarted for reentered participant (or other one with same codec)
+	struct SStream **pool;
+	size_t nb_pool;
+	size_t pool_size;  // max amount of parked streams
+
+	// codec options for streams allocated without explicit ones, indexed by [dir][type]
+	struct SCodecOptions codec_opts[2][2];
+
+	// negotiated conference profile. New streams are created with it
+	struct SMediaProfile profile;
+
 	// mutex for exclusive access to streams arrays
 	pthread_rwlock_t mutex;
 };
@@ -91,16 +190,54 @@ void scont_free(struct SStreamContainer *cont);
 
 void scont_dump(FILE *fp, struct SStreamContainer *cont);
 
+// limits amount of parked input streams. 0 disables pooling
+void scont_set_pool_size(struct SStreamContainer *cont, size_t size);
+
+// sets default codec options for streams allocated afterwards. NULL resets to preset defaults
+enum SError scont_set_codec_options(struct SStreamContainer *cont,
+                                    enum SStreamType type,
+                                    enum SStreamDirection dir,
+                                    const struct SCodecOptions *opts);
+
+void scont_get_profile(struct SStreamContainer *cont, struct SMediaProfile *profile);
+
+// changes codecs for new streams. Existing output streams switch codec before next frame.
+// Video resolution and frame rate of streams are kept
+void scont_set_profile(struct SStreamContainer *cont, const struct SMediaProfile *profile);
+
+// changes video parameters of output stream. Encoder and filter graph are rebuilt before next
+// frame. If stream is NULL - parameters are set as default for new streams and applied to all
+// output video streams
+enum SError scont_set_video_params(struct SStreamContainer *cont,
+                                   sstream_id_t stream,
+                                   const struct SVideoParams *params);
+
+// params and opts can be NULL - container defaults are used in that case. params are ignored
+// for audio streams
 enum SError scont_alloc_stream(struct SStreamContainer *cont,
                                part_id_t part_id,
                                timestamp_t start_ts,
                                enum SStreamType type,
                                enum SStreamDirection dir,
+                               const struct SVideoParams *params,
+                               const struct SCodecOptions *opts,
                                sstream_id_t *stream);
 
+// finds input stream of participant or allocates new one with container defaults. Input streams
+// are created lazily by conference thread when first media packet of given type arrives
+enum SError scont_get_input_stream(struct SStreamContainer *cont,
+                                   part_id_t part_id,
+                                   timestamp_t start_ts,
+                                   enum SStreamType type,
+                                   sstream_id_t *stream);
+
 void scont_close_stream(struct SStreamContainer *cont, sstream_id_t *stream);
 
-// usable when participant disconnects
+// closes input streams which got no packets for longer than timeout (ms) and frees streams
+// parked for longer than timeout. Returns amount of closed input streams
+size_t scont_close_idle_streams(struct SStreamContainer *cont, timestamp_t timeout);
+
+// usable when participant disconnects. Input streams are parked in pool for reuse
 void scont_close_streams(struct SStreamContainer *cont, part_id_t part_id);
 
 bool scont_has_stream(struct SStreamContainer *cont, sstream_id_t stream);
@@ -121,3 +258,59 @@ enum SError scont_push_frame(struct SStreamContainer *cont,
 enum SError scont_push_packet(struct SStreamContainer *cont,
                               sstream_id_t stream,
                               struct AVPacket **packet);
+
+// asks output video stream for keyframe. If stream is NULL - all output video streams are asked.
+// Requests coming within SELECON_KEYFRAME_MIN_INTERVAL after keyframe are served by one forced
+// keyframe at its end
+void scont_request_keyframe(struct SStreamContainer *cont, sstream_id_t stream);
+
+// same as scont_request_keyframe for packet handler of stream itself, which must not take
+// container lock
+void sstream_request_keyframe(struct SStream *stream);
+
+// simulcast layer output video stream sends to receiver when packet of given layer comes. Sent
+// layer switches to wanted one on its keyframe only. Called by packet handler of stream itself
+int sstream_sent_layer(struct SStream *stream,
+                       part_id_t receiver,
+                       unsigned epoch,
+                       int wanted,
+                       int layer,
+                       bool keyframe);
+
+// returns true if input video stream waits for keyframe and sender must be asked for it (again).
+// Asking is repeated every SELECON_KEYFRAME_REQUEST_INTERVAL while stream waits
+bool scont_keyframe_needed(struct SStreamContainer *cont, sstream_id_t stream);
+
+// amount of packets waiting for decoder of input stream: arrived ones and ones in jitter buffer
+// which are due already
+size_t scont_queued_packets(struct SStreamContainer *cont, sstream_id_t stream);
+
+enum SError scont_jitter_stats(struct SStreamContainer *cont,
+                               sstream_id_t stream,
+                               struct SJitterStats *stats);
+
+// audio and video playout of participant. Fails unless both input streams exist and got packets
+enum SError scont_lipsync_stats(struct SStreamContainer *cont,
+                                part_id_t part_id,
+                                struct SLipSyncStats *stats);
+
+// closes report interval of input stream. Returns false if stream is gone or nothing arrived
+// during interval
+bool scont_receiver_report(struct SStreamContainer *cont,
+                           sstream_id_t stream,
+                           struct SReceiverReport *report);
+
+enum SError scont_rate_stats(struct SStreamContainer *cont,
+                             sstream_id_t stream,
+                             struct SRateStats *stats);
+
+// applies report of receiver to congestion control of output streams of given type. Bandwidth
+// reported for lower simulcast layer is scaled up to full resolution one by each video stream
+void scont_rate_report(struct SStreamContainer *cont,
+                       enum SStreamType type,
+                       part_id_t receiver,
+                       const struct SReceiverReport *report);
+
+// tells input stream that packet was dropped before reaching it. Stream stays open and decoder
+// is resynced when packets come again
+enum SError scont_skip_packet(struct SStreamContainer *cont, sstream_id_t stream);
@@ -44,6 +44,9 @@ typedef void (*media_handler_fn_t)(void *user_data,
                                    enum AVMediaType mtype,
                                    struct AVFrame *frame);
 
+// dominant speaker changed. part_id is 0 when dominant speaker left conference
+typedef void (*speaker_handler_fn_t)(void *user_data, part_id_t part_id);
+
 struct AVPacket;
 typedef void (*packet_handler_fn_t)(void *user_data,
                                     struct SStream *stream,
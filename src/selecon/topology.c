@@ -0,0 +1,143 @@
+#include "topology.h"
+
+#include <stdlib.h>
+
+#include "config.h"
+
+const char* stopology_str(enum STopology topology) {
+	switch (topology) {
+		case STOPOLOGY_MESH: return "mesh";
+		case STOPOLOGY_RELAY: return "relay";
+		case STOPOLOGY_TWO_LEVEL: return "two-level";
+		default: return "unknown";
+	}
+}
+
+static uint32_t node_uplink(const struct STopologyNode* node) {
+	return node->capacity.uplink_kbps > 0 ? node->capacity.uplink_kbps
+	                                      : SELECON_DEFAULT_UPLINK_KBPS;
+}
+
+// participants which have not announced capacity yet have no CPU headroom and are never relays
+static bool node_eligible(const struct STopologyNode* node) {
+	return node->can_relay && node->capacity.cpu_headroom >= SELECON_TOPOLOGY_MIN_CPU_HEADROOM &&
+	       node->capacity.rtt_ms <= SELECON_TOPOLOGY_MAX_RELAY_RTT;
+}
+
+// more uplink first, lower RTT among equal ones
+static bool node_better(const struct STopologyNode* a, const struct STopologyNode* b) {
+	if (node_uplink(a) != node_uplink(b))
+		return node_uplink(a) > node_uplink(b);
+	return a->capacity.rtt_ms < b->capacity.rtt_ms;
+}
+
+uint64_t stopology_relay_load(size_t count,
+                              size_t nb_relays,
+                              size_t nb_served,
+                              uint32_t media_kbps) {
+	// every served node gets media of all others from relay, other relays get media of served
+	// nodes and of relay itself
+	return ((uint64_t)nb_served * (count - 1) + (uint64_t)(nb_relays - 1) * (nb_served + 1)) *
+	       media_kbps;
+}
+
+static bool mesh_fits(const struct STopologyNode* nodes, size_t count, uint32_t media_kbps) {
+	if (count > SELECON_TOPOLOGY_MESH_MAX)
+		return false;
+	for (size_t i = 0; i < count; ++i)
+		if (node_uplink(&nodes[i]) < (uint64_t)(count - 1) * media_kbps)
+			return false;
+	return true;
+}
+
+enum STopology stopology_plan(struct STopologyNode* nodes, size_t count, uint32_t media_kbps) {
+	for (size_t i = 0; i < count; ++i) {
+		nodes[i].relay    = false;
+		nodes[i].relay_id = 0;
+	}
+	if (count <= 2 || mesh_fits(nodes, count, media_kbps))
+		return STOPOLOGY_MESH;
+	size_t* candidates = calloc(count, sizeof(size_t));
+	if (candidates == NULL)
+		return STOPOLOGY_MESH;
+	size_t nb_candidates = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (!node_eligible(&nodes[i]))
+			continue;
+		size_t j = nb_candidates++;
+		for (; j > 0 && node_better(&nodes[i], &nodes[candidates[j - 1]]); --j)
+			candidates[j] = candidates[j - 1];
+		candidates[j] = i;
+	}
+	size_t max_relays = nb_candidates < SELECON_TOPOLOGY_MAX_RELAYS ? nb_candidates
+	                                                                 : SELECON_TOPOLOGY_MAX_RELAYS;
+	if (max_relays >= count)
+		max_relays = count - 1;
+	if (max_relays == 0) {
+		free(candidates);
+		return STOPOLOGY_MESH;
+	}
+	// fewest relays whose weakest one still carries its share
+	size_t nb_relays = max_relays;
+	for (size_t k = 1; k < max_relays; ++k) {
+		size_t nb_served = (count - 1) / k;  // ceil((count - k) / k)
+		if (node_uplink(&nodes[candidates[k - 1]]) >=
+		    stopology_relay_load(count, k, nb_served, media_kbps)) {
+			nb_relays = k;
+			break;
+		}
+	}
+	for (size_t r = 0; r < nb_relays; ++r) nodes[candidates[r]].relay = true;
+	// each node goes to relay with least load per uplink after taking it
+	size_t* served = calloc(nb_relays, sizeof(size_t));
+	for (size_t i = 0; i < count && served != NULL; ++i) {
+		if (nodes[i].relay)
+			continue;
+		size_t best = 0;
+		for (size_t r = 1; r < nb_relays; ++r) {
+			// (served + 1) / uplink compared without division
+			uint64_t load_r    = (uint64_t)(served[r] + 1) * node_uplink(&nodes[candidates[best]]);
+			uint64_t load_best = (uint64_t)(served[best] + 1) * node_uplink(&nodes[candidates[r]]);
+			if (load_r < load_best)
+				best = r;
+		}
+		++served[best];
+		nodes[i].relay_id = nodes[candidates[best]].part_id;
+	}
+	if (served == NULL) {  // keep it simple when memory is short: first relay serves everybody
+		for (size_t i = 0; i < count; ++i)
+			if (!nodes[i].relay)
+				nodes[i].relay_id = nodes[candidates[0]].part_id;
+	}
+	free(served);
+	free(candidates);
+	return nb_relays == 1 ? STOPOLOGY_RELAY : STOPOLOGY_TWO_LEVEL;
+}
+
+size_t stopology_fan_out(uint32_t uplink_kbps, size_t nb_presenters, uint32_t media_kbps) {
+	if (uplink_kbps == 0)
+		uplink_kbps = SELECON_DEFAULT_UPLINK_KBPS;
+	uint64_t stream_kbps = (uint64_t)(nb_presenters > 0 ? nb_presenters : 1) * media_kbps;
+	uint64_t fan_out     = stream_kbps > 0 ? uplink_kbps / stream_kbps : SELECON_WEBINAR_MAX_FANOUT;
+	return fan_out < SELECON_WEBINAR_MAX_FANOUT ? fan_out : SELECON_WEBINAR_MAX_FANOUT;
+}
+
+size_t stopology_pick_parent(const struct STreeNode* nodes,
+                             size_t count,
+                             size_t nb_presenters,
+                             uint32_t media_kbps) {
+	size_t best      = count;
+	size_t best_free = 0;
+	for (size_t i = 0; i < count; ++i) {
+		size_t fan_out = stopology_fan_out(nodes[i].uplink_kbps, nb_presenters, media_kbps);
+		if (!nodes[i].can_feed || nodes[i].nb_children >= fan_out)
+			continue;
+		size_t nb_free = fan_out - nodes[i].nb_children;
+		if (best == count || nodes[i].depth < nodes[best].depth ||
+		    (nodes[i].depth == nodes[best].depth && nb_free > best_free)) {
+			best      = i;
+			best_free = nb_free;
+		}
+	}
+	return best;
+}
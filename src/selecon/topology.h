@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "participant.h"
+#include "stypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum STopology {
+	STOPOLOGY_MESH      = 0,  // everybody sends media to everybody
+	STOPOLOGY_RELAY     = 1,  // single relay forwards media of all others
+	STOPOLOGY_TWO_LEVEL = 2,  // each relay serves own group and exchanges media with other relays
+};
+
+const char* stopology_str(enum STopology topology);
+
+// conference participant as seen by topology planner
+struct STopologyNode {
+	part_id_t part_id;
+	struct SPartCapacity capacity;
+	bool can_relay;  // false for participants which must not be chosen as relay
+	// filled by planner
+	bool relay;
+	part_id_t relay_id;  // relay this node sends media through, 0 for relays and in mesh
+};
+
+// chooses topology for conference where every participant sends media_kbps of media. Full mesh is
+// kept while conference is small and every uplink carries media to all peers. Otherwise as few
+// relays as their uplinks allow are taken among nodes with most uplink, and other nodes are split
+// between them in proportion to uplink. When even SELECON_TOPOLOGY_MAX_RELAYS relays are not enough
+// load is spread between as many relays as possible. Mesh is used when nobody can relay
+enum STopology stopology_plan(struct STopologyNode* nodes, size_t count, uint32_t media_kbps);
+
+// uplink one relay needs to serve given number of nodes in conference of count participants with
+// nb_relays relays
+uint64_t stopology_relay_load(size_t count,
+                              size_t nb_relays,
+                              size_t nb_served,
+                              uint32_t media_kbps);
+
+// participant able to feed webinar listeners, as seen by one who places new listener
+struct STreeNode {
+	bool can_feed;         // false for participants which must not feed new listener
+	uint32_t uplink_kbps;  // 0 if unknown
+	size_t depth;          // hops from presenters, 0 for presenters
+	size_t nb_children;    // listeners fed already
+};
+
+// listeners one node can feed with its uplink when nb_presenters presenters send media_kbps each,
+// no more than SELECON_WEBINAR_MAX_FANOUT
+size_t stopology_fan_out(uint32_t uplink_kbps, size_t nb_presenters, uint32_t media_kbps);
+
+// picks node new webinar listener gets media from: shallowest node with free fan out, one with
+// most free slots among equally deep. Tree is kept shallow, as every hop adds latency. Returns
+// count when all nodes are full
+size_t stopology_pick_parent(const struct STreeNode* nodes,
+                             size_t count,
+                             size_t nb_presenters,
+                             uint32_t media_kbps);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
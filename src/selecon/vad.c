@@ -0,0 +1,61 @@
+#include "vad.h"
+
+#include <libavutil/samplefmt.h>
+#include <math.h>
+
+#include "sample_convert.h"
+
+#define SILENCE_LEVEL -100.0f
+
+void svad_init(struct SVad *vad, float threshold, int hangover) {
+	vad->threshold     = threshold;
+	vad->hangover      = hangover;
+	vad->hangover_left = 0;
+	vad->level         = SILENCE_LEVEL;
+}
+
+static double sumsq_s16(const int16_t *samples, int nb_samples) {
+	int64_t sum = 0;
+	for (int i = 0; i < nb_samples; ++i) sum += (int32_t)samples[i] * samples[i];
+	return (double)sum / (32768.0 * 32768.0);
+}
+
+float svad_frame_level(const struct AVFrame *frame) {
+	int nb_channels = frame->ch_layout.nb_channels;
+	int planar      = av_sample_fmt_is_planar(frame->format);
+	int nb_planes   = planar ? nb_channels : 1;
+	int plane_size  = planar ? frame->nb_samples : frame->nb_samples * nb_channels;
+	if (plane_size <= 0 || nb_planes <= 0)
+		return SILENCE_LEVEL;
+	double sum = 0.0;
+	for (int p = 0; p < nb_planes; ++p) {
+		switch (frame->format) {
+			case AV_SAMPLE_FMT_FLT:
+			case AV_SAMPLE_FMT_FLTP:
+				sum += sconv_sumsq_flt((const float *)frame->extended_data[p], plane_size);
+				break;
+			case AV_SAMPLE_FMT_S16:
+			case AV_SAMPLE_FMT_S16P:
+				sum += sumsq_s16((const int16_t *)frame->extended_data[p], plane_size);
+				break;
+			default: return 0.0f;
+		}
+	}
+	double power = sum / ((double)plane_size * nb_planes);
+	if (power <= 1e-10)
+		return SILENCE_LEVEL;
+	return (float)(10.0 * log10(power));
+}
+
+bool svad_process(struct SVad *vad, const struct AVFrame *frame) {
+	vad->level = svad_frame_level(frame);
+	if (vad->level >= vad->threshold) {
+		vad->hangover_left = vad->hangover;
+		return true;
+	}
+	if (vad->hangover_left > 0) {
+		vad->hangover_left -= frame->nb_samples;
+		return true;
+	}
+	return false;
+}
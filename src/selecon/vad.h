@@ -0,0 +1,22 @@
+#pragma once
+
+#include <libavutil/frame.h>
+#include <stdbool.h>
+
+// energy based voice activity detector. Frame is voiced when its level is above threshold or
+// when voiced frame was seen less than hangover ago, so quiet word endings are not cut off
+struct SVad {
+	float threshold;    // dBov
+	int hangover;       // samples
+	int hangover_left;  // samples
+	float level;        // dBov of last processed frame
+};
+
+void svad_init(struct SVad *vad, float threshold, int hangover);
+
+// level of audio frame in dBov (0 is full scale square wave), -100 for digital silence. Float and
+// S16 formats are measured, frames in other formats are reported as full scale
+float svad_frame_level(const struct AVFrame *frame);
+
+// returns true if frame carries voice
+bool svad_process(struct SVad *vad, const struct AVFrame *frame);
@@ -0,0 +1,338 @@
+#define _GNU_SOURCE
+
+#include "video_compositor.h"
+
+#include <libavutil/imgutils.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "config.h"
+#include "stime.h"
+
+// swscale vector code writes whole aligned blocks, so tiles start at multiples of this
+#define TILE_ALIGN 32
+
+// black in limited range YUV
+#define BACKGROUND_Y 16
+#define BACKGROUND_UV 128
+
+static bool layout_valid(const struct SCompositorLayout *layout) {
+	return video_params_valid(&layout->canvas) && layout->columns >= 0 &&
+	       layout->canvas.width >= TILE_ALIGN;
+}
+
+enum SError scomp_init(struct SVideoCompositor *comp, const struct SCompositorLayout *layout) {
+	if (!layout_valid(layout))
+		return SELECON_INVALID_ARG;
+	memset(comp, 0, sizeof(*comp));
+	if (pthread_mutex_init(&comp->mutex, NULL) != 0)
+		return SELECON_PTHREAD_ERROR;
+	comp->layout   = *layout;
+	comp->relayout = true;
+	comp->canvas   = av_frame_alloc();
+	if (comp->canvas == NULL) {
+		scomp_free(comp);
+		return SELECON_MEMORY_ERROR;
+	}
+	return SELECON_OK;
+}
+
+static void tile_free(struct SCompositorTile *tile) {
+	av_frame_free(&tile->frame);
+	sws_freeContext(tile->sws);
+	tile->sws = NULL;
+}
+
+void scomp_free(struct SVideoCompositor *comp) {
+	if (comp->running)
+		scomp_stop(comp);
+	for (size_t i = 0; i < comp->nb_tiles; ++i) tile_free(&comp->tiles[i]);
+	free(comp->tiles);
+	av_frame_free(&comp->canvas);
+	pthread_mutex_destroy(&comp->mutex);
+	memset(comp, 0, sizeof(*comp));
+}
+
+enum SError scomp_set_layout(struct SVideoCompositor *comp, const struct SCompositorLayout *layout) {
+	if (!layout_valid(layout))
+		return SELECON_INVALID_ARG;
+	pthread_mutex_lock(&comp->mutex);
+	comp->layout   = *layout;
+	comp->relayout = true;
+	pthread_mutex_unlock(&comp->mutex);
+	return SELECON_OK;
+}
+
+static void *compositor_worker(void *arg) {
+	struct SVideoCompositor *comp = arg;
+	struct AVFrame *frame         = av_frame_alloc();
+	struct timespec next;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (comp->running) {
+		pthread_mutex_lock(&comp->mutex);
+		int64_t frame_ns = 1000000000 / comp->layout.canvas.framerate;
+		pthread_mutex_unlock(&comp->mutex);
+		int64_t ns   = next.tv_nsec + frame_ns;
+		next.tv_sec += ns / 1000000000;
+		next.tv_nsec = ns % 1000000000;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		// skip missed frames instead of composing them in a row
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		int64_t late = (now.tv_sec - next.tv_sec) * 1000000000 + now.tv_nsec - next.tv_nsec;
+		if (late > frame_ns)
+			next = now;
+		if (comp->running && scomp_compose(comp, frame) >= 0) {
+			comp->handler(comp->user_data, comp->part_id, AVMEDIA_TYPE_VIDEO, frame);
+			av_frame_unref(frame);
+		}
+	}
+	av_frame_free(&frame);
+	return NULL;
+}
+
+enum SError scomp_start(struct SVideoCompositor *comp,
+                        media_handler_fn_t handler,
+                        void *user_data,
+                        part_id_t part_id) {
+	if (handler == NULL)
+		return SELECON_INVALID_ARG;
+	pthread_mutex_lock(&comp->mutex);
+	if (comp->running) {
+		pthread_mutex_unlock(&comp->mutex);
+		return SELECON_ALREADY_INIT;
+	}
+	comp->handler   = handler;
+	comp->user_data = user_data;
+	comp->part_id   = part_id;
+	comp->running   = true;
+	if (pthread_create(&comp->thread, NULL, compositor_worker, comp) != 0) {
+		comp->running = false;
+		pthread_mutex_unlock(&comp->mutex);
+		return SELECON_PTHREAD_ERROR;
+	}
+	pthread_setname_np(comp->thread, "compositor");
+	pthread_mutex_unlock(&comp->mutex);
+	return SELECON_OK;
+}
+
+void scomp_stop(struct SVideoCompositor *comp) {
+	pthread_mutex_lock(&comp->mutex);
+	bool running  = comp->running;
+	comp->running = false;
+	pthread_mutex_unlock(&comp->mutex);
+	if (running)
+		pthread_join(comp->thread, NULL);
+}
+
+bool scomp_running(struct SVideoCompositor *comp) {
+	pthread_mutex_lock(&comp->mutex);
+	bool running = comp->running;
+	pthread_mutex_unlock(&comp->mutex);
+	return running;
+}
+
+// comp->mutex must be locked
+static struct SCompositorTile *find_tile(struct SVideoCompositor *comp, part_id_t part_id) {
+	for (size_t i = 0; i < comp->nb_tiles; ++i)
+		if (comp->tiles[i].part_id == part_id)
+			return &comp->tiles[i];
+	return NULL;
+}
+
+enum SError scomp_push(struct SVideoCompositor *comp,
+                       part_id_t part_id,
+                       const struct AVFrame *frame) {
+	enum SError err = SELECON_OK;
+	pthread_mutex_lock(&comp->mutex);
+	struct SCompositorTile *tile = find_tile(comp, part_id);
+	if (tile == NULL) {
+		struct SCompositorTile *tiles =
+		    reallocarray(comp->tiles, comp->nb_tiles + 1, sizeof(struct SCompositorTile));
+		struct AVFrame *tile_frame = av_frame_alloc();
+		if (tiles != NULL)
+			comp->tiles = tiles;
+		if (tiles == NULL || tile_frame == NULL) {
+			av_frame_free(&tile_frame);
+			pthread_mutex_unlock(&comp->mutex);
+			return SELECON_MEMORY_ERROR;
+		}
+		tile = &comp->tiles[comp->nb_tiles++];
+		memset(tile, 0, sizeof(*tile));
+		tile->part_id  = part_id;
+		tile->frame    = tile_frame;
+		comp->relayout = true;
+	}
+	// letterbox of tile depends on source size
+	if (frame->width != tile->src_width || frame->height != tile->src_height)
+		comp->relayout = true;
+	av_frame_unref(tile->frame);
+	if (av_frame_ref(tile->frame, frame) < 0)
+		err = SELECON_MEMORY_ERROR;
+	tile->frame_ts = get_curr_timestamp();
+	tile->dirty    = true;
+	pthread_mutex_unlock(&comp->mutex);
+	return err;
+}
+
+// comp->mutex must be locked
+static void remove_tile_locked(struct SVideoCompositor *comp, size_t index) {
+	tile_free(&comp->tiles[index]);
+	for (size_t i = index + 1; i < comp->nb_tiles; ++i) comp->tiles[i - 1] = comp->tiles[i];
+	comp->nb_tiles--;
+	comp->relayout = true;
+}
+
+void scomp_remove_source(struct SVideoCompositor *comp, part_id_t part_id) {
+	pthread_mutex_lock(&comp->mutex);
+	struct SCompositorTile *tile = find_tile(comp, part_id);
+	if (tile != NULL)
+		remove_tile_locked(comp, tile - comp->tiles);
+	pthread_mutex_unlock(&comp->mutex);
+}
+
+// splits canvas into grid cells and fits each source into its cell keeping aspect ratio
+static void layout_tiles(struct SVideoCompositor *comp) {
+	const int width  = comp->layout.canvas.width;
+	const int height = comp->layout.canvas.height;
+	int nb_tiles     = (int)comp->nb_tiles;
+	int columns      = comp->layout.columns;
+	if (columns <= 0)
+		columns = (int)ceil(sqrt(nb_tiles));
+	columns    = columns > nb_tiles ? nb_tiles : columns;
+	columns    = columns > width / TILE_ALIGN ? width / TILE_ALIGN : columns;
+	int rows   = (nb_tiles + columns - 1) / columns;
+	int cell_w = width / columns / TILE_ALIGN * TILE_ALIGN;
+	int cell_h = height / rows & ~1;
+	for (int i = 0; i < nb_tiles; ++i) {
+		struct SCompositorTile *tile = &comp->tiles[i];
+		int cell_x                   = i % columns * cell_w;
+		int cell_y                   = i / columns * cell_h;
+		tile->src_width              = tile->frame->width;
+		tile->src_height             = tile->frame->height;
+		int w                        = cell_w;
+		int h                        = cell_h;
+		if (tile->src_width > 0 && tile->src_height > 0) {
+			h = (int)((int64_t)w * tile->src_height / tile->src_width);
+			if (h > cell_h) {
+				h = cell_h;
+				w = (int)((int64_t)h * tile->src_width / tile->src_height);
+			}
+		}
+		// too many participants for canvas height, tile is hidden
+		if (w < 2 || h < 2)
+			w = h = 0;
+		tile->width  = w & ~1;
+		tile->height = h & ~1;
+		tile->x      = cell_x + (cell_w - tile->width) / 2 / TILE_ALIGN * TILE_ALIGN;
+		tile->y      = cell_y + ((cell_h - tile->height) / 2 & ~1);
+		tile->dirty  = tile->frame->buf[0] != NULL;
+	}
+}
+
+static void fill_background(struct AVFrame *canvas) {
+	for (int y = 0; y < canvas->height; ++y)
+		memset(canvas->data[0] + y * canvas->linesize[0], BACKGROUND_Y, canvas->width);
+	for (int p = 1; p <= 2; ++p)
+		for (int y = 0; y < canvas->height / 2; ++y)
+			memset(canvas->data[p] + y * canvas->linesize[p], BACKGROUND_UV, canvas->width / 2);
+}
+
+// scales (or copies, when size matches) tile frame straight into its canvas area
+static int draw_tile(struct SCompositorTile *tile, struct AVFrame *canvas) {
+	const struct AVFrame *src = tile->frame;
+	uint8_t *dst[4]           = {NULL};
+
+	dst[0] = canvas->data[0] + tile->y * canvas->linesize[0] + tile->x;
+	dst[1] = canvas->data[1] + tile->y / 2 * canvas->linesize[1] + tile->x / 2;
+	dst[2] = canvas->data[2] + tile->y / 2 * canvas->linesize[2] + tile->x / 2;
+	if (src->format == AV_PIX_FMT_YUV420P && src->width == tile->width &&
+	    src->height == tile->height) {
+		for (int p = 0; p <= 2; ++p) {
+			int shift = p == 0 ? 0 : 1;
+			av_image_copy_plane(dst[p],
+			                    canvas->linesize[p],
+			                    src->data[p],
+			                    src->linesize[p],
+			                    src->width >> shift,
+			                    src->height >> shift);
+		}
+		return 0;
+	}
+	tile->sws = sws_getCachedContext(tile->sws,
+	                                 src->width,
+	                                 src->height,
+	                                 src->format,
+	                                 tile->width,
+	                                 tile->height,
+	                                 AV_PIX_FMT_YUV420P,
+	                                 SWS_BILINEAR,
+	                                 NULL,
+	                                 NULL,
+	                                 NULL);
+	if (tile->sws == NULL)
+		return AVERROR(EINVAL);
+	int ret = sws_scale(tile->sws,
+	                    (const uint8_t *const *)src->data,
+	                    src->linesize,
+	                    0,
+	                    src->height,
+	                    dst,
+	                    canvas->linesize);
+	return ret < 0 ? ret : 0;
+}
+
+// comp->mutex must be locked. Canvas may still be referenced by consumer of previous frame
+static int prepare_canvas(struct SVideoCompositor *comp) {
+	struct AVFrame *canvas = comp->canvas;
+	if (canvas->buf[0] == NULL || canvas->width != comp->layout.canvas.width ||
+	    canvas->height != comp->layout.canvas.height) {
+		av_frame_unref(canvas);
+		canvas->format = AV_PIX_FMT_YUV420P;
+		canvas->width  = comp->layout.canvas.width;
+		canvas->height = comp->layout.canvas.height;
+		comp->relayout = true;
+		return av_frame_get_buffer(canvas, 0);
+	}
+	return av_frame_make_writable(canvas);
+}
+
+int scomp_compose(struct SVideoCompositor *comp, struct AVFrame *frame) {
+	av_frame_unref(frame);  // may hold canvas of previous call
+	pthread_mutex_lock(&comp->mutex);
+	// participant stopped sending video, give its place to others
+	timestamp_t now = get_curr_timestamp();
+	for (size_t i = 0; i < comp->nb_tiles; ++i)
+		if (now - comp->tiles[i].frame_ts > SELECON_INPUT_STREAM_IDLE_TIMEOUT * 1000000ULL)
+			remove_tile_locked(comp, i--);
+	if (comp->nb_tiles == 0) {
+		pthread_mutex_unlock(&comp->mutex);
+		return AVERROR(EAGAIN);
+	}
+	int ret = prepare_canvas(comp);
+	if (ret < 0) {
+		pthread_mutex_unlock(&comp->mutex);
+		return ret;
+	}
+	if (comp->relayout) {
+		layout_tiles(comp);
+		fill_background(comp->canvas);
+		comp->relayout = false;
+	}
+	int nb_drawn = 0;
+	for (size_t i = 0; i < comp->nb_tiles; ++i) {
+		struct SCompositorTile *tile = &comp->tiles[i];
+		if (!tile->dirty || tile->width == 0)
+			continue;
+		tile->dirty = false;
+		if (draw_tile(tile, comp->canvas) == 0)
+			nb_drawn++;
+	}
+	comp->canvas->pts       = comp->pts++;
+	comp->canvas->time_base = av_make_q(1, comp->layout.canvas.framerate);
+	ret = av_frame_ref(frame, comp->canvas);
+	pthread_mutex_unlock(&comp->mutex);
+	return ret < 0 ? ret : nb_drawn;
+}
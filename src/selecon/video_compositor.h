@@ -0,0 +1,80 @@
+#pragma once
+
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "error.h"
+#include "media_profile.h"
+#include "stypes.h"
+
+// place of single participant on canvas
+struct SCompositorTile {
+	part_id_t part_id;
+	struct AVFrame *frame;  // latest decoded frame, empty until first one arrives
+	timestamp_t frame_ts;
+	bool dirty;  // frame changed since tile was drawn
+
+	// picture area on canvas. Aspect ratio of source is kept inside grid cell
+	int x;
+	int y;
+	int width;
+	int height;
+
+	// source geometry area was computed for
+	int src_width;
+	int src_height;
+
+	struct SwsContext *sws;
+};
+
+// tiles latest frame of each participant into YUV420P canvas at fixed rate. Only tiles with new
+// frames are redrawn, the rest of canvas is kept from previous composition
+struct SVideoCompositor {
+	struct SCompositorLayout layout;
+
+	struct SCompositorTile *tiles;
+	size_t nb_tiles;
+	bool relayout;  // tiles moved, canvas is cleared and all tiles are redrawn
+
+	struct AVFrame *canvas;
+	int64_t pts;  // in frames
+
+	// composed frames handler, called from compositor thread
+	media_handler_fn_t handler;
+	void *user_data;
+	part_id_t part_id;
+
+	pthread_mutex_t mutex;
+	pthread_t thread;
+	bool running;
+};
+
+enum SError scomp_init(struct SVideoCompositor *comp, const struct SCompositorLayout *layout);
+
+void scomp_free(struct SVideoCompositor *comp);
+
+enum SError scomp_set_layout(struct SVideoCompositor *comp, const struct SCompositorLayout *layout);
+
+// starts composing at layout frame rate. Frames are passed to handler with given part_id
+enum SError scomp_start(struct SVideoCompositor *comp,
+                        media_handler_fn_t handler,
+                        void *user_data,
+                        part_id_t part_id);
+
+void scomp_stop(struct SVideoCompositor *comp);
+
+bool scomp_running(struct SVideoCompositor *comp);
+
+// keeps reference to frame as latest picture of participant
+enum SError scomp_push(struct SVideoCompositor *comp, part_id_t part_id, const struct AVFrame *frame);
+
+void scomp_remove_source(struct SVideoCompositor *comp, part_id_t part_id);
+
+// draws dirty tiles and puts reference to canvas into frame. Called by compositor thread, exposed
+// for tests and benchmarks. Returns number of redrawn tiles, AVERROR(EAGAIN) when there is
+// nothing to show or other negative AVERROR
+int scomp_compose(struct SVideoCompositor *comp, struct AVFrame *frame);
@@ -30,7 +30,7 @@ struct DevPairOutput {
 	struct AVFormatContext* afmt_ctx;
 	struct MediaFilterGraph agraph;
 	struct AVFormatContext* vfmt_ctx;
-	// struct MediaFilterGraph vgraph;
+	struct MediaFilterGraph vgraph;  // senders may change resolution at any moment
 };
 
 struct Dev {
@@ -155,6 +155,10 @@ static void input_video_worker2(struct DevPairInput* dev,
 	struct AVFrame* frame   = av_frame_alloc();
 	struct AVPacket* packet = av_packet_alloc();
 	timestamp_t ts          = 0;
+	AVRational framerate    = vfmt_ctx->streams[0]->avg_frame_rate;
+	timestamp_t frame_delta = 1000000000LL / SELECON_DEFAULT_VIDEO_FPS;
+	if (framerate.num > 0 && framerate.den > 0)
+		frame_delta = av_rescale(1000000000LL, framerate.den, framerate.num);
 	while (!dev->close_requested) {
 		int ret = av_read_frame(vfmt_ctx, packet);
 		if (ret < 0) {
@@ -165,7 +169,7 @@ static void input_video_worker2(struct DevPairInput* dev,
 		ret = avcodec_receive_frame(vcodec_ctx, frame);
 		while (ret == 0) {
 			frame->sample_aspect_ratio = vfmt_ctx->streams[0]->sample_aspect_ratio;
-			reduce_fps(1000000000LL / SELECON_DEFAULT_VIDEO_FPS, &ts);
+			reduce_fps(frame_delta, &ts);
 			selecon_stream_push_frame(dev->context, vstream, &frame);
 			frame = av_frame_alloc();
 			ret   = avcodec_receive_frame(vcodec_ctx, frame);
@@ -215,12 +219,12 @@ static void* input_video_worker(void* arg) {
 		fprintf(stderr, "failed to open video input\n");
 		return NULL;
 	}
-	const struct AVCodec* vcodec      = avcodec_find_decoder(AV_CODEC_ID_RAWVIDEO);
-	struct AVCodecContext* vcodec_ctx = avcodec_alloc_context3(vcodec);
-	vcodec_ctx->pix_fmt               = AV_PIX_FMT_YUV420P;
-	vcodec_ctx->width                 = SELECON_DEFAULT_VIDEO_WIDTH;
-	vcodec_ctx->height                = SELECON_DEFAULT_VIDEO_HEIGHT;
-	int ret                           = avcodec_open2(vcodec_ctx, vcodec, NULL);
+	// capture device dictates its own frame format, stream scales it as needed
+	const struct AVCodecParameters* par = vfmt_ctx->streams[0]->codecpar;
+	const struct AVCodec* vcodec        = avcodec_find_decoder(par->codec_id);
+	struct AVCodecContext* vcodec_ctx   = avcodec_alloc_context3(vcodec);
+	avcodec_parameters_to_context(vcodec_ctx, par);
+	int ret = avcodec_open2(vcodec_ctx, vcodec, NULL);
 	if (ret < 0)
 		fprintf(stderr, "failed to open video devoce decoder: ret = %d\n", ret);
 	else {
@@ -281,6 +285,10 @@ struct Dev* dev_create_sink(const char* adev_name, const char* vdev_name) {
 			fprintf(stderr, "fialed to open output video device: err = %d\n", ret);
 			goto cleanup_audio;
 		}
+		mfgraph_init_video(&dev->output.vgraph,
+		                   SELECON_DEFAULT_VIDEO_PIXEL_FMT,
+		                   SELECON_DEFAULT_VIDEO_WIDTH,
+		                   SELECON_DEFAULT_VIDEO_HEIGHT);
 		// create video stream
 		struct AVStream* vstream      = avformat_new_stream(dev->output.vfmt_ctx, NULL);
 		vstream->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
@@ -330,18 +338,28 @@ enum SError dev_push_frame(struct Dev* dev, enum AVMediaType mtype, struct AVFra
 		if (dev->output.vfmt_ctx == NULL)
 			av_frame_free(&frame);
 		else {
-			// av_interleaved_write_uncoded_frame not implemented for sdl,sdl2
-			// TODO: implement rawvideo codec scheme instead
-			frame->display_picture_number = frame->coded_picture_number;
-			int ret = av_interleaved_write_uncoded_frame(dev->output.vfmt_ctx, 0, frame);
-			if (ret < 0) {
-				char buf[AV_ERROR_MAX_STRING_SIZE];
-				fprintf(stderr,
-				        "failed to write to output video device: ret = %d (%s)\n",
-				        ret,
-				        av_make_error_string(buf, sizeof(buf), ret));
-				return SELECON_AVERROR;
+			// scale to window size, incoming resolution is up to sender
+			enum SError err = mfgraph_send(&dev->output.vgraph, frame);
+			if (err != SELECON_OK) {
+				av_frame_free(&frame);
+				return err;
+			}
+			while (mfgraph_receive(&dev->output.vgraph, frame) == 0) {
+				// av_interleaved_write_uncoded_frame not implemented for sdl,sdl2
+				// TODO: implement rawvideo codec scheme instead
+				frame->display_picture_number = frame->coded_picture_number;
+				int ret = av_interleaved_write_uncoded_frame(dev->output.vfmt_ctx, 0, frame);
+				if (ret < 0) {
+					char buf[AV_ERROR_MAX_STRING_SIZE];
+					fprintf(stderr,
+					        "failed to write to output video device: ret = %d (%s)\n",
+					        ret,
+					        av_make_error_string(buf, sizeof(buf), ret));
+					return SELECON_AVERROR;
+				}
+				frame = av_frame_alloc();  // av_interleaved_write takes onwership completely
 			}
+			av_frame_free(&frame);
 		}
 	}
 	return SELECON_OK;
@@ -360,6 +378,7 @@ void dev_close(struct Dev** dev) {
 			if ((*dev)->output.vfmt_ctx != NULL) {
 				av_write_trailer((*dev)->output.vfmt_ctx);
 				avformat_free_context((*dev)->output.vfmt_ctx);
+				mfgraph_free(&(*dev)->output.vgraph);
 			}
 		}
 		free(*dev);
@@ -8,13 +8,17 @@
 #include <stdlib.h>
 
 #include "config.h"
+#include "media_filters.h"
 
 struct PacketDump {
 	struct AVFormatContext* fmt_ctx;
 	struct AVStream* audio_stream;
 	struct AVCodecContext* acodec_ctx;
+	struct MediaFilterGraph agraph;  // received audio format depends on negotiated profile
+	int64_t audio_pts;
 	struct AVStream* video_stream;
 	struct AVCodecContext* vcodec_ctx;
+	struct MediaFilterGraph vgraph;  // sender may change resolution mid-stream
 };
 
 struct PacketDumpMap {
@@ -70,7 +74,7 @@ static struct AVStream* create_video_stream(struct AVFormatContext* fmt_ctx,
 	(*codec_ctx)->pix_fmt   = SELECON_DEFAULT_VIDEO_PIXEL_FMT;
 	(*codec_ctx)->width     = SELECON_DEFAULT_VIDEO_WIDTH;
 	(*codec_ctx)->height    = SELECON_DEFAULT_VIDEO_HEIGHT;
-	(*codec_ctx)->framerate = av_make_q(1, SELECON_DEFAULT_VIDEO_FPS);
+	(*codec_ctx)->framerate = av_make_q(SELECON_DEFAULT_VIDEO_FPS, 1);
 	(*codec_ctx)->time_base = av_make_q(1, 1000);
 
 	if (fmt_ctx->oformat->flags & AVFMT_GLOBALHEADER)
@@ -81,7 +85,7 @@ static struct AVStream* create_video_stream(struct AVFormatContext* fmt_ctx,
 	assert((*codec_ctx)->pix_fmt == SELECON_DEFAULT_VIDEO_PIXEL_FMT);
 	assert((*codec_ctx)->width == SELECON_DEFAULT_VIDEO_WIDTH);
 	assert((*codec_ctx)->height == SELECON_DEFAULT_VIDEO_HEIGHT);
-	assert((*codec_ctx)->framerate.den == SELECON_DEFAULT_VIDEO_FPS);
+	assert((*codec_ctx)->framerate.num == SELECON_DEFAULT_VIDEO_FPS);
 
 	avcodec_parameters_from_context(stream->codecpar, *codec_ctx);
 	stream->r_frame_rate = av_make_q(SELECON_DEFAULT_VIDEO_FPS, 1);
@@ -98,7 +102,16 @@ static struct PacketDump* pdump_create(const char* filename) {
 		return NULL;
 	}
 	pdump->audio_stream = create_audio_stream(pdump->fmt_ctx, &pdump->acodec_ctx);
+	mfgraph_init_audio(&pdump->agraph,
+	                   pdump->acodec_ctx->sample_fmt,
+	                   pdump->acodec_ctx->sample_rate,
+	                   pdump->acodec_ctx->ch_layout.nb_channels,
+	                   pdump->acodec_ctx->frame_size);
 	pdump->video_stream = create_video_stream(pdump->fmt_ctx, &pdump->vcodec_ctx);
+	mfgraph_init_video(&pdump->vgraph,
+	                   pdump->vcodec_ctx->pix_fmt,
+	                   pdump->vcodec_ctx->width,
+	                   pdump->vcodec_ctx->height);
 	if (!(pdump->fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
 		int ret = avio_open(&pdump->fmt_ctx->pb, filename, AVIO_FLAG_WRITE);
 		if (ret < 0) {
@@ -133,16 +146,35 @@ static void pdump_dump_common(struct AVFormatContext* fmt_ctx,
 }
 
 static void pdump_dump_audio(struct PacketDump* pdump, struct AVFrame* frame) {
-	pdump_dump_common(pdump->fmt_ctx, pdump->audio_stream, pdump->acodec_ctx, frame);
+	if (frame == NULL)  // flush
+		return pdump_dump_common(pdump->fmt_ctx, pdump->audio_stream, pdump->acodec_ctx, NULL);
+	frame = av_frame_clone(frame);
+	if (mfgraph_send(&pdump->agraph, frame) == SELECON_OK) {
+		while (mfgraph_receive(&pdump->agraph, frame) == 0) {
+			frame->time_base = pdump->acodec_ctx->time_base;
+			frame->pts       = av_rescale_q(pdump->audio_pts,
+                                      av_make_q(1, pdump->acodec_ctx->sample_rate),
+                                      pdump->acodec_ctx->time_base);
+			pdump->audio_pts += frame->nb_samples;
+			pdump_dump_common(pdump->fmt_ctx, pdump->audio_stream, pdump->acodec_ctx, frame);
+		}
+	}
+	av_frame_free(&frame);
 }
 
 static void pdump_dump_video(struct PacketDump* pdump, struct AVFrame* frame) {
-	if (frame != NULL) {
-		frame->pict_type = AV_PICTURE_TYPE_NONE;  // reset picture type, let encoder decide
-		frame->pts       = av_rescale(frame->pts, 1000, 15360);  // dirty hack for timestamps
-		frame->pkt_dts   = AV_NOPTS_VALUE;
+	if (frame == NULL)  // flush
+		return pdump_dump_common(pdump->fmt_ctx, pdump->video_stream, pdump->vcodec_ctx, NULL);
+	frame = av_frame_clone(frame);
+	if (mfgraph_send(&pdump->vgraph, frame) == SELECON_OK) {
+		while (mfgraph_receive(&pdump->vgraph, frame) == 0) {
+			frame->pict_type = AV_PICTURE_TYPE_NONE;  // reset picture type, let encoder decide
+			frame->pts       = av_rescale(frame->pts, 1000, 15360);  // dirty hack for timestamps
+			frame->pkt_dts   = AV_NOPTS_VALUE;
+			pdump_dump_common(pdump->fmt_ctx, pdump->video_stream, pdump->vcodec_ctx, frame);
+		}
 	}
-	pdump_dump_common(pdump->fmt_ctx, pdump->video_stream, pdump->vcodec_ctx, frame);
+	av_frame_free(&frame);
 }
 
 static void pdump_free(struct PacketDump** pdump) {
@@ -155,6 +187,8 @@ static void pdump_free(struct PacketDump** pdump) {
 			printf("failed to write trailer! err = %d\n", ret);
 		}
 		avcodec_free_context(&(*pdump)->acodec_ctx);
+		mfgraph_free(&(*pdump)->agraph);
+		mfgraph_free(&(*pdump)->vgraph);
 		avcodec_free_context(&(*pdump)->vcodec_ctx);
 		*pdump = NULL;
 	}
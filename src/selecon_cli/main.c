@@ -29,6 +29,20 @@ static const char* help_message =
     "  --version              print version and exit\n"
     "  --stub filename        stream given media file in a loop\n"
     "  --stat filename        enable CSV network statistics collection\n"
+    "  --preset name          encoder tuning: none, conference (default), low-cpu, quality\n"
+    "  --no-dtx               send audio while silent (DTX is on in conference and low-cpu)\n"
+    "  --top-k count          decode audio of this many loudest speakers only\n"
+    "  --last-n count         receive video of this many recent speakers only\n"
+    "  --simulcast count      encode sent video in this many layers of halving resolution\n"
+    "  --temporal count       encode sent video in this many temporal layers (vp8 only)\n"
+    "  --decode-tl count      decode this many temporal layers of received video\n"
+    "  --relay                forward media of other participants, they send it here only\n"
+    "  --uplink kbps          uplink capacity announced to other participants\n"
+    "  --auto-topology        choose mesh or relay tree when organising conference\n"
+    "  --webinar              organise webinar: only presenters send media\n"
+    "  --presenter            send media in webinars joined\n"
+    "  --codecs list          comma-separated preferred codecs (eg: opus,vp8)\n"
+    "  --video WxH[@fps]      resolution and frame rate of sent video (eg: 1280x720@30)\n"
     "\n"
     "DESCRIPTION:\n"
     "  Address can be IPv4/IPv6 (eg: 192.168.100.1:" SELECON_DEFAULT_LISTEN_PORT_STR
@@ -45,18 +59,45 @@ static struct Stub* stub               = NULL;
 static struct PacketDumpMap* dump_mapper = NULL;
 static struct StatFile* statfile         = NULL;
 
+static enum SCodecPreset codec_preset = SCODEC_PRESET_DEFAULT;
+static bool dtx                       = true;
+static int audio_top_k                = SELECON_DEFAULT_AUDIO_TOP_K;
+static int video_last_n               = SELECON_DEFAULT_VIDEO_LAST_N;
+static int simulcast                  = 0;
+static int temporal_layers            = 0;
+static int decode_temporal_layers     = SELECON_MAX_TEMPORAL_LAYERS;
+static bool relay                     = false;
+static int uplink_kbps                = 0;
+static bool auto_topology             = false;
+static bool webinar                   = false;
+static bool presenter                 = false;
+static char* codecs                   = NULL;
+static const char* video_params       = NULL;
+
 static void text_handler(void* user_data, part_id_t part_id, const char* message) {
 	printf("[%llu:] %s\n", part_id, message);
 }
 
+static void speaker_handler(void* user_data, part_id_t part_id) {
+	if (part_id != 0)
+		printf("[%llu] is speaking\n", part_id);
+}
+
 static void media_handler(void* user_data,
                           part_id_t part_id,
                           enum AVMediaType mtype,
                           struct AVFrame* frame) {
 	statfile_mark_arrived(statfile, context, part_id, mtype, frame);
+	// output device plays mixed audio and composed video
+	pdmap_dump(dump_mapper, part_id, mtype, frame);
+}
+
+static void conference_media_handler(void* user_data,
+                                     part_id_t part_id,
+                                     enum AVMediaType mtype,
+                                     struct AVFrame* frame) {
 	if (dev_out != NULL)
 		dev_push_frame(dev_out, mtype, av_frame_clone(frame));
-	pdmap_dump(dump_mapper, part_id, mtype, frame);
 }
 
 static int process_hangup_cmd(char* cmd) {
@@ -73,18 +114,24 @@ static void process_help_cmd(char* cmd) {
 	if (subcmd == NULL) {
 		printf(
 		    "list of available commands:\n"
-		    "  dev     manage IO devices\n"
-		    "  dump    print info about current selecon context state\n"
-		    "  exit    end active conference and close cli tool\n"
-		    "  hangup  emulate connection hangup\n"
-		    "  help    show this message\n"
-		    "  invite  send invitation for joining active conference to other client\n"
-		    "  leave   exit conference without exiting cli tool\n"
-		    "  quit    same as exit\n"
-		    "  reenter reenter same conference after hangup\n"
-		    "  say     send text message to conference chat\n"
-		    "  sleep   sleep\n"
-		    "  stub    set stub media file for playing in conference\n"
+		    "  dev      manage IO devices\n"
+		    "  dump     print info about current selecon context state\n"
+		    "  exit     end active conference and close cli tool\n"
+		    "  gain     change volume of participant\n"
+		    "  hangup   emulate connection hangup\n"
+		    "  help     show this message\n"
+		    "  invite   send invitation for joining active conference to other client\n"
+		    "  layout   change grid of participant videos\n"
+		    "  leave    exit conference without exiting cli tool\n"
+		    "  mute     mute participant audio\n"
+		    "  quit     same as exit\n"
+		    "  reenter  reenter same conference after hangup\n"
+		    "  say      send text message to conference chat\n"
+		    "  sleep    sleep\n"
+		    "  speakers list participants speaking now\n"
+		    "  stub     set stub media file for playing in conference\n"
+		    "  unmute   unmute participant audio\n"
+		    "  video    change resolution and frame rate of sent video\n"
 		    "\n");
 	} else {
 		subcmd++;
@@ -108,6 +155,12 @@ static void process_help_cmd(char* cmd) {
 			    "\n"
 			    "  Exit current conference and cli tool\n"
 			    "\n");
+		} else if (strcmp(subcmd, "gain") == 0) {
+			printf(
+			    "  > gain {part_id} {gain}\n"
+			    "\n"
+			    "  Set linear volume of participant in mixed audio (1 is unchanged)\n"
+			    "\n");
 		} else if (strcmp(subcmd, "hangup") == 0) {
 			printf(
 			    "  > hangup\n"
@@ -128,12 +181,27 @@ static void process_help_cmd(char* cmd) {
 			    "\n"
 			    "  Send invitation to other client\n"
 			    "\n");
+		} else if (strcmp(subcmd, "layout") == 0) {
+			printf(
+			    "  > layout auto\n"
+			    "  > layout {columns}\n"
+			    "  > layout {columns} {width}x{height}[@{fps}]\n"
+			    "\n"
+			    "  Set number of grid columns (auto for near square grid) and size of composed video\n"
+			    "\n");
 		} else if (strcmp(subcmd, "leave") == 0) {
 			printf(
 			    "  > leave\n"
 			    "\n"
 			    "  Leave current conference without closing cli tool\n"
 			    "\n");
+		} else if (strcmp(subcmd, "mute") == 0 || strcmp(subcmd, "unmute") == 0) {
+			printf(
+			    "  > mute {part_id}\n"
+			    "  > unmute {part_id}\n"
+			    "\n"
+			    "  Exclude participant audio from mix or bring it back\n"
+			    "\n");
 		} else if (strcmp(subcmd, "quit") == 0) {
 			printf(
 			    "  > quit\n"
@@ -158,6 +226,12 @@ static void process_help_cmd(char* cmd) {
 			    "\n"
 			    "  Sleep given amount of seconds\n"
 			    "\n");
+		} else if (strcmp(subcmd, "speakers") == 0) {
+			printf(
+			    "  > speakers\n"
+			    "\n"
+			    "  List participants speaking now with their audio levels, loudest first\n"
+			    "\n");
 		} else if (strcmp(subcmd, "stub") == 0) {
 			printf(
 			    "  > stub {media-file}\n"
@@ -165,6 +239,13 @@ static void process_help_cmd(char* cmd) {
 			    "\n"
 			    "  Set media file as stub audio/video for showing in conference\n"
 			    "\n");
+		} else if (strcmp(subcmd, "video") == 0) {
+			printf(
+			    "  > video {width}x{height}\n"
+			    "  > video {width}x{height}@{fps}\n"
+			    "\n"
+			    "  Change resolution and frame rate of sent video without restarting streams\n"
+			    "\n");
 		} else {
 			printf("unknown command '%s'\n", subcmd);
 		}
@@ -308,6 +389,89 @@ static int process_stub_cmd(char* cmd) {
 	return 0;
 }
 
+// parses WxH[@fps] string. Frame rate is left untouched if not given
+static bool parse_video_params(const char* str, struct SVideoParams* params) {
+	int fps = params->framerate;
+	int n   = sscanf(str, "%dx%d@%d", &params->width, &params->height, &fps);
+	if (n < 2)
+		return false;
+	params->framerate = fps;
+	return true;
+}
+
+static int process_video_cmd(char* cmd) {
+	char* spec = strchr(cmd, ' ');
+	struct SVideoParams params = {
+	    SELECON_DEFAULT_VIDEO_WIDTH, SELECON_DEFAULT_VIDEO_HEIGHT, SELECON_DEFAULT_VIDEO_FPS};
+	if (spec == NULL || !parse_video_params(++spec, &params)) {
+		printf("usage: video {width}x{height}[@{fps}]\n");
+		return 0;
+	}
+	enum SError err = selecon_set_video_params(context, &params);
+	if (err != SELECON_OK)
+		printf("failed to change video params: %s\n", serror_str(err));
+	else
+		printf("video switched to %dx%d@%d\n", params.width, params.height, params.framerate);
+	return 0;
+}
+
+static int process_gain_cmd(char* cmd) {
+	part_id_t part_id;
+	float gain;
+	if (sscanf(cmd, "gain %llu %f", &part_id, &gain) != 2) {
+		printf("usage: gain {part_id} {gain}\n");
+		return 0;
+	}
+	enum SError err = selecon_set_participant_gain(context, part_id, gain);
+	if (err != SELECON_OK)
+		printf("failed to set gain: %s\n", serror_str(err));
+	return 0;
+}
+
+static int process_mute_cmd(char* cmd, bool muted) {
+	part_id_t part_id;
+	if (sscanf(cmd, muted ? "mute %llu" : "unmute %llu", &part_id) != 1) {
+		printf("usage: %s {part_id}\n", muted ? "mute" : "unmute");
+		return 0;
+	}
+	enum SError err = selecon_set_participant_mute(context, part_id, muted);
+	if (err != SELECON_OK)
+		printf("failed to %s participant: %s\n", muted ? "mute" : "unmute", serror_str(err));
+	return 0;
+}
+
+static int process_speakers_cmd(char* cmd) {
+	struct SSpeaker speakers[16];
+	size_t count = selecon_get_active_speakers(context, speakers, 16);
+	if (count == 0)
+		printf("nobody is speaking\n");
+	for (size_t i = 0; i < count; ++i)
+		printf("  %llu %.1f dBov\n", speakers[i].part_id, speakers[i].level);
+	return 0;
+}
+
+static int process_layout_cmd(char* cmd) {
+	static struct SCompositorLayout layout = {
+	    {SELECON_DEFAULT_COMPOSITE_WIDTH,
+	     SELECON_DEFAULT_COMPOSITE_HEIGHT,
+	     SELECON_DEFAULT_COMPOSITE_FPS},
+	    0,
+	};
+	char columns[16];
+	char canvas[64];
+	int n = sscanf(cmd, "layout %15s %63s", columns, canvas);
+	if (n < 1 || (strcmp(columns, "auto") != 0 && atoi(columns) <= 0) ||
+	    (n == 2 && !parse_video_params(canvas, &layout.canvas))) {
+		printf("usage: layout auto|{columns} [{width}x{height}[@{fps}]]\n");
+		return 0;
+	}
+	layout.columns  = strcmp(columns, "auto") == 0 ? 0 : atoi(columns);
+	enum SError err = selecon_set_video_compositor(context, &layout, conference_media_handler);
+	if (err != SELECON_OK)
+		printf("failed to change layout: %s\n", serror_str(err));
+	return 0;
+}
+
 static int cmd_loop(void) {
 	int ret = 0;
 	char cmd[1024];
@@ -331,12 +495,24 @@ static int cmd_loop(void) {
 		} else if (STARTS_WITH(cmd, "dump")) {
 			if ((ret = process_dump_cmd(cmd)))
 				break;
+		} else if (STARTS_WITH(cmd, "gain")) {
+			if ((ret = process_gain_cmd(cmd)))
+				break;
 		} else if (STARTS_WITH(cmd, "invite")) {
 			if ((ret = process_invite_cmd(cmd)))
 				break;
+		} else if (STARTS_WITH(cmd, "layout")) {
+			if ((ret = process_layout_cmd(cmd)))
+				break;
 		} else if (STARTS_WITH(cmd, "leave")) {
 			if ((ret = process_leave_cmd(cmd)))
 				break;
+		} else if (STARTS_WITH(cmd, "mute")) {
+			if ((ret = process_mute_cmd(cmd, true)))
+				break;
+		} else if (STARTS_WITH(cmd, "unmute")) {
+			if ((ret = process_mute_cmd(cmd, false)))
+				break;
 		} else if (STARTS_WITH(cmd, "reenter")) {
 			if ((ret = process_reenter_cmd(cmd)))
 				break;
@@ -346,14 +522,55 @@ static int cmd_loop(void) {
 		} else if (STARTS_WITH(cmd, "sleep")) {
 			if ((ret = process_sleep_cmd(cmd)))
 				break;
+		} else if (STARTS_WITH(cmd, "speakers")) {
+			if ((ret = process_speakers_cmd(cmd)))
+				break;
 		} else if (STARTS_WITH(cmd, "stub")) {
 			if ((ret = process_stub_cmd(cmd)))
 				break;
+		} else if (STARTS_WITH(cmd, "video")) {
+			if ((ret = process_video_cmd(cmd)))
+				break;
 		}
 	}
 	return ret;
 }
 
+static bool parse_preset(const char* name, enum SCodecPreset* preset) {
+	for (enum SCodecPreset p = SCODEC_PRESET_NONE; p <= SCODEC_PRESET_QUALITY; ++p) {
+		if (strcmp(name, scodec_preset_str(p)) == 0) {
+			*preset = p;
+			return true;
+		}
+	}
+	return false;
+}
+
+// applies codec priorities given as comma-separated list of codec names
+static enum SError set_codec_priority(char* list) {
+	enum AVCodecID audio_ids[SELECON_MAX_MEDIA_PROFILES];
+	enum AVCodecID video_ids[SELECON_MAX_MEDIA_PROFILES];
+	size_t nb_audio = 0;
+	size_t nb_video = 0;
+	for (char* name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+		const AVCodecDescriptor* desc = avcodec_descriptor_get_by_name(name);
+		if (desc == NULL) {
+			printf("unknown codec: %s\n", name);
+			return SELECON_INVALID_ARG;
+		}
+		if (desc->type == AVMEDIA_TYPE_AUDIO && nb_audio < SELECON_MAX_MEDIA_PROFILES)
+			audio_ids[nb_audio++] = desc->id;
+		else if (desc->type == AVMEDIA_TYPE_VIDEO && nb_video < SELECON_MAX_MEDIA_PROFILES)
+			video_ids[nb_video++] = desc->id;
+	}
+	enum SError err = SELECON_OK;
+	if (nb_audio > 0)
+		err = selecon_set_codec_priority(context, AVMEDIA_TYPE_AUDIO, audio_ids, nb_audio);
+	if (err == SELECON_OK && nb_video > 0)
+		err = selecon_set_codec_priority(context, AVMEDIA_TYPE_VIDEO, video_ids, nb_video);
+	return err;
+}
+
 // list available audio-video input-output devices
 static void show_devices(void) {
 	const AVInputFormat* indev_fmt   = NULL;
@@ -389,6 +606,62 @@ int main(int argc, char** argv) {
 			update_stub(argv[++i]);
 		} else if (strcmp(argv[i], "--stat") == 0) {
 			statfile_open(&statfile, argv[++i]);
+		} else if (strcmp(argv[i], "--video") == 0) {
+			video_params = argv[++i];
+		} else if (strcmp(argv[i], "--codecs") == 0) {
+			codecs = argv[++i];
+		} else if (strcmp(argv[i], "--preset") == 0) {
+			if (!parse_preset(argv[++i], &codec_preset)) {
+				printf("unknown preset: %s\n", argv[i]);
+				return -1;
+			}
+		} else if (strcmp(argv[i], "--no-dtx") == 0) {
+			dtx = false;
+		} else if (strcmp(argv[i], "--top-k") == 0) {
+			audio_top_k = atoi(argv[++i]);
+			if (audio_top_k < 0) {
+				printf("invalid top-k: %s\n", argv[i]);
+				return -1;
+			}
+		} else if (strcmp(argv[i], "--last-n") == 0) {
+			video_last_n = atoi(argv[++i]);
+			if (video_last_n < 0) {
+				printf("invalid last-n: %s\n", argv[i]);
+				return -1;
+			}
+		} else if (strcmp(argv[i], "--simulcast") == 0) {
+			simulcast = atoi(argv[++i]);
+			if (simulcast < 1 || simulcast > SELECON_MAX_SIMULCAST_LAYERS) {
+				printf("invalid simulcast: %s\n", argv[i]);
+				return -1;
+			}
+		} else if (strcmp(argv[i], "--temporal") == 0) {
+			temporal_layers = atoi(argv[++i]);
+			if (temporal_layers < 1 || temporal_layers > SELECON_MAX_TEMPORAL_LAYERS) {
+				printf("invalid temporal: %s\n", argv[i]);
+				return -1;
+			}
+		} else if (strcmp(argv[i], "--decode-tl") == 0) {
+			decode_temporal_layers = atoi(argv[++i]);
+			if (decode_temporal_layers < 1 ||
+			    decode_temporal_layers > SELECON_MAX_TEMPORAL_LAYERS) {
+				printf("invalid decode-tl: %s\n", argv[i]);
+				return -1;
+			}
+		} else if (strcmp(argv[i], "--relay") == 0) {
+			relay = true;
+		} else if (strcmp(argv[i], "--uplink") == 0) {
+			uplink_kbps = atoi(argv[++i]);
+			if (uplink_kbps <= 0) {
+				printf("invalid uplink: %s\n", argv[i]);
+				return -1;
+			}
+		} else if (strcmp(argv[i], "--auto-topology") == 0) {
+			auto_topology = true;
+		} else if (strcmp(argv[i], "--webinar") == 0) {
+			webinar = true;
+		} else if (strcmp(argv[i], "--presenter") == 0) {
+			presenter = true;
 		} else {
 			printf("unknown option: %s\n", argv[i]);
 			return -1;
@@ -405,6 +678,31 @@ int main(int argc, char** argv) {
 		printf("failed to initialize context: err = %s\n", serror_str(err));
 		return -1;
 	}
+	err = selecon_set_speaker_handler(context, speaker_handler);
+	if (err == SELECON_OK)
+		err = selecon_set_audio_top_k(context, audio_top_k);
+	if (err == SELECON_OK)
+		err = selecon_set_video_last_n(context, video_last_n, SVIDEO_SUB_PAUSED);
+	if (err == SELECON_OK)
+		err = selecon_set_video_temporal_layers(context, decode_temporal_layers);
+	if (err == SELECON_OK)
+		err = selecon_set_audio_mixer(context, conference_media_handler);
+	if (err == SELECON_OK)
+		err = selecon_set_video_compositor(context, NULL, conference_media_handler);
+	if (err == SELECON_OK && relay)
+		err = selecon_set_role(context, SROLE_RELAY);
+	if (err == SELECON_OK && presenter)
+		err = selecon_set_role(context, SROLE_PRESENTER);
+	if (err == SELECON_OK)
+		err = selecon_set_webinar(context, webinar);
+	if (err == SELECON_OK)
+		err = selecon_set_uplink_capacity(context, uplink_kbps);
+	if (err == SELECON_OK)
+		err = selecon_set_auto_topology(context, auto_topology);
+	if (err != SELECON_OK) {
+		printf("failed to set up conference media: err = %s\n", serror_str(err));
+		return -1;
+	}
 	if (username != NULL) {
 		err = selecon_set_username(context, username);
 		if (err != SELECON_OK) {
@@ -412,6 +710,39 @@ int main(int argc, char** argv) {
 			return -1;
 		}
 	}
+	if (codecs != NULL) {
+		err = set_codec_priority(codecs);
+		if (err != SELECON_OK) {
+			printf("failed to set codec priority: err = %s\n", serror_str(err));
+			return -1;
+		}
+	}
+	if (video_params != NULL) {
+		struct SVideoParams params = {
+		    SELECON_DEFAULT_VIDEO_WIDTH, SELECON_DEFAULT_VIDEO_HEIGHT, SELECON_DEFAULT_VIDEO_FPS};
+		if (!parse_video_params(video_params, &params)) {
+			printf("invalid video params: %s\n", video_params);
+			return -1;
+		}
+		err = selecon_set_video_params(context, &params);
+		if (err != SELECON_OK) {
+			printf("failed to set video params: err = %s\n", serror_str(err));
+			return -1;
+		}
+	}
+	if (codec_preset != SCODEC_PRESET_DEFAULT || !dtx || simulcast > 0 || temporal_layers > 0) {
+		struct SCodecOptions opts = {.preset          = codec_preset,
+		                             .dtx             = dtx ? 0 : -1,
+		                             .simulcast       = simulcast,
+		                             .temporal_layers = temporal_layers};
+		err = selecon_set_codec_options(context, AVMEDIA_TYPE_AUDIO, true, &opts);
+		if (err == SELECON_OK)
+			err = selecon_set_codec_options(context, AVMEDIA_TYPE_VIDEO, true, &opts);
+		if (err != SELECON_OK) {
+			printf("failed to set codec preset: err = %s\n", serror_str(err));
+			return -1;
+		}
+	}
 	int ret = cmd_loop();
 	statfile_close(&statfile);
 	pdmap_free(&dump_mapper);
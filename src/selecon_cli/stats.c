@@ -31,6 +31,9 @@ void statfile_mark_arrived(struct StatFile* sf,
                            enum AVMediaType mtype,
                            struct AVFrame* frame) {
 	if (sf != NULL) {
+		// frame is stamped by clock of its sender
+		timestamp_t send_ts = selecon_get_start_ts(ctx) +
+		                      av_rescale_q(frame->pts, frame->time_base, av_make_q(1, 1000000000));
 		char buffer[256];
 		snprintf(buffer,
 		         sizeof(buffer),
@@ -38,8 +41,7 @@ void statfile_mark_arrived(struct StatFile* sf,
 		         selecon_get_conf_id(ctx),
 		         selecon_get_self_id(ctx),
 		         part_id,
-		         selecon_get_start_ts(ctx) +
-		             av_rescale_q(frame->pts, frame->time_base, av_make_q(1, 1000000000)),
+		         selecon_to_local_ts(ctx, part_id, send_ts),
 		         get_curr_timestamp(),
 		         frame->sample_rate == 0 ? "video" : "audio");
 		fputs(buffer, sf->file);
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include "active_speakers.h"
+#include "config.h"
+
+// speaker ranking from header levels: smoothing, switch margin and timeouts
+
+static constexpr timestamp_t kPacket = 20000000ULL;  // 20 ms between packets
+
+class ActiveSpeakersTest : public ::testing::Test {
+protected:
+	void SetUp() override { ASSERT_EQ(sspeak_init(&tracker), SELECON_OK); }
+	void TearDown() override { sspeak_free(&tracker); }
+
+	// feeds same level of each participant for given amount of packets, returns dominant changes
+	int feed(std::initializer_list<std::pair<part_id_t, float>> levels, int nb_packets) {
+		int changes = 0;
+		for (int i = 0; i < nb_packets; ++i) {
+			now += kPacket;
+			for (auto [part_id, level] : levels)
+				changes += sspeak_update(&tracker, part_id, level, now);
+		}
+		return changes;
+	}
+
+	SSpeakerTracker tracker;
+	timestamp_t now = 1000000000ULL;
+};
+
+TEST_F(ActiveSpeakersTest, RanksLoudestFirst) {
+	feed({{1, -30.0f}, {2, -20.0f}, {3, -90.0f}, {4, -40.0f}}, 20);
+	SSpeaker ranking[2];
+	ASSERT_EQ(sspeak_ranking(&tracker, ranking, 2, now), 2u);
+	EXPECT_EQ(ranking[0].part_id, 2u);
+	EXPECT_EQ(ranking[1].part_id, 1u);
+	EXPECT_EQ(sspeak_rank(&tracker, 4, now), 2);
+	EXPECT_EQ(sspeak_rank(&tracker, 3, now), -1);  // below VAD threshold
+	EXPECT_EQ(sspeak_dominant(&tracker), 2u);
+}
+
+TEST_F(ActiveSpeakersTest, SwitchNeedsMargin) {
+	EXPECT_EQ(feed({{1, -30.0f}}, 10), 1);
+	// slightly louder participant does not take over
+	EXPECT_EQ(feed({{1, -30.0f}, {2, -28.0f}}, 50), 0);
+	EXPECT_EQ(sspeak_dominant(&tracker), 1u);
+	EXPECT_EQ(feed({{1, -30.0f}, {2, -15.0f}}, 10), 1);
+	EXPECT_EQ(sspeak_dominant(&tracker), 2u);
+}
+
+TEST_F(ActiveSpeakersTest, SilentDominantIsReplaced) {
+	feed({{1, -20.0f}, {2, -100.0f}}, 10);
+	ASSERT_EQ(sspeak_dominant(&tracker), 1u);
+	// quiet speaker takes over once dominant one releases below threshold
+	feed({{1, -127.0f}, {2, -45.0f}}, 100);
+	EXPECT_EQ(sspeak_dominant(&tracker), 2u);
+	// pause keeps dominant speaker
+	feed({{1, -127.0f}, {2, -127.0f}}, 100);
+	EXPECT_EQ(sspeak_dominant(&tracker), 2u);
+	SSpeaker ranking[2];
+	EXPECT_EQ(sspeak_ranking(&tracker, ranking, 2, now), 0u);
+}
+
+TEST_F(ActiveSpeakersTest, ForgetsStaleAndRemoved) {
+	feed({{1, -20.0f}, {2, -25.0f}}, 10);
+	feed({{2, -25.0f}}, SELECON_SPEAKER_TIMEOUT * 1000000ULL / kPacket + 1);
+	EXPECT_EQ(sspeak_rank(&tracker, 1, now), -1);  // no packets for too long
+	EXPECT_EQ(sspeak_dominant(&tracker), 2u);
+	EXPECT_TRUE(sspeak_remove(&tracker, 2));
+	EXPECT_EQ(sspeak_dominant(&tracker), 0u);
+	EXPECT_EQ(sspeak_rank(&tracker, 2, now), -1);
+}
+
+TEST_F(ActiveSpeakersTest, TopKWithHold) {
+	feed({{1, -20.0f}, {2, -30.0f}}, 10);
+	// nobody is dropped while conference is not larger than k
+	EXPECT_TRUE(sspeak_in_top(&tracker, 2, 2, now));
+	feed({{1, -20.0f}, {2, -30.0f}, {3, -40.0f}}, 10);
+	EXPECT_TRUE(sspeak_in_top(&tracker, 1, 2, now));
+	EXPECT_TRUE(sspeak_in_top(&tracker, 2, 2, now));
+	EXPECT_FALSE(sspeak_in_top(&tracker, 3, 2, now));
+	// participant pushed out of top is kept for hold time
+	feed({{1, -20.0f}, {2, -30.0f}, {3, -10.0f}}, 10);
+	EXPECT_TRUE(sspeak_in_top(&tracker, 3, 2, now));
+	EXPECT_TRUE(sspeak_in_top(&tracker, 2, 2, now));
+	feed({{1, -20.0f}, {2, -30.0f}, {3, -10.0f}}, SELECON_AUDIO_TOP_K_HOLD * 1000000ULL / kPacket);
+	EXPECT_FALSE(sspeak_in_top(&tracker, 2, 2, now));
+}
+
+TEST_F(ActiveSpeakersTest, RecentSpeakersOrder) {
+	feed({{1, -20.0f}, {2, -100.0f}, {3, -100.0f}}, 5);
+	feed({{1, -127.0f}, {2, -100.0f}, {3, -20.0f}}, 100);
+	feed({{1, -127.0f}, {2, -100.0f}, {3, -127.0f}}, 100);
+	part_id_t ids[3];
+	ASSERT_EQ(sspeak_recent(&tracker, ids, 3), 2u);  // 2 never spoke
+	EXPECT_EQ(ids[0], 3u);
+	EXPECT_EQ(ids[1], 1u);
+	ASSERT_EQ(sspeak_recent(&tracker, ids, 1), 1u);
+	EXPECT_EQ(ids[0], 3u);
+}
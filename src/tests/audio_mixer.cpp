@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/frame.h>
+
+#include "audio_mixer.h"
+#include "config.h"
+}
+
+// mixer sums sources on its own clock: each mix takes one tick from every source that has
+// buffered prefill, applies gain and mute, and keeps result within full scale
+
+static constexpr int kRate     = 48000;
+static constexpr int kChannels = 2;
+static constexpr int kTick     = kRate * SELECON_MIXER_TICK / 1000;
+
+static AVFrame* const_frame(float value, int nb_samples = kTick) {
+	AVFrame* frame     = av_frame_alloc();
+	frame->format      = AV_SAMPLE_FMT_FLTP;
+	frame->sample_rate = kRate;
+	frame->nb_samples  = nb_samples;
+	frame->time_base   = av_make_q(1, kRate);
+	av_channel_layout_default(&frame->ch_layout, kChannels);
+	av_frame_get_buffer(frame, 0);
+	for (int c = 0; c < kChannels; ++c)
+		for (int i = 0; i < nb_samples; ++i) ((float*)frame->data[c])[i] = value;
+	return frame;
+}
+
+static void push(SAudioMixer* mixer, part_id_t part_id, float value, int nb_ticks) {
+	AVFrame* frame = const_frame(value);
+	for (int i = 0; i < nb_ticks; ++i) ASSERT_EQ(smixer_push(mixer, part_id, frame), SELECON_OK);
+	av_frame_free(&frame);
+}
+
+class AudioMixerTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		ASSERT_EQ(smixer_init(&mixer, kRate, kChannels, kTick), SELECON_OK);
+		out = av_frame_alloc();
+	}
+
+	void TearDown() override {
+		av_frame_free(&out);
+		smixer_free(&mixer);
+	}
+
+	float sample(int channel, int index) { return ((float*)out->data[channel])[index]; }
+
+	SAudioMixer mixer;
+	AVFrame* out;
+};
+
+TEST_F(AudioMixerTest, SumsSourcesWithGain) {
+	ASSERT_EQ(smixer_set_gain(&mixer, 2, 0.5f), SELECON_OK);
+	push(&mixer, 1, 0.25f, SELECON_MIXER_PREFILL);
+	push(&mixer, 2, 0.5f, SELECON_MIXER_PREFILL);
+	ASSERT_EQ(smixer_mix(&mixer, out), 2);
+	ASSERT_EQ(out->nb_samples, kTick);
+	EXPECT_EQ(out->pts, 0);
+	for (int c = 0; c < kChannels; ++c) {
+		EXPECT_FLOAT_EQ(sample(c, 0), 0.5f);
+		EXPECT_FLOAT_EQ(sample(c, kTick - 1), 0.5f);
+	}
+
+	ASSERT_EQ(smixer_set_mute(&mixer, 1, true), SELECON_OK);
+	ASSERT_EQ(smixer_mix(&mixer, out), 1);
+	EXPECT_EQ(out->pts, kTick);
+	EXPECT_FLOAT_EQ(sample(0, 0), 0.25f);
+}
+
+TEST_F(AudioMixerTest, WaitsForPrefillAfterUnderrun) {
+	push(&mixer, 1, 0.5f, SELECON_MIXER_PREFILL - 1);
+	EXPECT_EQ(smixer_mix(&mixer, out), 0);
+	EXPECT_EQ(sample(0, 0), 0.0f);
+	push(&mixer, 1, 0.5f, 1);
+	for (int i = 0; i < SELECON_MIXER_PREFILL; ++i) EXPECT_EQ(smixer_mix(&mixer, out), 1);
+	// underrun sends source back to prefill
+	EXPECT_EQ(smixer_mix(&mixer, out), 0);
+	push(&mixer, 1, 0.5f, SELECON_MIXER_PREFILL - 1);
+	EXPECT_EQ(smixer_mix(&mixer, out), 0);
+	push(&mixer, 1, 0.5f, 1);
+	EXPECT_EQ(smixer_mix(&mixer, out), 1);
+}
+
+TEST_F(AudioMixerTest, LimiterKeepsFullScale) {
+	const int nb_sources = 4;
+	const int nb_ticks   = 50;
+	for (part_id_t id = 1; id <= nb_sources; ++id) push(&mixer, id, 0.5f, SELECON_MIXER_PREFILL);
+	float prev_gain = 1.0f;
+	for (int t = 0; t < nb_ticks; ++t) {
+		// loud for first half, then quiet: limiter must release smoothly
+		float value = t < nb_ticks / 2 ? 0.5f : 0.05f;
+		for (part_id_t id = 1; id <= nb_sources; ++id) push(&mixer, id, value, 1);
+		ASSERT_EQ(smixer_mix(&mixer, out), nb_sources);
+		for (int c = 0; c < kChannels; ++c)
+			for (int i = 0; i < kTick; ++i) ASSERT_LE(fabsf(sample(c, i)), 1.0f + 1e-6f);
+		EXPECT_LE(mixer.limiter_gain, 1.0f);
+		if (t >= nb_ticks / 2 + SELECON_MIXER_PREFILL) {
+			EXPECT_GE(mixer.limiter_gain, prev_gain);
+		}
+		prev_gain = mixer.limiter_gain;
+	}
+	EXPECT_GT(mixer.limiter_gain, 0.5f);
+}
+
+TEST_F(AudioMixerTest, DropsBacklogOverMaxDelay) {
+	push(&mixer, 1, 0.5f, SELECON_MIXER_MAX_DELAY * 3);
+	ASSERT_EQ(smixer_mix(&mixer, out), 1);
+	int nb_heard = 1;
+	while (smixer_mix(&mixer, out) > 0) ++nb_heard;
+	EXPECT_LE(nb_heard, SELECON_MIXER_MAX_DELAY);
+}
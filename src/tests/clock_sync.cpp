@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include "clock_sync.h"
+#include "config.h"
+
+// peer clock from ping exchanges: offset, queueing filter, drift, steps and corrected latency
+
+static constexpr int64_t kMs           = 1000000;
+static constexpr timestamp_t kStart    = 1000000000000000000ULL;
+static constexpr int64_t kPeerOffset   = 5000 * kMs;  // peer clock is 5 s ahead
+static constexpr int64_t kOneWay       = 10 * kMs;
+static constexpr int64_t kHold         = 1 * kMs;  // peer answers ping after that
+static constexpr timestamp_t kInterval = SELECON_PING_INTERVAL * kMs;
+
+// peer clock reading at local time
+struct Peer {
+	int64_t offset = kPeerOffset;
+	double drift   = 0.0;
+
+	timestamp_t at(timestamp_t local) const {
+		return local + offset + (int64_t)(drift * (double)(int64_t)(local - kStart));
+	}
+
+	// one exchange started at local time, extra delay is added to ping and pong ways
+	bool exchange(SClockSync* sync, timestamp_t ping, int64_t up = 0, int64_t down = 0) const {
+		timestamp_t recv = ping + kOneWay + up;
+		timestamp_t send = recv + kHold;
+		timestamp_t pong = send + kOneWay + down;
+		return sclock_add(sync, ping, at(recv), at(send), pong);
+	}
+};
+
+TEST(ClockSync, OffsetFromSymmetricExchange) {
+	SClockSync sync;
+	sclock_init(&sync);
+	EXPECT_FALSE(sclock_valid(&sync));
+	EXPECT_EQ(sclock_offset(&sync, kStart), 0);
+	Peer peer;
+	ASSERT_TRUE(peer.exchange(&sync, kStart));
+	EXPECT_TRUE(sclock_valid(&sync));
+	EXPECT_EQ(sclock_offset(&sync, kStart), kPeerOffset);
+	EXPECT_EQ(sync.min_delay, 2 * kOneWay);
+	EXPECT_EQ(sclock_to_local(&sync, peer.at(kStart + 123 * kMs)), kStart + 123 * kMs);
+	// pong sent before ping was received can not happen
+	EXPECT_FALSE(sclock_add(&sync, kStart, peer.at(kStart) + 1, peer.at(kStart), kStart + kMs));
+}
+
+TEST(ClockSync, QueueingIsFilteredOut) {
+	SClockSync sync;
+	sclock_init(&sync);
+	Peer peer;
+	// pings queue up to 30 ms, one in five goes through fast
+	for (int i = 0; i < 20; ++i)
+		peer.exchange(&sync, kStart + i * kInterval, i % 5 == 0 ? 0 : (i % 7) * 5 * kMs, 0);
+	int64_t error = sclock_offset(&sync, kStart + 20 * kInterval) - kPeerOffset;
+	EXPECT_LE(llabs(error), SELECON_CLOCK_DELAY_MARGIN * kMs / 2);
+	EXPECT_EQ(sync.min_delay, 2 * kOneWay);
+}
+
+TEST(ClockSync, DriftIsTracked) {
+	SClockSync sync;
+	sclock_init(&sync);
+	Peer peer;
+	peer.drift = 50e-6;  // peer clock runs 50 ppm fast
+	for (int i = 0; i < SELECON_CLOCK_SAMPLES; ++i)
+		peer.exchange(&sync, kStart + i * kInterval, (i % 3) * kMs / 2, 0);
+	EXPECT_NEAR(sync.drift * 1e6, 50.0, 10.0);
+	// minute later without exchanges, constant offset would be 3 ms off
+	timestamp_t later = kStart + 60000 * kMs;
+	EXPECT_LE(llabs(sclock_offset(&sync, later) - (int64_t)(peer.at(later) - later)), kMs);
+}
+
+TEST(ClockSync, PeerClockStepResetsHistory) {
+	SClockSync sync;
+	sclock_init(&sync);
+	Peer peer;
+	for (int i = 0; i < 10; ++i) peer.exchange(&sync, kStart + i * kInterval);
+	peer.offset -= 2000 * kMs;  // NTP daemon of peer stepped its clock back
+	peer.exchange(&sync, kStart + 10 * kInterval);
+	EXPECT_EQ(sync.count, 1u);
+	EXPECT_EQ(sclock_offset(&sync, kStart + 10 * kInterval), peer.offset);
+	// slow exchange can not be trusted enough for that
+	peer.offset += 2000 * kMs;
+	peer.exchange(&sync, kStart + 11 * kInterval, 500 * kMs, 0);
+	EXPECT_EQ(sync.count, 2u);
+}
+
+TEST(ClockSync, TrackerCorrectsLatency) {
+	SClockTracker tracker;
+	ASSERT_EQ(sclocks_init(&tracker), SELECON_OK);
+	Peer peer;
+	SClockStats stats;
+	timestamp_t now = kStart;
+	// clock is not known yet, timestamps stay as they are
+	sclocks_arrived(&tracker, 7, peer.at(now), now + kOneWay);
+	EXPECT_FALSE(sclocks_stats(&tracker, 7, now, &stats));
+	EXPECT_EQ(sclocks_to_local(&tracker, 7, now), now);
+	timestamp_t recv = now + kOneWay;
+	ASSERT_TRUE(sclocks_exchange(
+	    &tracker, 7, now, peer.at(recv), peer.at(recv + kHold), recv + kHold + kOneWay));
+	ASSERT_TRUE(sclocks_stats(&tracker, 7, now, &stats));
+	EXPECT_EQ(stats.offset_ns, kPeerOffset);
+	EXPECT_EQ(stats.nb_samples, 1u);
+	EXPECT_LT(stats.latency_ms, 0.0f);
+	// media captured by peer arrives one way later, whatever its clock says
+	for (int i = 0; i < 10; ++i) {
+		now += 20 * kMs;
+		sclocks_arrived(&tracker, 7, peer.at(now), now + kOneWay);
+	}
+	ASSERT_TRUE(sclocks_stats(&tracker, 7, now, &stats));
+	EXPECT_NEAR(stats.latency_ms, kOneWay / 1e6f, 0.01f);
+	EXPECT_EQ(sclocks_to_local(&tracker, 7, peer.at(now)), now);
+	sclocks_remove(&tracker, 7);
+	EXPECT_FALSE(sclocks_stats(&tracker, 7, now, &stats));
+	sclocks_free(&tracker);
+}
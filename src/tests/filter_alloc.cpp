@@ -0,0 +1,149 @@
+#include <dlfcn.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+extern "C" {
+#include <libavutil/frame.h>
+
+#include "media_filters.h"
+}
+
+// counts allocations done by libav* while video frames go through MediaFilterGraph.
+//
+// av_malloc is backed by posix_memalign on linux, so it is interposed here. libavfilter still
+// allocates small bookkeeping structures (AVFrame, AVBufferRef) per frame, but image buffers
+// must come from pools of graph links once graph is warmed up
+
+static constexpr int kFrames        = 10000;
+static constexpr int kWarmupFrames  = 100;
+static constexpr size_t kLargeAlloc = 4096;  // anything bigger is image data
+
+static std::atomic<bool> counting{false};
+static std::atomic<size_t> nb_large_allocs{0};
+static std::atomic<size_t> nb_small_allocs{0};
+
+extern "C" int posix_memalign(void** ptr, size_t alignment, size_t size) {
+	using posix_memalign_fn  = int (*)(void**, size_t, size_t);
+	static auto real_memalign = (posix_memalign_fn)dlsym(RTLD_NEXT, "posix_memalign");
+	if (counting && size >= kLargeAlloc)
+		++nb_large_allocs;
+	else if (counting)
+		++nb_small_allocs;
+	return real_memalign(ptr, alignment, size);
+}
+
+static AVFrame* create_video_frame(int width, int height) {
+	AVFrame* frame             = av_frame_alloc();
+	frame->format              = AV_PIX_FMT_YUV420P;
+	frame->width               = width;
+	frame->height              = height;
+	frame->time_base           = av_make_q(1, 1000);
+	frame->sample_aspect_ratio = av_make_q(1, 1);
+	av_frame_get_buffer(frame, 0);
+	for (int plane = 0; plane < 3; ++plane) {
+		int lines = plane == 0 ? height : height / 2;
+		for (int y = 0; y < lines; ++y)
+			for (int x = 0; x < frame->linesize[plane]; ++x)
+				frame->data[plane][y * frame->linesize[plane] + x] = (uint8_t)(x + y * plane);
+	}
+	return frame;
+}
+
+// pushes source frame through graph, returns amount of frames received
+static int filter_frames(MediaFilterGraph* graph, AVFrame* src, int count) {
+	AVFrame* in  = av_frame_alloc();
+	AVFrame* out = av_frame_alloc();
+	int received = 0;
+	for (int i = 0; i < count; ++i) {
+		av_frame_ref(in, src);
+		in->pts = i * 33;
+		if (mfgraph_send(graph, in) != SELECON_OK)
+			break;
+		while (mfgraph_receive(graph, out) >= 0) {
+			++received;
+			av_frame_unref(out);
+		}
+	}
+	av_frame_free(&in);
+	av_frame_free(&out);
+	return received;
+}
+
+static void check_video_path(int src_width, int src_height, int dst_width, int dst_height) {
+	MediaFilterGraph graph;
+	mfgraph_init_video(&graph, AV_PIX_FMT_YUV420P, dst_width, dst_height);
+	graph.allow_bypass = false;  // same size frames would skip graph and its pools otherwise
+	AVFrame* src       = create_video_frame(src_width, src_height);
+
+	// graph build and pool fill during warm-up must be seen, else zero below proves nothing
+	nb_large_allocs = 0;
+	counting        = true;
+	int warmed_up   = filter_frames(&graph, src, kWarmupFrames);
+	counting        = false;
+	ASSERT_EQ(warmed_up, kWarmupFrames);
+	EXPECT_GT(nb_large_allocs, 0u);
+
+	nb_large_allocs = 0;
+	nb_small_allocs = 0;
+	counting        = true;
+	int received    = filter_frames(&graph, src, kFrames);
+	counting        = false;
+
+	printf("%dx%d -> %dx%d: %zu large, %.1f small allocations per frame\n",
+	       src_width,
+	       src_height,
+	       dst_width,
+	       dst_height,
+	       nb_large_allocs.load(),
+	       (double)nb_small_allocs / kFrames);
+	EXPECT_EQ(received, kFrames);
+	EXPECT_EQ(nb_large_allocs, 0u);
+	EXPECT_GT(nb_small_allocs, 0u);  // per frame bookkeeping still goes through hook
+	av_frame_free(&src);
+	mfgraph_free(&graph);
+}
+
+TEST(FilterAlloc, VideoScaleUsesPooledBuffers) {
+	check_video_path(640, 360, 320, 180);
+}
+
+TEST(FilterAlloc, VideoSameSizeUsesPooledBuffers) {
+	check_video_path(320, 180, 320, 180);
+}
+
+// pushes frames of given size starting at first_pts, every output must have graph target format
+static void check_video_output(MediaFilterGraph* graph, int width, int height, int64_t first_pts) {
+	AVFrame* src = create_video_frame(width, height);
+	AVFrame* in  = av_frame_alloc();
+	AVFrame* out = av_frame_alloc();
+	int received = 0;
+	for (int i = 0; i < kWarmupFrames; ++i) {
+		av_frame_ref(in, src);
+		in->pts = first_pts + i * 33;
+		ASSERT_EQ(mfgraph_send(graph, in), SELECON_OK);
+		while (mfgraph_receive(graph, out) >= 0) {
+			EXPECT_EQ(out->format, graph->pixel_fmt);
+			EXPECT_EQ(out->width, graph->width);
+			EXPECT_EQ(out->height, graph->height);
+			++received;
+			av_frame_unref(out);
+		}
+	}
+	EXPECT_EQ(received, kWarmupFrames) << width << "x" << height;
+	av_frame_free(&in);
+	av_frame_free(&out);
+	av_frame_free(&src);
+}
+
+// passthrough, graph and passthrough again as source size changes back and forth
+TEST(FilterAlloc, VideoPathFollowsSourceSize) {
+	MediaFilterGraph graph;
+	mfgraph_init_video(&graph, AV_PIX_FMT_YUV420P, 320, 180);
+	check_video_output(&graph, 320, 180, 0);
+	check_video_output(&graph, 640, 360, kWarmupFrames * 33);
+	check_video_output(&graph, 320, 180, 2 * kWarmupFrames * 33);
+	mfgraph_free(&graph);
+}
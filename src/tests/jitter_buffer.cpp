@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "config.h"
+#include "jitter_buffer.h"
+
+// jitter buffer: packets ordered by sender time, released on playout clock, lost audio concealed
+
+static constexpr timestamp_t kStart = 1000000000000ULL;
+static constexpr int64_t kFrame     = 20;  // ms
+
+static timestamp_t at(int64_t ms) {
+	return kStart + ms * 1000000ULL;
+}
+
+static SJitterPacket packet(int64_t pts, bool silence = false) {
+	return {reinterpret_cast<void*>(pts + 1), pts, kFrame, silence};
+}
+
+// pops everything due at given time
+static std::vector<int64_t> pop_due(SJitterBuffer* jb, timestamp_t now) {
+	std::vector<int64_t> played;
+	SJitterPacket out;
+	timestamp_t due;
+	for (SJitterResult res; (res = sjbuf_pop(jb, now, &out, &due)) == SJBUF_PACKET ||
+	                        res == SJBUF_LOST;)
+		played.push_back(res == SJBUF_LOST ? -out.pts : out.pts);
+	return played;
+}
+
+TEST(JitterBuffer, ReordersBySenderTimestamp) {
+	SJitterBuffer jb;
+	sjbuf_init(&jb, true);
+	for (int64_t pts : {0, 40, 20, 60}) {
+		SJitterPacket p = packet(pts);
+		ASSERT_TRUE(sjbuf_push(&jb, &p, at(pts > 0 ? 65 : 5)));
+	}
+	// late packets raised delay, last one plays with it
+	SJitterStats stats;
+	sjbuf_stats(&jb, &stats);
+	EXPECT_EQ(stats.nb_late, 1u);
+	EXPECT_EQ(pop_due(&jb, at(66 + stats.delay_ms)), (std::vector<int64_t>{0, 20, 40, 60}));
+}
+
+TEST(JitterBuffer, ReleasesOnPlayoutClock) {
+	SJitterBuffer jb;
+	sjbuf_init(&jb, true);
+	SJitterPacket p = packet(0);
+	ASSERT_TRUE(sjbuf_push(&jb, &p, at(5)));
+	SJitterPacket out;
+	timestamp_t due = 0;
+	EXPECT_EQ(sjbuf_pop(&jb, at(5), &out, &due), SJBUF_WAIT);
+	EXPECT_EQ(due, at(5 + SELECON_JITTER_MIN_DELAY));
+	// decoder busy for 30 ms past playout time
+	EXPECT_EQ(sjbuf_lag(&jb, at(5)), 0);
+	EXPECT_EQ(sjbuf_lag(&jb, due + 30 * 1000000ULL), 30);
+	EXPECT_EQ(sjbuf_pop(&jb, due, &out, &due), SJBUF_PACKET);
+	EXPECT_EQ(out.data, p.data);
+	SJitterStats stats;
+	sjbuf_stats(&jb, &stats);
+	EXPECT_EQ(stats.depth, 0u);
+	EXPECT_EQ(stats.nb_packets, 1u);
+	EXPECT_EQ(stats.nb_late, 0u);
+}
+
+TEST(JitterBuffer, DelayFollowsJitter) {
+	SJitterBuffer jb;
+	sjbuf_init(&jb, true);
+	// every other packet is 30 ms slower
+	for (int64_t i = 0; i < 100; ++i) {
+		SJitterPacket p = packet(i * kFrame);
+		sjbuf_push(&jb, &p, at(i * kFrame + 5 + (i % 2) * 30));
+		pop_due(&jb, at(i * kFrame));
+	}
+	SJitterStats stats;
+	sjbuf_stats(&jb, &stats);
+	EXPECT_GT(stats.jitter_ms, 20.0f);
+	EXPECT_GE(stats.delay_ms, 80);
+	EXPECT_LE(stats.delay_ms, SELECON_JITTER_MAX_DELAY);
+	EXPECT_GT(stats.depth, 0u);
+	// steady arrival lets delay go back slowly, never below minimum
+	for (int64_t i = 100; i < 1000; ++i) {
+		SJitterPacket p = packet(i * kFrame);
+		sjbuf_push(&jb, &p, at(i * kFrame + 5));
+		pop_due(&jb, at(i * kFrame));
+	}
+	SJitterStats steady;
+	sjbuf_stats(&jb, &steady);
+	EXPECT_LT(steady.delay_ms, stats.delay_ms);
+	EXPECT_GE(steady.delay_ms, SELECON_JITTER_MIN_DELAY);
+}
+
+TEST(JitterBuffer, LostAudioIsConcealedAndDroppedWhenLate) {
+	SJitterBuffer jb;
+	sjbuf_init(&jb, true);
+	for (int64_t pts : {0, 20, 60}) {
+		SJitterPacket p = packet(pts);
+		ASSERT_TRUE(sjbuf_push(&jb, &p, at(pts + 5)));
+	}
+	const int64_t delay = 5 + SELECON_JITTER_MIN_DELAY;
+	EXPECT_EQ(pop_due(&jb, at(20 + delay)), (std::vector<int64_t>{0, 20}));
+	EXPECT_TRUE(pop_due(&jb, at(40 + delay - 1)).empty());
+	EXPECT_EQ(pop_due(&jb, at(40 + delay)), (std::vector<int64_t>{-40}));
+	SJitterPacket late = packet(40);
+	EXPECT_FALSE(sjbuf_push(&jb, &late, at(40 + delay + 1)));
+	EXPECT_EQ(pop_due(&jb, at(60 + delay + 5)), (std::vector<int64_t>{60}));
+	SJitterStats stats;
+	sjbuf_stats(&jb, &stats);
+	EXPECT_EQ(stats.nb_late, 1u);
+	EXPECT_EQ(stats.nb_dropped, 1u);
+	EXPECT_EQ(stats.nb_concealed, 1u);
+}
+
+TEST(JitterBuffer, LateVideoStillPlays) {
+	SJitterBuffer jb;
+	sjbuf_init(&jb, false);
+	for (int64_t pts : {0, 20, 60}) {
+		SJitterPacket p = packet(pts);
+		ASSERT_TRUE(sjbuf_push(&jb, &p, at(pts + 5)));
+	}
+	EXPECT_EQ(pop_due(&jb, at(1000)), (std::vector<int64_t>{0, 20, 60}));
+	SJitterPacket late = packet(40);
+	ASSERT_TRUE(sjbuf_push(&jb, &late, at(1000)));
+	EXPECT_EQ(pop_due(&jb, at(1000)), (std::vector<int64_t>{40}));
+}
+
+TEST(JitterBuffer, ConcealmentIsBounded) {
+	SJitterBuffer jb;
+	sjbuf_init(&jb, true);
+	SJitterPacket p = packet(0);
+	ASSERT_TRUE(sjbuf_push(&jb, &p, at(5)));
+	std::vector<int64_t> played = pop_due(&jb, at(10000));
+	ASSERT_EQ(played.size(), 1u + SELECON_PLC_MAX_CONCEAL / kFrame);
+	SJitterPacket out;
+	timestamp_t due;
+	EXPECT_EQ(sjbuf_pop(&jb, at(10000), &out, &due), SJBUF_EMPTY);
+	// nothing is concealed after silence marker of DTX sender
+	SJitterBuffer dtx;
+	sjbuf_init(&dtx, true);
+	SJitterPacket marker = packet(0, true);
+	ASSERT_TRUE(sjbuf_push(&dtx, &marker, at(5)));
+	EXPECT_EQ(pop_due(&dtx, at(10000)), (std::vector<int64_t>{0}));
+}
+
+// packets captured together reach audio and video buffers after given transit
+static void feed_av(SJitterBuffer* audio,
+                    SJitterBuffer* video,
+                    int64_t audio_transit,
+                    int64_t video_transit) {
+	sjbuf_init(audio, true);
+	sjbuf_init(video, false);
+	for (int64_t pts = 0; pts < 10 * kFrame; pts += kFrame) {
+		SJitterPacket a = packet(pts), v = packet(pts);
+		sjbuf_push(audio, &a, at(pts + audio_transit));
+		sjbuf_push(video, &v, at(pts + video_transit));
+	}
+}
+
+TEST(JitterBuffer, LipSyncDelaysEarlierStream) {
+	SJitterBuffer audio, video;
+	SLipSyncStats stats;
+	sjbuf_init(&audio, true);
+	sjbuf_init(&video, false);
+	EXPECT_FALSE(sjbuf_lipsync(&audio, &video, &stats));
+	feed_av(&audio, &video, 5, 65);
+	ASSERT_TRUE(sjbuf_lipsync(&audio, &video, &stats));
+	EXPECT_EQ(stats.av_offset_ms, 60);
+	EXPECT_EQ(stats.audio_delay_ms, 60);
+	EXPECT_EQ(stats.video_delay_ms, 0);
+	EXPECT_EQ(stats.residual_ms, 0);
+	// captured together, played together
+	SJitterPacket out;
+	timestamp_t audio_due = 0, video_due = 0;
+	EXPECT_EQ(sjbuf_pop(&audio, at(0), &out, &audio_due), SJBUF_WAIT);
+	EXPECT_EQ(sjbuf_pop(&video, at(0), &out, &video_due), SJBUF_WAIT);
+	EXPECT_EQ(audio_due, video_due);
+	// video waits for late audio
+	feed_av(&audio, &video, 50, 5);
+	ASSERT_TRUE(sjbuf_lipsync(&audio, &video, &stats));
+	EXPECT_EQ(stats.av_offset_ms, -45);
+	EXPECT_EQ(stats.audio_delay_ms, 0);
+	EXPECT_EQ(stats.video_delay_ms, 45);
+	// offset within tolerance is left
+	feed_av(&audio, &video, 5, 10);
+	ASSERT_TRUE(sjbuf_lipsync(&audio, &video, &stats));
+	EXPECT_EQ(stats.audio_delay_ms, 0);
+	EXPECT_EQ(stats.residual_ms, 5);
+}
+
+TEST(JitterBuffer, LipSyncWindowIsBounded) {
+	SJitterBuffer audio, video;
+	SLipSyncStats stats;
+	feed_av(&audio, &video, 5, 1005);
+	ASSERT_TRUE(sjbuf_lipsync(&audio, &video, &stats));
+	EXPECT_EQ(stats.av_offset_ms, 1000);
+	EXPECT_EQ(stats.audio_delay_ms, SELECON_LIPSYNC_MAX_DELAY);
+	EXPECT_EQ(stats.residual_ms, 1000 - SELECON_LIPSYNC_MAX_DELAY);
+	SJitterStats jitter;
+	sjbuf_stats(&audio, &jitter);
+	EXPECT_EQ(jitter.sync_delay_ms, SELECON_LIPSYNC_MAX_DELAY);
+}
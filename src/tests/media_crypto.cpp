@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "config.h"
+#include "media_crypto.h"
+
+// media sealed once by sender opens at every receiver holding conference key, until key rotates
+
+static constexpr part_id_t kSender = 42;
+
+// header is authenticated, payload encrypted, tag follows payload as in media messages
+struct Sealed {
+	struct SMediaSeal seal;
+	std::vector<uint8_t> data;
+	uint8_t tag[SMCRYPT_TAG_SIZE];
+};
+
+static const std::vector<uint8_t> kPayload = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13};
+
+class MediaCrypto : public ::testing::Test {
+protected:
+	void SetUp() override {
+		ASSERT_EQ(smcrypt_init(&sender), SELECON_OK);
+		ASSERT_EQ(smcrypt_init(&receiver), SELECON_OK);
+		struct SMediaKey keys[2];
+		smcrypt_export(&sender, keys);
+		smcrypt_import(&receiver, keys);
+	}
+
+	void TearDown() override {
+		smcrypt_free(&sender);
+		smcrypt_free(&receiver);
+	}
+
+	Sealed seal(timestamp_t now = 0) {
+		Sealed sealed;
+		sealed.data = kPayload;
+		EXPECT_EQ(smcrypt_seal(&sender,
+		                       kSender,
+		                       now,
+		                       &sealed.seal,
+		                       &sealed.seal,
+		                       sizeof(sealed.seal),
+		                       sealed.data.data(),
+		                       sealed.data.size(),
+		                       sealed.tag),
+		          SELECON_OK);
+		return sealed;
+	}
+
+	SError open(struct SMediaCrypto* crypto, Sealed& sealed, part_id_t sender = kSender) {
+		return smcrypt_open(crypto,
+		                    sender,
+		                    &sealed.seal,
+		                    &sealed.seal,
+		                    sizeof(sealed.seal),
+		                    sealed.data.data(),
+		                    sealed.data.size(),
+		                    sealed.tag);
+	}
+
+	struct SMediaCrypto sender;
+	struct SMediaCrypto receiver;
+};
+
+TEST_F(MediaCrypto, SealedPayloadOpens) {
+	Sealed sealed = seal();
+	EXPECT_NE(sealed.data, kPayload);
+	ASSERT_EQ(open(&receiver, sealed), SELECON_OK);
+	EXPECT_EQ(sealed.data, kPayload);
+}
+
+TEST_F(MediaCrypto, NonceNeverRepeats) {
+	Sealed first  = seal();
+	Sealed second = seal();
+	EXPECT_EQ(first.seal.key_id, second.seal.key_id);
+	EXPECT_NE(first.seal.counter, second.seal.counter);
+	EXPECT_NE(first.data, second.data);
+}
+
+TEST_F(MediaCrypto, AlteredMessageIsRejected) {
+	Sealed payload = seal();
+	payload.data[0] ^= 1;
+	EXPECT_EQ(open(&receiver, payload), SELECON_CRYPTO_ERROR);
+	Sealed header = seal();
+	++header.seal.counter;
+	EXPECT_EQ(open(&receiver, header), SELECON_CRYPTO_ERROR);
+	Sealed tag = seal();
+	tag.tag[0] ^= 1;
+	EXPECT_EQ(open(&receiver, tag), SELECON_CRYPTO_ERROR);
+	Sealed other = seal();  // media of one participant passed on behalf of other
+	EXPECT_EQ(open(&receiver, other, kSender + 1), SELECON_CRYPTO_ERROR);
+}
+
+TEST_F(MediaCrypto, ReplayedFrameIsRejected) {
+	Sealed first  = seal();
+	Sealed second = seal();
+	Sealed copy   = first;
+	ASSERT_EQ(open(&receiver, second), SELECON_OK);
+	// reordered frame still opens once
+	ASSERT_EQ(open(&receiver, first), SELECON_OK);
+	EXPECT_EQ(open(&receiver, copy), SELECON_CRYPTO_ERROR);
+	// frames older than window are rejected as well
+	Sealed old = seal();
+	for (int i = 0; i < SMCRYPT_REPLAY_WINDOW; ++i) {
+		Sealed next = seal();
+		ASSERT_EQ(open(&receiver, next), SELECON_OK);
+	}
+	EXPECT_EQ(open(&receiver, old), SELECON_CRYPTO_ERROR);
+	// same counter of other sender is other frame
+	struct SMediaCrypto other;
+	ASSERT_EQ(smcrypt_init(&other), SELECON_OK);
+	struct SMediaKey keys[2];
+	smcrypt_export(&sender, keys);
+	smcrypt_import(&other, keys);
+	Sealed foreign;
+	foreign.data = kPayload;
+	ASSERT_EQ(smcrypt_seal(&other,
+	                       kSender + 1,
+	                       0,
+	                       &foreign.seal,
+	                       &foreign.seal,
+	                       sizeof(foreign.seal),
+	                       foreign.data.data(),
+	                       foreign.data.size(),
+	                       foreign.tag),
+	          SELECON_OK);
+	EXPECT_EQ(foreign.seal.counter, first.seal.counter);
+	EXPECT_EQ(open(&receiver, foreign, kSender + 1), SELECON_OK);
+	smcrypt_free(&other);
+}
+
+TEST_F(MediaCrypto, OutsiderCanNotOpen) {
+	struct SMediaCrypto outsider;
+	ASSERT_EQ(smcrypt_init(&outsider), SELECON_OK);
+	Sealed sealed = seal();
+	EXPECT_EQ(open(&outsider, sealed), SELECON_CRYPTO_ERROR);
+	smcrypt_free(&outsider);
+}
+
+TEST_F(MediaCrypto, RotationSwitchesAfterDelay) {
+	const timestamp_t delay = SELECON_MEDIA_KEY_SWITCH_DELAY * 1000000ULL;
+	struct SMediaKey key;
+	ASSERT_EQ(smcrypt_generate(&sender, &key), SELECON_OK);
+	ASSERT_TRUE(smcrypt_install(&sender, &key, 1000));
+	EXPECT_FALSE(smcrypt_install(&sender, &key, 1000));  // replayed
+	struct SMediaKey far = key;
+	far.id += 2;  // skips rotation, would block ones in between
+	EXPECT_FALSE(smcrypt_install(&sender, &far, 1000));
+	far.id = UINT32_MAX;
+	EXPECT_FALSE(smcrypt_install(&sender, &far, 1000));
+	Sealed old_key  = seal(1000 + delay - 1);
+	Sealed in_queue = seal(1000 + delay - 1);
+	EXPECT_NE(old_key.seal.key_id, key.id);
+	EXPECT_EQ(open(&receiver, old_key), SELECON_OK);
+	Sealed new_key = seal(1000 + delay);
+	EXPECT_EQ(new_key.seal.key_id, key.id);
+	EXPECT_EQ(new_key.seal.counter, 0u);
+	EXPECT_EQ(open(&receiver, new_key), SELECON_CRYPTO_ERROR);  // not delivered yet
+	ASSERT_TRUE(smcrypt_install(&receiver, &key, 2000));
+	new_key = seal(1000 + delay);
+	EXPECT_EQ(open(&receiver, new_key), SELECON_OK);
+	// media sealed with previous key before switch still opens after it
+	EXPECT_EQ(open(&receiver, in_queue), SELECON_OK);
+}
+
+TEST_F(MediaCrypto, NewcomerOpensBothKeys) {
+	struct SMediaKey key;
+	ASSERT_EQ(smcrypt_generate(&sender, &key), SELECON_OK);
+	ASSERT_TRUE(smcrypt_install(&sender, &key, 0));
+	ASSERT_TRUE(smcrypt_install(&receiver, &key, 0));
+	Sealed old_key = seal(0);
+	struct SMediaKey keys[2];
+	smcrypt_export(&receiver, keys);
+	EXPECT_NE(keys[0].id, keys[1].id);
+	struct SMediaCrypto newcomer;
+	ASSERT_EQ(smcrypt_init(&newcomer), SELECON_OK);
+	smcrypt_import(&newcomer, keys);
+	Sealed new_key = seal(SELECON_MEDIA_KEY_SWITCH_DELAY * 1000000ULL);
+	EXPECT_EQ(open(&newcomer, old_key), SELECON_OK);
+	EXPECT_EQ(open(&newcomer, new_key), SELECON_OK);
+	smcrypt_free(&newcomer);
+}
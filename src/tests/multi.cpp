@@ -131,3 +131,25 @@ TEST_F(Multi4, passAudioData) {
 		EXPECT_GT(userRcvQueue[ctxs[i]].size(), 0);
 	}
 }
+
+TEST_F(Multi4, webinarFeedsListenersThroughTree) {
+	// organiser uplink feeds one listener only, so other two are fed by listener
+	ASSERT_EQ(selecon_set_webinar(ctxs[0], true), SELECON_OK);
+	ASSERT_EQ(selecon_set_uplink_capacity(ctxs[0], 600), SELECON_OK);
+	for (size_t i = 1; i < participants_count; ++i)
+		ASSERT_EQ(selecon_invite2(ctxs[0], sockAddrs[i]), SELECON_OK);
+	sleep(1);  // placed listeners are met by their feeders
+
+	sstream_id_t audio_stream = NULL;
+	EXPECT_EQ(selecon_stream_alloc_audio(ctxs[1], &audio_stream), SELECON_NOT_PRESENTER);
+	ASSERT_EQ(selecon_stream_alloc_audio(ctxs[0], &audio_stream), SELECON_OK);
+	double time = 0.0;
+	while (time < 1.0) {
+		AVFrame* frame = create_audio_frame(time);
+		SError err     = selecon_stream_push_frame(ctxs[0], audio_stream, &frame);
+		av_frame_free(&frame);
+		ASSERT_EQ(err, SELECON_OK);
+	}
+	sleep(5);
+	for (size_t i = 1; i < participants_count; ++i) EXPECT_GT(userRcvQueue[ctxs[i]].size(), 0);
+}
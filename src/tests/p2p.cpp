@@ -1,9 +1,13 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <deque>
 
 extern "C" {
+#include <libavcodec/avcodec.h>
 #include <libavutil/frame.h>
 }
 
@@ -141,3 +145,135 @@ TEST_F(P2P, passData) {
 	          << " seconds)" << std::endl;
 	ASSERT_GT(user2RcvQueue.size(), 0);
 }
+
+static AVFrame* create_video_frame(int width, int height, int index) {
+	AVFrame* frame = av_frame_alloc();
+	frame->format  = SELECON_DEFAULT_VIDEO_PIXEL_FMT;
+	frame->width   = width;
+	frame->height  = height;
+	av_frame_get_buffer(frame, 0);
+	for (int y = 0; y < height; ++y)
+		for (int x = 0; x < width; ++x) frame->data[0][y * frame->linesize[0] + x] = x + y + index;
+	for (int p = 1; p <= 2; ++p)
+		for (int y = 0; y < height / 2; ++y)
+			memset(frame->data[p] + y * frame->linesize[p], 128, width / 2);
+	return frame;
+}
+
+TEST_F(P2P, simulcastLayerSwitch) {
+	if (avcodec_find_encoder(SELECON_DEFAULT_VIDEO_CODEC_ID) == nullptr)
+		GTEST_SKIP() << "video encoder not available";
+	auto err = selecon_context_init2(user1Ctx, user1SockAddr, NULL, NULL, user1_rcv_handler);
+	ASSERT_EQ(err, SELECON_OK);
+	err = selecon_context_init2(user2Ctx, user2SockAddr, NULL, NULL, user2_rcv_handler);
+	ASSERT_EQ(err, SELECON_OK);
+
+	sleep(1);
+
+	err = selecon_invite2(user1Ctx, user2SockAddr);
+	ASSERT_EQ(err, SELECON_OK);
+
+	// user1 sends 640x360 and 320x180 layers, user2 takes the lower one
+	const int width = 640, height = 360, fps = 30;
+	SVideoParams params = {width, height, fps};
+	SCodecOptions opts  = {};
+	opts.simulcast      = 2;
+	opts.gop_size       = fps / 2;
+	sstream_id_t video_stream;
+	err = selecon_stream_alloc_video2(user1Ctx, &params, &opts, &video_stream);
+	ASSERT_EQ(err, SELECON_OK);
+	sleep(1);  // user2 must know user1 to subscribe
+	err = selecon_set_video_layer(user2Ctx, selecon_get_self_id(user1Ctx), 1);
+	ASSERT_EQ(err, SELECON_OK);
+
+	for (int i = 0; i < 2 * fps; ++i) {
+		AVFrame* frame = create_video_frame(width, height, i);
+		err            = selecon_stream_push_frame(user1Ctx, video_stream, &frame);
+		av_frame_free(&frame);
+		ASSERT_EQ(err, SELECON_OK);
+		usleep(1000000 / fps);
+	}
+
+	// wait until data transfered
+	sleep(1);
+
+	ASSERT_GT(user2RcvQueue.size(), 0);
+	AVFrame* last = user2RcvQueue.back().second;
+	EXPECT_EQ(last->width, width / 2);
+	EXPECT_EQ(last->height, height / 2);
+}
+
+// noise is expensive to encode, so encoder spends all bitrate it is given
+static AVFrame* create_noise_frame(int width, int height) {
+	AVFrame* frame = av_frame_alloc();
+	frame->format  = SELECON_DEFAULT_VIDEO_PIXEL_FMT;
+	frame->width   = width;
+	frame->height  = height;
+	av_frame_get_buffer(frame, 0);
+	for (int p = 0; p < 3; ++p)
+		for (int y = 0; y < (p == 0 ? height : height / 2); ++y)
+			for (int x = 0; x < (p == 0 ? width : width / 2); ++x)
+				frame->data[p][y * frame->linesize[p] + x] = rand();
+	return frame;
+}
+
+// uplink of sender is narrower than configured bitrate. Receiver reports bring encoder under it,
+// and video keeps coming without piling up in jitter buffer of receiver
+TEST_F(P2P, rateAdaptsToCappedUplink) {
+	const AVCodec* encoder = avcodec_find_encoder(SELECON_DEFAULT_VIDEO_CODEC_ID);
+	if (encoder == nullptr || strcmp(encoder->name, "libx264") != 0)
+		GTEST_SKIP() << "only libx264 follows bitrate changes at runtime";
+	auto err = selecon_context_init2(user1Ctx, user1SockAddr, NULL, NULL, user1_rcv_handler);
+	ASSERT_EQ(err, SELECON_OK);
+	err = selecon_context_init2(user2Ctx, user2SockAddr, NULL, NULL, user2_rcv_handler);
+	ASSERT_EQ(err, SELECON_OK);
+
+	sleep(1);
+
+	err = selecon_invite2(user1Ctx, user2SockAddr);
+	ASSERT_EQ(err, SELECON_OK);
+
+	const int width = 320, height = 180, fps = 30, seconds = 20;
+	const uint32_t cap_kbps = 300;
+	SVideoParams params = {width, height, fps};
+	SCodecOptions opts  = {};
+	opts.bit_rate       = 1000000;
+	opts.max_rate       = 1000000;
+	opts.buffer_size    = 500000;
+	opts.gop_size       = fps;
+	sstream_id_t video_stream;
+	err = selecon_stream_alloc_video2(user1Ctx, &params, &opts, &video_stream);
+	ASSERT_EQ(err, SELECON_OK);
+	ASSERT_EQ(selecon_set_send_limit(user1Ctx, cap_kbps), SELECON_OK);
+
+	// last 5 seconds are taken as settled
+	part_id_t sender   = selecon_get_self_id(user1Ctx);
+	double sum_bitrate = 0.0;
+	int nb_settled     = 0;
+	size_t max_depth   = 0;
+	for (int i = 0; i < seconds * fps; ++i) {
+		AVFrame* frame = create_noise_frame(width, height);
+		err            = selecon_stream_push_frame(user1Ctx, video_stream, &frame);
+		av_frame_free(&frame);
+		ASSERT_EQ(err, SELECON_OK);
+		usleep(1000000 / fps);
+		if (i < (seconds - 5) * fps)
+			continue;
+		SRateStats rate;
+		ASSERT_EQ(selecon_stream_get_rate_stats(user1Ctx, video_stream, &rate), SELECON_OK);
+		sum_bitrate += rate.bitrate;
+		nb_settled++;
+		SJitterStats jitter;
+		if (selecon_get_jitter_stats(user2Ctx, sender, AVMEDIA_TYPE_VIDEO, &jitter) == SELECON_OK)
+			max_depth = std::max(max_depth, jitter.depth);
+	}
+
+	SRateStats rate;
+	ASSERT_EQ(selecon_stream_get_rate_stats(user1Ctx, video_stream, &rate), SELECON_OK);
+	std::cout << "settled at " << sum_bitrate / nb_settled << " bit/s, " << rate.framerate
+	          << " fps, jitter buffer depth up to " << max_depth << std::endl;
+	EXPECT_GT(rate.nb_receivers, 0u);
+	EXPECT_LT(sum_bitrate / nb_settled, cap_kbps * 1000.0);
+	EXPECT_LE(max_depth, (size_t)fps);  // less than second of video waits for playout
+	EXPECT_GT(user2RcvQueue.size(), 0);
+}
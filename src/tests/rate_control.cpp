@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "config.h"
+#include "rate_control.h"
+
+// receiver reports and congestion control: meter, back off, growth and simulated capped link
+
+static constexpr int64_t kMs           = 1000000;
+static constexpr timestamp_t kStart    = 1000000000000ULL;
+static constexpr timestamp_t kInterval = SELECON_REPORT_INTERVAL * kMs;
+static constexpr int64_t kMaxBitrate   = 4000000;
+static constexpr int kMaxFps           = 30;
+
+static SReceiverReport normal_report(uint32_t bandwidth_kbps) {
+	SReceiverReport report = {};
+	report.bandwidth_kbps  = bandwidth_kbps;
+	return report;
+}
+
+TEST(RateControl, MeterMeasuresInterval) {
+	SRateMeter meter;
+	srate_meter_init(&meter, kStart);
+	SJitterStats jitter = {};
+	SReceiverReport report;
+	EXPECT_FALSE(srate_meter_report(&meter, &jitter, 0, 0, kStart + kInterval, &report));
+	// 125 kB/s with transit growing 10 ms each 100 ms
+	timestamp_t since = kStart + kInterval;
+	for (int i = 1; i <= 10; ++i)
+		srate_meter_packet(&meter, 12500, (20 + i * 10) * kMs, since + i * 100 * kMs);
+	jitter.nb_packets   = 10;
+	jitter.nb_concealed = 1;
+	jitter.jitter_ms    = 3.4f;
+	ASSERT_TRUE(srate_meter_report(&meter, &jitter, 4, 15, since + kInterval, &report));
+	EXPECT_EQ(report.bandwidth_kbps, 1000u);
+	EXPECT_EQ(report.delay_gradient, 100000);
+	EXPECT_EQ(report.queue_delay_ms, 45);
+	EXPECT_EQ(report.loss, 90);
+	EXPECT_EQ(report.jitter_ms, 3);
+	EXPECT_EQ(report.queue_depth, 4);
+	EXPECT_EQ(report.decode_lag_ms, 15);
+	// counters are taken over interval
+	srate_meter_packet(&meter, 12500, 30 * kMs, since + kInterval + 500 * kMs);
+	jitter.nb_packets++;
+	ASSERT_TRUE(srate_meter_report(&meter, &jitter, 0, 0, since + 2 * kInterval, &report));
+	EXPECT_EQ(report.loss, 0);
+	EXPECT_EQ(report.delay_gradient, 0);
+	EXPECT_EQ(report.bandwidth_kbps, 100u);
+}
+
+TEST(RateControl, LossBacksOffOncePerInterval) {
+	SRateControl rc;
+	srate_init(&rc, kMaxBitrate, kMaxFps);
+	SReceiverReport report = normal_report(4000);
+	timestamp_t now        = kStart;
+	// nothing to grow into
+	EXPECT_FALSE(srate_report(&rc, 1, &report, now));
+	report.loss = SELECON_RATE_LOSS_HIGH + 1;
+	now += kInterval;
+	ASSERT_TRUE(srate_report(&rc, 1, &report, now));
+	EXPECT_EQ(rc.bitrate, (int64_t)(kMaxBitrate * SELECON_RATE_BACKOFF));
+	int64_t backed_off = rc.bitrate;
+	// same congestion from another receiver within interval
+	EXPECT_FALSE(srate_report(&rc, 2, &report, now + 100 * kMs));
+	// loss below high mark holds bitrate
+	report.loss = SELECON_RATE_LOSS_LOW + 1;
+	now += kInterval;
+	EXPECT_FALSE(srate_report(&rc, 1, &report, now));
+	EXPECT_EQ(rc.bitrate, backed_off);
+}
+
+TEST(RateControl, WorstReceiverRules) {
+	SRateControl rc;
+	srate_init(&rc, kMaxBitrate, kMaxFps);
+	rc.bitrate             = kMaxBitrate / 2;
+	SReceiverReport good   = normal_report(2000);
+	SReceiverReport lossy  = normal_report(2000);
+	lossy.loss             = SELECON_RATE_LOSS_LOW + 1;
+	timestamp_t now        = kStart + 10 * kInterval;
+	srate_report(&rc, 2, &lossy, now);
+	now += kInterval;
+	EXPECT_FALSE(srate_report(&rc, 1, &good, now));
+	// receiver which stopped reporting does not hold others
+	now += 2 * kInterval;
+	ASSERT_TRUE(srate_report(&rc, 1, &good, now));
+	EXPECT_EQ(rc.bitrate, (int64_t)(kMaxBitrate / 2 * SELECON_RATE_INCREASE));
+}
+
+TEST(RateControl, FramerateFollowsBitrate) {
+	SRateControl rc;
+	srate_init(&rc, kMaxBitrate, kMaxFps);
+	SReceiverReport report = normal_report(100);
+	report.queue_delay_ms  = SELECON_RATE_MAX_QUEUE_DELAY + 1;
+	timestamp_t now        = kStart;
+	int prev_fps           = rc.framerate;
+	for (int i = 0; i < 20; ++i, now += kInterval) {
+		srate_report(&rc, 1, &report, now);
+		EXPECT_LE(rc.framerate, prev_fps);
+		prev_fps = rc.framerate;
+	}
+	EXPECT_EQ(rc.bitrate, (int64_t)(kMaxBitrate * SELECON_RATE_MIN_FRACTION));
+	EXPECT_LT(rc.framerate, kMaxFps);
+	EXPECT_GE(rc.framerate, SELECON_RATE_MIN_FPS);
+	// recovers fully without congestion
+	report = normal_report(4000);
+	for (int i = 0; i < 60; ++i, now += kInterval) srate_report(&rc, 1, &report, now);
+	EXPECT_EQ(rc.bitrate, kMaxBitrate);
+	EXPECT_EQ(rc.framerate, kMaxFps);
+}
+
+// model of link only: sender encodes at target bitrate every 10 ms into link of fixed capacity with
+// FIFO queue, receiver meter reports back each interval. No encoder, stream or connection is
+// involved, end to end behaviour over real capped link is not covered here
+TEST(RateControl, ConvergesOnSimulatedBandwidthCap) {
+	constexpr int64_t kCapacity = 1000000;  // bit/s
+	constexpr int64_t kOneWay   = 20 * kMs;
+	constexpr int64_t kTick     = 10 * kMs;
+	constexpr int kSeconds      = 60;
+	SRateControl rc;
+	srate_init(&rc, kMaxBitrate, kMaxFps);
+	SRateMeter meter;
+	srate_meter_init(&meter, kStart);
+	SJitterStats jitter = {};
+	timestamp_t link_free = kStart;
+	timestamp_t report_ts = kStart + kInterval;
+	double sum_bitrate = 0.0;
+	int nb_steady      = 0;
+	int64_t max_queue  = 0, last_queue = 0;
+	for (timestamp_t now = kStart; now < kStart + kSeconds * kInterval; now += kTick) {
+		size_t size = rc.bitrate * kTick / kMs / 1000 / 8;
+		// serialized after everything queued before
+		link_free = std::max(link_free, now) + size * 8 * 1000000000LL / kCapacity;
+		timestamp_t arrival = link_free + kOneWay;
+		int64_t queue       = link_free - now;
+		srate_meter_packet(&meter, size, arrival - now, arrival);
+		if (now >= report_ts) {
+			SReceiverReport report;
+			if (srate_meter_report(&meter, &jitter, 0, 0, now, &report))
+				srate_report(&rc, 1, &report, now + kOneWay);
+			report_ts += kInterval;
+		}
+		if (now >= kStart + (kSeconds - 20) * kInterval) {
+			sum_bitrate += rc.bitrate;
+			nb_steady++;
+			max_queue = std::max(max_queue, queue);
+		}
+		last_queue = queue;
+	}
+	double mean = sum_bitrate / nb_steady;
+	EXPECT_GT(mean, 0.7 * kCapacity);
+	EXPECT_LT(mean, 1.1 * kCapacity);
+	EXPECT_LT(max_queue, 2 * SELECON_RATE_MAX_QUEUE_DELAY * kMs);
+	EXPECT_LT(last_queue, SELECON_RATE_MAX_QUEUE_DELAY * kMs);
+}
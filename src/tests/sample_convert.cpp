@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/frame.h>
+
+#include "media_filters.h"
+}
+
+#include "sample_convert.h"
+
+// SIMD sample kernels must give exactly the same samples as scalar code and as libavfilter
+// (libswresample) conversion they replace
+
+static constexpr int kChannels   = 2;
+static constexpr int kRate       = 48000;
+static constexpr int kFrameSize  = 1024;  // encoder frame size
+static constexpr int kDeviceSize = 441;   // odd device chunks exercise fifo and kernel tails
+static constexpr int kFrames     = 50;
+
+// deterministic pseudo-random samples in [-amplitude, amplitude]
+static float noise(uint32_t& state, float amplitude) {
+	state = state * 1664525u + 1013904223u;
+	return ((state >> 8) / (float)(1 << 24) * 2.0f - 1.0f) * amplitude;
+}
+
+static AVFrame* create_frame(AVSampleFormat fmt, int rate, int nb_samples, uint32_t& state) {
+	AVFrame* frame     = av_frame_alloc();
+	frame->format      = fmt;
+	frame->sample_rate = rate;
+	frame->nb_samples  = nb_samples;
+	frame->time_base   = av_make_q(1, rate);
+	av_channel_layout_default(&frame->ch_layout, kChannels);
+	av_frame_get_buffer(frame, 0);
+	for (int i = 0; i < nb_samples; ++i)
+		for (int c = 0; c < kChannels; ++c) {
+			if (fmt == AV_SAMPLE_FMT_S16)
+				((int16_t*)frame->data[0])[i * kChannels + c] = (int16_t)noise(state, 32767.0f);
+			else  // slightly over full scale to check clipping
+				((float*)frame->data[c])[i] = noise(state, 1.25f);
+		}
+	return frame;
+}
+
+// pushes frames through graph and returns raw bytes of all output frames
+static std::vector<uint8_t> filter_audio(bool allow_bypass,
+                                         AVSampleFormat src_fmt,
+                                         int src_rate,
+                                         AVSampleFormat dst_fmt) {
+	MediaFilterGraph graph;
+	mfgraph_init_audio(&graph, dst_fmt, kRate, kChannels, kFrameSize);
+	graph.allow_bypass = allow_bypass;
+	std::vector<uint8_t> out;
+	uint32_t state  = 1;
+	AVFrame* result = av_frame_alloc();
+	for (int i = 0; i < kFrames; ++i) {
+		AVFrame* frame = create_frame(src_fmt, src_rate, kDeviceSize, state);
+		EXPECT_EQ(mfgraph_send(&graph, frame), SELECON_OK);
+		av_frame_free(&frame);
+		while (mfgraph_receive(&graph, result) == 0) {
+			int plane_size = result->nb_samples * av_get_bytes_per_sample(dst_fmt);
+			if (av_sample_fmt_is_planar(dst_fmt))
+				for (int c = 0; c < kChannels; ++c)
+					out.insert(out.end(), result->data[c], result->data[c] + plane_size);
+			else
+				out.insert(out.end(), result->data[0], result->data[0] + plane_size * kChannels);
+		}
+	}
+	if (allow_bypass)
+		EXPECT_NE(graph.path, MFPATH_GRAPH);
+	else
+		EXPECT_EQ(graph.path, MFPATH_GRAPH);
+	av_frame_free(&result);
+	mfgraph_free(&graph);
+	return out;
+}
+
+TEST(SampleConvert, KernelsMatchScalar) {
+	enum SConvSimd detected = sconv_simd_detect();
+	uint32_t state          = 7;
+	for (int channels = 1; channels <= 3; ++channels) {
+		const int n = 1000 + channels;  // not multiple of vector width
+		std::vector<int16_t> s16(n * channels);
+		for (auto& s : s16) s = (int16_t)noise(state, 32767.0f);
+		s16[0] = INT16_MIN;
+		s16[1] = INT16_MAX;
+		std::vector<std::vector<float>> flt(channels, std::vector<float>(n));
+		for (auto& plane : flt)
+			for (int i = 0; i < n; ++i)  // exact halves check round to even
+				plane[i] = i % 5 == 0 ? (i - n / 2 + 0.5f) / 32768.0f : noise(state, 1.5f);
+		std::vector<const float*> flt_ptrs;
+		for (auto& plane : flt) flt_ptrs.push_back(plane.data());
+
+		std::vector<std::vector<float>> ref_flt(channels, std::vector<float>(n));
+		std::vector<int16_t> ref_s16(n * channels);
+		std::vector<float> ref_gain(flt[0]);
+		std::vector<float> ref_ramp(flt[0]);
+		std::vector<float> ref_mix(flt[0]);
+		float ref_peak   = 0.0f;
+		double ref_sumsq = 0.0;
+		for (int level = SCONV_SIMD_NONE; level <= detected; ++level) {
+			ASSERT_EQ(sconv_set_simd_level((SConvSimd)level), level);
+			std::vector<std::vector<float>> out_flt(channels, std::vector<float>(n));
+			std::vector<float*> out_ptrs;
+			for (auto& plane : out_flt) out_ptrs.push_back(plane.data());
+			std::vector<int16_t> out_s16(n * channels);
+			std::vector<float> gain(flt[0]);
+			sconv_s16_to_fltp(s16.data(), out_ptrs.data(), channels, n);
+			sconv_fltp_to_s16(flt_ptrs.data(), out_s16.data(), channels, n);
+			sconv_gain_flt(gain.data(), n, 0.3f);
+			std::vector<float> ramp(flt[0]);
+			sconv_gain_ramp_flt(ramp.data(), n, 0.9f, 0.2f);
+			std::vector<float> mix(flt[0]);
+			sconv_mix_flt(mix.data(), flt[channels - 1].data(), n, 0.7f);
+			float peak   = sconv_peak_flt(flt[channels - 1].data(), n);
+			double sumsq = sconv_sumsq_flt(flt[channels - 1].data(), n);
+			if (level == SCONV_SIMD_NONE) {
+				ref_flt   = out_flt;
+				ref_s16   = out_s16;
+				ref_gain  = gain;
+				ref_ramp  = ramp;
+				ref_mix   = mix;
+				ref_peak  = peak;
+				ref_sumsq = sumsq;
+				continue;
+			}
+			SCOPED_TRACE(sconv_simd_str((SConvSimd)level));
+			for (int c = 0; c < channels; ++c)
+				EXPECT_EQ(memcmp(out_flt[c].data(), ref_flt[c].data(), n * sizeof(float)), 0);
+			EXPECT_EQ(out_s16, ref_s16);
+			EXPECT_EQ(memcmp(gain.data(), ref_gain.data(), n * sizeof(float)), 0);
+			EXPECT_EQ(memcmp(ramp.data(), ref_ramp.data(), n * sizeof(float)), 0);
+			EXPECT_EQ(memcmp(mix.data(), ref_mix.data(), n * sizeof(float)), 0);
+			EXPECT_EQ(peak, ref_peak);
+			EXPECT_NEAR(sumsq, ref_sumsq, ref_sumsq * 1e-5);  // summation order differs
+		}
+	}
+	sconv_set_simd_level(detected);
+}
+
+TEST(SampleConvert, S16ToFltpMatchesFilterGraph) {
+	auto graph  = filter_audio(false, AV_SAMPLE_FMT_S16, kRate, AV_SAMPLE_FMT_FLTP);
+	auto direct = filter_audio(true, AV_SAMPLE_FMT_S16, kRate, AV_SAMPLE_FMT_FLTP);
+	ASSERT_FALSE(graph.empty());
+	EXPECT_EQ(direct, graph);
+}
+
+TEST(SampleConvert, FltpToS16MatchesFilterGraph) {
+	auto graph  = filter_audio(false, AV_SAMPLE_FMT_FLTP, kRate, AV_SAMPLE_FMT_S16);
+	auto direct = filter_audio(true, AV_SAMPLE_FMT_FLTP, kRate, AV_SAMPLE_FMT_S16);
+	ASSERT_FALSE(graph.empty());
+	EXPECT_EQ(direct, graph);
+}
+
+// resampler is the same libswresample in both cases, but graph feeds it in different chunks,
+// so only closeness is required
+TEST(SampleConvert, ResampleCloseToFilterGraph) {
+	auto graph  = filter_audio(false, AV_SAMPLE_FMT_S16, 44100, AV_SAMPLE_FMT_FLTP);
+	auto direct = filter_audio(true, AV_SAMPLE_FMT_S16, 44100, AV_SAMPLE_FMT_FLTP);
+	ASSERT_FALSE(graph.empty());
+	size_t nb_floats = std::min(graph.size(), direct.size()) / sizeof(float);
+	const float* a   = (const float*)graph.data();
+	const float* b   = (const float*)direct.data();
+	for (size_t i = 0; i < nb_floats; ++i) ASSERT_NEAR(a[i], b[i], 1e-5) << "sample " << i;
+}
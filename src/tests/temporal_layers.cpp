@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+}
+
+#include "codec_options.h"
+#include "config.h"
+
+// temporal layer patterns, layer tracking of encoder packets and decoding of VP8 L1T3 stream with
+// upper layers dropped
+
+static constexpr int kWidth  = 320;
+static constexpr int kHeight = 180;
+static constexpr int kFrames = 60;
+
+TEST(TemporalLayers, Patterns) {
+	const int l1t2[] = {0, 1, 0, 1, 0, 1, 0, 1};
+	const int l1t3[] = {0, 2, 1, 2, 0, 2, 1, 2};
+	for (int i = 0; i < 8; ++i) {
+		EXPECT_EQ(scodec_temporal_layer_id(1, i), 0);
+		EXPECT_EQ(scodec_temporal_layer_id(2, i), l1t2[i]);
+		EXPECT_EQ(scodec_temporal_layer_id(3, i), l1t3[i]);
+	}
+}
+
+TEST(TemporalLayers, TrackerFollowsSubmittedFrames) {
+	STemporalTracker tracker;
+	scodec_temporal_init(&tracker, 3);
+	for (int64_t pts = 0; pts < 4; ++pts) scodec_temporal_submit(&tracker, pts, false);
+	// packets come out late and some frames are dropped by encoder
+	EXPECT_EQ(scodec_temporal_packet(&tracker, 1, false), 2);
+	EXPECT_EQ(scodec_temporal_packet(&tracker, 3, false), 2);
+	EXPECT_EQ(scodec_temporal_packet(&tracker, 2, false), 1);
+	// forced keyframe restarts pattern
+	EXPECT_EQ(scodec_temporal_submit(&tracker, 4, false), 0);
+	EXPECT_EQ(scodec_temporal_submit(&tracker, 5, false), 2);
+	EXPECT_EQ(scodec_temporal_submit(&tracker, 6, true), 0);
+	EXPECT_EQ(scodec_temporal_submit(&tracker, 7, false), 2);
+	EXPECT_EQ(scodec_temporal_submit(&tracker, 8, false), 1);
+	EXPECT_EQ(scodec_temporal_packet(&tracker, 7, false), 2);
+	EXPECT_EQ(scodec_temporal_packet(&tracker, 8, false), 1);
+	// keyframes and unknown frames are never dropped
+	EXPECT_EQ(scodec_temporal_packet(&tracker, 5, true), 0);
+	EXPECT_EQ(scodec_temporal_packet(&tracker, 100, false), 0);
+	EXPECT_EQ(scodec_temporal_packet(&tracker, AV_NOPTS_VALUE, false), 0);
+	for (int64_t pts = 9; pts < 9 + SELECON_TEMPORAL_PENDING; ++pts)
+		scodec_temporal_submit(&tracker, pts, false);
+	EXPECT_EQ(scodec_temporal_packet(&tracker, 5, false), 0);
+}
+
+TEST(TemporalLayers, OnlyLibvpxEncoderIsLayered) {
+	SCodecOptions opts    = {};
+	opts.temporal_layers  = SELECON_MAX_TEMPORAL_LAYERS + 1;  // clamped
+	const AVCodec* vpx    = avcodec_find_encoder_by_name("libvpx");
+	const AVCodec* x264   = avcodec_find_encoder_by_name("libx264");
+	const AVCodec* vp8dec = avcodec_find_decoder(AV_CODEC_ID_VP8);
+	if (vpx != nullptr) {
+		EXPECT_EQ(scodec_temporal_layers(vpx, &opts), SELECON_MAX_TEMPORAL_LAYERS);
+	}
+	if (x264 != nullptr) {
+		EXPECT_EQ(scodec_temporal_layers(x264, &opts), 1);
+	}
+	if (vp8dec != nullptr) {
+		EXPECT_EQ(scodec_temporal_layers(vp8dec, &opts), 1);
+	}
+	opts.temporal_layers = 0;
+	if (vpx != nullptr) {
+		EXPECT_EQ(scodec_temporal_layers(vpx, &opts), 1);
+	}
+}
+
+TEST(TemporalLayers, BaseLayerDecodesAlone) {
+	const AVCodec* encoder = avcodec_find_encoder_by_name("libvpx");
+	const AVCodec* decoder = avcodec_find_decoder(AV_CODEC_ID_VP8);
+	if (encoder == nullptr || decoder == nullptr)
+		GTEST_SKIP() << "libvpx not available";
+	AVCodecContext* enc = avcodec_alloc_context3(encoder);
+	enc->pix_fmt        = AV_PIX_FMT_YUV420P;
+	enc->width          = kWidth;
+	enc->height         = kHeight;
+	enc->framerate      = av_make_q(30, 1);
+	enc->time_base      = av_make_q(1, 30);
+	SCodecOptions opts  = {};
+	ASSERT_EQ(scodec_options_preset(&opts, SCODEC_PRESET_CONFERENCE, enc), SELECON_OK);
+	opts.temporal_layers = 3;
+	opts.gop_size        = kFrames;  // single keyframe
+	ASSERT_EQ(scodec_open(enc, encoder, &opts), 0);
+	scodec_options_free(&opts);
+	AVCodecContext* dec = avcodec_alloc_context3(decoder);
+	ASSERT_EQ(avcodec_open2(dec, decoder, nullptr), 0);
+
+	AVPacket* packet = av_packet_alloc();
+	AVFrame* decoded = av_frame_alloc();
+	STemporalTracker tracker;
+	scodec_temporal_init(&tracker, 3);
+	int nb_packets = 0, nb_sent = 0, nb_decoded = 0;
+	for (int i = 0; i <= kFrames; ++i) {
+		AVFrame* frame = nullptr;
+		if (i < kFrames) {
+			frame         = av_frame_alloc();
+			frame->format = enc->pix_fmt;
+			frame->width  = kWidth;
+			frame->height = kHeight;
+			frame->pts    = i;
+			av_frame_get_buffer(frame, 0);
+			for (int p = 0; p < 3; ++p)
+				for (int y = 0; y < (p == 0 ? kHeight : kHeight / 2); ++y)
+					memset(frame->data[p] + y * frame->linesize[p],
+					       (i * 7 + y + p * 50) & 0xff,
+					       p == 0 ? kWidth : kWidth / 2);
+			scodec_temporal_submit(&tracker, frame->pts, false);
+		}
+		ASSERT_EQ(avcodec_send_frame(enc, frame), 0);
+		av_frame_free(&frame);
+		while (avcodec_receive_packet(enc, packet) == 0) {
+			++nb_packets;
+			bool keyframe = packet->flags & AV_PKT_FLAG_KEY;
+			if (scodec_temporal_packet(&tracker, packet->pts, keyframe) == 0) {
+				EXPECT_EQ(avcodec_send_packet(dec, packet), 0);
+				++nb_sent;
+				while (avcodec_receive_frame(dec, decoded) == 0) {
+					++nb_decoded;
+					av_frame_unref(decoded);
+				}
+			}
+			av_packet_unref(packet);
+		}
+	}
+	EXPECT_EQ(nb_packets, kFrames);
+	EXPECT_EQ(nb_sent, kFrames / 4);
+	EXPECT_EQ(nb_decoded, nb_sent);
+	av_frame_free(&decoded);
+	av_packet_free(&packet);
+	avcodec_free_context(&dec);
+	avcodec_free_context(&enc);
+}
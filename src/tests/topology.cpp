@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "config.h"
+#include "topology.h"
+
+// topology planner: mesh for small calls, fewest relays uplinks allow for bigger ones
+
+static constexpr uint32_t kMedia = 600;  // kbps per participant
+
+static STopologyNode node(part_id_t id,
+                          uint32_t uplink_kbps,
+                          uint32_t rtt_ms      = 20,
+                          uint8_t cpu_headroom = 80,
+                          bool can_relay       = true) {
+	STopologyNode node = {};
+	node.part_id       = id;
+	node.capacity      = {uplink_kbps, rtt_ms, cpu_headroom};
+	node.can_relay     = can_relay;
+	return node;
+}
+
+static std::vector<part_id_t> relays(const std::vector<STopologyNode>& nodes) {
+	std::vector<part_id_t> ids;
+	for (const STopologyNode& n : nodes)
+		if (n.relay)
+			ids.push_back(n.part_id);
+	return ids;
+}
+
+TEST(Topology, SmallCallStaysMesh) {
+	std::vector<STopologyNode> nodes;
+	for (part_id_t id = 1; id <= 4; ++id) nodes.push_back(node(id, 5000));
+	EXPECT_EQ(stopology_plan(nodes.data(), nodes.size(), kMedia), STOPOLOGY_MESH);
+	for (const STopologyNode& n : nodes) {
+		EXPECT_FALSE(n.relay);
+		EXPECT_EQ(n.relay_id, 0u);
+	}
+}
+
+TEST(Topology, NarrowUplinksUseSingleRelay) {
+	std::vector<STopologyNode> nodes;
+	for (part_id_t id = 1; id <= 5; ++id) nodes.push_back(node(id, 1000));
+	nodes.push_back(node(6, 50000));
+	ASSERT_EQ(stopology_plan(nodes.data(), nodes.size(), kMedia), STOPOLOGY_RELAY);
+	ASSERT_EQ(relays(nodes), std::vector<part_id_t>{6});
+	for (const STopologyNode& n : nodes) {
+		if (!n.relay) {
+			EXPECT_EQ(n.relay_id, 6u);
+		}
+	}
+}
+
+TEST(Topology, ThirtyParticipantsUseTwoLevelTree) {
+	std::vector<STopologyNode> nodes;
+	for (part_id_t id = 1; id <= 30; ++id) nodes.push_back(node(id, 200000));
+	// single relay would need 29 * 29 streams, two relays 14 * 29 + 15 each
+	ASSERT_GT(stopology_relay_load(30, 2, 14, kMedia), 200000u);
+	ASSERT_EQ(stopology_plan(nodes.data(), nodes.size(), kMedia), STOPOLOGY_TWO_LEVEL);
+	std::vector<part_id_t> ids = relays(nodes);
+	ASSERT_EQ(ids.size(), 3u);
+	std::map<part_id_t, int> groups;
+	for (const STopologyNode& n : nodes) {
+		if (n.relay) {
+			EXPECT_EQ(n.relay_id, 0u);
+			continue;
+		}
+		ASSERT_NE(std::find(ids.begin(), ids.end(), n.relay_id), ids.end());
+		++groups[n.relay_id];
+	}
+	for (auto [relay, size] : groups) {
+		EXPECT_EQ(size, 9);
+		EXPECT_LE(stopology_relay_load(30, 3, size, kMedia), 200000u);
+	}
+}
+
+TEST(Topology, BusyFarAndOrganiserDoNotRelay) {
+	std::vector<STopologyNode> nodes;
+	for (part_id_t id = 1; id <= 5; ++id) nodes.push_back(node(id, 1000));
+	nodes.push_back(node(6, 100000, 20, SELECON_TOPOLOGY_MIN_CPU_HEADROOM - 1));
+	nodes.push_back(node(7, 100000, SELECON_TOPOLOGY_MAX_RELAY_RTT + 1));
+	nodes.push_back(node(8, 100000, 20, 80, false));
+	nodes.push_back(node(9, 50000));
+	ASSERT_EQ(stopology_plan(nodes.data(), nodes.size(), kMedia), STOPOLOGY_RELAY);
+	EXPECT_EQ(relays(nodes), std::vector<part_id_t>{9});
+}
+
+TEST(Topology, MeshWhenNobodyCanRelay) {
+	std::vector<STopologyNode> nodes;
+	for (part_id_t id = 1; id <= 10; ++id) nodes.push_back(node(id, 0, 0, 0));  // not announced
+	EXPECT_EQ(stopology_plan(nodes.data(), nodes.size(), kMedia), STOPOLOGY_MESH);
+	EXPECT_TRUE(relays(nodes).empty());
+}
+
+TEST(Topology, FanOutFollowsUplink) {
+	EXPECT_EQ(stopology_fan_out(600, 1, kMedia), 1u);
+	EXPECT_EQ(stopology_fan_out(3000, 2, kMedia), 2u);
+	EXPECT_EQ(stopology_fan_out(500, 1, kMedia), 0u);
+	EXPECT_EQ(stopology_fan_out(1000000, 1, kMedia), (size_t)SELECON_WEBINAR_MAX_FANOUT);
+	EXPECT_EQ(stopology_fan_out(0, 1, kMedia), SELECON_DEFAULT_UPLINK_KBPS / kMedia);
+}
+
+TEST(Topology, ListenersFillShallowNodesFirst) {
+	// presenter with room for one listener, two listeners under it with room for more
+	std::vector<STreeNode> nodes = {
+	    {true, 600, 0, 1},
+	    {true, 3000, 1, 0},
+	    {true, 6000, 1, 0},
+	    {true, 100000, 2, 0},
+	};
+	EXPECT_EQ(stopology_pick_parent(nodes.data(), nodes.size(), 1, kMedia), 2u);
+	nodes[2].can_feed = false;  // in subtree of placed listener
+	EXPECT_EQ(stopology_pick_parent(nodes.data(), nodes.size(), 1, kMedia), 1u);
+	nodes[1].nb_children = 5;
+	EXPECT_EQ(stopology_pick_parent(nodes.data(), nodes.size(), 1, kMedia), 3u);
+	nodes[3].nb_children = SELECON_WEBINAR_MAX_FANOUT;
+	EXPECT_EQ(stopology_pick_parent(nodes.data(), nodes.size(), 1, kMedia), nodes.size());
+}
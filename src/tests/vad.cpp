@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/frame.h>
+
+#include "vad.h"
+}
+
+// level metering and voice/silence decisions with hangover
+
+static constexpr int kRate      = 48000;
+static constexpr int kChannels  = 2;
+static constexpr int kFrameSize = 1024;
+
+static AVFrame* sine_frame(AVSampleFormat fmt, double amplitude) {
+	AVFrame* frame     = av_frame_alloc();
+	frame->format      = fmt;
+	frame->sample_rate = kRate;
+	frame->nb_samples  = kFrameSize;
+	av_channel_layout_default(&frame->ch_layout, kChannels);
+	av_frame_get_buffer(frame, 0);
+	for (int i = 0; i < kFrameSize; ++i) {
+		double v = amplitude * sin(2 * M_PI * 1000.0 * i / kRate);
+		for (int c = 0; c < kChannels; ++c) {
+			if (fmt == AV_SAMPLE_FMT_S16)
+				((int16_t*)frame->data[0])[i * kChannels + c] = (int16_t)lrint(v * INT16_MAX);
+			else
+				((float*)frame->data[c])[i] = (float)v;
+		}
+	}
+	return frame;
+}
+
+TEST(Vad, MeasuresLevel) {
+	// full scale sine is 3 dB below full scale square
+	for (AVSampleFormat fmt : {AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_S16}) {
+		AVFrame* loud  = sine_frame(fmt, 1.0);
+		AVFrame* quiet = sine_frame(fmt, 0.01);
+		AVFrame* zero  = sine_frame(fmt, 0.0);
+		EXPECT_NEAR(svad_frame_level(loud), -3.0f, 0.1f);
+		EXPECT_NEAR(svad_frame_level(quiet), -43.0f, 0.1f);
+		EXPECT_EQ(svad_frame_level(zero), -100.0f);
+		av_frame_free(&loud);
+		av_frame_free(&quiet);
+		av_frame_free(&zero);
+	}
+}
+
+TEST(Vad, KeepsVoiceForHangover) {
+	SVad vad;
+	svad_init(&vad, -50.0f, 3 * kFrameSize);
+	AVFrame* voice   = sine_frame(AV_SAMPLE_FMT_FLTP, 0.1);
+	AVFrame* silence = sine_frame(AV_SAMPLE_FMT_FLTP, 0.0001);
+	EXPECT_FALSE(svad_process(&vad, silence));
+	EXPECT_TRUE(svad_process(&vad, voice));
+	for (int i = 0; i < 3; ++i) EXPECT_TRUE(svad_process(&vad, silence));
+	EXPECT_FALSE(svad_process(&vad, silence));
+	EXPECT_LT(vad.level, -50.0f);
+	EXPECT_TRUE(svad_process(&vad, voice));
+	av_frame_free(&voice);
+	av_frame_free(&silence);
+}
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+extern "C" {
+#include <libavutil/frame.h>
+
+#include "video_compositor.h"
+}
+
+// grid placement of participants and redrawing of changed tiles only
+
+static constexpr int kWidth  = 640;
+static constexpr int kHeight = 360;
+
+static AVFrame* solid_frame(int width, int height, uint8_t luma) {
+	AVFrame* frame = av_frame_alloc();
+	frame->format  = AV_PIX_FMT_YUV420P;
+	frame->width   = width;
+	frame->height  = height;
+	av_frame_get_buffer(frame, 0);
+	for (int y = 0; y < height; ++y) memset(frame->data[0] + y * frame->linesize[0], luma, width);
+	for (int p = 1; p <= 2; ++p)
+		for (int y = 0; y < height / 2; ++y)
+			memset(frame->data[p] + y * frame->linesize[p], 128, width / 2);
+	return frame;
+}
+
+class VideoCompositorTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		SCompositorLayout layout = {{kWidth, kHeight, 15}, 0};
+		ASSERT_EQ(scomp_init(&comp, &layout), SELECON_OK);
+		out = av_frame_alloc();
+	}
+
+	void TearDown() override {
+		av_frame_free(&out);
+		scomp_free(&comp);
+	}
+
+	void push(part_id_t part_id, uint8_t luma, int width = kWidth / 2, int height = kHeight / 2) {
+		AVFrame* frame = solid_frame(width, height, luma);
+		ASSERT_EQ(scomp_push(&comp, part_id, frame), SELECON_OK);
+		av_frame_free(&frame);
+	}
+
+	uint8_t luma(int x, int y) { return out->data[0][y * out->linesize[0] + x]; }
+
+	SVideoCompositor comp;
+	AVFrame* out;
+};
+
+TEST_F(VideoCompositorTest, NothingToShowWithoutSources) {
+	EXPECT_EQ(scomp_compose(&comp, out), AVERROR(EAGAIN));
+}
+
+TEST_F(VideoCompositorTest, PlacesSourcesInGrid) {
+	for (part_id_t id = 1; id <= 4; ++id) push(id, (uint8_t)(50 + id));
+	ASSERT_EQ(scomp_compose(&comp, out), 4);
+	ASSERT_EQ(out->width, kWidth);
+	ASSERT_EQ(out->height, kHeight);
+	EXPECT_EQ(luma(0, 0), 51);
+	EXPECT_EQ(luma(kWidth - 1, 0), 52);
+	EXPECT_EQ(luma(0, kHeight - 1), 53);
+	EXPECT_EQ(luma(kWidth - 1, kHeight - 1), 54);
+}
+
+TEST_F(VideoCompositorTest, RedrawsOnlyChangedTiles) {
+	for (part_id_t id = 1; id <= 4; ++id) push(id, 60);
+	ASSERT_EQ(scomp_compose(&comp, out), 4);
+	EXPECT_EQ(scomp_compose(&comp, out), 0);
+	push(2, 90);
+	ASSERT_EQ(scomp_compose(&comp, out), 1);
+	EXPECT_EQ(luma(0, 0), 60);
+	EXPECT_EQ(luma(kWidth - 1, 0), 90);
+	EXPECT_EQ(out->pts, 2);
+}
+
+TEST_F(VideoCompositorTest, RelayoutOnLeave) {
+	for (part_id_t id = 1; id <= 4; ++id) push(id, 70);
+	ASSERT_EQ(scomp_compose(&comp, out), 4);
+	scomp_remove_source(&comp, 4);
+	ASSERT_EQ(scomp_compose(&comp, out), 3);
+	EXPECT_EQ(luma(kWidth - 1, kHeight - 1), 16);  // freed cell is background
+}
+
+TEST_F(VideoCompositorTest, KeepsAspectRatio) {
+	push(1, 80, 320, 320);  // square source in 640x360 canvas
+	ASSERT_EQ(scomp_compose(&comp, out), 1);
+	ASSERT_EQ(comp.nb_tiles, 1u);
+	EXPECT_EQ(comp.tiles[0].height, kHeight);
+	EXPECT_EQ(comp.tiles[0].width, kHeight);
+	EXPECT_EQ(luma(0, kHeight / 2), 16);
+	EXPECT_NEAR(luma(kWidth / 2, kHeight / 2), 80, 1);  // scaled
+}